@@ -33,13 +33,9 @@ int main() {
 
     DiscreteGaussianGenerator dgg = DiscreteGaussianGenerator(4.0);
 
-    FVParams slow_params {
-        false,
-        opt::q, opt::p, opt::logn, opt::phim,
-        (opt::q/opt::p),
-        OPTIMIZED, std::make_shared<DiscreteGaussianGenerator>(dgg),
-        9
-    };
+    FVParams slow_params = MakeFVParams(g_param_sets[g_default_param_set], OPTIMIZED,
+            std::make_shared<DiscreteGaussianGenerator>(dgg), 9);
+    slow_params.fast_modulli = false;
 
     FVParams fast_params = slow_params;
     fast_params.fast_modulli = true;
@@ -64,10 +60,11 @@ int main() {
         index_list.push_back(opt::phim/2-i);
     }
 
+    AutomorphismKeys keys;
     start = currentDateTime();
     for(ui64 i=0; i < nRep; i++){
         kp = KeyGen(test_params);
-        EvalAutomorphismKeyGen(kp.sk, index_list, test_params);
+        keys = EvalAutomorphismKeyGen(kp.sk, index_list, test_params);
     }
     stop = currentDateTime();
     std::cout << " KeyGen ("<< index_list.size() <<" keys): " << (stop-start)/nRep << std::endl;
@@ -96,10 +93,10 @@ int main() {
     std::cout << " Preprocess Filter: " << (stop-start)/nRep << std::endl;
 
     //--------------------- Conv1D (Rot) --------------------
-    auto ct_conv_rot = conv_1d_rot(ct_vec, enc_filter.size(), test_params);
+    auto ct_conv_rot = conv_1d_rot(ct_vec, enc_filter.size(), keys, test_params);
     start = currentDateTime();
     for(ui64 i=0; i < nRep; i++){
-        ct_conv_rot = conv_1d_rot(ct_vec, enc_filter.size(), test_params);
+        ct_conv_rot = conv_1d_rot(ct_vec, enc_filter.size(), keys, test_params);
     }
     stop = currentDateTime();
     std::cout << " Conv1D: " << (stop-start)/nRep << std::endl;
@@ -114,10 +111,10 @@ int main() {
     std::cout << " Conv1D: " << (stop-start)/nRep << std::endl;
 
     //------------------------ Conv1D ----------------------
-    auto ct_conv_1d = conv_1d_online(ct_vec, enc_filter, test_params);
+    auto ct_conv_1d = conv_1d_online(ct_vec, enc_filter, keys, test_params);
     start = currentDateTime();
     for(ui64 i=0; i < nRep; i++){
-        ct_conv_1d = conv_1d_online(ct_vec, enc_filter, test_params);
+        ct_conv_1d = conv_1d_online(ct_vec, enc_filter, keys, test_params);
     }
     stop = currentDateTime();
     std::cout << " Conv1D: " << (stop-start)/nRep << std::endl;
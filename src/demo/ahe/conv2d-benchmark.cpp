@@ -11,8 +11,12 @@ Copyright (c) 2017, Massachusetts Institute of Technology (MIT)
 */
 
 #include <utils/backend.h>
+#include <cstdio>
 #include <iostream>
 #include <random>
+#include <stdexcept>
+#include <stdlib.h>
+#include <unistd.h>
 #include "pke/gazelle.h"
 
 using namespace std;
@@ -34,13 +38,9 @@ int main() {
 
     DiscreteGaussianGenerator dgg = DiscreteGaussianGenerator(4.0);
 
-    FVParams slow_params {
-        false,
-        opt::q, opt::p, opt::logn, opt::phim,
-        (opt::q/opt::p),
-        OPTIMIZED, std::make_shared<DiscreteGaussianGenerator>(dgg),
-        8
-    };
+    FVParams slow_params = MakeFVParams(g_param_sets[g_default_param_set], OPTIMIZED,
+            std::make_shared<DiscreteGaussianGenerator>(dgg), 8);
+    slow_params.fast_modulli = false;
 
     FVParams fast_params = slow_params;
     fast_params.fast_modulli = true;
@@ -142,10 +142,11 @@ int main() {
         index_list.push_back(opt::phim/2);
     }
 
+    AutomorphismKeys keys;
     start = currentDateTime();
     for(ui64 i=0; i < nRep; i++){
         kp = KeyGen(test_params);
-        EvalAutomorphismKeyGen(kp.sk, index_list, test_params);
+        keys = EvalAutomorphismKeyGen(kp.sk, index_list, test_params);
     }
     stop = currentDateTime();
     std::cout << " KeyGen ("<< index_list.size() <<" keys): " << (stop-start)/nRep << std::endl;
@@ -169,6 +170,24 @@ int main() {
     //std::cout << vec_to_str(enc_filter[0][0]) << std::endl;
     //std::cout << vec_to_str(enc_filter[0][1]) << std::endl;
 
+    //----------------- Map Cached Filter ------------------
+    char filter_cache[] = "/tmp/conv2d-benchmark-XXXXXX";
+    int cache_fd = mkstemp(filter_cache);
+    if (cache_fd < 0) {
+        throw std::runtime_error("Could not create a cache file");
+    }
+    close(cache_fd);
+    EncMatCacheId filter_id {conv_type, pt_window_size, (ui32)enc_filter.size(),
+            (ui32)enc_filter[0].size()};
+    SaveEncMat(filter_cache, enc_filter, filter_id, test_params);
+    start = currentDateTime();
+    for(ui64 i=0; i < nRep; i++){
+        MappedEncMat mapped_filter(filter_cache, filter_id, test_params);
+    }
+    stop = currentDateTime();
+    std::remove(filter_cache);
+    std::cout << " Map Cached Filter: " << (stop-start)/nRep << std::endl;
+
     //----------------- Preprocess Vector ------------------
     auto ct_mat = preprocess_ifmap(kp.sk, ifmap, pt_window_size, pt_num_windows, test_params);
     start = currentDateTime();
@@ -186,13 +205,13 @@ int main() {
 
     //------------------------ Conv2D ----------------------
     auto ct_conv = (conv_type) ?
-            conv_2d_2stage_online(ct_mat, enc_filter, filter.shape, ifmap.shape, test_params):
-            conv_2d_online(ct_mat, enc_filter, filter.shape, ifmap.shape, test_params);
+            conv_2d_2stage_online(ct_mat, enc_filter, filter.shape, ifmap.shape, keys, test_params):
+            conv_2d_online(ct_mat, enc_filter, filter.shape, ifmap.shape, keys, test_params);
     start = currentDateTime();
     for(ui64 i=0; i < nRep; i++){
         ct_conv = (conv_type) ?
-                    conv_2d_2stage_online(ct_mat, enc_filter, filter.shape, ifmap.shape, test_params):
-                    conv_2d_online(ct_mat, enc_filter, filter.shape, ifmap.shape, test_params);
+                    conv_2d_2stage_online(ct_mat, enc_filter, filter.shape, ifmap.shape, keys, test_params):
+                    conv_2d_online(ct_mat, enc_filter, filter.shape, ifmap.shape, keys, test_params);
     }
     stop = currentDateTime();
     std::cout << " Conv2D: " << (stop-start)/nRep << std::endl;
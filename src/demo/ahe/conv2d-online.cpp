@@ -26,8 +26,9 @@ using namespace osuCrypto;
 std::string addr = "localhost";
 ui32 out_chn = 5, in_chn = 4, in_h = 14, in_w = 14;
 ui32 f_h = 3, f_w = 3;
-ui32 window_size = 9, conv_type = 0;
-ui32 pt_window_size = 10, pt_num_windows = 2;
+ui32 conv_type = 0;
+// Chosen by PlanWindows in main
+ui32 window_size, pt_window_size, pt_num_windows;
 ui32 num_rep = 100;
 
 
@@ -35,14 +36,8 @@ void ahe_client(){
     std::cout << "Client" << std::endl;
 
     DiscreteGaussianGenerator dgg = DiscreteGaussianGenerator(4.0);
-    FVParams test_params {
-        true,
-        opt::q, opt::p, opt::logn, opt::phim,
-        (opt::q/opt::p),
-        OPTIMIZED, std::make_shared<DiscreteGaussianGenerator>(dgg),
-        window_size
-    };
-    ui32 num_windows = 1 + floor(log2(test_params.q))/test_params.window_size;
+    FVParams test_params = MakeFVParams(g_param_sets[g_default_param_set], OPTIMIZED,
+            std::make_shared<DiscreteGaussianGenerator>(dgg), window_size);
 
     // get up the networking
     IOService ios(0);
@@ -109,14 +104,13 @@ void ahe_client(){
         }
     }
 
-    EvalAutomorphismKeyGen(kp.sk, index_list, test_params);
-    for(ui32 n=0; n<index_list.size(); n++){
-        auto rk = g_rk_map[index_list[n]];
-        for(ui32 w=0; w<num_windows; w++){
-            chl.send(rk->a[w]);
-            chl.send(rk->b[w]);
-        }
-    }
+    // The a rows of the keys are expanded from their seeds on the server.
+    // Each key is sent as soon as it is done, the server expands it while
+    // the rest are generated.
+    EvalAutomorphismKeyGenSeeded(kp.sk, index_list, test_params,
+            [&](const ui32 n, const SeededRelinKey& rk){
+        chl.asyncSend(Pack(rk, test_params));
+    });
 
     std::cout
         << "      Sent: " << chl.getTotalDataSent() << std::endl
@@ -126,19 +120,15 @@ void ahe_client(){
     time.setTimePoint("setup");
 
     for(ui32 rep=0; rep<num_rep; rep++){
-        auto ct_mat = preprocess_ifmap(kp.sk, ifmap, pt_window_size, pt_num_windows, test_params);
-        for(ui32 w=0; w<ct_mat.size(); w++){
-            for(ui32 n=0; n<ct_mat[0].size(); n++){
-                chl.send(ct_mat[w][n].a);
-                chl.send(ct_mat[w][n].b);
-            }
-        }
-
-        CTVec ct_conv(out_ct, Ciphertext(opt::phim));
-        for(ui32 n=0; n<ct_conv.size(); n++){
-            chl.recv(ct_conv[n].a);
-            chl.recv(ct_conv[n].b);
-        }
+        // Only the seeds of a and the b halves go over the wire
+        auto ct_mat = preprocess_ifmap_seeded(kp.sk, ifmap, pt_window_size, pt_num_windows, test_params);
+        chl.asyncSend(Pack(ct_mat, test_params));
+
+        // The results come back switched to a small modulus
+        CompressedCTVec ct_conv(out_ct, CompressedCiphertext(opt::phim, ModSwitchBits(test_params)));
+        uv64 buf;
+        chl.recv(buf);
+        Unpack(buf, ct_conv);
         auto ofmap = postprocess_conv(kp.sk, ct_conv, output_shape, test_params);
     }
 
@@ -161,13 +151,8 @@ void ahe_server(){
     std::cout << "Server" << std::endl;
 
     DiscreteGaussianGenerator dgg = DiscreteGaussianGenerator(4.0);
-    FVParams test_params {
-        true,
-        opt::q, opt::p, opt::logn, opt::phim,
-        (opt::q/opt::p),
-        OPTIMIZED, std::make_shared<DiscreteGaussianGenerator>(dgg),
-        window_size
-    };
+    FVParams test_params = MakeFVParams(g_param_sets[g_default_param_set], OPTIMIZED,
+            std::make_shared<DiscreteGaussianGenerator>(dgg), window_size);
     ui32 num_windows = 1 + floor(log2(test_params.q))/test_params.window_size;
 
     // get up the networking
@@ -237,32 +222,37 @@ void ahe_server(){
         }
     }
 
+    // A server holds the keys of each client in a session of its own
+    KeyStore key_store(test_params);
+    const SessionId session = 0;
+    SeededRelinKey rk(test_params.phim, num_windows);
     for(ui32 n=0; n<index_list.size(); n++){
-        RelinKey rk(test_params.phim, num_windows);
-        for(ui32 w=0; w<num_windows; w++){
-            chl.recv(rk.a[w]);
-            chl.recv(rk.b[w]);
-        }
-        g_rk_map[index_list[n]] =std::make_shared<RelinKey>(rk);
+        uv64 rk_buf;
+        chl.recv(rk_buf);
+        Unpack(rk_buf, rk, test_params);
+        key_store.Add(session, {index_list[n]}, {rk});
     }
 
+    // The scratch of each request is carved from one arena, recycled on
+    // the next request
+    Arena arena(1 << 24, true);
     time.setTimePoint("setup");
     for(ui32 rep=0; rep<num_rep; rep++){
-        CTMat ct_mat(pt_num_windows, std::vector<Ciphertext>(in_ct, Ciphertext(test_params.phim)));
-        for(ui32 w=0; w<ct_mat.size(); w++){
-            for(ui32 n=0; n<ct_mat[0].size(); n++){
-                chl.recv(ct_mat[w][n].a);
-                chl.recv(ct_mat[w][n].b);
-            }
-        }
-
+        arena.reset();
+        SeededCTMat ct_seeded(pt_num_windows,
+                std::vector<SeededCiphertext>(in_ct, SeededCiphertext(test_params.phim)));
+        uv64 buf;
+        chl.recv(buf);
+        Unpack(buf, ct_seeded, test_params);
+        auto ct_mat = Expand(ct_seeded, test_params);
+
+        auto keys = key_store.Acquire(session);
         auto ct_conv = (conv_type) ?
-                conv_2d_2stage_online(ct_mat, enc_filter, filter.shape, ifmap_shape, test_params):
-                conv_2d_online(ct_mat, enc_filter, filter.shape, ifmap_shape, test_params);
-        for(ui32 n=0; n<ct_conv.size(); n++){
-            chl.send(ct_conv[n].a);
-            chl.send(ct_conv[n].b);
-        }
+                conv_2d_2stage_online(ct_mat, enc_filter, filter.shape, ifmap_shape, *keys,
+                        test_params, &arena):
+                conv_2d_online(ct_mat, enc_filter, filter.shape, ifmap_shape, *keys, test_params,
+                        &arena);
+        chl.send(Pack(ModSwitch(ct_conv, ModSwitchBits(test_params), test_params)));
     }
     time.setTimePoint("online");
 
@@ -277,13 +267,34 @@ void ahe_server(){
 }
 
 int main(int argc, char** argv) {
-    std::cin >> out_chn >> in_chn >> in_h >> in_w >> f_w >> f_h >> window_size >> conv_type;
+    std::cin >> out_chn >> in_chn >> in_h >> in_w >> f_w >> f_h >> conv_type;
 
     ftt_precompute(opt::z, opt::q, opt::logn);
     ftt_precompute(opt::z_p, opt::p, opt::logn);
     encoding_precompute(opt::p, opt::logn);
     precompute_automorph_index(opt::phim);
 
+    // The widest windows that leave the noise margin, both parties plan the
+    // same from the shapes
+    DiscreteGaussianGenerator dgg = DiscreteGaussianGenerator(4.0);
+    // The key switching window is the planner's to pick
+    FVParams plan_params = MakeFVParams(g_param_sets[g_default_param_set], OPTIMIZED,
+            std::make_shared<DiscreteGaussianGenerator>(dgg), 1);
+    auto plan = PlanWindows([](const ui32 pt_window_size, const ui32 pt_num_windows,
+            const FVParams& params){
+        Filter2DShape filter_shape(out_chn, in_chn, f_h, f_w);
+        ConvShape in_shape(in_chn, in_h, in_w);
+        auto noise = (conv_type) ?
+                conv_2d_2stage_noise(filter_shape, in_shape, pt_window_size, pt_num_windows, params):
+                conv_2d_noise(filter_shape, in_shape, pt_window_size, pt_num_windows, params);
+        return EstimateModSwitch(noise, ModSwitchBits(params), params);
+    }, plan_params);
+    window_size = plan.window_size;
+    pt_window_size = plan.pt_window_size;
+    pt_num_windows = plan.pt_num_windows;
+    std::cout << "Windows: " << pt_num_windows << "x" << pt_window_size << " bits, key switching "
+        << window_size << " bits, margin " << plan.margin << std::endl;
+
     if (argc == 1)
     {
         std::vector<std::thread> thrds(2);
@@ -30,13 +30,9 @@ int main() {
 
     DiscreteGaussianGenerator dgg = DiscreteGaussianGenerator(4.0);
 
-    FVParams slow_params {
-        false,
-        opt::q, opt::p, opt::logn, opt::phim,
-        (opt::q/opt::p),
-        OPTIMIZED, std::make_shared<DiscreteGaussianGenerator>(dgg),
-        20
-    };
+    FVParams slow_params = MakeFVParams(g_param_sets[g_default_param_set], OPTIMIZED,
+            std::make_shared<DiscreteGaussianGenerator>(dgg), 20);
+    slow_params.fast_modulli = false;
 
     FVParams test_params = slow_params;
 
@@ -34,13 +34,9 @@ int main() {
 
     DiscreteGaussianGenerator dgg = DiscreteGaussianGenerator(4.0);
 
-    FVParams slow_params {
-        false,
-        opt::q, opt::p, opt::logn, opt::phim,
-        (opt::q/opt::p),
-        OPTIMIZED, std::make_shared<DiscreteGaussianGenerator>(dgg),
-        20
-    };
+    FVParams slow_params = MakeFVParams(g_param_sets[g_default_param_set], OPTIMIZED,
+            std::make_shared<DiscreteGaussianGenerator>(dgg), 20);
+    slow_params.fast_modulli = false;
     uv32 windows = {20, 10, 5};
 
     FVParams test_params = slow_params;
@@ -63,18 +59,19 @@ int main() {
                 index_list[i] = index;
                 index = index*2;
             }
+            AutomorphismKeys keys;
             start = currentDateTime();
             for(ui64 i=0; i < nRep; i++){
-                EvalAutomorphismKeyGen(kp.sk, index_list, test_params);
+                keys = EvalAutomorphismKeyGen(kp.sk, index_list, test_params);
             }
             stop = currentDateTime();
             std::cout << " Relin KeyGen ("<< index_list.size() <<" keys): " << (stop-start)/nRep << std::endl;
 
             //------------------- EvalAutomorph --------------------
             start = currentDateTime();
-            auto ct_rot = EvalAutomorphism(rot, ct1, test_params);
+            auto ct_rot = EvalAutomorphism(rot, keys, ct1, test_params);
             for(ui64 i=0; i < nRep; i++){
-                ct_rot = EvalAutomorphism(rot, ct1, test_params);
+                ct_rot = EvalAutomorphism(rot, keys, ct1, test_params);
             }
             stop = currentDateTime();
             std::cout << " Automorph: " << (stop-start)/nRep << std::endl;
@@ -91,8 +88,8 @@ int main() {
             //----------------- DecomposedAutomorph ----------------
             start = currentDateTime();
             for(ui64 i=0; i < nRep; i++){
-                const auto rk = GetAutomorphismKey(rot);
-                auto ct_rotd =  EvalAutomorphismDigits(rot, *rk, ct1, digits_ct1, test_params);
+                const auto& rk = GetAutomorphismKey(keys, rot);
+                auto ct_rotd =  EvalAutomorphismDigits(rot, rk, ct1, digits_ct1, test_params);
             }
             stop = currentDateTime();
             std::cout << " DecomposedAutomorph: " << (stop-start)/nRep << std::endl;
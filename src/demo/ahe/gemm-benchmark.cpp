@@ -35,13 +35,9 @@ int main() {
 
     DiscreteGaussianGenerator dgg = DiscreteGaussianGenerator(4.0);
 
-    FVParams slow_params {
-        false,
-        opt::q, opt::p, opt::logn, opt::phim,
-        (opt::q/opt::p),
-        OPTIMIZED, std::make_shared<DiscreteGaussianGenerator>(dgg),
-        8
-    };
+    FVParams slow_params = MakeFVParams(g_param_sets[g_default_param_set], OPTIMIZED,
+            std::make_shared<DiscreteGaussianGenerator>(dgg), 8);
+    slow_params.fast_modulli = false;
 
     FVParams fast_params = slow_params;
     fast_params.fast_modulli = true;
@@ -87,10 +83,11 @@ int main() {
         // index_list.push_back(i+(opt::phim/2));
     }
 
+    AutomorphismKeys keys;
     start = currentDateTime();
     for(ui64 i=0; i < nRep; i++){
         kp = KeyGen(test_params);
-        EvalAutomorphismKeyGen(kp.sk, index_list, test_params);
+        keys = EvalAutomorphismKeyGen(kp.sk, index_list, test_params);
     }
     stop = currentDateTime();
     std::cout << " KeyGen ("<< index_list.size() <<" keys): " << (stop-start)/nRep << std::endl;
@@ -120,10 +117,10 @@ int main() {
     //--------------------- Multiply -----------------------
     CTVec ct_prod;
     if(rows_per_ct > 1){
-        //ct_prod = gemm_online(ct_mat_c, enc_mat_s, num_cols_c, test_params);
+        //ct_prod = gemm_online(ct_mat_c, enc_mat_s, num_cols_c, keys, test_params);
         start = currentDateTime();
         for(ui64 i=0; i < nRep; i++){
-            ct_prod = gemm_online(ct_mat_c, enc_mat_s, num_cols_c, test_params);
+            ct_prod = gemm_online(ct_mat_c, enc_mat_s, num_cols_c, keys, test_params);
         }
         stop = currentDateTime();
 
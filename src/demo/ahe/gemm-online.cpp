@@ -25,25 +25,19 @@ using namespace osuCrypto;
 
 std::string addr = "localhost";
 ui32 num_rep = 2;
-ui32 window_size = 20;
+// Chosen by PlanWindows in main
+ui32 window_size, mat_window_size, mat_num_windows;
 ui32 n1_n3 = 128, n2 = 128;
 ui32 num_rows_s = n1_n3, num_cols_s = n2;
 ui32 num_rows_c = n2, num_cols_c = n1_n3;
-ui32 mat_window_size = 20, mat_num_windows = 1;
 
 
 void ahe_client(){
     std::cout << "Client" << std::endl;
 
     DiscreteGaussianGenerator dgg = DiscreteGaussianGenerator(4.0);
-    FVParams test_params {
-        true,
-        opt::q, opt::p, opt::logn, opt::phim,
-        (opt::q/opt::p),
-        OPTIMIZED, std::make_shared<DiscreteGaussianGenerator>(dgg),
-        window_size
-    };
-    ui32 num_windows = 1 + floor(log2(test_params.q))/test_params.window_size;
+    FVParams test_params = MakeFVParams(g_param_sets[g_default_param_set], OPTIMIZED,
+            std::make_shared<DiscreteGaussianGenerator>(dgg), window_size);
 
     // get up the networking
     IOService ios(0);
@@ -68,14 +62,13 @@ void ahe_client(){
             index_list.push_back(test_params.phim-i*num_cols_c);
         }
 
-        EvalAutomorphismKeyGen(kp.sk, index_list, test_params);
-        for(ui32 n=0; n<index_list.size(); n++){
-            auto rk = g_rk_map[index_list[n]];
-            for(ui32 w=0; w<num_windows; w++){
-                chl.send(rk->a[w]);
-                chl.send(rk->b[w]);
-            }
-        }
+        // The a rows of the keys are expanded from their seeds on the server.
+        // Each key is sent as soon as it is done, the server expands it while
+        // the rest are generated.
+        EvalAutomorphismKeyGenSeeded(kp.sk, index_list, test_params,
+                [&](const ui32 n, const SeededRelinKey& rk){
+            chl.asyncSend(Pack(rk, test_params));
+        });
 
         if(rep == 0) {
             std::cout
@@ -87,18 +80,14 @@ void ahe_client(){
         time.setTimePoint("setup");
 
         auto ct_mat_c = preprocess_gemm_c(kp.sk, mat_c, mat_window_size, mat_num_windows, test_params);
-        for(ui32 n=0; n<ct_mat_c.size(); n++){
-            for(ui32 m=0; m<ct_mat_c[0].size(); m++){
-                chl.send(ct_mat_c[n][m].a);
-                chl.send(ct_mat_c[n][m].b);
-            }
-        }
+        chl.asyncSend(Pack(ct_mat_c, test_params));
 
-        CTVec ct_prod(num_rows_s/rows_per_ct, Ciphertext(opt::phim));
-        for(ui32 n=0; n<ct_prod.size(); n++){
-            chl.recv(ct_prod[n].a);
-            chl.recv(ct_prod[n].b);
-        }
+        // The results come back switched to a small modulus
+        CompressedCTVec ct_prod(num_rows_s/rows_per_ct,
+                CompressedCiphertext(opt::phim, ModSwitchBits(test_params)));
+        uv64 buf;
+        chl.recv(buf);
+        Unpack(buf, ct_prod);
 
         auto prod = postprocess_gemm(kp.sk, ct_prod, num_rows_s, num_cols_c, test_params);
 
@@ -125,13 +114,8 @@ void ahe_server(){
     std::cout << "Server" << std::endl;
 
     DiscreteGaussianGenerator dgg = DiscreteGaussianGenerator(4.0);
-    FVParams test_params {
-        true,
-        opt::q, opt::p, opt::logn, opt::phim,
-        (opt::q/opt::p),
-        OPTIMIZED, std::make_shared<DiscreteGaussianGenerator>(dgg),
-        window_size
-    };
+    FVParams test_params = MakeFVParams(g_param_sets[g_default_param_set], OPTIMIZED,
+            std::make_shared<DiscreteGaussianGenerator>(dgg), window_size);
     ui32 num_windows = 1 + floor(log2(test_params.q))/test_params.window_size;
 
     // get up the networking
@@ -155,13 +139,15 @@ void ahe_server(){
             index_list.push_back(test_params.phim-i*num_cols_c);
         }
 
+        // A server holds the keys of each client in a session of its own
+        KeyStore key_store(test_params);
+        const SessionId session = 0;
+        SeededRelinKey rk(test_params.phim, num_windows);
         for(ui32 n=0; n<index_list.size(); n++){
-            RelinKey rk(test_params.phim, num_windows);
-            for(ui32 w=0; w<num_windows; w++){
-                chl.recv(rk.a[w]);
-                chl.recv(rk.b[w]);
-            }
-            g_rk_map[index_list[n]] =std::make_shared<RelinKey>(rk);
+            uv64 rk_buf;
+            chl.recv(rk_buf);
+            Unpack(rk_buf, rk, test_params);
+            key_store.Add(session, {index_list[n]}, {rk});
         }
 
         EncMat enc_mat_s;
@@ -171,24 +157,19 @@ void ahe_server(){
         time.setTimePoint("setup");
 
         CTMat ct_mat_c(num_rows_c/rows_per_ct, std::vector<Ciphertext>(mat_num_windows, Ciphertext(opt::phim)));
-        for(ui32 n=0; n<ct_mat_c.size(); n++){
-            for(ui32 m=0; m<ct_mat_c[0].size(); m++){
-                chl.recv(ct_mat_c[n][m].a);
-                chl.recv(ct_mat_c[n][m].b);
-            }
-        }
+        uv64 buf;
+        chl.recv(buf);
+        Unpack(buf, ct_mat_c, test_params);
 
         CTVec ct_prod;
         if(rows_per_ct > 1){
-            ct_prod = gemm_online(ct_mat_c, enc_mat_s, num_cols_c, test_params);
+            auto keys = key_store.Acquire(session);
+            ct_prod = gemm_online(ct_mat_c, enc_mat_s, num_cols_c, *keys, test_params);
         } else {
             ct_prod = gemm_phim_online(ct_mat_c, mat_s_t, mat_window_size, mat_num_windows, test_params);
         }
 
-        for(ui32 n=0; n<ct_prod.size(); n++){
-            chl.send(ct_prod[n].a);
-            chl.send(ct_prod[n].b);
-        }
+        chl.send(Pack(ModSwitch(ct_prod, ModSwitchBits(test_params), test_params)));
         time.setTimePoint("online");
 
         if(rep != 0)
@@ -211,6 +192,25 @@ int main(int argc, char** argv) {
     encoding_precompute(opt::p, opt::logn);
     precompute_automorph_index(opt::phim);
 
+    // The widest windows that leave the noise margin, both parties plan the
+    // same from the shapes
+    DiscreteGaussianGenerator dgg = DiscreteGaussianGenerator(4.0);
+    // The key switching window is the planner's to pick
+    FVParams plan_params = MakeFVParams(g_param_sets[g_default_param_set], OPTIMIZED,
+            std::make_shared<DiscreteGaussianGenerator>(dgg), 1);
+    auto plan = PlanWindows([](const ui32 pt_window_size, const ui32 pt_num_windows,
+            const FVParams& params){
+        auto noise = (params.phim/num_cols_c > 1) ?
+                gemm_noise(num_rows_c, num_cols_c, pt_window_size, pt_num_windows, params):
+                gemm_phim_noise(num_rows_c, num_cols_c, pt_window_size, pt_num_windows, params);
+        return EstimateModSwitch(noise, ModSwitchBits(params), params);
+    }, plan_params);
+    window_size = plan.window_size;
+    mat_window_size = plan.pt_window_size;
+    mat_num_windows = plan.pt_num_windows;
+    std::cout << "Windows: " << mat_num_windows << "x" << mat_window_size << " bits, key switching "
+        << window_size << " bits, margin " << plan.margin << std::endl;
+
     if (argc == 1)
     {
         std::vector<std::thread> thrds(2);
@@ -34,13 +34,9 @@ int main() {
 
     DiscreteGaussianGenerator dgg = DiscreteGaussianGenerator(4.0);
 
-    FVParams slow_params {
-        false,
-        opt::q, opt::p, opt::logn, opt::phim,
-        (opt::q/opt::p),
-        OPTIMIZED, std::make_shared<DiscreteGaussianGenerator>(dgg),
-        8
-    };
+    FVParams slow_params = MakeFVParams(g_param_sets[g_default_param_set], OPTIMIZED,
+            std::make_shared<DiscreteGaussianGenerator>(dgg), 8);
+    slow_params.fast_modulli = false;
 
     FVParams fast_params = slow_params;
     fast_params.fast_modulli = true;
@@ -72,10 +68,11 @@ int main() {
         index_list.push_back(i);
     }
 
+    AutomorphismKeys keys;
     start = currentDateTime();
     for(ui64 i=0; i < nRep; i++){
         kp = KeyGen(test_params);
-        EvalAutomorphismKeyGen(kp.sk, index_list, test_params);
+        keys = EvalAutomorphismKeyGen(kp.sk, index_list, test_params);
     }
     stop = currentDateTime();
     std::cout << " KeyGen ("<< index_list.size() <<" keys): " << (stop-start)/nRep << std::endl;
@@ -102,10 +99,10 @@ int main() {
     std::cout << " Preprocess Matrix ("<< num_rows <<" rows): " << (stop-start)/nRep << std::endl;
 
     //--------------------- Multiply -----------------------
-    auto ct_prod = mat_mul_online(ct_vec, enc_mat, num_cols, test_params);
+    auto ct_prod = mat_mul_online(ct_vec, enc_mat, num_cols, keys, test_params);
     start = currentDateTime();
     for(ui64 i=0; i < nRep; i++){
-        ct_prod = mat_mul_online(ct_vec, enc_mat, num_cols, test_params);
+        ct_prod = mat_mul_online(ct_vec, enc_mat, num_cols, keys, test_params);
     }
     stop = currentDateTime();
     std::cout << " Multiply: " << (stop-start)/nRep << std::endl;
@@ -24,8 +24,9 @@ using namespace lbcrypto;
 using namespace osuCrypto;
 
 std::string addr = "localhost";
-ui32 num_rows = 100, num_cols = 980, window_size = 9;
-ui32 mat_window_size = 10, mat_num_windows = 2;
+ui32 num_rows = 100, num_cols = 980;
+// Chosen by PlanWindows in main
+ui32 window_size, mat_window_size, mat_num_windows;
 ui32 num_rep = 100;
 
 
@@ -33,14 +34,8 @@ void ahe_client(){
     std::cout << "Client" << std::endl;
 
     DiscreteGaussianGenerator dgg = DiscreteGaussianGenerator(4.0);
-    FVParams test_params {
-        true,
-        opt::q, opt::p, opt::logn, opt::phim,
-        (opt::q/opt::p),
-        OPTIMIZED, std::make_shared<DiscreteGaussianGenerator>(dgg),
-        window_size
-    };
-    ui32 num_windows = 1 + floor(log2(test_params.q))/test_params.window_size;
+    FVParams test_params = MakeFVParams(g_param_sets[g_default_param_set], OPTIMIZED,
+            std::make_shared<DiscreteGaussianGenerator>(dgg), window_size);
 
     // get up the networking
     IOService ios(0);
@@ -64,14 +59,13 @@ void ahe_client(){
         index_list.push_back(i);
     }
 
-    EvalAutomorphismKeyGen(kp.sk, index_list, test_params);
-    for(ui32 n=0; n<index_list.size(); n++){
-        auto rk = g_rk_map[index_list[n]];
-        for(ui32 w=0; w<num_windows; w++){
-            chl.send(rk->a[w]);
-            chl.send(rk->b[w]);
-        }
-    }
+    // The a rows of the keys are expanded from their seeds on the server.
+    // Each key is sent as soon as it is done, the server expands it while
+    // the rest are generated.
+    EvalAutomorphismKeyGenSeeded(kp.sk, index_list, test_params,
+            [&](const ui32 n, const SeededRelinKey& rk){
+        chl.asyncSend(Pack(rk, test_params));
+    });
 
     std::cout
         << "      Sent: " << chl.getTotalDataSent() << std::endl
@@ -81,15 +75,15 @@ void ahe_client(){
     time.setTimePoint("setup");
 
     for(ui32 rep=0; rep<num_rep; rep++){
-        auto ct_vec = preprocess_vec(kp.sk, vec, mat_window_size, mat_num_windows, test_params);
-        for(ui32 n=0; n<ct_vec.size(); n++){
-            chl.send(ct_vec[n].a);
-            chl.send(ct_vec[n].b);
-        }
-
-        Ciphertext ct_prod(opt::phim);
-        chl.recv(ct_prod.a);
-        chl.recv(ct_prod.b);
+        // Only the seeds of a and the b halves go over the wire
+        auto ct_vec = preprocess_vec_seeded(kp.sk, vec, mat_window_size, mat_num_windows, test_params);
+        chl.asyncSend(Pack(ct_vec, test_params));
+
+        // The result comes back switched to a small modulus
+        CompressedCiphertext ct_prod(opt::phim, ModSwitchBits(test_params));
+        uv64 buf;
+        chl.recv(buf);
+        Unpack(buf, ct_prod);
         auto prod = postprocess_prod(kp.sk, ct_prod, num_cols, num_rows, test_params);
     }
 
@@ -112,13 +106,8 @@ void ahe_server(){
     std::cout << "Server" << std::endl;
 
     DiscreteGaussianGenerator dgg = DiscreteGaussianGenerator(4.0);
-    FVParams test_params {
-        true,
-        opt::q, opt::p, opt::logn, opt::phim,
-        (opt::q/opt::p),
-        OPTIMIZED, std::make_shared<DiscreteGaussianGenerator>(dgg),
-        window_size
-    };
+    FVParams test_params = MakeFVParams(g_param_sets[g_default_param_set], OPTIMIZED,
+            std::make_shared<DiscreteGaussianGenerator>(dgg), window_size);
     ui32 num_windows = 1 + floor(log2(test_params.q))/test_params.window_size;
 
     // get up the networking
@@ -144,26 +133,32 @@ void ahe_server(){
         index_list.push_back(i);
     }
 
+    // A server holds the keys of each client in a session of its own
+    KeyStore key_store(test_params);
+    const SessionId session = 0;
+    SeededRelinKey rk(test_params.phim, num_windows);
     for(ui32 n=0; n<index_list.size(); n++){
-        RelinKey rk(test_params.phim, num_windows);
-        for(ui32 w=0; w<num_windows; w++){
-            chl.recv(rk.a[w]);
-            chl.recv(rk.b[w]);
-        }
-        g_rk_map[index_list[n]] =std::make_shared<RelinKey>(rk);
+        uv64 rk_buf;
+        chl.recv(rk_buf);
+        Unpack(rk_buf, rk, test_params);
+        key_store.Add(session, {index_list[n]}, {rk});
     }
 
+    // The scratch of each request is carved from one arena, recycled on
+    // the next request
+    Arena arena(1 << 24, true);
     time.setTimePoint("setup");
     for(ui32 rep=0; rep<num_rep; rep++){
-        CTVec ct_vec(mat_num_windows, Ciphertext(opt::phim));
-        for(ui32 n=0; n<ct_vec.size(); n++){
-            chl.recv(ct_vec[n].a);
-            chl.recv(ct_vec[n].b);
-        }
-
-        auto ct_prod = mat_mul_online(ct_vec, enc_mat, num_cols, test_params);
-        chl.send(ct_prod.a);
-        chl.send(ct_prod.b);
+        arena.reset();
+        SeededCTVec ct_seeded(mat_num_windows, SeededCiphertext(opt::phim));
+        uv64 buf;
+        chl.recv(buf);
+        Unpack(buf, ct_seeded, test_params);
+        auto ct_vec = Expand(ct_seeded, test_params);
+
+        auto keys = key_store.Acquire(session);
+        auto ct_prod = mat_mul_online(ct_vec, enc_mat, num_cols, *keys, test_params, &arena);
+        chl.send(Pack(ModSwitch(ct_prod, ModSwitchBits(test_params), test_params)));
     }
     time.setTimePoint("online");
 
@@ -178,13 +173,31 @@ void ahe_server(){
 }
 
 int main(int argc, char** argv) {
-    std::cin >> num_rows >> num_cols >> window_size;
+    std::cin >> num_rows >> num_cols;
 
     ftt_precompute(opt::z, opt::q, opt::logn);
     ftt_precompute(opt::z_p, opt::p, opt::logn);
     encoding_precompute(opt::p, opt::logn);
     precompute_automorph_index(opt::phim);
 
+    // The widest windows that leave the noise margin, both parties plan the
+    // same from the shapes
+    DiscreteGaussianGenerator dgg = DiscreteGaussianGenerator(4.0);
+    // The key switching window is the planner's to pick
+    FVParams plan_params = MakeFVParams(g_param_sets[g_default_param_set], OPTIMIZED,
+            std::make_shared<DiscreteGaussianGenerator>(dgg), 1);
+    auto plan = PlanWindows([](const ui32 pt_window_size, const ui32 pt_num_windows,
+            const FVParams& params){
+        return EstimateModSwitch(
+                mat_mul_noise(num_rows, num_cols, pt_window_size, pt_num_windows, params),
+                ModSwitchBits(params), params);
+    }, plan_params);
+    window_size = plan.window_size;
+    mat_window_size = plan.pt_window_size;
+    mat_num_windows = plan.pt_num_windows;
+    std::cout << "Windows: " << mat_num_windows << "x" << mat_window_size << " bits, key switching "
+        << window_size << " bits, margin " << plan.margin << std::endl;
+
     if (argc == 1)
     {
         std::vector<std::thread> thrds(2);
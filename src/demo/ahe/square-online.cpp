@@ -31,13 +31,8 @@ void ahe_client(){
     std::cout << "Client" << std::endl;
 
     DiscreteGaussianGenerator dgg = DiscreteGaussianGenerator(4.0);
-    FVParams test_params {
-        true,
-        opt::q, opt::p, opt::logn, opt::phim,
-        (opt::q/opt::p),
-        OPTIMIZED, std::make_shared<DiscreteGaussianGenerator>(dgg),
-        window_size
-    };
+    FVParams test_params = MakeFVParams(g_param_sets[g_default_param_set], OPTIMIZED,
+            std::make_shared<DiscreteGaussianGenerator>(dgg), window_size);
 
     // get up the networking
     IOService ios(0);
@@ -61,14 +56,13 @@ void ahe_client(){
 
     for(ui32 rep=0; rep<num_rep; rep++){
         auto ct_vec = preprocess_client_share(kp.sk, vec_c, test_params);
-        for(ui32 n=0; n<ct_vec.size(); n++){
-            chl.send(ct_vec[n].a);
-            chl.send(ct_vec[n].b);
-        }
-
-        Ciphertext ct_c_f(opt::phim);
-        chl.recv(ct_c_f.a);
-        chl.recv(ct_c_f.b);
+        chl.asyncSend(Pack(ct_vec, test_params));
+
+        // The result comes back switched to a small modulus
+        CompressedCiphertext ct_c_f(opt::phim, ModSwitchBits(test_params));
+        uv64 buf;
+        chl.recv(buf);
+        Unpack(buf, ct_c_f);
         auto vec_c_f = postprocess_client_share(kp.sk, ct_c_f, vec_size, test_params);
     }
 
@@ -91,13 +85,8 @@ void ahe_server(){
     std::cout << "Server" << std::endl;
 
     DiscreteGaussianGenerator dgg = DiscreteGaussianGenerator(4.0);
-    FVParams test_params {
-        true,
-        opt::q, opt::p, opt::logn, opt::phim,
-        (opt::q/opt::p),
-        OPTIMIZED, std::make_shared<DiscreteGaussianGenerator>(dgg),
-        window_size
-    };
+    FVParams test_params = MakeFVParams(g_param_sets[g_default_param_set], OPTIMIZED,
+            std::make_shared<DiscreteGaussianGenerator>(dgg), window_size);
 
     // get up the networking
     IOService ios(0);
@@ -116,14 +105,12 @@ void ahe_server(){
         std::tie(pt_vec, vec_s_f) = preprocess_server_share(vec_s, test_params);
 
         CTVec ct_vec(2, Ciphertext(opt::phim));
-        for(ui32 n=0; n<ct_vec.size(); n++){
-            chl.recv(ct_vec[n].a);
-            chl.recv(ct_vec[n].b);
-        }
+        uv64 buf;
+        chl.recv(buf);
+        Unpack(buf, ct_vec, test_params);
 
         auto ct_c_f = square_online(ct_vec, pt_vec, test_params);
-        chl.send(ct_c_f.a);
-        chl.send(ct_c_f.b);
+        chl.asyncSend(Pack(ModSwitch(ct_c_f, ModSwitchBits(test_params), test_params)));
     }
     time.setTimePoint("online");
 
@@ -3,6 +3,7 @@
 #include "util.h"
 #include "aes.h"
 #include "gc.h"
+#include "math/distributiongenerator.h"
 #include <time.h>
 
 #include <iostream>
@@ -50,14 +51,15 @@ int finishBuilding(GarbledCircuit *gc, BuildContext *context) {
     return (int) (endTime - startTime);
 }
 
-block createInputLabels(GarbledCircuit *gc, InputLabels& inputLabels) {
-    block R = randomBlock();
+block createInputLabels(GarbledCircuit *gc, InputLabels& inputLabels, osuCrypto::PRNG& prng) {
+    block R = prng.get<block>();
     short* pR_16 = (short *) (&R);
     *pR_16 |= 1;
 
-    block* rand_context = getRandContext();
+    std::vector<block> labels(gc->n+2);
+    prng.get<block>(labels.data(), labels.size());
     for (int i = 0; i < (gc->n+2); i ++) {
-        randAESBlock(&gc->wires[i].label0, rand_context);
+        gc->wires[i].label0 = labels[i];
         gc->wires[i].label1 = xorBlocks(R, gc->wires[i].label0);
 
         if(i < gc->n) {
@@ -70,24 +72,23 @@ block createInputLabels(GarbledCircuit *gc, InputLabels& inputLabels) {
 }
 
 long garbleCircuit(GarbledCircuit *gc, InputLabels& inputLabels, OutputMap& outputMap) {
-    GarbledGate *garbledGate;
+    return garbleCircuit(gc, inputLabels, outputMap, get_prng().stream());
+}
 
-    seedRandom();
+long garbleCircuit(GarbledCircuit *gc, InputLabels& inputLabels, OutputMap& outputMap,
+        osuCrypto::PRNG& prng) {
+    GarbledGate *garbledGate;
 
     unsigned long startTime = RDTSC;
 
-    auto R = createInputLabels(gc, inputLabels);
+    auto R = createInputLabels(gc, inputLabels, prng);
     auto& garbledTable = gc->garbledTable;
 
-    block table_key = randomBlock();
+    block table_key = prng.get<block>();
     gc->table_key = table_key;
     AES_KEY KT;
     AESInit(&table_key, &KT);
 
-    block label_key = randomBlock();
-    AES_KEY KL;
-    AESInit(&label_key, &KL);
-
     long lsb0, lsb1;
     int input0, input1, output;
     long tableIndex = 0;
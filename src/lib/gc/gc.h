@@ -21,6 +21,7 @@
 #include "common.h"
 
 #include <vector>
+#include <cryptoTools/Crypto/PRNG.h>
 
 namespace lbcrypto {
 
@@ -55,8 +56,17 @@ int finishBuilding(GarbledCircuit *garbledCircuit, BuildContext *ctx);
 //The inputLabels field is expected to contain 2n fresh input labels, obtained
 //by calling createInputLabels. The outputMap is expected to be a 2m-block sized
 //empty array.
+//The labels and the table key are drawn from prng, or from the calling thread's
+//stream when it is not given. Circuits garbled concurrently each need a stream
+//of their own, see fork_prng.
 long garbleCircuit(GarbledCircuit *garbledCircuit, InputLabels& inputLabels,
         OutputMap& outputMap);
+long garbleCircuit(GarbledCircuit *garbledCircuit, InputLabels& inputLabels,
+        OutputMap& outputMap, osuCrypto::PRNG& prng);
+
+// Fresh input labels with a common offset R, which is returned
+block createInputLabels(GarbledCircuit *garbledCircuit, InputLabels& inputLabels,
+        osuCrypto::PRNG& prng);
 
 // A simple function that selects n input labels from 2n labels, using the
 // inputBits array where each element is a bit.
@@ -20,16 +20,13 @@
 #include "common.h"
 #include "util.h"
 #include "gc.h"
+#include "math/distributiongenerator.h"
 #include <stdio.h>
 #include <ctype.h>
 #include <time.h>
 
 namespace lbcrypto {
 
-// static __m128i cur_seed;
-block __current_rand_index;
-AES_KEY __rand_aes_key;
-
 void countToN(ui64 *a, ui64 n) {
     for (ui64 i = 0; i < n; i++)
         a[i] = i;
@@ -65,24 +62,8 @@ double doubleMean(double *values, int n) {
     return total / n;
 }
 
-// This is only for testing and benchmark purposes. Use a more 
-// secure seeding mechanism for actual use.
-int already_initialized = 0;
-void seedRandom() {
-  if (!already_initialized) {
-    already_initialized = 1;
-    __current_rand_index = zero_block();
-    srand(time(NULL));
-    block cur_seed = _mm_set_epi32(rand(), rand(), rand(), rand());
-    AES_set_encrypt_key((unsigned char *) &cur_seed, 128, &__rand_aes_key);
-  }
-}
-
 block randomBlock() {
-  block out;
-  const __m128i *sched = getRandContext();
-  randAESBlock(&out, sched);
-  return out;
+  return get_prng().stream().get<block>();
 }
 
 void print_block(block x){
@@ -35,9 +35,8 @@ int getWords(char *line, char *words[], int maxwords);
 int median(int A[], int n);
 double doubleMean(double A[], int n);
 
-void seedRandom(void);
+// Draws from the calling thread's AES stream
 block randomBlock();
-void randAESBlock(block* out);
 
 // Compute AES in place. out is a block and sched is a pointer to an 
 // expanded AES key.
@@ -46,14 +45,6 @@ void randAESBlock(block* out);
                                   out = _mm_aesenc_si128(out, sched[jx]);\
                                 out = _mm_aesenclast_si128(out, sched[jx]);}
 
-extern block __current_rand_index;
-extern AES_KEY __rand_aes_key;
-
-// #define getRandContext() ((__m128i *) (__rand_aes_key.rd_key));
-// #define randAESBlock(out,sched) {__current_rand_index++; *out = __current_rand_index;inPlaceAES(*out,sched);}
-static inline block* getRandContext(void) {return __rand_aes_key.rd_key;};
-static inline void randAESBlock(block* out,const block* sched) {__current_rand_index = __current_rand_index+1; *out = __current_rand_index;inPlaceAES(*out,sched);}
-
 void print_block(block x);
 
 void print_gc(GarbledCircuit& gc);
@@ -1,18 +1,21 @@
 #include <utils/backend.h>
 #include "automorph.h"
+#include "bit_twiddle.h"
 #include <map>
+#include <stdexcept>
 
 #include <iostream>
 
 namespace lbcrypto {
 
-    std::map<ui32, uv32> g_automorph_index;
+    std::map<ui32, std::shared_ptr<const AutomorphContext>> g_automorph_context_map;
+    std::mutex g_automorph_context_mutex;
 
     std::vector<uv64> base_decompose(const uv64& coeff, const ui32 window_size, const ui32 num_windows){
         ui32 phim = coeff.size();
         std::vector<uv64> decomposed(num_windows, uv64(phim));
 
-        ui64 mask = (1 << window_size) - 1;
+        ui64 mask = ((ui64)1 << window_size) - 1;
         for(ui32 j=0; j<phim; j++){
             ui64 curr_coeff = coeff[j];
             for(ui32 i=0; i<num_windows; i++){
@@ -24,42 +27,100 @@ namespace lbcrypto {
         return decomposed;
     }
 
-    void precompute_automorph_index(const ui32 phim){
-        uv32 automorph_indices = uv32(phim);
-
+    AutomorphContext::AutomorphContext(const ui32 phim) :
+            phim(phim), index(phim), reverse(phim), m_perm(new std::atomic<const uv32*>[phim]) {
         ui32 g = 1;
         ui32 phim_by_2 = phim >> 1;
         ui32 mask = (phim << 1) - 1;
         for(ui32 i=0; i<phim/2; i++){
-            automorph_indices[i] = g;
-            automorph_indices[i+phim_by_2] = (g*mask) & mask;
+            index[i] = g;
+            index[i+phim_by_2] = (g*mask) & mask;
             g = (g * 5) & mask;
         }
-        g_automorph_index[phim] = std::move(automorph_indices);
+
+        // The evaluations are stored in bit reversed order
+        ui32 logn = log_pow2(phim);
+        for(ui32 i=0; i<phim; i++){
+            reverse[i] = ReverseBits(i, logn);
+        }
+
+        for(ui32 i=0; i<phim; i++){
+            m_perm[i].store(nullptr, std::memory_order_relaxed);
+        }
+    }
+
+    AutomorphContext::~AutomorphContext(){
+        for(ui32 i=0; i<phim; i++){
+            delete m_perm[i].load(std::memory_order_relaxed);
+        }
+    }
+
+    const uv32& AutomorphContext::eval_permutation(const ui32 rot) const {
+        if(rot >= phim){
+            throw std::logic_error("Rotation out of range");
+        }
+
+        auto perm = m_perm[rot].load(std::memory_order_acquire);
+        if(perm != nullptr){
+            return *perm;
+        }
+
+        std::lock_guard<std::mutex> lock(m_perm_mutex);
+        perm = m_perm[rot].load(std::memory_order_relaxed);
+        if(perm == nullptr){
+            // Evaluation rev[j] is at psi^(2j+1), which the automorphism sends
+            // to psi^((2j+1)*index), the evaluation rev[((2j+1)*index-1)/2]
+            auto table = new uv32(phim);
+            ui32 mask = phim-1;
+            ui32 idx = (index[rot] + 1)/2 - 1;
+            for(ui32 j=0; j<phim; j++){
+                (*table)[reverse[j]] = reverse[idx];
+                idx = (idx+index[rot]) & mask;
+            }
+            perm = table;
+            m_perm[rot].store(perm, std::memory_order_release);
+        }
+        return *perm;
+    }
+
+    void precompute_automorph_index(const ui32 phim){
+        auto ctx = std::make_shared<const AutomorphContext>(phim);
+        std::lock_guard<std::mutex> lock(g_automorph_context_mutex);
+        g_automorph_context_map[phim] = ctx;
 
         return;
     }
 
-    ui32 get_automorph_index(const ui32 i, const ui32 phim){
-        return g_automorph_index[phim][i];
+    std::shared_ptr<const AutomorphContext> get_automorph_context(const ui32 phim){
+        std::lock_guard<std::mutex> lock(g_automorph_context_mutex);
+        auto mSearch = g_automorph_context_map.find(phim);
+        if(mSearch == g_automorph_context_map.end()) {
+            throw std::logic_error("Automorphism indices must be precomputed");
+        }
+        return mSearch->second;
     }
 
-    uv64 automorph(const uv64& input, ui32 rot){
-        ui32 phim = input.size();
-        ui32 mask = phim-1;
-        auto index = g_automorph_index[phim][rot];
+    ui32 get_automorph_index(const ui32 i, const ui32 phim){
+        return get_automorph_context(phim)->index[i];
+    }
 
-        uv64 result(phim);
-        auto idx = (index + 1)/2 - 1;
-        for (ui32 j = 0; j < phim; j++) {
-            //determines which power of primitive root unity we should switch to
-            result[j] = input[idx];
-            idx = (idx+index) & mask;
+    void automorph(const ui64* input, ui64* output, const ui32 rot, const AutomorphContext& ctx){
+        const auto& perm = ctx.eval_permutation(rot);
+        for (ui32 k = 0; k < ctx.phim; k++) {
+            output[k] = input[perm[k]];
         }
+    }
 
+    uv64 automorph(const uv64& input, const ui32 rot, const AutomorphContext& ctx){
+        uv64 result(input.size());
+        automorph(input.data(), result.data(), rot, ctx);
         return result;
     }
 
+    uv64 automorph(const uv64& input, const ui32 rot){
+        return automorph(input, rot, *get_automorph_context(input.size()));
+    }
+
     uv64 automorph_pt(const uv64& input, ui32 rot){
         ui32 phim = input.size();
         ui32 phim_by_2 = phim/2;
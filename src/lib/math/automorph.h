@@ -9,14 +9,51 @@
 #define LBCRYPTO_MATH_AUTOMORPH_H_
 
 #include "utils/backend.h"
+#include <atomic>
+#include <memory>
+#include <mutex>
 
 namespace lbcrypto{
+    /**
+    * @brief Slot permutation tables for the automorphisms of a ring of size phim.
+    * Immutable once built.
+    */
+    struct AutomorphContext {
+        explicit AutomorphContext(const ui32 phim);
+        ~AutomorphContext();
+
+        const ui32 phim;
+
+        // Galois element for each rotation
+        uv32 index;
+        // Bit reversal used to address the evaluations
+        uv32 reverse;
+
+        // The automorphism for rot as a permutation of the evaluations: output
+        // k is input perm[k]. Tables are built on first use and never change
+        // afterwards, so lookups from several threads do not lock.
+        const uv32& eval_permutation(const ui32 rot) const;
+
+    private:
+        mutable std::unique_ptr<std::atomic<const uv32*>[]> m_perm;
+        mutable std::mutex m_perm_mutex;
+    };
+
     std::vector<uv64> base_decompose(const uv64& coeff, const ui32 window_size, const ui32 num_windows);
 
     void precompute_automorph_index(const ui32 phim);
 
+    // Registered context for phim. Registering it again does not affect the
+    // holders of the old one.
+    std::shared_ptr<const AutomorphContext> get_automorph_context(const ui32 phim);
+
     ui32 get_automorph_index(const ui32 rot, const ui32 phim);
 
+    uv64 automorph(const uv64& input, const ui32 rot, const AutomorphContext& ctx);
+
+    // Writes to a caller provided buffer of size phim, which must not alias input
+    void automorph(const ui64* input, ui64* output, const ui32 rot, const AutomorphContext& ctx);
+
     uv64 automorph(const uv64& input, const ui32 rot);
 
     uv64 automorph_pt(const uv64& input, const ui32 rot);
@@ -27,6 +27,8 @@
  
 #include <utils/backend.h>
 #include "discretegaussiangenerator.h"
+#include <algorithm>
+#include <cmath>
 
 // #include <iostream>
 
@@ -35,8 +37,6 @@ namespace lbcrypto {
     DiscreteGaussianGenerator::DiscreteGaussianGenerator(double std) : DistributionGenerator() {
         m_std = std;
 
-        m_vals.clear();
-
         //weightDiscreteGaussian
         double acc = 1e-15;
         double variance = m_std * m_std;
@@ -48,62 +48,66 @@ namespace lbcrypto {
         //double mr = 20; // see DG14 for details
         //int fin = (int)ceil(m_std * mr);
 
-        double cusum = 1.0;
-
-        for (si32 x = 1; x <= fin; x++) {
-            cusum = cusum + 2 * exp(-x * x / (variance * 2));
-        }
-
-        m_a = 1 / cusum;
-
-        //fin = (int)ceil(sqrt(-2 * variance * log(acc))); //not needed - same as above
-        double temp;
-
-        for (si32 i = 1; i <= fin; i++) {
-            temp = m_a * exp(-((double)(i * i) / (2 * variance)));
-            m_vals.push_back(temp);
+        // The weights are summed in long double, which has the 63 bits
+        // needed for the table entries
+        std::vector<long double> weights(fin + 1);
+        long double cusum = 0;
+        for (si32 x = 0; x <= fin; x++) {
+            weights[x] = std::exp(-(long double)(x * x) / (variance * 2));
+            cusum += (x == 0)? weights[x]: 2 * weights[x];
         }
 
-        // take cumulative summation
-        for (ui32 i = 1; i < m_vals.size(); i++) {
-            m_vals[i] += m_vals[i - 1];
+        const long double scale = std::ldexp((long double)1.0, 63);
+        long double cdf = 0;
+        m_cdt.clear();
+        for (si32 x = 0; x < fin; x++) {
+            cdf += ((x == 0)? weights[x]: 2 * weights[x]) / cusum;
+            m_cdt.push_back((si64)std::min(std::round(cdf * scale), scale - 1));
         }
+    }
 
-        // for (ui32 i = 0; i<m_vals.size(); i++) {
-        //  std::cout << m_vals[i] << std::endl;
-        // }
+    template <class Prng>
+    void DiscreteGaussianGenerator::FillVectorImpl(ui64* v, const ui32 size, const ui64 modulus,
+            Prng& prng) const {
+        constexpr ui32 chunk = 256;
+        const si64* cdt = m_cdt.data();
+        const ui32 cdt_size = m_cdt.size();
+
+        ui64 words[chunk];
+        si64 u[chunk], mag[chunk];
+        for (ui32 i = 0; i < size; i += chunk) {
+            ui32 n = std::min(chunk, size - i);
+            prng.template get<ui64>(words, n);
+
+            for (ui32 j = 0; j < n; j++) {
+                u[j] = (si64)(words[j] >> 1);
+                mag[j] = 0;
+            }
+            // Table outermost, so that the compares of a row run across the chunk
+            for (ui32 k = 0; k < cdt_size; k++) {
+                const si64 c = cdt[k];
+                for (ui32 j = 0; j < n; j++) {
+                    mag[j] += (u[j] >= c);
+                }
+            }
 
-        //std::cout<<m_a<<std::endl;
+            // The low bit is the sign, applied with a mask
+            for (ui32 j = 0; j < n; j++) {
+                ui64 x = mag[j];
+                ui64 neg = -((words[j] & 1) & (ui64)(x != 0));
+                v[i+j] = x ^ ((x ^ (modulus - x)) & neg);
+            }
+        }
     }
 
-    ui32 DiscreteGaussianGenerator::FindInVector(const std::vector<double> &S, double search) const {
-        //STL binary search implementation
-        auto lower = std::lower_bound(S.begin(), S.end(), search);
-        if (lower != S.end())
-            return lower - S.begin();
-        else
-            throw std::runtime_error("DGG Inversion Sampling. FindInVector value not found: " + std::to_string(search));
+    void DiscreteGaussianGenerator::FillVector(ui64* v, const ui32 size, const ui64 modulus,
+            osuCrypto::PRNG& prng) const {
+        FillVectorImpl(v, size, modulus, prng);
     }
 
     uv64 DiscreteGaussianGenerator::GenerateVector(const ui32 size, const ui64 &modulus) const {
-        //we need to use the binary uniform generator rathen than regular continuous distribution; see DG14 for details
-        std::uniform_real_distribution<double> distribution(0.0, 1.0);
-
         uv64 ans(size);
-        auto& prng = get_prng();
-        for (ui32 i = 0; i < size; i++) {
-            double seed = distribution(prng) - 0.5;
-            if (std::abs(seed) <= m_a / 2) {
-                ans[i] = ui64(0);
-            } else{
-                ui32 val = FindInVector(m_vals, (std::abs(seed) - m_a / 2));
-                if (seed > 0) {
-                    ans[i] = ui64(val+1);
-                } else {
-                    ans[i] = ui64(modulus-val-1);
-                }
-            }
-        }
+        FillVectorImpl(ans.data(), size, modulus, get_prng());
         return ans;
     }
 
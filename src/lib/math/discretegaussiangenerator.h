@@ -52,7 +52,8 @@ namespace lbcrypto {
         DiscreteGaussianGenerator (double std = 4.0);
 
         /**
-        * @brief           Generates a vector of random values within this Discrete Gaussian Distribution. Uses Peikert's inversion method.
+        * @brief           Generates a vector of random values within this Discrete Gaussian Distribution. Uses a
+        *                  cumulative distribution table, see FillVector.
         *
         * @param  size     The number of values to return.
         * @param  modulus  modulus of the polynomial ring.
@@ -60,14 +61,27 @@ namespace lbcrypto {
         */
         uv64 GenerateVector (ui32 size, const ui64 &modulus) const;
 
-    private:
-        ui32 FindInVector (const std::vector<double> &S, double search) const;
+        /**
+        * @brief           Writes size samples mod modulus to v, with the randomness drawn from prng. Threads
+        *                  that sample concurrently should each pass a stream of their own.
+        *
+        * Each sample compares a 63-bit uniform word against the whole cumulative table and takes a
+        * sign from the remaining bit, so the time does not depend on the values drawn. The words are
+        * taken from the AES stream a chunk at a time and the comparisons vectorize across the chunk.
+        */
+        void FillVector (ui64* v, const ui32 size, const ui64 modulus, osuCrypto::PRNG& prng) const;
 
-        // Gyana to add precomputation methods and data members
-        // all parameters are set as int because it is assumed that they are used for generating "small" polynomials only
-        double m_a;
+        /**
+        * @brief           Returns the standard deviation of the distribution.
+        */
+        double GetStd () const { return m_std; }
+
+    private:
+        template <class Prng>
+        void FillVectorImpl (ui64* v, const ui32 size, const ui64 modulus, Prng& prng) const;
 
-        std::vector<double> m_vals;
+        // m_cdt[k] = 2^63*Pr(|x| <= k), rounded and kept below 2^63
+        std::vector<si64> m_cdt;
     
         /**
         * The standard deviation of the distribution.
@@ -9,10 +9,47 @@
 #include "distributiongenerator.h"
 #include "math/params.h"
 #include <cryptoTools/Crypto/PRNG.h>
+#include <algorithm>
+#include <mutex>
 #include <random>
 
 namespace lbcrypto {
-    osuCrypto::PRNG aes128_engine::m_prng(_mm_setzero_si128(), 256);
+    static osuCrypto::block os_seed() {
+        std::random_device rd;
+        ui64 words[2];
+        for (auto& w: words) {
+            w = ((ui64)rd() << 32) | rd();
+        }
+        return _mm_set_epi64x(words[1], words[0]);
+    }
+
+    static std::mutex& root_mutex() {
+        static std::mutex mutex;
+        return mutex;
+    }
+
+    // Only used under root_mutex
+    static osuCrypto::PRNG& root_prng() {
+        static osuCrypto::PRNG root(os_seed(), 256);
+        return root;
+    }
+
+    static osuCrypto::block next_thread_seed() {
+        std::lock_guard<std::mutex> lock(root_mutex());
+        return root_prng().get<osuCrypto::block>();
+    }
+
+    void set_prng_seed(const osuCrypto::block& seed) {
+        osuCrypto::block thread_seed;
+        {
+            std::lock_guard<std::mutex> lock(root_mutex());
+            root_prng().SetSeed(seed);
+            thread_seed = root_prng().get<osuCrypto::block>();
+        }
+        get_prng().stream().SetSeed(thread_seed);
+    }
+
+    thread_local osuCrypto::PRNG aes128_engine::m_prng(next_thread_seed(), 256);
 
     aes128_engine& get_prng(){
         // C++11 thread-safe static initialization
@@ -39,56 +76,109 @@ namespace lbcrypto {
     }
 
     uv64 get_tug_vector (const ui32 size, const ui64 modulus) {
-        auto prng = get_prng();
-        auto distribution = std::uniform_int_distribution<si32>(-1,1);
-        ui64 minus1 = modulus - 1;
         uv64 v(size);
+        get_tug_vector(v.data(), size, modulus, get_prng().stream());
+        return v;
+    }
+
+    osuCrypto::PRNG fork_prng(osuCrypto::PRNG& prng) {
+        return osuCrypto::PRNG(prng.get<osuCrypto::block>(), 256);
+    }
+
+    // A byte below 255 is uniform mod 3, the rest are rejected and compacted
+    // away like in fill_uniform below
+    void get_tug_vector(ui64* v, const ui32 size, const ui64 modulus, osuCrypto::PRNG& prng) {
+        constexpr ui32 chunk = 512;
+        const ui64 values[3] = {0, 1, modulus - 1};
+
+        uint8_t bytes[chunk];
+        for (ui32 i = 0; i < size;) {
+            ui32 n = std::min<ui32>(chunk, (size - i) + (size - i)/64 + 8);
+            prng.get<uint8_t>(bytes, n);
 
-        for(ui32 m=0; m<size; m++){
-            si32 rand = distribution(prng);
-            switch(rand){
-            case -1:
-                v[m] = minus1; break;
-            case 0:
-                v[m] = 0; break;
-            case 1:
-                v[m] = 1; break;
+            for (ui32 k = 0; k < n && i < size; k++) {
+                v[i] = values[bytes[k] % 3];
+                i += (bytes[k] != 255);
             }
+        }
+    }
 
+    // Uniform sampling from words of type W with a double width type D. The
+    // words come from the AES stream a chunk at a time. A word is reduced by
+    // a multiply high and kept only if it is below the largest multiple of
+    // modulus that fits in W, so the result is unbiased. The output index is
+    // advanced by the comparison instead of a branch, so the rare rejections
+    // do not cost mispredictions.
+    template <class W, class D, class Prng>
+    static void fill_uniform(ui64* v, const ui32 size, const ui64 modulus, Prng& prng) {
+        constexpr ui32 bits = 8*sizeof(W);
+        constexpr ui32 chunk = 512;
+
+        const W m = (W)modulus;
+        const W ratio = (W)(((D)1 << bits)/m);
+        const W accept_max = (W)((D)ratio*m - 1);
+
+        W words[chunk];
+        for (ui32 i = 0; i < size;) {
+            // Ask for a few extra words to cover the rejections
+            ui32 n = std::min<ui32>(chunk, (size - i) + (size - i)/8 + 8);
+            prng.template get<W>(words, n);
+
+            for (ui32 k = 0; k < n && i < size; k++) {
+                W r = words[k];
+                W rem = r - (W)(((D)r*ratio) >> bits)*m;
+                v[i] = (rem >= m)? rem - m: rem;
+                i += (r <= accept_max);
+            }
         }
+    }
 
-        return v;
+    template <class Prng>
+    static void fill_uniform(ui64* v, const ui32 size, const ui64 modulus, Prng& prng) {
+        if (modulus <= 1) {
+            std::fill(v, v + size, 0);
+        } else if (modulus < ((ui64)1 << 32)) {
+            fill_uniform<ui32, ui64>(v, size, modulus, prng);
+        } else {
+            fill_uniform<ui64, ui128>(v, size, modulus, prng);
+        }
     }
 
-    uv64 get_dug_vector(const ui32 size, const ui64 modulus) {
-        auto prng = get_prng();
-        auto distribution = std::uniform_int_distribution<ui64>(0, modulus-1);
+    void get_dug_vector(ui64* v, const ui32 size, const ui64 modulus) {
+        fill_uniform(v, size, modulus, get_prng());
+    }
 
-        uv64 v(size);
+    void get_dug_vector(ui64* v, const ui32 size, const ui64 modulus,
+            const osuCrypto::block& seed) {
+        osuCrypto::PRNG prng(seed);
+        fill_uniform(v, size, modulus, prng);
+    }
 
-        for (ui32 i = 0; i < size; i++) {
-            v[i] = distribution(prng);
-        }
-        return v;
+    void get_dug_vector(ui64* v, const ui32 size, const ui64 modulus, osuCrypto::PRNG& prng) {
+        fill_uniform(v, size, modulus, prng);
+    }
 
+    osuCrypto::block get_seed(osuCrypto::PRNG& prng) {
+        return prng.get<osuCrypto::block>();
     }
 
-    uv64 get_dug_vector_opt(const ui32 size) {
-        auto prng = get_prng();
-        ui64 max = ((opt::q) << 4);
+    osuCrypto::block get_seed() {
+        auto& prng = get_prng();
+        ui64 lo = prng();
+        ui64 hi = prng();
+        return _mm_set_epi64x(hi, lo);
+    }
 
+    uv64 get_dug_vector(const ui32 size, const ui64 modulus) {
         uv64 v(size);
-
-        for (ui32 i = 0; i < size;) {
-            ui64 rand = prng();
-            if(rand < max){
-                v[i] = opt::modq_full(rand);
-                i++;
-            }
-        }
+        get_dug_vector(v.data(), size, modulus);
         return v;
     }
 
+    uv64 get_dug_vector_opt(const ui32 size) {
+        return get_dug_vector_opt<opt::default_modulli>(size);
+    }
+
 
     uv64 get_dgg_testvector(ui32 size, ui64 p, float std_dev){
         std::normal_distribution<double> distribution(0,std_dev);
@@ -17,16 +17,19 @@
 #endif
 
 #include "utils/backend.h"
+#include "math/params.h"
 #include <random>
 #include <cryptoTools/Common/Defines.h>
 #include <cryptoTools/Crypto/PRNG.h>
 
 namespace lbcrypto {
 
-    // AES Engine
+    // AES Engine over the AES stream of the calling thread. Each thread's
+    // stream is seeded from a shared root stream the first time it is used,
+    // and the root stream from the OS.
     struct aes128_engine {
     private:
-        static osuCrypto::PRNG m_prng;
+        static thread_local osuCrypto::PRNG m_prng;
 
     public:
         aes128_engine(){};
@@ -36,20 +39,68 @@ namespace lbcrypto {
         constexpr static result_type max() { return -1; }
 
         result_type operator()();
+
+        // count values straight from the AES counter mode stream, which is
+        // generated a buffer of blocks at a time
+        template <class T>
+        void get(T* dest, const ui32 count) {
+            m_prng.get<T>(dest, count);
+        }
+
+        // The underlying stream, for the functions that take one explicitly
+        osuCrypto::PRNG& stream() {
+            return m_prng;
+        }
     };
 
     // Return a static generator object
     aes128_engine &get_prng();
+
+    // For tests only: restarts the root stream from a fixed seed and reseeds
+    // the calling thread's stream from it. Threads that already drew from
+    // their streams keep them.
+    void set_prng_seed(const osuCrypto::block& seed);
     // std::mt19937_64 &get_prng();
 
+    // A new stream seeded from prng. Tasks that run concurrently each take a
+    // fork, and forking a seeded stream in a fixed order makes them
+    // reproducible.
+    osuCrypto::PRNG fork_prng(osuCrypto::PRNG& prng);
+
     uv64 get_bug_vector(const ui32 size);
 
     uv64 get_tug_vector(const ui32 size, const ui64 modulus);
 
+    // Writes size values uniform in {-1, 0, 1} mod modulus, drawn from prng
+    void get_tug_vector(ui64* v, const ui32 size, const ui64 modulus, osuCrypto::PRNG& prng);
+
     uv64 get_dug_vector(const ui32 size, const ui64 modulus);
 
+    // Writes size uniform values mod modulus to a caller provided buffer
+    void get_dug_vector(ui64* v, const ui32 size, const ui64 modulus);
+
+    void get_dug_vector(ui64* v, const ui32 size, const ui64 modulus, osuCrypto::PRNG& prng);
+
+    // Same from an AES stream keyed with seed, so that the vector can be
+    // regenerated from the seed alone. The output for a given seed is part of
+    // the wire format of the seeded ciphertexts and must not change.
+    void get_dug_vector(ui64* v, const ui32 size, const ui64 modulus,
+            const osuCrypto::block& seed);
+
+    // Fresh 128-bit seed for the function above
+    osuCrypto::block get_seed();
+
+    osuCrypto::block get_seed(osuCrypto::PRNG& prng);
+
     uv64 get_dug_vector_opt(const ui32 size);
 
+    // Uniform vector mod Modulli::q. The bulk sampler reduces with a multiply
+    // high, which is as cheap as the special form of q.
+    template <class Modulli>
+    uv64 get_dug_vector_opt(const ui32 size) {
+        return get_dug_vector(size, Modulli::q);
+    }
+
     uv64 get_dgg_testvector(ui32 size, ui64 p, float std_dev = 40.0);
 
     uv64 get_uniform_testvector(ui32 size, ui64 max);
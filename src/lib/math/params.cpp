@@ -9,45 +9,20 @@
 #include "math/params.h"
 
 namespace lbcrypto {
-    namespace opt {
-        ui32 logn = 11;
-        ui32 phim = (1 << logn);
-
-        /*
-        //q (<60 bits), p (>18) bits
-        ui64 q(1152921504346550273);
-        ui64 z(236170385413442746);
-        ui64 p(307201);
-        ui64 z_p(227254);
-        ui64 mu = ((ui64)1 << (2*19+2))/p; //  [Adjusted for fast partial]
-        */
-
-
-        //q (<60 bits), p (>19) bits
-        ui64 q(1152921504499937281);
-        ui64 z(246029739010950493);
-        ui64 p(557057);
-        ui64 z_p(201127);
-        ui64 mu = ((ui64)1 << (2*20+2))/p; //  [Adjusted for fast partial]
-
-
-        /* //q (<60 bits), p (>20) bits
-        ui64 q(1152921504414760961);
-        ui64 z(1012134726195831682);
-        ui64 p(1712129);
-        ui64 z_p(290337);
-        ui64 mu = ((ui64)1 << (2*21+2))/p; //  [Adjusted for fast partial]
-        ui64 mu_h = (mu >> 4); //  [Adjusted for fast partial]
-        ui64 mu_l = (mu % 16); //  [Adjusted for fast partial]
-        */
-
-
-        // ui64 z(824956925455712260);
-        ui64 delta = ((ui64)1<<60)-q;
-        ui64 delta16 = delta << 4;
-        ui64 q4 = q << 2;
-        ui64 delta2 = delta << 1;
+    const ParamSet& get_param_set(const std::string& name){
+        for (ui32 i = 0; i < g_num_param_sets; i++) {
+            if (name == g_param_sets[i].name) {
+                return g_param_sets[i];
+            }
+        }
+        throw std::logic_error("Unknown parameter set " + name);
+    }
 
-        ui64 p2 = (p << 1);
+    std::vector<std::string> get_param_set_names(){
+        std::vector<std::string> names;
+        for (ui32 i = 0; i < g_num_param_sets; i++) {
+            names.push_back(g_param_sets[i].name);
+        }
+        return names;
     }
 }
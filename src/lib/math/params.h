@@ -1,84 +1,234 @@
 #ifndef LBCRYPTO_MATH_PARAMS_H
 #define LBCRYPTO_MATH_PARAMS_H
 
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
 #include "utils/backend.h"
 #include "math/bit_twiddle.h"
 
 namespace lbcrypto {
+    /**
+    * @brief One supported parameter set: the ring dimension, a pseudo-Mersenne
+    * ciphertext modulus q = 2^60 - delta, a plaintext modulus p and primitive
+    * 2n-th roots of unity z mod q and z_p mod p.
+    */
+    struct ParamSet {
+        const char* name;
+        ui32 logn;
+        ui64 q, z;
+        ui64 p, z_p;
+    };
+
+    // All the parameter sets with fast reduction kernels. Sets are looked up by
+    // name at runtime, and several of them can be used at once.
+    constexpr ParamSet g_param_sets[] = {
+        //q (<60 bits), p (>18) bits
+        {"n2048_p19", 11, 1152921504346550273ULL, 236170385413442746ULL, 307201, 227254},
+        //q (<60 bits), p (>19) bits
+        {"n2048_p20", 11, 1152921504499937281ULL, 246029739010950493ULL, 557057, 201127},
+        //q (<60 bits), p (>20) bits
+        {"n2048_p21", 11, 1152921504414760961ULL, 1012134726195831682ULL, 1712129, 290337},
+        //q (<60 bits), p (>19) bits, fewer ciphertexts for the large layers
+        {"n4096_p20", 12, 1152921504414760961ULL, 474888799860551409ULL, 557057, 160144},
+        {"n8192_p20", 13, 1152921504414760961ULL, 905346104105462422ULL, 557057, 446794},
+    };
+
+    constexpr ui32 g_num_param_sets = sizeof(g_param_sets)/sizeof(ParamSet);
+
+    // Index of the set behind the opt:: constants
+    constexpr ui32 g_default_param_set = 1;
+
+    const ParamSet& get_param_set(const std::string& name);
+
+    std::vector<std::string> get_param_set_names();
+
     namespace opt {
-        extern ui32 logn;
-        extern ui32 phim;
-
-        extern ui64 q;
-        extern ui64 z;
-        extern ui64 p;
-        extern ui64 z_p;
-        extern ui64 mu;
-        extern ui64 mu_h;
-        extern ui64 mu_l;
-        // extern ui64 z;
-        extern ui64 delta;
-        extern ui64 delta16;
-        extern ui64 q4;
-        extern ui64 delta2;
-        extern ui64 p2;
+        constexpr ui32 bit_length(const ui64 a){
+            return (a == 0)? 0: 1 + bit_length(a >> 1);
+        }
+
+        /**
+        * @brief Reduction kernels for q = 2^60 - delta and a small p, with all
+        * the constants known at compile time.
+        */
+        template <ui64 Q, ui64 P>
+        struct modulli {
+            static_assert(Q < ((ui64)1 << 60) && ((ui64)1 << 60) - Q < ((ui64)1 << 30),
+                    "q must be 2^60 - delta for a delta below 2^30");
+
+            static constexpr ui64 q = Q;
+            static constexpr ui64 p = P;
+
+            static constexpr ui64 delta = ((ui64)1 << 60) - Q;
+            static constexpr ui64 delta16 = delta << 4;
+            static constexpr ui64 q4 = Q << 2;
+            static constexpr ui64 delta2 = delta << 1;
+            static constexpr ui64 p2 = P << 1;
+
+            // The shift here is 2*ceil(log2(p))+2 [Adjusted for fast partial]
+            static constexpr ui32 mu_shift = 2*bit_length(P) + 2;
+            static constexpr ui64 mu = ((ui64)1 << mu_shift)/P;
+            // Products of two values below p no longer fit a*mu in 64 bits
+            static constexpr bool mu_wide = (3*bit_length(P) + 3 > 64);
+
+            static inline ui64 modp_part(ui64 a){
+                if (mu_wide) {
+                    return (a - (ui64)(((ui128)a*mu) >> mu_shift)*P);
+                }
+                return (a - ((a*mu) >> mu_shift)*P);
+            }
+
+            static inline ui64 modp_full(ui64 a){
+                ui64 b = modp_part(a);
+                return ((b >= P)? b-P: b);
+            }
+
+            static inline ui64 modp_finalize(ui64 a){
+                return ((a >= P)? a-P: a);
+            }
+
+            static inline ui64 modq_part(ui128 a){
+                ui128 b = (ui128)((ui64)a) + (a >> 64)*(ui128)delta16;  // (64b) + (60+34=94b) = max(95b)
+                ui64 c = (ui64)(b >> 61)*delta2 + ((ui64)b & ones(61));  // max (34+31=65b) + (61b) = 62b
+                return c;
+            }
+
+            static inline ui64 modq_full(ui128 a){
+                ui64 b = modq_part(a);
+                while(b >= Q){
+                    b -= Q;
+                }
+                return b;
+            }
+
+            static inline ui64 modq_part(ui64 a){
+                return (a >> 60)*delta + (a & ones(60));
+            }
+
+            static inline ui64 modq_full(ui64 a){
+                ui64 b = modq_part(a);
+                while(b >= Q){
+                    b -= Q;
+                }
+                return b;
+            }
+
+            static inline ui64 sub_modq_part(ui64 a, ui64 b){
+                return modq_part(a + q4 - b);
+            }
+
+            static inline ui64 mul_modq_part(ui64 a, ui64 b){
+                ui128 c = (ui128)a*(ui128)b; // 124b number
+                return modq_part(c);
+            }
+
+            static inline ui64 lshift_modq_part(ui64 a, ui32 shift){
+                ui128 c = ((ui128)a << shift); // 124b number
+                return modq_part(c);
+            }
+        };
+
+        template <ui64 Q, ui64 P> constexpr ui64 modulli<Q, P>::q;
+        template <ui64 Q, ui64 P> constexpr ui64 modulli<Q, P>::p;
+        template <ui64 Q, ui64 P> constexpr ui64 modulli<Q, P>::delta;
+        template <ui64 Q, ui64 P> constexpr ui64 modulli<Q, P>::delta16;
+        template <ui64 Q, ui64 P> constexpr ui64 modulli<Q, P>::q4;
+        template <ui64 Q, ui64 P> constexpr ui64 modulli<Q, P>::delta2;
+        template <ui64 Q, ui64 P> constexpr ui64 modulli<Q, P>::p2;
+        template <ui64 Q, ui64 P> constexpr ui32 modulli<Q, P>::mu_shift;
+        template <ui64 Q, ui64 P> constexpr ui64 modulli<Q, P>::mu;
+        template <ui64 Q, ui64 P> constexpr bool modulli<Q, P>::mu_wide;
+
+        template <ui32 I>
+        using param_set_modulli = modulli<g_param_sets[I].q, g_param_sets[I].p>;
+
+        typedef param_set_modulli<g_default_param_set> default_modulli;
+
+        // The default parameter set
+        constexpr ui32 logn = g_param_sets[g_default_param_set].logn;
+        constexpr ui32 phim = (1 << logn);
+
+        constexpr ui64 q = default_modulli::q;
+        constexpr ui64 z = g_param_sets[g_default_param_set].z;
+        constexpr ui64 p = default_modulli::p;
+        constexpr ui64 z_p = g_param_sets[g_default_param_set].z_p;
+        constexpr ui64 mu = default_modulli::mu;
+        constexpr ui64 delta = default_modulli::delta;
+        constexpr ui64 delta16 = default_modulli::delta16;
+        constexpr ui64 q4 = default_modulli::q4;
+        constexpr ui64 delta2 = default_modulli::delta2;
+        constexpr ui64 p2 = default_modulli::p2;
 
         inline ui64 modp_part(ui64 a){
-            // The constant here is 2*ceil(log2(p))+2
-            return (a - ((a*mu) >> 42)*p);
+            return default_modulli::modp_part(a);
         }
 
-        /*inline ui64 modp_part(ui64 a){
-            return  (a - ((a*mu_h + ((a*mu_l) >> 4)) >> 40)*p);
-        }*/
-
         inline ui64 modp_full(ui64 a){
-            ui64 b = modp_part(a);
-            return ((b >= p)? b-p: b);
+            return default_modulli::modp_full(a);
         }
 
         inline ui64 modp_finalize(ui64 a){
-            return ((a >= p)? a-p: a);
+            return default_modulli::modp_finalize(a);
         }
 
         inline ui64 modq_part(ui128 a){
-            ui128 b = (ui128)((ui64)a) + (a >> 64)*(ui128)delta16;  // (64b) + (60+34=94b) = max(95b)
-            ui64 c = (ui64)(b >> 61)*delta2 + ((ui64)b & ones(61));  // max (34+31=65b) + (61b) = 62b
-            return c;
+            return default_modulli::modq_part(a);
         }
 
         inline ui64 modq_full(ui128 a){
-            ui64 b = modq_part(a);
-            while(b >= q){
-                b -= q;
-            }
-            return b;
+            return default_modulli::modq_full(a);
         }
 
         inline ui64 modq_part(ui64 a){
-            return (a >> 60)*delta + (a & ones(60));
+            return default_modulli::modq_part(a);
         }
 
         inline ui64 modq_full(ui64 a){
-            ui64 b = modq_part(a);
-            while(b >= q){
-                b -= q;
-            }
-            return b;
+            return default_modulli::modq_full(a);
         }
 
         inline ui64 sub_modq_part(ui64 a, ui64 b){
-            return modq_part(a + q4 - b);
+            return default_modulli::sub_modq_part(a, b);
         }
 
         inline ui64 mul_modq_part(ui64 a, ui64 b){
-            ui128 c = (ui128)a*(ui128)b; // 124b number
-            return modq_part(c);
+            return default_modulli::mul_modq_part(a, b);
         }
 
         inline ui64 lshift_modq_part(ui64 a, ui32 shift){
-            ui128 c = ((ui128)a << shift); // 124b number
-            return modq_part(c);
+            return default_modulli::lshift_modq_part(a, shift);
+        }
+
+        template <ui32 I, class F>
+        inline typename std::enable_if<(I == g_num_param_sets)>::type
+        with_modulli(const ui64, const ui64, F&&){
+            throw std::logic_error("No fast reduction kernels for these modulli");
+        }
+
+        // Calls f(modulli<q, p>()) with the kernels compiled for (q, p). Throws
+        // if (q, p) is not one of the registered parameter sets.
+        template <ui32 I = 0, class F>
+        inline typename std::enable_if<(I < g_num_param_sets)>::type
+        with_modulli(const ui64 q, const ui64 p, F&& f){
+            if (g_param_sets[I].q == q && g_param_sets[I].p == p) {
+                f(param_set_modulli<I>());
+                return;
+            }
+            with_modulli<I+1>(q, p, std::forward<F>(f));
+        }
+
+        // True if with_modulli can dispatch (q, p)
+        inline bool has_modulli(const ui64 q, const ui64 p){
+            for (ui32 i = 0; i < g_num_param_sets; i++) {
+                if (g_param_sets[i].q == q && g_param_sets[i].p == p) {
+                    return true;
+                }
+            }
+            return false;
         }
     }
 }
@@ -8,299 +8,442 @@
  *
  */
 
+#include <mutex>
+
 #include "transfrm.h"
+#include "transfrm_simd.h"
 #include "bit_twiddle.h"
 #include "math/params.h"
+#include "utils/thread_pool.h"
 
 namespace lbcrypto {
-    std::map<ui64, uv64> g_rootOfUnityMap;
-    std::map<ui64, uv64> g_rootOfUnityInverseMap;
-    std::map<ui64, uv64> g_scaledInverseMap;
-    std::map<ui64, uv32> g_reverseMap;
-
-    //Number Theoretic Transform - ITERATIVE IMPLEMENTATION -  twiddle factor table precomputed
-    uv64 ntt_fwd(const uv64& element,
-            const uv64 &rootOfUnityTable, const ui64 modulus,
+    // Contexts registered by ftt_precompute. A context replaced by a later
+    // registration lives on with the holders of its shared_ptr.
+    std::map<ui64, std::shared_ptr<const NttContext>> g_nttContextMap;
+    std::mutex g_nttContextMutex;
+
+    // The lazy butterflies keep values below 4*modulus in 64 bits, larger
+    // moduli go through the division based transform. Lazy values reach
+    // 2^63 above 2^61, the vector kernels compare them unsigned.
+    const ui64 g_maxLazyModulus = ((ui64)1 << 62);
+
+    // Cooley-Tukey negacyclic NTT, natural order in and bit reversed order out.
+    // Fully reduces after every butterfly.
+    void ntt_fwd(ui64* result, const ui64* psiTable, const ui64 modulus,
             const ui32 logn) {
         ui32 phim = (1 << logn);
-        uv64 result(phim);
-        const auto& reverse_id = g_reverseMap[modulus];
-
 
-        //reverse coefficients (bit reversal)
-        for (ui32 i = 0; i < phim; i++){
-            result[i] = element[reverse_id[i]];
+        for (ui32 m = 1, t = phim; m < phim; m <<= 1)
+        {
+            t >>= 1;
+            for (ui32 i = 0; i < m; i++)
+            {
+                ui64 omega = psiTable[m+i];
+                ui64* x = result + 2*i*t;
+                ui64* y = x + t;
+                for (ui32 j = 0; j < t; j++)
+                {
+                    ui64 omegaFactor = mod_mul(y[j], omega, modulus);
+                    ui64 butterflyMinus = (x[j] < omegaFactor)? x[j] + (modulus - omegaFactor):
+                            x[j] - omegaFactor;
+                    x[j] = (x[j] >= modulus - omegaFactor)? x[j] - (modulus - omegaFactor):
+                            x[j] + omegaFactor;
+                    y[j] = butterflyMinus;
+                }
+            }
         }
+    }
 
-        ui64 omegaFactor;
-        ui64 butterflyPlus;
-        ui64 butterflyMinus;
+    // Gentleman-Sande negacyclic inverse NTT, bit reversed order in and natural
+    // order out. The result is not scaled by 1/n.
+    void ntt_inv(ui64* result, const ui64* psiInvTable, const ui64 modulus,
+            const ui32 logn) {
+        ui32 phim = (1 << logn);
 
-        for (ui32 logm = 1; logm <= logn; logm++)
+        for (ui32 m = phim, t = 1; m > 1; m >>= 1, t <<= 1)
         {
-            for (ui32 j = 0; j<phim; j = j + (1 << logm))
+            ui32 half = (m >> 1);
+            for (ui32 i = 0; i < half; i++)
             {
-                for (ui32 i = 0; i < (ui32)(1 << (logm-1)); i++)
+                ui64 omega = psiInvTable[half+i];
+                ui64* x = result + 2*i*t;
+                ui64* y = x + t;
+                for (ui32 j = 0; j < t; j++)
                 {
+                    ui64 butterflyMinus = (x[j] < y[j])? x[j] + (modulus - y[j]): x[j] - y[j];
+                    x[j] = (x[j] >= modulus - y[j])? x[j] - (modulus - y[j]): x[j] + y[j];
+                    y[j] = mod_mul(butterflyMinus, omega, modulus);
+                }
+            }
+        }
+    }
 
-                    ui32 x = (i << (1+logn-logm));
+    // Lazy version of ntt_fwd, the input must be in [0, 4*modulus) and so is
+    // the output. Groups narrower than the vector width are done with the
+    // scalar butterfly.
+    void ntt_fwd_lazy(ui64* result, const ui64* psiTable,
+            const ui64* psiShoupTable, const ui64 modulus, const ui32 logn) {
+        ui32 phim = (1 << logn);
+        ui32 width = simd::simd_width();
+        ui64 modulus2 = (modulus << 1);
 
-                    ui64 omega = rootOfUnityTable[x];
+        for (ui32 m = 1, t = phim; m < phim; m <<= 1)
+        {
+            t >>= 1;
+            for (ui32 i = 0; i < m; i++)
+            {
+                ui64* x = result + 2*i*t;
+                ui64* y = x + t;
+                if (t < width) {
+                    for (ui32 j = 0; j < t; j++)
+                    {
+                        simd::butterfly_ct(x[j], y[j], psiTable[m+i], psiShoupTable[m+i],
+                                modulus, modulus2);
+                    }
+                } else {
+                    simd::ntt_ct_butterflies(x, y, psiTable[m+i], psiShoupTable[m+i],
+                            t, modulus);
+                }
+            }
+        }
+    }
 
-                    ui32 indexEven = j + i;
-                    ui32 indexOdd = j + i + (1 << (logm-1));
+    // Lazy version of ntt_inv, the input must be in [0, 2*modulus) and so is
+    // the output
+    void ntt_inv_lazy(ui64* result, const ui64* psiInvTable,
+            const ui64* psiInvShoupTable, const ui64 modulus, const ui32 logn) {
+        ui32 phim = (1 << logn);
+        ui32 width = simd::simd_width();
+        ui64 modulus2 = (modulus << 1);
 
-                    if (result[indexOdd] != 0)
+        for (ui32 m = phim, t = 1; m > 1; m >>= 1, t <<= 1)
+        {
+            ui32 half = (m >> 1);
+            for (ui32 i = 0; i < half; i++)
+            {
+                ui64* x = result + 2*i*t;
+                ui64* y = x + t;
+                if (t < width) {
+                    for (ui32 j = 0; j < t; j++)
                     {
-                        if (result[indexOdd] == 1){
-                            omegaFactor = omega;
-                        } else {
-                            omegaFactor = mod_mul(omega, result[indexOdd], modulus);
-                        }
+                        simd::butterfly_gs(x[j], y[j], psiInvTable[half+i],
+                                psiInvShoupTable[half+i], modulus, modulus2);
+                    }
+                } else {
+                    simd::ntt_gs_butterflies(x, y, psiInvTable[half+i],
+                            psiInvShoupTable[half+i], t, modulus);
+                }
+            }
+        }
+    }
 
-                        // Potential overflow issue analyze carefully
-                        // butterflyPlus = result[indexEven] + omegaFactor;
-                        // butterflyMinus = result[indexEven] + modulus - omegaFactor;
+    // Interleaved version of ntt_fwd_lazy over count polynomials
+    void ntt_fwd_lazy_batch(ui64* const* polys, const ui32 count, const ui64* psiTable,
+            const ui64* psiShoupTable, const ui64 modulus, const ui32 logn) {
+        ui32 phim = (1 << logn);
+        ui32 width = simd::simd_width();
+        ui64 modulus2 = (modulus << 1);
 
-                        // No overflow
-                        butterflyPlus = result[indexEven];
-                        butterflyPlus += omegaFactor;
-                        if (butterflyPlus >= modulus)
-                            butterflyPlus -= modulus;
+        for (ui32 m = 1, t = phim; m < phim; m <<= 1)
+        {
+            t >>= 1;
+            for (ui32 i = 0; i < m; i++)
+            {
+                ui64 omega = psiTable[m+i];
+                ui64 omegaShoup = psiShoupTable[m+i];
+                for (ui32 k = 0; k < count; k++)
+                {
+                    ui64* x = polys[k] + 2*i*t;
+                    ui64* y = x + t;
+                    if (t < width) {
+                        for (ui32 j = 0; j < t; j++)
+                        {
+                            simd::butterfly_ct(x[j], y[j], omega, omegaShoup, modulus, modulus2);
+                        }
+                    } else {
+                        simd::ntt_ct_butterflies(x, y, omega, omegaShoup, t, modulus);
+                    }
+                }
+            }
+        }
+    }
 
-                        butterflyMinus = result[indexEven];
-                        if (result[indexEven] < omegaFactor)
-                            butterflyMinus += modulus;
-                        butterflyMinus -= omegaFactor;
+    // Interleaved version of ntt_inv_lazy over count polynomials
+    void ntt_inv_lazy_batch(ui64* const* polys, const ui32 count, const ui64* psiInvTable,
+            const ui64* psiInvShoupTable, const ui64 modulus, const ui32 logn) {
+        ui32 phim = (1 << logn);
+        ui32 width = simd::simd_width();
+        ui64 modulus2 = (modulus << 1);
 
-                        result[indexEven] = butterflyPlus;
-                        result[indexOdd] = butterflyMinus;
+        for (ui32 m = phim, t = 1; m > 1; m >>= 1, t <<= 1)
+        {
+            ui32 half = (m >> 1);
+            for (ui32 i = 0; i < half; i++)
+            {
+                ui64 omega = psiInvTable[half+i];
+                ui64 omegaShoup = psiInvShoupTable[half+i];
+                for (ui32 k = 0; k < count; k++)
+                {
+                    ui64* x = polys[k] + 2*i*t;
+                    ui64* y = x + t;
+                    if (t < width) {
+                        for (ui32 j = 0; j < t; j++)
+                        {
+                            simd::butterfly_gs(x[j], y[j], omega, omegaShoup, modulus, modulus2);
+                        }
                     } else {
-                          result[indexOdd] = result[indexEven];
+                        simd::ntt_gs_butterflies(x, y, omega, omegaShoup, t, modulus);
                     }
                 }
-
             }
         }
-
-        return result;
     }
 
-    //main Forward CRT Transform - implements FTT - uses iterative NTT as a subroutine
-    uv64 ftt_fwd(const uv64& element,
-            const ui64 modulus, const ui32 logn) {
-        auto mSearch = g_rootOfUnityMap.find(modulus);
-        if(mSearch == g_rootOfUnityMap.end()) {
-            throw std::logic_error("Root of Unity table must be precomputed");
+    NttContext::NttContext(const ui64 rootOfUnity, const ui64 modulus, const ui32 logn) :
+            modulus(modulus), logn(logn), phim(1 << logn), tables(nullptr, free) {
+        void* buffer = nullptr;
+        if (posix_memalign(&buffer, 64, 4*phim*sizeof(ui64)) != 0) {
+            throw std::bad_alloc();
         }
+        tables.reset((ui64*)buffer);
 
-        ui32 phim = (1<<logn);
-        uv64 InputToFFT(phim, 0);
-        for (ui32 i = 0; i<phim; i++)
-            InputToFFT[i] = mod_mul(element[i], g_rootOfUnityMap[modulus][i], modulus);
-
-        auto OpFFT = ntt_fwd(InputToFFT, g_rootOfUnityMap[modulus], modulus, logn);
+        ui64* table = tables.get();
+        ui64* table_shoup = table + phim;
+        ui64* table_inv = table + 2*phim;
+        ui64* table_inv_shoup = table + 3*phim;
 
-        return OpFFT;
-    }
-
-    //main Inverse CRT Transform - implements FTT - uses iterative NTT as a subroutine
-    uv64 ftt_inv(const uv64& element,
-            const ui64 modulus, const ui32 logn) {
-        ui32 phim = (1<<logn);
-        auto mSearch = g_rootOfUnityInverseMap.find(modulus);
-        if(mSearch == g_rootOfUnityInverseMap.end()) {
-            throw std::logic_error("Root of Unity table must be precomputed");
+        //Precomputes the powers of psi and psi^-1 in bit reversed order
+        ui64 rootOfUnityInverse = mod_inv(rootOfUnity, modulus);
+        ui64 x(1), x_inv(1);
+        for (ui32 i = 0; i<phim; i++) {
+            ui32 rev = ReverseBits(i, logn);
+            table[rev] = x;
+            table_inv[rev] = x_inv;
+            x = mod_mul(x, rootOfUnity, modulus);
+            x_inv = mod_mul(x_inv, rootOfUnityInverse, modulus);
         }
 
-        auto OpIFFT = ntt_fwd(element, g_rootOfUnityInverseMap[modulus], modulus, logn);
-
-        for (ui32 i=0; i<phim; i++){
-            OpIFFT[i] = mod_mul(OpIFFT[i], g_scaledInverseMap[modulus][i], modulus);
+        //Precomputes the Shoup companions for the twiddle tables
+        for (ui32 i = 0; i < phim; i++) {
+            table_shoup[i] = simd::shoup(table[i], modulus);
+            table_inv_shoup[i] = simd::shoup(table_inv[i], modulus);
         }
 
-        return OpIFFT;
+        psi = table;
+        psi_shoup = table_shoup;
+        psi_inv = table_inv;
+        psi_inv_shoup = table_inv_shoup;
+
+        phim_inv = mod_inv(phim, modulus);
+        phim_inv_shoup = simd::shoup(phim_inv, modulus);
     }
 
-    uv64 inline ntt_fwd_opt(const uv64& element, const uv64& rootOfUnityTable) {
-        ui32 phim = opt::phim;
-        ui32 logn = opt::logn;
-        const auto& reverse_id = g_reverseMap[opt::q];
+    //main Forward CRT Transform - implements FTT - the evaluations are left
+    //in bit reversed order
+    void ftt_fwd(const NttContext& ctx, const ui64* element, ui64* result) {
+        if (ctx.modulus >= g_maxLazyModulus) {
+            for (ui32 i = 0; i<ctx.phim; i++)
+                result[i] = mod(element[i], ctx.modulus);
 
-        //reverse coefficients (bit reversal)
-        uv64 result(phim);
-        for (ui32 i = 0; i < phim; i++)
-            result[i] = element[reverse_id[i]];
+            ntt_fwd(result, ctx.psi, ctx.modulus, ctx.logn);
+            return;
+        }
 
-        ui64 resultP;
-        ui64 omegaFactor;
+        // The input is allowed to be any 64-bit value
+        simd::reduce_lazy(result, element, ctx.phim, ctx.modulus);
 
-        for (ui32 logm = 1; logm <= logn; logm++)
-        {
-            for (ui32 j = 0; j<phim; j = j + (1 << logm))
-            {
-                for (ui32 i = 0; i < ((ui32)1 << (logm-1)); i++)
-                {
-                    ui32 x = (i << (1+logn-logm));
-                    const ui64& omega = rootOfUnityTable[x];
+        ntt_fwd_lazy(result, ctx.psi, ctx.psi_shoup, ctx.modulus, ctx.logn);
+        simd::reduce_4q(result, ctx.phim, ctx.modulus);
+    }
 
-                    ui32 indexEven = j + i;
-                    ui32 indexOdd = j + i + (1 << (logm-1));
+    //main Inverse CRT Transform - implements FTT - takes the evaluations in bit
+    //reversed order
+    void ftt_inv(const NttContext& ctx, const ui64* element, ui64* result) {
+        if (ctx.modulus >= g_maxLazyModulus) {
+            for (ui32 i = 0; i<ctx.phim; i++)
+                result[i] = mod(element[i], ctx.modulus);
 
-                    if (result[indexOdd] != 0){
-                        omegaFactor = opt::mul_modq_part(omega, result[indexOdd]);
-                        resultP = opt::modq_part(result[indexEven]);
-                        result[indexEven] = (resultP + omegaFactor);
-                        result[indexOdd] = (resultP + opt::q4 - omegaFactor);
-                    } else {
-                      result[indexOdd] = result[indexEven];
-                    }
-
-                }
+            ntt_inv(result, ctx.psi_inv, ctx.modulus, ctx.logn);
 
+            for (ui32 i=0; i<ctx.phim; i++){
+                result[i] = mod_mul(result[i], ctx.phim_inv, ctx.modulus);
             }
+            return;
         }
 
-        return result;
-    }
-
-    uv64 ftt_fwd_opt(const uv64& input){
-        ui32 phim = opt::phim;
-        const auto& rootOfUnityTable = g_rootOfUnityMap[opt::q];
+        simd::reduce_lazy(result, element, ctx.phim, ctx.modulus);
 
-        uv64 element(phim);
-        for (ui32 i = 0; i<phim; i++)
-            element[i] = opt::mul_modq_part(input[i], rootOfUnityTable[i]);
+        ntt_inv_lazy(result, ctx.psi_inv, ctx.psi_inv_shoup, ctx.modulus, ctx.logn);
 
-        return ntt_fwd_opt(element, rootOfUnityTable);
+        simd::mul_shoup_lazy(result, result, ctx.phim_inv, ctx.phim_inv_shoup,
+                ctx.phim, ctx.modulus);
+        simd::reduce_4q(result, ctx.phim, ctx.modulus);
     }
 
-    uv64 ftt_inv_opt(const uv64& input){
-        ui32 phim = opt::phim;
-        const auto& rootOfUnityInverseTable = g_rootOfUnityInverseMap[opt::q];
-        const auto& scaledInverseTable = g_scaledInverseMap[opt::q];
-
-        //reverse coefficients (bit reversal)
-        uv64 result(phim);
-        result = ntt_fwd_opt(input, rootOfUnityInverseTable);
-
-        uv64 element(phim);
-        for (ui32 i = 0; i<phim; i++)
-            element[i] = opt::mul_modq_part(result[i], scaledInverseTable[i]);
-
-        return element;
+    // Polynomials per interleaved block, about 256KB of coefficients so that a
+    // block stays in L2 while it goes through all the stages
+    static ui32 batch_block_size(const ui32 phim) {
+        return std::max<ui32>(1, (1 << 15)/phim);
     }
 
-    uv64 inline ntt_fwd_opt_p(const uv64& element, const uv64& rootOfUnityTable) {
-        ui32 phim = opt::phim;
-        ui32 logn = opt::logn;
-        const auto& reverse_id = g_reverseMap[opt::p];
-
-        //reverse coefficients (bit reversal)
-        uv64 result(phim);
-        for (ui32 i = 0; i < phim; i++)
-            result[i] = element[reverse_id[i]];
-
-        ui64 resultP;
-        ui64 omegaFactor;
-
-        for (ui32 logm = 1; logm <= logn; logm++)
-        {
-            for (ui32 j = 0; j<phim; j = j + (1 << logm))
-            {
-                for (ui32 i = 0; i < ((ui32)1 << (logm-1)); i++)
-                {
-                    ui32 x = (i << (1+logn-logm));
-                    const ui64& omega = rootOfUnityTable[x];
+    // Calls f(begin, end) for the blocks of [0, count), over pool if given
+    static void for_each_block(const ui32 count, const ui32 block, ThreadPool* pool,
+            const std::function<void(ui32, ui32)>& f) {
+        ui32 num_blocks = (count + block - 1)/block;
+        auto run = [&](ui32 b) {
+            f(b*block, std::min(count, (b+1)*block));
+        };
+        if (pool == nullptr) {
+            for (ui32 b = 0; b < num_blocks; b++) {
+                run(b);
+            }
+        } else {
+            pool->parallel_for(num_blocks, run);
+        }
+    }
 
-                    ui32 indexEven = j + i;
-                    ui32 indexOdd = j + i + (1 << (logm-1));
+    void ftt_fwd_batch(const NttContext& ctx, ui64* const* polys, const ui32 count,
+            ThreadPool* pool) {
+        for_each_block(count, batch_block_size(ctx.phim), pool, [&](ui32 begin, ui32 end) {
+            if (ctx.modulus >= g_maxLazyModulus) {
+                for (ui32 k = begin; k < end; k++) {
+                    ftt_fwd(ctx, polys[k], polys[k]);
+                }
+                return;
+            }
 
-                    if (result[indexOdd] != 0){
-                        omegaFactor = opt::modp_part(omega*result[indexOdd]);
-                        resultP = opt::modp_part(result[indexEven]);
-                        result[indexEven] = (resultP + omegaFactor);
-                        result[indexOdd] = (resultP + opt::p2 - omegaFactor);
-                    } else {
-                      result[indexOdd] = result[indexEven];
-                    }
+            for (ui32 k = begin; k < end; k++) {
+                simd::reduce_lazy(polys[k], polys[k], ctx.phim, ctx.modulus);
+            }
+            ntt_fwd_lazy_batch(polys + begin, end - begin, ctx.psi, ctx.psi_shoup,
+                    ctx.modulus, ctx.logn);
+            for (ui32 k = begin; k < end; k++) {
+                simd::reduce_4q(polys[k], ctx.phim, ctx.modulus);
+            }
+        });
+    }
 
+    void ftt_inv_batch(const NttContext& ctx, ui64* const* polys, const ui32 count,
+            ThreadPool* pool) {
+        for_each_block(count, batch_block_size(ctx.phim), pool, [&](ui32 begin, ui32 end) {
+            if (ctx.modulus >= g_maxLazyModulus) {
+                for (ui32 k = begin; k < end; k++) {
+                    ftt_inv(ctx, polys[k], polys[k]);
                 }
+                return;
+            }
 
+            for (ui32 k = begin; k < end; k++) {
+                simd::reduce_lazy(polys[k], polys[k], ctx.phim, ctx.modulus);
+            }
+            ntt_inv_lazy_batch(polys + begin, end - begin, ctx.psi_inv, ctx.psi_inv_shoup,
+                    ctx.modulus, ctx.logn);
+            for (ui32 k = begin; k < end; k++) {
+                simd::mul_shoup_lazy(polys[k], polys[k], ctx.phim_inv, ctx.phim_inv_shoup,
+                        ctx.phim, ctx.modulus);
+                simd::reduce_4q(polys[k], ctx.phim, ctx.modulus);
             }
+        });
+    }
+
+    static std::vector<ui64*> matrix_rows(ui64* polys, const ui32 count, const ui32 phim) {
+        std::vector<ui64*> rows(count);
+        for (ui32 k = 0; k < count; k++) {
+            rows[k] = polys + (size_t)k*phim;
         }
+        return rows;
+    }
 
-        return result;
+    void ftt_fwd_batch(const NttContext& ctx, ui64* polys, const ui32 count,
+            ThreadPool* pool) {
+        auto rows = matrix_rows(polys, count, ctx.phim);
+        ftt_fwd_batch(ctx, rows.data(), count, pool);
     }
 
-    uv64 ftt_fwd_opt_p(const uv64& input){
-        ui32 phim = opt::phim;
-        const auto& rootOfUnityTable = g_rootOfUnityMap[opt::p];
+    void ftt_inv_batch(const NttContext& ctx, ui64* polys, const ui32 count,
+            ThreadPool* pool) {
+        auto rows = matrix_rows(polys, count, ctx.phim);
+        ftt_inv_batch(ctx, rows.data(), count, pool);
+    }
 
-        uv64 element(phim);
-        for (ui32 i = 0; i<phim; i++)
-            element[i] = opt::modp_part(input[i] * rootOfUnityTable[i]);
+    std::shared_ptr<const NttContext> get_ntt_context(const ui64 modulus) {
+        std::lock_guard<std::mutex> lock(g_nttContextMutex);
+        auto mSearch = g_nttContextMap.find(modulus);
+        if(mSearch == g_nttContextMap.end()) {
+            throw std::logic_error("Root of Unity table must be precomputed");
+        }
+        return mSearch->second;
+    }
 
-        element = ntt_fwd_opt_p(element, rootOfUnityTable);
-        for (ui32 i = 0; i<phim; i++)
-            element[i] = opt::modp_full(element[i]);
+    // Registered context for modulus, checked against the requested size
+    static std::shared_ptr<const NttContext> find_ntt_context(const ui64 modulus, const ui32 logn) {
+        auto ctx = get_ntt_context(modulus);
+        if(ctx->logn != logn) {
+            throw std::logic_error("Transform size does not match the precomputed tables");
+        }
+        return ctx;
+    }
 
-        return element;
+    void ftt_fwd(const ui64* element, ui64* result,
+            const ui64 modulus, const ui32 logn) {
+        ftt_fwd(*find_ntt_context(modulus, logn), element, result);
     }
 
-    uv64 ftt_inv_opt_p(const uv64& input){
-        ui32 phim = opt::phim;
-        const auto& rootOfUnityInverseTable = g_rootOfUnityInverseMap[opt::p];
-        const auto& scaledInverseTable = g_scaledInverseMap[opt::p];
+    void ftt_inv(const ui64* element, ui64* result,
+            const ui64 modulus, const ui32 logn) {
+        ftt_inv(*find_ntt_context(modulus, logn), element, result);
+    }
 
-        //reverse coefficients (bit reversal)
-        uv64 result(phim);
-        result = ntt_fwd_opt_p(input, rootOfUnityInverseTable);
+    uv64 ftt_fwd(const uv64& element,
+            const ui64 modulus, const ui32 logn) {
+        uv64 result(1 << logn);
+        ftt_fwd(element.data(), result.data(), modulus, logn);
+        return result;
+    }
 
-        uv64 element(phim);
-        for (ui32 i = 0; i<phim; i++)
-            element[i] = opt::modp_full(result[i]*scaledInverseTable[i]);
+    uv64 ftt_inv(const uv64& element,
+            const ui64 modulus, const ui32 logn) {
+        uv64 result(1 << logn);
+        ftt_inv(element.data(), result.data(), modulus, logn);
+        return result;
+    }
 
-        return element;
+    uv64 ftt_fwd_opt(const uv64& input){
+        return ftt_fwd(input, opt::q, opt::logn);
     }
 
-    void ftt_precompute(const ui64 rootOfUnity, const ui64 modulus,  const ui32 logn) {
-        ui32 phim = (1<<logn);
+    uv64 ftt_inv_opt(const uv64& input){
+        return ftt_inv(input, opt::q, opt::logn);
+    }
 
-        //Precomputes twiddle factor omega and FTT parameter phi for Forward Transform
-        ui64 x(1);
+    uv64 ftt_fwd_opt_p(const uv64& input){
+        return ftt_fwd(input, opt::p, opt::logn);
+    }
 
-        uv64 table(phim);
-        for (ui32 i = 0; i<phim; i++) {
-            table[i] = x;
-            x = mod_mul(x, rootOfUnity, modulus);
-        }
-        g_rootOfUnityMap[modulus] = std::move(table);
+    uv64 ftt_inv_opt_p(const uv64& input){
+        return ftt_inv(input, opt::p, opt::logn);
+    }
 
-        //Precomputes twiddle factor omega and FTT parameter phi for Inverse Transform
-        x = 1;
-        ui64 rootOfUnityInverse = mod_inv(rootOfUnity, modulus);
+    void ftt_fwd_opt(const ui64* input, ui64* output){
+        ftt_fwd(input, output, opt::q, opt::logn);
+    }
 
-        uv64  table_inv(phim);
-        for (ui32 i = 0; i<phim; i++) {
-            table_inv[i] = x;
-            x = mod_mul(x, rootOfUnityInverse, modulus);
-        }
-        g_rootOfUnityInverseMap[modulus] = std::move(table_inv);
+    void ftt_inv_opt(const ui64* input, ui64* output){
+        ftt_inv(input, output, opt::q, opt::logn);
+    }
 
-        ui64 modulus_inv = mod_inv(phim, modulus);
-        uv64  table_scaled_inv(phim);
-        for (ui32 i = 0; i<phim; i++) {
-            table_scaled_inv[i] = mod_mul(modulus_inv, g_rootOfUnityInverseMap[modulus][i], modulus);
-        }
-        g_scaledInverseMap[modulus] = std::move(table_scaled_inv);
+    void ftt_fwd_opt_p(const ui64* input, ui64* output){
+        ftt_fwd(input, output, opt::p, opt::logn);
+    }
 
-        uv32  reverse_id(phim);
-        for (ui32 i = 0; i < phim; i++){
-            reverse_id[i] = ReverseBits(i, logn);
-        }
-        g_reverseMap[modulus] = std::move(reverse_id);
+    void ftt_inv_opt_p(const ui64* input, ui64* output){
+        ftt_inv(input, output, opt::p, opt::logn);
+    }
 
+    void ftt_precompute(const ui64 rootOfUnity, const ui64 modulus,  const ui32 logn) {
+        auto ctx = std::make_shared<const NttContext>(rootOfUnity, modulus, logn);
+        std::lock_guard<std::mutex> lock(g_nttContextMutex);
+        g_nttContextMap[modulus] = ctx;
     }
 
 
@@ -312,7 +455,7 @@ namespace lbcrypto {
             throw std::logic_error("size of root of unity and size of moduli chain not of same size");
         }
 
-        for (ui32 i = numOfRootU; i<numOfRootU; ++i) {
+        for (ui32 i = 0; i<numOfRootU; ++i) {
             ftt_precompute(rootsOfUnity[i], moduliiChain[i], logn);
         }
     }
@@ -19,6 +19,8 @@
 #include <complex>
 #include <time.h>
 #include <map>
+#include <memory>
+#include <algorithm>
 #include <fstream>
 #include <thread>
 
@@ -28,6 +30,39 @@
 */
 namespace lbcrypto {
 
+    /**
+    * @brief Precomputed tables for the negacyclic transforms modulo one prime.
+    *
+    * The context is immutable once built. All the tables share a single 64-byte
+    * aligned allocation and the kernels read them through plain pointers, so
+    * one context can be used from any number of threads.
+    */
+    struct NttContext {
+        NttContext(const ui64 rootOfUnity, const ui64 modulus, const ui32 logn);
+
+        NttContext(const NttContext&) = delete;
+        NttContext& operator=(const NttContext&) = delete;
+
+        const ui64 modulus;
+        const ui32 logn;
+        const ui32 phim;
+
+        // Powers of psi and psi^-1 in bit reversed order and their Shoup companions
+        const ui64* psi;
+        const ui64* psi_shoup;
+        const ui64* psi_inv;
+        const ui64* psi_inv_shoup;
+
+        ui64 phim_inv;
+        ui64 phim_inv_shoup;
+
+    private:
+        std::unique_ptr<ui64, void (*)(void*)> tables;
+    };
+
+    // The evaluation domain is kept in bit reversed order: entry k of the forward
+    // transform holds the evaluation at psi^(2*rev(k)+1). Pointwise operations
+    // do not care, the automorphisms and the packed encoding account for it.
     uv64 ftt_fwd(const uv64& element, const ui64 modulus, const ui32 logn);
 
     uv64 ftt_inv(const uv64& element, const ui64 modulus, const ui32 logn);
@@ -40,8 +75,50 @@ namespace lbcrypto {
 
     uv64 ftt_inv_opt_p(const uv64& element);
 
+    // Allocation free versions of the transforms above. The output has to hold
+    // 2^logn values and may be the same buffer as the input.
+    void ftt_fwd(const ui64* element, ui64* result, const ui64 modulus, const ui32 logn);
+
+    void ftt_inv(const ui64* element, ui64* result, const ui64 modulus, const ui32 logn);
+
+    void ftt_fwd_opt(const ui64* element, ui64* result);
+
+    void ftt_inv_opt(const ui64* element, ui64* result);
+
+    void ftt_fwd_opt_p(const ui64* element, ui64* result);
+
+    void ftt_inv_opt_p(const ui64* element, ui64* result);
+
+    void ftt_fwd(const NttContext& ctx, const ui64* element, ui64* result);
+
+    void ftt_inv(const NttContext& ctx, const ui64* element, ui64* result);
+
+    class ThreadPool;
+
+    // In-place transforms of count polynomials of ctx.phim values. Blocks of
+    // polynomials go through the stages together, so each twiddle is loaded
+    // once per block, and the blocks are spread over pool when one is given.
+    void ftt_fwd_batch(const NttContext& ctx, ui64* const* polys, const ui32 count,
+            ThreadPool* pool = nullptr);
+
+    void ftt_inv_batch(const NttContext& ctx, ui64* const* polys, const ui32 count,
+            ThreadPool* pool = nullptr);
+
+    // Same for a contiguous count x phim matrix
+    void ftt_fwd_batch(const NttContext& ctx, ui64* polys, const ui32 count,
+            ThreadPool* pool = nullptr);
+
+    void ftt_inv_batch(const NttContext& ctx, ui64* polys, const ui32 count,
+            ThreadPool* pool = nullptr);
+
+    // Builds the context for modulus and registers it for the functions above
+    // that look the tables up by modulus
     void ftt_precompute(const ui64 rootOfUnity, const ui64 modulus, const ui32 logn);
 
+    // Registered context for modulus. Registering it again does not affect
+    // the holders of the old one.
+    std::shared_ptr<const NttContext> get_ntt_context(const ui64 modulus);
+
     void ftt_pre_compute(const uv64 &rootOfUnity, const uv64 &moduliiChain, const ui32 logn);
 
 } // namespace lbcrypto ends
@@ -0,0 +1,375 @@
+/*
+ * transfrm_simd.cpp
+ *
+ *	Scalar, AVX2 and AVX-512 versions of the lazy butterfly kernels. The
+ *	vector versions are compiled with target attributes so that the rest of
+ *	the library does not need to be built for a particular instruction set,
+ *	the right version is picked at runtime from the cpu features.
+ *
+ */
+
+#include <atomic>
+#include <x86intrin.h>
+#include "math/transfrm_simd.h"
+
+namespace lbcrypto {
+    namespace simd {
+
+    //------------------------------- Scalar ------------------------------
+    static void ntt_ct_butterflies_scalar(ui64* x, ui64* y, const ui64 w, const ui64 w_shoup,
+            const ui32 n, const ui64 q){
+        ui64 q2 = (q << 1);
+        for(ui32 i=0; i<n; i++){
+            butterfly_ct(x[i], y[i], w, w_shoup, q, q2);
+        }
+    }
+
+    static void ntt_gs_butterflies_scalar(ui64* x, ui64* y, const ui64 w, const ui64 w_shoup,
+            const ui32 n, const ui64 q){
+        ui64 q2 = (q << 1);
+        for(ui32 i=0; i<n; i++){
+            butterfly_gs(x[i], y[i], w, w_shoup, q, q2);
+        }
+    }
+
+    static void reduce_4q_scalar(ui64* x, const ui32 n, const ui64 q){
+        ui64 q2 = (q << 1);
+        for(ui32 i=0; i<n; i++){
+            ui64 v = (x[i] >= q2) ? x[i] - q2 : x[i];
+            x[i] = (v >= q) ? v - q : v;
+        }
+    }
+
+    static void mul_shoup_lazy_scalar(ui64* out, const ui64* in, const ui64 w, const ui64 w_shoup,
+            const ui32 n, const ui64 q){
+        for(ui32 i=0; i<n; i++){
+            ui64 Q = (ui64)(((ui128)w_shoup * in[i]) >> 64);
+            out[i] = w*in[i] - Q*q;
+        }
+    }
+
+    //-------------------------------- AVX2 -------------------------------
+    // AVX2 has no 64-bit multiplies so both halves of the product are
+    // assembled from 32x32 bit partial products. It has no unsigned
+    // compares either, lazy values reach 2^63 for q above 2^61 so both
+    // sides of a compare are biased by 2^63 to use the signed one.
+    __attribute__((target("avx2")))
+    static inline __m256i mulhi_epu64_avx2(const __m256i a, const __m256i b){
+        const __m256i lo32 = _mm256_set1_epi64x(0xffffffff);
+        __m256i a_hi = _mm256_srli_epi64(a, 32);
+        __m256i b_hi = _mm256_srli_epi64(b, 32);
+
+        __m256i ll = _mm256_mul_epu32(a, b);
+        __m256i lh = _mm256_mul_epu32(a, b_hi);
+        __m256i hl = _mm256_mul_epu32(a_hi, b);
+        __m256i hh = _mm256_mul_epu32(a_hi, b_hi);
+
+        __m256i mid = _mm256_add_epi64(_mm256_srli_epi64(ll, 32), _mm256_and_si256(lh, lo32));
+        mid = _mm256_add_epi64(mid, _mm256_and_si256(hl, lo32));
+
+        hh = _mm256_add_epi64(hh, _mm256_srli_epi64(lh, 32));
+        hh = _mm256_add_epi64(hh, _mm256_srli_epi64(hl, 32));
+        return _mm256_add_epi64(hh, _mm256_srli_epi64(mid, 32));
+    }
+
+    __attribute__((target("avx2")))
+    static inline __m256i mullo_epi64_avx2(const __m256i a, const __m256i b){
+        __m256i ll = _mm256_mul_epu32(a, b);
+        __m256i lh = _mm256_mul_epu32(a, _mm256_srli_epi64(b, 32));
+        __m256i hl = _mm256_mul_epu32(_mm256_srli_epi64(a, 32), b);
+        return _mm256_add_epi64(ll, _mm256_slli_epi64(_mm256_add_epi64(lh, hl), 32));
+    }
+
+    // w*y - floor(w_shoup*y/2^64)*q, in [0, 2q)
+    __attribute__((target("avx2")))
+    static inline __m256i mul_shoup_avx2(const __m256i y, const __m256i w, const __m256i w_shoup,
+            const __m256i q){
+        __m256i Q = mulhi_epu64_avx2(w_shoup, y);
+        return _mm256_sub_epi64(mullo_epi64_avx2(w, y), mullo_epi64_avx2(Q, q));
+    }
+
+    // m - 1 biased by 2^63 for csub_avx2
+    __attribute__((target("avx2")))
+    static inline __m256i csub_bound_avx2(const ui64 m){
+        return _mm256_set1_epi64x((m - 1) ^ (1ULL << 63));
+    }
+
+    // Subtract m from the lanes of a that are >= m, m_bound from csub_bound_avx2
+    __attribute__((target("avx2")))
+    static inline __m256i csub_avx2(const __m256i a, const __m256i m, const __m256i m_bound){
+        const __m256i bias = _mm256_set1_epi64x(1ULL << 63);
+        __m256i mask = _mm256_cmpgt_epi64(_mm256_xor_si256(a, bias), m_bound);
+        return _mm256_sub_epi64(a, _mm256_and_si256(mask, m));
+    }
+
+    __attribute__((target("avx2")))
+    static void ntt_ct_butterflies_avx2(ui64* x, ui64* y, const ui64 w, const ui64 w_shoup,
+            const ui32 n, const ui64 q){
+        const __m256i vq = _mm256_set1_epi64x(q);
+        const __m256i vq2 = _mm256_set1_epi64x(q << 1);
+        const __m256i vq2_bound = csub_bound_avx2(q << 1);
+        const __m256i vw = _mm256_set1_epi64x(w);
+        const __m256i vwp = _mm256_set1_epi64x(w_shoup);
+
+        ui32 i = 0;
+        for(; i+4<=n; i+=4){
+            __m256i vx = _mm256_loadu_si256((const __m256i*)(x+i));
+            __m256i vy = _mm256_loadu_si256((const __m256i*)(y+i));
+
+            vx = csub_avx2(vx, vq2, vq2_bound);
+            __m256i vT = mul_shoup_avx2(vy, vw, vwp, vq);
+
+            _mm256_storeu_si256((__m256i*)(x+i), _mm256_add_epi64(vx, vT));
+            _mm256_storeu_si256((__m256i*)(y+i), _mm256_add_epi64(_mm256_sub_epi64(vx, vT), vq2));
+        }
+        ntt_ct_butterflies_scalar(x+i, y+i, w, w_shoup, n-i, q);
+    }
+
+    __attribute__((target("avx2")))
+    static void ntt_gs_butterflies_avx2(ui64* x, ui64* y, const ui64 w, const ui64 w_shoup,
+            const ui32 n, const ui64 q){
+        const __m256i vq = _mm256_set1_epi64x(q);
+        const __m256i vq2 = _mm256_set1_epi64x(q << 1);
+        const __m256i vq2_bound = csub_bound_avx2(q << 1);
+        const __m256i vw = _mm256_set1_epi64x(w);
+        const __m256i vwp = _mm256_set1_epi64x(w_shoup);
+
+        ui32 i = 0;
+        for(; i+4<=n; i+=4){
+            __m256i vx = _mm256_loadu_si256((const __m256i*)(x+i));
+            __m256i vy = _mm256_loadu_si256((const __m256i*)(y+i));
+
+            __m256i vT = _mm256_add_epi64(_mm256_sub_epi64(vx, vy), vq2);
+            vx = csub_avx2(_mm256_add_epi64(vx, vy), vq2, vq2_bound);
+
+            _mm256_storeu_si256((__m256i*)(x+i), vx);
+            _mm256_storeu_si256((__m256i*)(y+i), mul_shoup_avx2(vT, vw, vwp, vq));
+        }
+        ntt_gs_butterflies_scalar(x+i, y+i, w, w_shoup, n-i, q);
+    }
+
+    __attribute__((target("avx2")))
+    static void reduce_4q_avx2(ui64* x, const ui32 n, const ui64 q){
+        const __m256i vq = _mm256_set1_epi64x(q);
+        const __m256i vq_bound = csub_bound_avx2(q);
+        const __m256i vq2 = _mm256_set1_epi64x(q << 1);
+        const __m256i vq2_bound = csub_bound_avx2(q << 1);
+
+        ui32 i = 0;
+        for(; i+4<=n; i+=4){
+            __m256i vx = _mm256_loadu_si256((const __m256i*)(x+i));
+            vx = csub_avx2(vx, vq2, vq2_bound);
+            vx = csub_avx2(vx, vq, vq_bound);
+            _mm256_storeu_si256((__m256i*)(x+i), vx);
+        }
+        reduce_4q_scalar(x+i, n-i, q);
+    }
+
+    __attribute__((target("avx2")))
+    static void mul_shoup_lazy_avx2(ui64* out, const ui64* in, const ui64 w, const ui64 w_shoup,
+            const ui32 n, const ui64 q){
+        const __m256i vq = _mm256_set1_epi64x(q);
+        const __m256i vw = _mm256_set1_epi64x(w);
+        const __m256i vwp = _mm256_set1_epi64x(w_shoup);
+
+        ui32 i = 0;
+        for(; i+4<=n; i+=4){
+            __m256i vx = _mm256_loadu_si256((const __m256i*)(in+i));
+            _mm256_storeu_si256((__m256i*)(out+i), mul_shoup_avx2(vx, vw, vwp, vq));
+        }
+        mul_shoup_lazy_scalar(out+i, in+i, w, w_shoup, n-i, q);
+    }
+
+    //------------------------------- AVX-512 -----------------------------
+    // AVX-512DQ gives us the low half of the 64-bit product directly, only
+    // the high half needs to be assembled from partial products. Shifts,
+    // multiplies and minimums use the zero masked forms with all lanes
+    // set, gcc warns about the undefined source the unmasked ones pass.
+    static const __mmask8 ALL_LANES = 0xff;
+
+    __attribute__((target("avx512f,avx512dq")))
+    static inline __m512i mulhi_epu64_avx512(const __m512i a, const __m512i b){
+        const __m512i lo32 = _mm512_set1_epi64(0xffffffff);
+        __m512i a_hi = _mm512_maskz_srli_epi64(ALL_LANES, a, 32);
+        __m512i b_hi = _mm512_maskz_srli_epi64(ALL_LANES, b, 32);
+
+        __m512i ll = _mm512_maskz_mul_epu32(ALL_LANES, a, b);
+        __m512i lh = _mm512_maskz_mul_epu32(ALL_LANES, a, b_hi);
+        __m512i hl = _mm512_maskz_mul_epu32(ALL_LANES, a_hi, b);
+        __m512i hh = _mm512_maskz_mul_epu32(ALL_LANES, a_hi, b_hi);
+
+        __m512i mid = _mm512_add_epi64(_mm512_maskz_srli_epi64(ALL_LANES, ll, 32), _mm512_and_si512(lh, lo32));
+        mid = _mm512_add_epi64(mid, _mm512_and_si512(hl, lo32));
+
+        hh = _mm512_add_epi64(hh, _mm512_maskz_srli_epi64(ALL_LANES, lh, 32));
+        hh = _mm512_add_epi64(hh, _mm512_maskz_srli_epi64(ALL_LANES, hl, 32));
+        return _mm512_add_epi64(hh, _mm512_maskz_srli_epi64(ALL_LANES, mid, 32));
+    }
+
+    __attribute__((target("avx512f,avx512dq")))
+    static inline __m512i mul_shoup_avx512(const __m512i y, const __m512i w, const __m512i w_shoup,
+            const __m512i q){
+        __m512i Q = mulhi_epu64_avx512(w_shoup, y);
+        return _mm512_sub_epi64(_mm512_mullo_epi64(w, y), _mm512_mullo_epi64(Q, q));
+    }
+
+    // min(a, a-m) is a-m exactly when a >= m, otherwise a-m wraps around
+    __attribute__((target("avx512f,avx512dq")))
+    static inline __m512i csub_avx512(const __m512i a, const __m512i m){
+        return _mm512_maskz_min_epu64(ALL_LANES, a, _mm512_sub_epi64(a, m));
+    }
+
+    __attribute__((target("avx512f,avx512dq")))
+    static void ntt_ct_butterflies_avx512(ui64* x, ui64* y, const ui64 w, const ui64 w_shoup,
+            const ui32 n, const ui64 q){
+        const __m512i vq = _mm512_set1_epi64(q);
+        const __m512i vq2 = _mm512_set1_epi64(q << 1);
+        const __m512i vw = _mm512_set1_epi64(w);
+        const __m512i vwp = _mm512_set1_epi64(w_shoup);
+
+        ui32 i = 0;
+        for(; i+8<=n; i+=8){
+            __m512i vx = _mm512_loadu_si512((const void*)(x+i));
+            __m512i vy = _mm512_loadu_si512((const void*)(y+i));
+
+            vx = csub_avx512(vx, vq2);
+            __m512i vT = mul_shoup_avx512(vy, vw, vwp, vq);
+
+            _mm512_storeu_si512((void*)(x+i), _mm512_add_epi64(vx, vT));
+            _mm512_storeu_si512((void*)(y+i), _mm512_add_epi64(_mm512_sub_epi64(vx, vT), vq2));
+        }
+        // Narrow groups still fit the 256-bit kernel
+        ntt_ct_butterflies_avx2(x+i, y+i, w, w_shoup, n-i, q);
+    }
+
+    __attribute__((target("avx512f,avx512dq")))
+    static void ntt_gs_butterflies_avx512(ui64* x, ui64* y, const ui64 w, const ui64 w_shoup,
+            const ui32 n, const ui64 q){
+        const __m512i vq = _mm512_set1_epi64(q);
+        const __m512i vq2 = _mm512_set1_epi64(q << 1);
+        const __m512i vw = _mm512_set1_epi64(w);
+        const __m512i vwp = _mm512_set1_epi64(w_shoup);
+
+        ui32 i = 0;
+        for(; i+8<=n; i+=8){
+            __m512i vx = _mm512_loadu_si512((const void*)(x+i));
+            __m512i vy = _mm512_loadu_si512((const void*)(y+i));
+
+            __m512i vT = _mm512_add_epi64(_mm512_sub_epi64(vx, vy), vq2);
+            vx = csub_avx512(_mm512_add_epi64(vx, vy), vq2);
+
+            _mm512_storeu_si512((void*)(x+i), vx);
+            _mm512_storeu_si512((void*)(y+i), mul_shoup_avx512(vT, vw, vwp, vq));
+        }
+        ntt_gs_butterflies_avx2(x+i, y+i, w, w_shoup, n-i, q);
+    }
+
+    __attribute__((target("avx512f,avx512dq")))
+    static void reduce_4q_avx512(ui64* x, const ui32 n, const ui64 q){
+        const __m512i vq = _mm512_set1_epi64(q);
+        const __m512i vq2 = _mm512_set1_epi64(q << 1);
+
+        ui32 i = 0;
+        for(; i+8<=n; i+=8){
+            __m512i vx = _mm512_loadu_si512((const void*)(x+i));
+            vx = csub_avx512(csub_avx512(vx, vq2), vq);
+            _mm512_storeu_si512((void*)(x+i), vx);
+        }
+        reduce_4q_scalar(x+i, n-i, q);
+    }
+
+    __attribute__((target("avx512f,avx512dq")))
+    static void mul_shoup_lazy_avx512(ui64* out, const ui64* in, const ui64 w, const ui64 w_shoup,
+            const ui32 n, const ui64 q){
+        const __m512i vq = _mm512_set1_epi64(q);
+        const __m512i vw = _mm512_set1_epi64(w);
+        const __m512i vwp = _mm512_set1_epi64(w_shoup);
+
+        ui32 i = 0;
+        for(; i+8<=n; i+=8){
+            __m512i vx = _mm512_loadu_si512((const void*)(in+i));
+            _mm512_storeu_si512((void*)(out+i), mul_shoup_avx512(vx, vw, vwp, vq));
+        }
+        mul_shoup_lazy_scalar(out+i, in+i, w, w_shoup, n-i, q);
+    }
+
+    //------------------------------ Dispatch -----------------------------
+    typedef void (*butterfly_fn)(ui64*, ui64*, const ui64, const ui64, const ui32, const ui64);
+    typedef void (*reduce_fn)(ui64*, const ui32, const ui64);
+    typedef void (*mul_shoup_fn)(ui64*, const ui64*, const ui64, const ui64, const ui32, const ui64);
+
+    struct kernel_table {
+        SIMD_LEVEL level;
+        ui32 width;
+        butterfly_fn ct_butterflies;
+        butterfly_fn gs_butterflies;
+        reduce_fn reduce;
+        mul_shoup_fn mul_shoup;
+    };
+
+    static const kernel_table g_kernels[] = {
+        {SCALAR, 1, ntt_ct_butterflies_scalar, ntt_gs_butterflies_scalar,
+                reduce_4q_scalar, mul_shoup_lazy_scalar},
+        {AVX2, 4, ntt_ct_butterflies_avx2, ntt_gs_butterflies_avx2,
+                reduce_4q_avx2, mul_shoup_lazy_avx2},
+        {AVX512, 4, ntt_ct_butterflies_avx512, ntt_gs_butterflies_avx512,
+                reduce_4q_avx512, mul_shoup_lazy_avx512},
+    };
+
+    SIMD_LEVEL max_simd_level(){
+        __builtin_cpu_init();
+        if(__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512dq")){
+            return AVX512;
+        } else if(__builtin_cpu_supports("avx2")){
+            return AVX2;
+        }
+        return SCALAR;
+    }
+
+    // The tables are constant and every level computes the same values, so
+    // a transform that sees the level change half way is still correct
+    static std::atomic<const kernel_table*>& selected_kernels(){
+        static std::atomic<const kernel_table*> kernels(&g_kernels[max_simd_level()]);
+        return kernels;
+    }
+
+    static const kernel_table* current_kernels(){
+        return selected_kernels().load(std::memory_order_relaxed);
+    }
+
+    SIMD_LEVEL get_simd_level(){
+        return current_kernels()->level;
+    }
+
+    SIMD_LEVEL set_simd_level(SIMD_LEVEL level){
+        SIMD_LEVEL max_level = max_simd_level();
+        selected_kernels().store(&g_kernels[(level > max_level) ? max_level : level],
+                std::memory_order_relaxed);
+        return get_simd_level();
+    }
+
+    ui32 simd_width(){
+        return current_kernels()->width;
+    }
+
+    void ntt_ct_butterflies(ui64* x, ui64* y, const ui64 w, const ui64 w_shoup,
+            const ui32 n, const ui64 q){
+        current_kernels()->ct_butterflies(x, y, w, w_shoup, n, q);
+    }
+
+    void ntt_gs_butterflies(ui64* x, ui64* y, const ui64 w, const ui64 w_shoup,
+            const ui32 n, const ui64 q){
+        current_kernels()->gs_butterflies(x, y, w, w_shoup, n, q);
+    }
+
+    void reduce_4q(ui64* x, const ui32 n, const ui64 q){
+        current_kernels()->reduce(x, n, q);
+    }
+
+    void mul_shoup_lazy(ui64* out, const ui64* in, const ui64 w, const ui64 w_shoup,
+            const ui32 n, const ui64 q){
+        current_kernels()->mul_shoup(out, in, w, w_shoup, n, q);
+    }
+
+    }
+}
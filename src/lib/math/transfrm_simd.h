@@ -0,0 +1,88 @@
+/*
+ * transfrm_simd.h
+ *
+ *	Vectorized butterfly kernels for the transform code. All kernels use
+ *	Harvey's lazy reduction with Shoup precomputed twiddles and work for any
+ *	modulus below 2^62. Values are kept in [0, 4q) between the stages.
+ *
+ */
+
+#ifndef LBCRYPTO_MATH_TRANSFRM_SIMD_H
+#define LBCRYPTO_MATH_TRANSFRM_SIMD_H
+
+#include "utils/backend.h"
+
+namespace lbcrypto {
+    namespace simd {
+        enum SIMD_LEVEL {
+            SCALAR = 0,
+            AVX2 = 1,
+            AVX512 = 2
+        };
+
+        // Best level supported by the cpu we are running on
+        SIMD_LEVEL max_simd_level();
+
+        // Level currently used by the transforms
+        SIMD_LEVEL get_simd_level();
+
+        // Select the level used by the transforms. Requests above the cpu
+        // capability are clamped. Returns the level actually selected. Safe
+        // to call while other threads run transforms.
+        SIMD_LEVEL set_simd_level(SIMD_LEVEL level);
+
+        // Smallest butterfly run the kernels of the current level vectorize,
+        // narrower groups are better done with the scalar butterflies directly
+        ui32 simd_width();
+
+        // Shoup companion of w, floor(w*2^64/q). Requires w < q.
+        inline ui64 shoup(const ui64 w, const ui64 q){
+            return (ui64)(((ui128)w << 64) / q);
+        }
+
+        // Single lazy Cooley-Tukey butterfly, q2 = 2*q:
+        //  (x, y) <- (x + w*y, x - w*y) with inputs and outputs in [0, 4q)
+        inline void butterfly_ct(ui64& x, ui64& y, const ui64 w, const ui64 w_shoup,
+                const ui64 q, const ui64 q2){
+            ui64 X = (x >= q2) ? x - q2 : x;
+            ui64 Q = (ui64)(((ui128)w_shoup * y) >> 64);
+            ui64 T = w*y - Q*q;
+            x = X + T;
+            y = X - T + q2;
+        }
+
+        // Single lazy Gentleman-Sande butterfly, q2 = 2*q:
+        //  (x, y) <- (x + y, w*(x - y)) with inputs and outputs in [0, 2q)
+        inline void butterfly_gs(ui64& x, ui64& y, const ui64 w, const ui64 w_shoup,
+                const ui64 q, const ui64 q2){
+            ui64 T = x - y + q2;
+            ui64 X = x + y;
+            x = (X >= q2) ? X - q2 : X;
+            ui64 Q = (ui64)(((ui128)w_shoup * T) >> 64);
+            y = w*T - Q*q;
+        }
+
+        // n Cooley-Tukey butterflies sharing the twiddle w
+        void ntt_ct_butterflies(ui64* x, ui64* y, const ui64 w, const ui64 w_shoup,
+                const ui32 n, const ui64 q);
+
+        // n Gentleman-Sande butterflies sharing the twiddle w
+        void ntt_gs_butterflies(ui64* x, ui64* y, const ui64 w, const ui64 w_shoup,
+                const ui32 n, const ui64 q);
+
+        // Reduce n values from [0, 4q) to [0, q)
+        void reduce_4q(ui64* x, const ui32 n, const ui64 q);
+
+        // out[i] = in[i]*w mod q, in [0, 2q). The input can be any 64-bit value,
+        // out and in are allowed to alias.
+        void mul_shoup_lazy(ui64* out, const ui64* in, const ui64 w, const ui64 w_shoup,
+                const ui32 n, const ui64 q);
+
+        // Reduce n arbitrary 64-bit values to [0, 2q), out and in can alias
+        inline void reduce_lazy(ui64* out, const ui64* in, const ui32 n, const ui64 q){
+            mul_shoup_lazy(out, in, 1, shoup(1, q), n, q);
+        }
+    }
+}
+
+#endif
@@ -34,16 +34,18 @@ EncMat preprocess_filter_1d(const uv64& filter, const ui32 window_size,
 
     EncMat enc_filter(filter_size, std::vector<uv64>(num_windows, uv64(params.phim)));
     for(ui32 row=0; row<filter_size; row++){
-        auto pt_row = packed_encode(filter_mat[row], params.p, params.logn);
+        auto pt_row = packed_encode(filter_mat[row], params);
         auto decomposed_row = base_decompose(pt_row, window_size, num_windows);
         for(ui32 w=0; w<num_windows; w++){
-            enc_filter[row][w] = NullEncrypt(decomposed_row[w], params);
+            enc_filter[row][w] = decomposed_row[w];
         }
     }
+    ToEvalBatch(enc_filter, params);
     return enc_filter;
 }
 
-CTMat conv_1d_rot(const CTVec& ct_vec, const ui32& filter_size, const FVParams& params){
+CTMat conv_1d_rot(const CTVec& ct_vec, const ui32& filter_size, const AutomorphismKeys& keys,
+        const FVParams& params){
     ui32 offset = (filter_size-1)/2;
     ui32 mask = (params.phim >> 1)-1;
 
@@ -55,8 +57,7 @@ CTMat conv_1d_rot(const CTVec& ct_vec, const ui32& filter_size, const FVParams&
             if(rot == 0){
                 ct_mat[row][w] = ct_vec[w];
             } else {
-                auto rk = GetAutomorphismKey(rot);
-                ct_mat[row][w] = EvalAutomorphismDigits(rot, *rk, ct_vec[w], digits_vec_w, params);
+                ct_mat[row][w] = EvalAutomorphismDigits(rot, keys, ct_vec[w], digits_vec_w, params);
             }
         }
     }
@@ -64,23 +65,23 @@ CTMat conv_1d_rot(const CTVec& ct_vec, const ui32& filter_size, const FVParams&
     return ct_mat;
 }
 
-Ciphertext conv_1d_mul(const CTMat& ct_mat, const EncMat& enc_filter, const FVParams& params){
+Ciphertext conv_1d_mul(const CTMat& ct_mat, const EncMatView& enc_filter, const FVParams& params){
     ui32 filter_size = enc_filter.size();
 
-    Ciphertext conv(params.phim);
+    CiphertextAccumulator conv(params.phim);
     for(ui32 w=0; w<ct_mat[0].size(); w++){
         for(ui32 row=0; row<filter_size; row++){
-            auto mult = EvalMultPlain(ct_mat[row][w], enc_filter[row][w], params);
-            conv = EvalAdd(conv, mult, params);
+            EvalMultPlainAccumulate(conv, ct_mat[row][w], enc_filter[row][w], params);
         }
     }
 
-    return conv;
+    return Reduce(conv, params);
 }
 
-Ciphertext conv_1d_online(const CTVec& ct_vec, const EncMat& enc_filter, const FVParams& params){
+Ciphertext conv_1d_online(const CTVec& ct_vec, const EncMatView& enc_filter,
+        const AutomorphismKeys& keys, const FVParams& params){
     auto filter_size = enc_filter.size();
-    auto ct_mat = conv_1d_rot(ct_vec, filter_size, params);
+    auto ct_mat = conv_1d_rot(ct_vec, filter_size, keys, params);
     return conv_1d_mul(ct_mat, enc_filter, params);
 }
 
@@ -18,12 +18,13 @@
 
 namespace lbcrypto {
 
-void update_ct_mat(CTMat& ct_mat, const ui32 ct_idx,
+template <class CT>
+void update_ct_mat(std::vector<std::vector<CT>>& ct_mat, const ui32 ct_idx,
         const SecretKey& sk, const uv64& in,
         const ui32 window_size, const ui32 num_windows, const FVParams& params){
-    uv64 pt = packed_encode(in, params.p, params.logn);
+    uv64 pt = packed_encode(in, params);
     for(ui32 w=0; w<num_windows; w++){
-        ct_mat[w][ct_idx] = Encrypt(sk, pt, params);
+        EncryptInto(ct_mat[w][ct_idx], sk, pt, params);
 
         // Scale for the next iteration
         for (ui32 i=0; i<params.phim; i++){
@@ -32,7 +33,8 @@ void update_ct_mat(CTMat& ct_mat, const ui32 ct_idx,
     }
 }
 
-CTMat preprocess_ifmap(const SecretKey& sk, const ConvLayer& in,
+template <class CT>
+static std::vector<std::vector<CT>> preprocess_ifmap_impl(const SecretKey& sk, const ConvLayer& in,
         const ui32 window_size, const ui32 num_windows, const FVParams& params){
     ui32 chn_pow2 = nxt_pow2(in.shape.h*in.shape.w);
     ui32 row_pow2 = nxt_pow2(in.shape.w);
@@ -45,7 +47,7 @@ CTMat preprocess_ifmap(const SecretKey& sk, const ConvLayer& in,
         ui32 num_ct = num_ct_chn*2*div_ceil(in.shape.chn, 2);
         ui32 rows_per_ct = params.phim/2/row_pow2;
 
-        CTMat ct_mat(num_windows, std::vector<Ciphertext>(num_ct, Ciphertext(params.phim)));
+        std::vector<std::vector<CT>> ct_mat(num_windows, std::vector<CT>(num_ct, CT(params.phim)));
         for(ui32 curr_set=0; curr_set<div_ceil(in.shape.chn, 2); curr_set++){
             for(ui32 ct_offset=0; ct_offset<num_ct_chn*2; ct_offset++){
                 // Pack the appropriate number of channels into a single ciphertext
@@ -81,7 +83,7 @@ CTMat preprocess_ifmap(const SecretKey& sk, const ConvLayer& in,
         ui32 num_ct = div_ceil(tot_pixels, params.phim);
         ui32 chn_per_ct = params.phim/chn_pow2;
 
-        CTMat ct_mat(num_windows, std::vector<Ciphertext>(num_ct, Ciphertext(params.phim)));
+        std::vector<std::vector<CT>> ct_mat(num_windows, std::vector<CT>(num_ct, CT(params.phim)));
         for(ui32 ct_idx=0; ct_idx<num_ct; ct_idx++){
             // Pack the appropriate number of channels into a single ciphertext
             uv64 packed_chn(params.phim, 0);
@@ -110,6 +112,16 @@ CTMat preprocess_ifmap(const SecretKey& sk, const ConvLayer& in,
     }
 }
 
+CTMat preprocess_ifmap(const SecretKey& sk, const ConvLayer& in,
+        const ui32 window_size, const ui32 num_windows, const FVParams& params){
+    return preprocess_ifmap_impl<Ciphertext>(sk, in, window_size, num_windows, params);
+}
+
+SeededCTMat preprocess_ifmap_seeded(const SecretKey& sk, const ConvLayer& in,
+        const ui32 window_size, const ui32 num_windows, const FVParams& params){
+    return preprocess_ifmap_impl<SeededCiphertext>(sk, in, window_size, num_windows, params);
+}
+
 EncMat preprocess_filter(const Filter2D& filter, const ConvShape& shape,
          const ui32 window_size, const ui32 num_windows, const FVParams& params){
     ui32 chn_pow2 = nxt_pow2(shape.h*shape.w);
@@ -175,10 +187,10 @@ EncMat preprocess_filter(const Filter2D& filter, const ConvShape& shape,
                             // std::cout << enc_row << ": " <<  vec_to_str(filter_base) << std::endl;
 
                             // Encode to coeff, decompose into windows and encode to eval
-                            auto pt_row = packed_encode(filter_base, params.p, params.logn);
+                            auto pt_row = packed_encode(filter_base, params);
                             auto decomposed_row = base_decompose(pt_row, window_size, num_windows);
                             for(ui32 w=0; w<num_windows; w++){
-                                enc_filter[enc_row][w] = NullEncrypt(decomposed_row[w], params);
+                                enc_filter[enc_row][w] = decomposed_row[w];
                             }
                             enc_row++;
                         }
@@ -187,13 +199,14 @@ EncMat preprocess_filter(const Filter2D& filter, const ConvShape& shape,
             }
         }
 
-
+        ToEvalBatch(enc_filter, params);
         return enc_filter;
     }
 }
 
-CTVec conv_2d_online(const CTMat& ct_mat, const EncMat& enc_mat,
-        const Filter2DShape& filter_shape, const ConvShape& in_shape, const FVParams& params){
+CTVec conv_2d_online(const CTMat& ct_mat, const EncMatView& enc_mat,
+        const Filter2DShape& filter_shape, const ConvShape& in_shape,
+        const AutomorphismKeys& keys, const FVParams& params, Arena* arena){
     ui32 chn_pow2 = nxt_pow2(in_shape.h*in_shape.w);
     ui32 row_pow2 = nxt_pow2(in_shape.w);
 
@@ -210,47 +223,41 @@ CTVec conv_2d_online(const CTMat& ct_mat, const EncMat& enc_mat,
         ui32 out_ct = div_ceil(filter_shape.out_chn, chn_per_ct);
         ui32 inner_loop = chn_per_ct;
 
-        CTVec ct_vec(out_ct, Ciphertext(params.phim));
-        Ciphertext rot_vec(params.phim);
+        std::vector<CiphertextAccumulator> ct_acc(out_ct, CiphertextAccumulator(params.phim));
 
         // Input stationary computation over all the plaintext windows
         for(ui32 w=0; w<ct_mat.size(); w++){
             ui32 row = 0;
             for(ui32 curr_in_ct=0; curr_in_ct<in_ct; curr_in_ct++){
-                auto digits_vec_w = HoistedDecompose(ct_mat[w][curr_in_ct], params);
+                auto digits_vec_w = HoistedDecompose(ct_mat[w][curr_in_ct], params, arena);
 
                 // Compute the rotation index
                 for(ui32 curr_loop=0; curr_loop<inner_loop; curr_loop++){
                     ui32 rot_base = curr_loop*chn_pow2;
+                    uv32 rot_list;
                     for(ui32 f_h=0; f_h<filter_shape.f_h; f_h++){
                         ui32 rot_h = (f_h-offset_h)*in_shape.w;
                         for(ui32 f_w=0; f_w<filter_shape.f_w; f_w++){
                             ui32 rot_w = (f_w-offset_w);
                             ui32 rot_f = ((rot_base + rot_h + rot_w) & ((params.phim >> 1) - 1));
-                            ui32 rot = (rot_base & (params.phim >> 1)) + rot_f;
-
-                            // Rotate if necessary
-                            const Ciphertext *curr_vec = &ct_mat[w][curr_in_ct];
-                            if(rot != 0){
-                                auto rk = GetAutomorphismKey(rot);
-                                rot_vec = EvalAutomorphismDigits(rot, *rk, *curr_vec, digits_vec_w, params);
-                                curr_vec = &rot_vec;
-                            }
-
-                            // Accumulate to all the outputs
-                            for(ui32 curr_out_ct=0; curr_out_ct<out_ct; curr_out_ct++){
-                                auto mult = EvalMultPlain(*curr_vec, enc_mat[row][w], params);
-                                ct_vec[curr_out_ct] = EvalAdd(ct_vec[curr_out_ct], mult, params);
-                                // std::cout << w << " " << curr_in_ct << " " << row << " " << rot << std::endl;
-                                row++;
-                            }
+                            rot_list.push_back((rot_base & (params.phim >> 1)) + rot_f);
                         }
                     }
+
+                    // Accumulate every rotation of the filter window to all the outputs
+                    ForEachAutomorphism(rot_list, keys, ct_mat[w][curr_in_ct], digits_vec_w, params,
+                            [&](ui32 r, const Ciphertext& rot_vec){
+                        for(ui32 curr_out_ct=0; curr_out_ct<out_ct; curr_out_ct++){
+                            EvalMultPlainAccumulate(ct_acc[curr_out_ct], rot_vec, enc_mat[row][w], params);
+                            // std::cout << w << " " << curr_in_ct << " " << row << " " << rot_list[r] << std::endl;
+                            row++;
+                        }
+                    });
                 }
             }
         }
 
-        return ct_vec;
+        return Reduce(ct_acc, params);
     }
 }
 
@@ -325,10 +332,10 @@ EncMat preprocess_filter_2stage(const Filter2D& filter, const ConvShape& shape,
                                 // std::cout << std::endl;
 
                                 // Encode to coeff, decompose into windows and encode to eval
-                                auto pt_row = packed_encode(filter_base, params.p, params.logn);
+                                auto pt_row = packed_encode(filter_base, params);
                                 auto decomposed_row = base_decompose(pt_row, window_size, num_windows);
                                 for(ui32 w=0; w<num_windows; w++){
-                                    enc_filter[enc_row][w] = NullEncrypt(decomposed_row[w], params);
+                                    enc_filter[enc_row][w] = decomposed_row[w];
                                 }
                                 enc_row++;
                             }
@@ -338,6 +345,7 @@ EncMat preprocess_filter_2stage(const Filter2D& filter, const ConvShape& shape,
             }
         }
 
+        ToEvalBatch(enc_filter, params);
         return enc_filter;
     } else {
         ui32 chn_per_ct = params.phim/chn_pow2;
@@ -396,10 +404,10 @@ EncMat preprocess_filter_2stage(const Filter2D& filter, const ConvShape& shape,
 
 
                             // Encode to coeff, decompose into windows and encode to eval
-                            auto pt_row = packed_encode(filter_base, params.p, params.logn);
+                            auto pt_row = packed_encode(filter_base, params);
                             auto decomposed_row = base_decompose(pt_row, window_size, num_windows);
                             for(ui32 w=0; w<num_windows; w++){
-                                enc_filter[enc_row][w] = NullEncrypt(decomposed_row[w], params);
+                                enc_filter[enc_row][w] = decomposed_row[w];
                             }
                             enc_row++;
                         }
@@ -408,12 +416,14 @@ EncMat preprocess_filter_2stage(const Filter2D& filter, const ConvShape& shape,
             }
         }
 
+        ToEvalBatch(enc_filter, params);
         return enc_filter;
     }
 }
 
-CTVec conv_2d_2stage_online(const CTMat& ct_mat, const EncMat& enc_mat,
-        const Filter2DShape& filter_shape, const ConvShape& in_shape, const FVParams& params){
+CTVec conv_2d_2stage_online(const CTMat& ct_mat, const EncMatView& enc_mat,
+        const Filter2DShape& filter_shape, const ConvShape& in_shape,
+        const AutomorphismKeys& keys, const FVParams& params, Arena* arena){
     ui32 chn_pow2 = nxt_pow2(in_shape.h*in_shape.w);
     ui32 row_pow2 = nxt_pow2(in_shape.w);
 
@@ -433,8 +443,7 @@ CTVec conv_2d_2stage_online(const CTMat& ct_mat, const EncMat& enc_mat,
         // ui32 in_ct = num_ct_chn*2*div_ceil(filter_shape.in_chn, 2);
         ui32 out_ct = num_ct_chn*2*div_ceil(filter_shape.out_chn, 2);
 
-        CTVec ct_mid(out_ct*2, Ciphertext(params.phim));
-        CTVec rot_vec(2, Ciphertext(params.phim));
+        std::vector<CiphertextAccumulator> ct_acc(out_ct*2, CiphertextAccumulator(params.phim));
 
         // Input stationary computation over all the plaintext windows
         for(ui32 w=0; w<ct_mat.size(); w++){
@@ -443,10 +452,10 @@ CTVec conv_2d_2stage_online(const CTMat& ct_mat, const EncMat& enc_mat,
                 for(ui32 in_row_idx=0; in_row_idx<2*num_ct_chn; in_row_idx++){
                     ui32 in_ct_idx = in_row_idx + in_set*2*num_ct_chn;
 
-                    std::vector<uv64> digits_vec_w;
+                    std::vector<av64> digits_vec_w;
                     if((filter_shape.f_w > 1) || (in_row_idx < offset_h) ||
                             (in_row_idx >= (2*num_ct_chn-offset_h))) {
-                        digits_vec_w = HoistedDecompose(ct_mat[w][in_ct_idx], params);
+                        digits_vec_w = HoistedDecompose(ct_mat[w][in_ct_idx], params, arena);
                     }
 
                     for(ui32 f_w=0; f_w<filter_shape.f_w; f_w++){
@@ -458,20 +467,11 @@ CTVec conv_2d_2stage_online(const CTMat& ct_mat, const EncMat& enc_mat,
                             rot_h = (params.phim >> 1)-in_shape.w;
                         }
                         ui32 rot_a = (rot_w & ((params.phim >> 1) - 1));
-                        const Ciphertext *base_vec = &ct_mat[w][in_ct_idx];
-                        if(rot_a != 0){
-                            auto rk = GetAutomorphismKey(rot_a);
-                            rot_vec[0] = EvalAutomorphismDigits(rot_a, *rk, *base_vec, digits_vec_w, params);
-                            base_vec = &rot_vec[0];
-                        }
-
                         ui32 rot_b = ((rot_h + rot_w) & ((params.phim >> 1) - 1));
-                        const Ciphertext *alt_vec = &ct_mat[w][in_ct_idx];
-                        if(rot_b != 0){
-                            auto rk = GetAutomorphismKey(rot_b);
-                            rot_vec[1] = EvalAutomorphismDigits(rot_b, *rk, *alt_vec, digits_vec_w, params);
-                            alt_vec = &rot_vec[1];
-                        }
+                        auto rot_vec = EvalAutomorphismDigitsBatch({rot_a, rot_b}, keys,
+                                ct_mat[w][in_ct_idx], digits_vec_w, params);
+                        const Ciphertext *base_vec = &rot_vec[0];
+                        const Ciphertext *alt_vec = &rot_vec[1];
 
                         for(ui32 f_h=0; f_h<filter_shape.f_h; f_h++){
                             ui32 out_row_idx = in_row_idx+offset_h;
@@ -498,8 +498,8 @@ CTVec conv_2d_2stage_online(const CTMat& ct_mat, const EncMat& enc_mat,
                                 for(ui32 inner_loop=0; inner_loop<2; inner_loop++){
                                     ui32 mid_ct_idx = 2*out_ct_idx + inner_loop;
 
-                                    auto mult = EvalMultPlain(*curr_vec, enc_mat[filter_row][w], params);
-                                    ct_mid[mid_ct_idx] = EvalAdd(ct_mid[mid_ct_idx], mult, params);
+                                    EvalMultPlainAccumulate(ct_acc[mid_ct_idx], *curr_vec,
+                                            enc_mat[filter_row][w], params);
                                     /* std::cout << w << " " << in_ct_idx << " " << f_w << " " << f_h
                                             << " " << filter_row << " "
                                             << rot << " " << mid_ct_idx << std::endl; */
@@ -512,11 +512,12 @@ CTVec conv_2d_2stage_online(const CTMat& ct_mat, const EncMat& enc_mat,
             }
         }
 
+        auto ct_mid = Reduce(ct_acc, params);
         CTVec ct_vec(out_ct, Ciphertext(params.phim));
         // Compute the rotation index
         for(ui32 curr_out_ct=0; curr_out_ct<out_ct; curr_out_ct++){
             // std::cout << curr_loop << " " << rot << std::endl;
-            auto rot_vec = EvalAutomorphism(params.phim/2, ct_mid[curr_out_ct*2+1], params);
+            auto rot_vec = EvalAutomorphism(params.phim/2, keys, ct_mid[curr_out_ct*2+1], params);
             ct_vec[curr_out_ct] = EvalAdd(ct_mid[curr_out_ct*2], rot_vec, params);
         }
 
@@ -527,44 +528,39 @@ CTVec conv_2d_2stage_online(const CTMat& ct_mat, const EncMat& enc_mat,
         ui32 out_ct = div_ceil(filter_shape.out_chn, chn_per_ct);
         ui32 inner_loop = chn_per_ct;
 
-        CTVec ct_mid(out_ct*inner_loop, Ciphertext(params.phim));
-        Ciphertext rot_vec(params.phim);
+        std::vector<CiphertextAccumulator> ct_acc(out_ct*inner_loop, CiphertextAccumulator(params.phim));
 
         // Input stationary computation over all the plaintext windows
         for(ui32 w=0; w<ct_mat.size(); w++){
             ui32 row = 0;
             for(ui32 curr_in_ct=0; curr_in_ct<in_ct; curr_in_ct++){
-                std::vector<uv64> digits_vec_w;
+                std::vector<av64> digits_vec_w;
                 if(filter_shape.f_h*filter_shape.f_w > 1) {
-                    digits_vec_w = HoistedDecompose(ct_mat[w][curr_in_ct], params);
+                    digits_vec_w = HoistedDecompose(ct_mat[w][curr_in_ct], params, arena);
                 }
 
+                uv32 rot_list;
                 for(ui32 f_h=0; f_h<filter_shape.f_h; f_h++){
                     ui32 rot_h = (f_h-offset_h)*in_shape.w;
                     for(ui32 f_w=0; f_w<filter_shape.f_w; f_w++){
                         ui32 rot_w = (f_w-offset_w);
-                        ui32 rot = ((rot_h + rot_w) & ((params.phim >> 1) - 1));
-
-                        // Rotate if necessary
-                        const Ciphertext *curr_vec = &ct_mat[w][curr_in_ct];
-                        if(rot != 0){
-                            auto rk = GetAutomorphismKey(rot);
-                            rot_vec = EvalAutomorphismDigits(rot, *rk, *curr_vec, digits_vec_w, params);
-                            curr_vec = &rot_vec;
-                        }
-
-                        // Accumulate to all the outputs
-                        for(ui32 curr_out_ct=0; curr_out_ct<out_ct*inner_loop; curr_out_ct++){
-                            auto mult = EvalMultPlain(*curr_vec, enc_mat[row][w], params);
-                            ct_mid[curr_out_ct] = EvalAdd(ct_mid[curr_out_ct], mult, params);
-                            // std::cout << w << " " << curr_in_ct << " " << row << " " << rot << std::endl;
-                            row++;
-                        }
+                        rot_list.push_back((rot_h + rot_w) & ((params.phim >> 1) - 1));
                     }
                 }
+
+                // Accumulate every rotation of the filter window to all the outputs
+                ForEachAutomorphism(rot_list, keys, ct_mat[w][curr_in_ct], digits_vec_w, params,
+                        [&](ui32 r, const Ciphertext& rot_vec){
+                    for(ui32 curr_out_ct=0; curr_out_ct<out_ct*inner_loop; curr_out_ct++){
+                        EvalMultPlainAccumulate(ct_acc[curr_out_ct], rot_vec, enc_mat[row][w], params);
+                        // std::cout << w << " " << curr_in_ct << " " << row << " " << rot_list[r] << std::endl;
+                        row++;
+                    }
+                });
             }
         }
 
+        auto ct_mid = Reduce(ct_acc, params);
         CTVec ct_vec(out_ct, Ciphertext(params.phim));
         // Compute the rotation index
         for(ui32 curr_out_ct=0; curr_out_ct<out_ct; curr_out_ct++){
@@ -576,9 +572,9 @@ CTVec conv_2d_2stage_online(const CTMat& ct_mat, const EncMat& enc_mat,
                 ui32 rot = (rot_base & (params.phim >> 1)) + rot_r;
 
                 // std::cout << curr_loop << " " << rot << std::endl;
-                auto rot_vec = EvalAutomorphism(rot, ct_mid[base_idx+curr_loop], params);
+                auto rot_vec = EvalAutomorphism(rot, keys, ct_mid[base_idx+curr_loop], params);
 
-                ct_vec[curr_out_ct] = EvalAdd(ct_vec[curr_out_ct], rot_vec, params);
+                EvalAddInPlace(ct_vec[curr_out_ct], rot_vec, params);
             }
         }
 
@@ -586,7 +582,62 @@ CTVec conv_2d_2stage_online(const CTMat& ct_mat, const EncMat& enc_mat,
     }
 }
 
-ConvLayer postprocess_conv(const SecretKey& sk, const CTVec& ct_vec,
+NoiseEstimate conv_2d_noise(const Filter2DShape& filter_shape, const ConvShape& in_shape,
+        const ui32 window_size, const ui32 num_windows, const FVParams& params){
+    ui32 chn_pow2 = nxt_pow2(in_shape.h*in_shape.w);
+    ui32 row_pow2 = nxt_pow2(in_shape.w);
+
+    if (row_pow2*2 > params.phim || chn_pow2*2 > params.phim){
+        throw std::logic_error("Rows larger than half a ciphertext not supported");
+    }
+
+    // Every output accumulates each rotation of every input window, the
+    // windows and input ciphertexts are rotated under the same keys
+    ui32 chn_per_ct = params.phim/chn_pow2;
+    ui32 in_ct = div_ceil(filter_shape.in_chn, chn_per_ct);
+    ui32 rotations = chn_per_ct*filter_shape.f_h*filter_shape.f_w;
+
+    auto rot_vec = EstimateKeySwitch(EstimateEncrypt(params), params);
+    auto prod = EstimateMultPlain(rot_vec, (ui64)1 << window_size, params);
+    return EstimateSum(EstimateSum(prod, num_windows*in_ct, true), rotations);
+}
+
+NoiseEstimate conv_2d_2stage_noise(const Filter2DShape& filter_shape, const ConvShape& in_shape,
+        const ui32 window_size, const ui32 num_windows, const FVParams& params){
+    ui32 chn_pow2 = nxt_pow2(in_shape.h*in_shape.w);
+    ui32 row_pow2 = nxt_pow2(in_shape.w);
+
+    if (row_pow2*2 > params.phim){
+        throw std::logic_error("Rows larger than half a ciphertext not supported");
+    }
+
+    // The intermediate sums, of which each output adds up inner_loop with
+    // all but the first rotated. The products of each filter column share
+    // the rotation keys.
+    ui32 same_key, rotations, inner_loop;
+    if(chn_pow2*2 > params.phim) {
+        same_key = num_windows*div_ceil(filter_shape.in_chn, 2)*filter_shape.f_h;
+        rotations = filter_shape.f_w;
+        inner_loop = 2;
+    } else {
+        ui32 chn_per_ct = params.phim/chn_pow2;
+        same_key = num_windows*div_ceil(filter_shape.in_chn, chn_per_ct);
+        rotations = filter_shape.f_h*filter_shape.f_w;
+        inner_loop = chn_per_ct;
+    }
+
+    auto rot_vec = EstimateKeySwitch(EstimateEncrypt(params), params);
+    auto prod = EstimateMultPlain(rot_vec, (ui64)1 << window_size, params);
+    auto mid = EstimateSum(EstimateSum(prod, same_key, true), rotations);
+    auto ret = mid;
+    for(ui32 curr_loop=1; curr_loop<inner_loop; curr_loop++){
+        ret = EstimateAdd(ret, EstimateKeySwitch(mid, params));
+    }
+    return ret;
+}
+
+template <class CT>
+static ConvLayer postprocess_conv_impl(const SecretKey& sk, const std::vector<CT>& ct_vec,
          const ConvShape& shape, const FVParams& params){
     ui32 chn_pow2 = nxt_pow2(shape.h*shape.w);
     ui32 row_pow2 = nxt_pow2(shape.w);
@@ -602,7 +653,7 @@ ConvLayer postprocess_conv(const SecretKey& sk, const CTVec& ct_vec,
         for(ui32 out_set=0; out_set<div_ceil(shape.chn, 2); out_set++){
             for(ui32 out_row_idx = 0; out_row_idx < 2*num_ct_chn; out_row_idx++){
                 ui32 curr_out_ct = out_row_idx + out_set*2*num_ct_chn;
-                auto pt = packed_decode(Decrypt(sk, ct_vec[curr_out_ct], params), params.p, params.logn);
+                auto pt = packed_decode(Decrypt(sk, ct_vec[curr_out_ct], params), params);
 
                 // std::cout << vec_to_str(pt) << std::endl;
                 ui32 src = 0;
@@ -631,7 +682,7 @@ ConvLayer postprocess_conv(const SecretKey& sk, const CTVec& ct_vec,
         ui32 curr_chn = 0;
         ConvLayer ofmap(shape.chn, shape.h, shape.w);
         for(ui32 curr_out_ct = 0; curr_out_ct < ct_vec.size(); curr_out_ct++){
-            auto pt = packed_decode(Decrypt(sk, ct_vec[curr_out_ct], params), params.p, params.logn);
+            auto pt = packed_decode(Decrypt(sk, ct_vec[curr_out_ct], params), params);
             // std::cout << vec_to_str(pt) << std::endl;
             for(ui32 src_base=0; src_base<params.phim; src_base+=chn_pow2){
                 ui32 src = src_base;
@@ -653,6 +704,16 @@ ConvLayer postprocess_conv(const SecretKey& sk, const CTVec& ct_vec,
     }
 }
 
+ConvLayer postprocess_conv(const SecretKey& sk, const CTVec& ct_vec,
+         const ConvShape& shape, const FVParams& params){
+    return postprocess_conv_impl(sk, ct_vec, shape, params);
+}
+
+ConvLayer postprocess_conv(const SecretKey& sk, const CompressedCTVec& ct_vec,
+         const ConvShape& shape, const FVParams& params){
+    return postprocess_conv_impl(sk, ct_vec, shape, params);
+}
+
 ConvLayer conv_2d_pt(const ConvLayer& in, const Filter2D& filter, bool same, const ui32 p){
     ui32 out_h = in.shape.h - ((same) ? 0 : (filter.shape.f_h - 1));
     ui32 out_w = in.shape.w - ((same) ? 0 : (filter.shape.f_w - 1));
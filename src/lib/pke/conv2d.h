@@ -17,22 +17,41 @@ namespace lbcrypto {
     CTMat preprocess_ifmap(const SecretKey& sk, const ConvLayer& pt,
             const ui32 window_size, const ui32 num_windows, const FVParams& params);
 
+    // Same with seeded ciphertexts, for upload to the server
+    SeededCTMat preprocess_ifmap_seeded(const SecretKey& sk, const ConvLayer& pt,
+            const ui32 window_size, const ui32 num_windows, const FVParams& params);
+
     EncMat preprocess_filter(const Filter2D& filter, const ConvShape& shape,
              const ui32 window_size, const ui32 num_windows, const FVParams& params);
 
-    CTVec conv_2d_online(const CTMat& ct_mat, const EncMat& enc_mat,
-            const Filter2DShape& filter_shape, const ConvShape& in_shape, const FVParams& params);
+    // The hoisted digits of the rotations are carved from arena when given,
+    // as in mat_mul_online
+    CTVec conv_2d_online(const CTMat& ct_mat, const EncMatView& enc_mat,
+            const Filter2DShape& filter_shape, const ConvShape& in_shape,
+            const AutomorphismKeys& keys, const FVParams& params, Arena* arena = nullptr);
 
     EncMat preprocess_filter_2stage(const Filter2D& filter, const ConvShape& shape,
              const ui32 window_size, const ui32 num_windows, const FVParams& params);
 
-    CTVec conv_2d_2stage_online(const CTMat& ct_mat, const EncMat& enc_mat,
-            const Filter2DShape& filter_shape, const ConvShape& in_shape, const FVParams& params);
+    CTVec conv_2d_2stage_online(const CTMat& ct_mat, const EncMatView& enc_mat,
+            const Filter2DShape& filter_shape, const ConvShape& in_shape,
+            const AutomorphismKeys& keys, const FVParams& params, Arena* arena = nullptr);
+
+    // Estimated noise of the outputs of conv_2d_online and
+    // conv_2d_2stage_online, for PlanWindows
+    NoiseEstimate conv_2d_noise(const Filter2DShape& filter_shape, const ConvShape& in_shape,
+            const ui32 window_size, const ui32 num_windows, const FVParams& params);
+
+    NoiseEstimate conv_2d_2stage_noise(const Filter2DShape& filter_shape, const ConvShape& in_shape,
+            const ui32 window_size, const ui32 num_windows, const FVParams& params);
 
 
     ConvLayer postprocess_conv(const SecretKey& sk, const CTVec& ct_vec,
              const ConvShape& shape, const FVParams& params);
 
+    ConvLayer postprocess_conv(const SecretKey& sk, const CompressedCTVec& ct_vec,
+             const ConvShape& shape, const FVParams& params);
+
     ConvLayer conv_2d_pt(const ConvLayer& in, const Filter2D& filter, bool same, const ui32 p);
 
     bool check_conv(const ConvLayer& ofmap, const ConvLayer& ofmap_ref);
@@ -0,0 +1,156 @@
+/*
+ * encmat_cache.cpp
+ *
+ *	On-disk cache of preprocessed weights, see encmat_cache.h.
+ *
+ */
+
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "pke/encmat_cache.h"
+
+namespace lbcrypto {
+
+// "GZENCMAT" read as a little endian word
+static const ui64 ENCMAT_MAGIC = 0x54414d434e455a47ULL;
+static const size_t ENCMAT_HEADER_BYTES = 4096;
+
+enum EncMatHeader {
+    HDR_MAGIC, HDR_VERSION, HDR_Q, HDR_P, HDR_LOGN, HDR_FAST_MODULLI, HDR_KEY, HDR_WINDOW,
+    HDR_ROWS, HDR_COLS, HDR_WORDS
+};
+
+static size_t data_bytes(const ui64 rows, const ui64 cols, const FVParams& params){
+    return rows*cols*params.phim*sizeof(ui64);
+}
+
+// Reads and checks the header of the open file fd, false if it is not a
+// cache for id and params
+static bool read_header(const int fd, const EncMatCacheId& id, const FVParams& params){
+    ui64 header[HDR_WORDS];
+    struct stat st;
+    if ((pread(fd, header, sizeof(header), 0) != sizeof(header)) || (fstat(fd, &st) != 0)) {
+        return false;
+    }
+    if ((header[HDR_MAGIC] != ENCMAT_MAGIC) || (header[HDR_VERSION] != ENCMAT_CACHE_VERSION) ||
+            (header[HDR_Q] != params.q) || (header[HDR_P] != params.p) ||
+            (header[HDR_LOGN] != params.logn) ||
+            (header[HDR_FAST_MODULLI] != (ui64)params.fast_modulli) ||
+            (header[HDR_KEY] != id.key) || (header[HDR_WINDOW] != id.pt_window_size) ||
+            (header[HDR_ROWS] != id.rows) || (header[HDR_COLS] != id.cols)) {
+        return false;
+    }
+    return (size_t)st.st_size == ENCMAT_HEADER_BYTES + data_bytes(id.rows, id.cols, params);
+}
+
+void SaveEncMat(const std::string& path, const EncMat& enc_mat, const EncMatCacheId& id,
+        const FVParams& params){
+    if (enc_mat.size() != id.rows) {
+        throw std::logic_error("EncMat rows do not match the cache id");
+    }
+
+    uv64 header(ENCMAT_HEADER_BYTES/sizeof(ui64));
+    header[HDR_MAGIC] = ENCMAT_MAGIC;
+    header[HDR_VERSION] = ENCMAT_CACHE_VERSION;
+    header[HDR_Q] = params.q;
+    header[HDR_P] = params.p;
+    header[HDR_LOGN] = params.logn;
+    header[HDR_FAST_MODULLI] = params.fast_modulli;
+    header[HDR_KEY] = id.key;
+    header[HDR_WINDOW] = id.pt_window_size;
+    header[HDR_ROWS] = id.rows;
+    header[HDR_COLS] = id.cols;
+
+    std::string tmp_path = path + ".tmp." + std::to_string(getpid());
+    std::ofstream f(tmp_path, std::ios::binary | std::ios::trunc);
+    f.write((const char*)header.data(), ENCMAT_HEADER_BYTES);
+    for (const auto& row: enc_mat) {
+        if (row.size() != id.cols) {
+            std::remove(tmp_path.c_str());
+            throw std::logic_error("EncMat columns do not match the cache id");
+        }
+        for (const auto& pt: row) {
+            if (pt.size() != params.phim) {
+                std::remove(tmp_path.c_str());
+                throw std::logic_error("EncMat plaintext size does not match the parameters");
+            }
+            f.write((const char*)pt.data(), params.phim*sizeof(ui64));
+        }
+    }
+    f.close();
+    if (!f || (std::rename(tmp_path.c_str(), path.c_str()) != 0)) {
+        std::remove(tmp_path.c_str());
+        throw std::logic_error("Could not write " + path);
+    }
+}
+
+bool IsEncMatCache(const std::string& path, const EncMatCacheId& id, const FVParams& params){
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    bool valid = read_header(fd, id, params);
+    close(fd);
+    return valid;
+}
+
+MappedEncMat::MappedEncMat(const std::string& path, const EncMatCacheId& id,
+        const FVParams& params) :
+        m_map(nullptr), m_map_bytes(0), m_data(nullptr), m_rows(id.rows), m_cols(id.cols),
+        m_phim(params.phim) {
+    // The header is checked on the descriptor that is mapped, a cache
+    // renamed over path meanwhile cannot slip in
+    int fd = open(path.c_str(), O_RDONLY);
+    if ((fd < 0) || !read_header(fd, id, params)) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        throw std::logic_error(path + " is not an EncMat cache for these parameters");
+    }
+
+    m_map_bytes = ENCMAT_HEADER_BYTES + data_bytes(m_rows, m_cols, params);
+    m_map = mmap(nullptr, m_map_bytes, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (m_map == MAP_FAILED) {
+        throw std::logic_error("Could not map " + path);
+    }
+    // Starts reading the pages in ahead of the first request
+    madvise(m_map, m_map_bytes, MADV_WILLNEED);
+    m_data = (const ui64*)((const char*)m_map + ENCMAT_HEADER_BYTES);
+}
+
+MappedEncMat::~MappedEncMat() {
+    munmap(m_map, m_map_bytes);
+}
+
+EncMatView MappedEncMat::view() const {
+    return EncMatView(m_data, m_rows, m_cols, m_phim);
+}
+
+EncMat MappedEncMat::load() const {
+    EncMat enc_mat(m_rows, std::vector<uv64>(m_cols, uv64(m_phim)));
+    for (ui32 row = 0; row < m_rows; row++) {
+        for (ui32 w = 0; w < m_cols; w++) {
+            const ui64* pt = m_data + ((size_t)row*m_cols + w)*m_phim;
+            std::copy(pt, pt + m_phim, enc_mat[row][w].begin());
+        }
+    }
+    return enc_mat;
+}
+
+shared_ptr<const MappedEncMat> CachedEncMat(const std::string& path, const EncMatCacheId& id,
+        const FVParams& params, const std::function<EncMat()>& preprocess){
+    if (!IsEncMatCache(path, id, params)) {
+        SaveEncMat(path, preprocess(), id, params);
+    }
+    return std::make_shared<const MappedEncMat>(path, id, params);
+}
+
+}  // namespace lbcrypto ends
@@ -0,0 +1,84 @@
+/*
+ * encmat_cache.h
+ *
+ *	On-disk cache of preprocessed weights. The EncMat made by the preprocess
+ *	functions only depends on the weights, the plaintext windows and the
+ *	parameters, so a server can write it once and map it at every later
+ *	start instead of encoding and transforming the weights again. The file
+ *	is mapped read-only and shared, so worker processes serving the same
+ *	model share one copy of it in the page cache.
+ *
+ *	Format, version 2, in native byte order: a header page of 64-bit words
+ *	holding the magic, the version, q, p, logn, fast_modulli, the key, the
+ *	plaintext window size, the rows and the plaintexts per row, then every
+ *	plaintext of every row in order as phim 64-bit values in the evaluation
+ *	domain. The data starts at a page boundary so each plaintext is aligned
+ *	like a uv64.
+ *
+ */
+
+#ifndef LBCRYPTO_CRYPTO_ENCMAT_CACHE_H
+#define LBCRYPTO_CRYPTO_ENCMAT_CACHE_H
+
+#include <functional>
+#include <string>
+
+#include "utils/backend.h"
+#include "pke/fv.h"
+#include "pke/layers.h"
+
+namespace lbcrypto {
+
+    const ui64 ENCMAT_CACHE_VERSION = 2;
+
+    // What a cache has to match to be mapped. key identifies the weights,
+    // such as a model version or a hash of the weights. The plaintext window
+    // and the shape are those the preprocess function was called with and
+    // gives.
+    struct EncMatCacheId {
+        ui64 key;
+        ui32 pt_window_size;
+        ui32 rows, cols;
+    };
+
+    // Writes enc_mat to path, throws if it does not have the shape of id.
+    // The file is written under a temporary name and renamed, so readers
+    // never see a partial file.
+    void SaveEncMat(const std::string& path, const EncMat& enc_mat, const EncMatCacheId& id,
+            const FVParams& params);
+
+    // Whether path holds a cache of this version for id and params
+    bool IsEncMatCache(const std::string& path, const EncMatCacheId& id, const FVParams& params);
+
+    class MappedEncMat {
+    public:
+        // Throws unless IsEncMatCache(path, id, params)
+        MappedEncMat(const std::string& path, const EncMatCacheId& id, const FVParams& params);
+        ~MappedEncMat();
+
+        MappedEncMat(const MappedEncMat&) = delete;
+        MappedEncMat& operator=(const MappedEncMat&) = delete;
+
+        // For the online functions, valid while the mapping is
+        EncMatView view() const;
+
+        // A copy in memory
+        EncMat load() const;
+
+        ui32 rows() const { return m_rows; }
+        ui32 cols() const { return m_cols; }
+
+    private:
+        void* m_map;
+        size_t m_map_bytes;
+        const ui64* m_data;
+        ui32 m_rows, m_cols, m_phim;
+    };
+
+    // The cache at path, made with preprocess and saved first if path does
+    // not hold one for id and params
+    shared_ptr<const MappedEncMat> CachedEncMat(const std::string& path, const EncMatCacheId& id,
+            const FVParams& params, const std::function<EncMat()>& preprocess);
+
+} // namespace lbcrypto ends
+#endif
@@ -14,72 +14,82 @@ Copyright (c) 2017, Massachusetts Institute of Technology (MIT)
 #define LBCRYPTO_CRYPTO_FV_C
 
 #include <map>
+#include <mutex>
 #include <iostream>
 #include <fstream>
 
 #include "math/params.h"
 #include "math/transfrm.h"
+#include "math/bit_twiddle.h"
+#include "pke/encoding.h"
 
 namespace lbcrypto {
-    std::map<ui64, uv32> g_to_ftt_map;
-    std::map<ui64, uv32> g_from_ftt_map;
+    std::map<ui64, std::shared_ptr<const EncodingContext>> g_encoding_context_map;
+    std::mutex g_encoding_context_mutex;
 
-    void encoding_precompute(const ui64& mod_p, const ui32& logn){
+    EncodingContext::EncodingContext(const ui64 mod_p, const ui32 logn) :
+            mod_p(mod_p), logn(logn), to_ftt_perm(1 << logn), from_ftt_perm(1 << logn) {
         ui32 phim = (1 << logn);
         ui32 phim_by_2 = phim/2;
         ui32 mask = phim*2-1;
 
         // Create the permutations that interchange the automorphism and crt ordering
         // First we create the cyclic group generated by 5 and then adjoin the co-factor by multiplying by 3
-        uv32 to_ftt_perm(phim);
-        uv32 from_ftt_perm(phim);
-
+        // The crt slots are kept in the bit reversed order the transforms use
         ui32 curr_index = 1;
         for (ui32 i = 0; i < phim_by_2; i++) {
-            to_ftt_perm[(curr_index - 1) / 2] = i;
-            from_ftt_perm[i] = (curr_index - 1) / 2;
+            ui32 crt_index = ReverseBits((curr_index - 1) / 2, logn);
+            to_ftt_perm[crt_index] = i;
+            from_ftt_perm[i] = crt_index;
 
             ui32 cofactor_index = (curr_index * mask) & mask;
-            to_ftt_perm[(cofactor_index - 1) / 2] = i + phim_by_2;
-            from_ftt_perm[i + phim_by_2] = (cofactor_index - 1) / 2;
+            ui32 crt_cofactor_index = ReverseBits((cofactor_index - 1) / 2, logn);
+            to_ftt_perm[crt_cofactor_index] = i + phim_by_2;
+            from_ftt_perm[i + phim_by_2] = crt_cofactor_index;
 
             curr_index = (curr_index * 5) & mask;
         }
-        g_to_ftt_map[mod_p] = std::move(to_ftt_perm);
-        g_from_ftt_map[mod_p] = std::move(from_ftt_perm);
+    }
+
+    void encoding_precompute(const ui64& mod_p, const ui32& logn){
+        auto ctx = std::make_shared<const EncodingContext>(mod_p, logn);
+        std::lock_guard<std::mutex> lock(g_encoding_context_mutex);
+        g_encoding_context_map[mod_p] = ctx;
 
         return;
     }
 
-    uv64 packed_encode(const uv64& input, const ui64 mod_p, const ui32 logn){
-        ui32 phim = (1<<logn);
+    std::shared_ptr<const EncodingContext> get_encoding_context(const ui64 mod_p){
+        std::lock_guard<std::mutex> lock(g_encoding_context_mutex);
+        auto mSearch = g_encoding_context_map.find(mod_p);
+        if(mSearch == g_encoding_context_map.end()) {
+            throw std::logic_error("Encoding permutations must be precomputed");
+        }
+        return mSearch->second;
+    }
+
+    uv64 packed_encode(const uv64& input, const EncodingContext& enc, const NttContext& ntt){
+        ui32 phim = (1 << enc.logn);
         uv64 input_perm(phim);
-        const auto& to_ftt_perm = g_to_ftt_map[mod_p];
+        const auto& to_ftt_perm = enc.to_ftt_perm;
 
         // Permute to CRT Order
         for (ui32 i = 0; i < phim; i++) {
             input_perm[i] = input[to_ftt_perm[i]];
         }
-        if(mod_p == opt::p){
-            input_perm = ftt_inv_opt_p(input_perm);
-        } else {
-            input_perm = ftt_inv(input_perm, mod_p, logn);
-        }
+        ftt_inv(ntt, input_perm.data(), input_perm.data());
 
         return input_perm;
     }
 
-    uv64 packed_decode(const uv64& input, const ui64 mod_p, const ui32 logn){
+    uv64 packed_decode(const uv64& input, const EncodingContext& enc, const NttContext& ntt){
         // Transform Coeff to Eval
-        ui32 phim = (1<<logn);
+        ui32 phim = (1 << enc.logn);
         uv64 output_perm(phim), output_tr(phim);
-        const auto& from_ftt_perm = g_from_ftt_map[mod_p];
+        const auto& from_ftt_perm = enc.from_ftt_perm;
+
+        ftt_fwd(ntt, input.data(), output_tr.data());
 
-        if(mod_p == opt::p){
-            output_tr = ftt_fwd_opt_p(input);
-        } else {
-            output_tr = ftt_fwd(input, mod_p, logn);
-        }
         // Permute to automorphism Order
         for (ui32 i = 0; i < phim; i++) {
             output_perm[i] = output_tr[from_ftt_perm[i]];
@@ -88,6 +98,28 @@ namespace lbcrypto {
         return output_perm;
     }
 
+    uv64 packed_encode(const uv64& input, const ui64 mod_p, const ui32 logn){
+        return packed_encode(input, *get_encoding_context(mod_p), *get_ntt_context(mod_p));
+    }
+
+    uv64 packed_decode(const uv64& input, const ui64 mod_p, const ui32 logn){
+        return packed_decode(input, *get_encoding_context(mod_p), *get_ntt_context(mod_p));
+    }
+
+    uv64 packed_encode(const uv64& input, const FVParams& params){
+        if(params.ctx){
+            return packed_encode(input, *params.ctx->encoding, *params.ctx->ntt_p);
+        }
+        return packed_encode(input, params.p, params.logn);
+    }
+
+    uv64 packed_decode(const uv64& input, const FVParams& params){
+        if(params.ctx){
+            return packed_decode(input, *params.ctx->encoding, *params.ctx->ntt_p);
+        }
+        return packed_decode(input, params.p, params.logn);
+    }
+
 }  // namespace lbcrypto ends
 
 #endif
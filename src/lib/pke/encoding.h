@@ -14,14 +14,42 @@ Copyright (c) 2017, Massachusetts Institute of Technology (MIT)
 #define LBCRYPTO_CRYPTO_ENCODING_H
 
 #include "pke/pke_types.h"
+#include "pke/fv.h"
 
 namespace lbcrypto {
 
+    /**
+    * @brief Permutations between the slot order and the crt order for the
+    * packed encoding mod p. Immutable once built.
+    */
+    struct EncodingContext {
+        EncodingContext(const ui64 mod_p, const ui32 logn);
+
+        const ui64 mod_p;
+        const ui32 logn;
+
+        uv32 to_ftt_perm;
+        uv32 from_ftt_perm;
+    };
+
     void encoding_precompute(const ui64& mod_p, const ui32& logn);
 
+    // Registered context for mod_p. Registering it again does not affect
+    // the holders of the old one.
+    std::shared_ptr<const EncodingContext> get_encoding_context(const ui64 mod_p);
+
+    uv64 packed_encode(const uv64& input, const EncodingContext& enc, const NttContext& ntt);
+
+    uv64 packed_decode(const uv64& input, const EncodingContext& enc, const NttContext& ntt);
+
     uv64 packed_encode(const uv64& input, const ui64 mod_p, const ui32 logn);
 
     uv64 packed_decode(const uv64& input, const ui64 mod_p, const ui32 logn);
 
+    // Use the tables of params.ctx when it is set and the registered ones otherwise
+    uv64 packed_encode(const uv64& input, const FVParams& params);
+
+    uv64 packed_decode(const uv64& input, const FVParams& params);
+
 } // namespace lbcrypto ends
 #endif
@@ -7,9 +7,12 @@
  *
  */
 
+#include <atomic>
+#include <cmath>
 #include <iostream>
 #include <map>
 #include <memory>
+#include <mutex>
 using std::shared_ptr;
 
 #ifndef LBCRYPTO_CRYPTO_FV_C
@@ -20,41 +23,105 @@ using std::shared_ptr;
 #include "math/automorph.h"
 #include "pke/encoding.h"
 #include "pke/fv.h"
+#include "utils/thread_pool.h"
 
 #include <iostream>
 
 namespace lbcrypto {
 
-std::map<ui32, shared_ptr<RelinKey>> g_rk_map;
+FVContext::FVContext(const ui64 q, const ui64 z, const ui64 p, const ui64 z_p, const ui32 logn) :
+        ntt_q(std::make_shared<const NttContext>(z, q, logn)),
+        ntt_p(std::make_shared<const NttContext>(z_p, p, logn)),
+        automorph(std::make_shared<const AutomorphContext>(1 << logn)),
+        encoding(std::make_shared<const EncodingContext>(p, logn)) {
+}
+
+FVContext::FVContext(const ParamSet& set) :
+        FVContext(set.q, set.z, set.p, set.z_p, set.logn) {
+}
+
+FVParams MakeFVParams(const ParamSet& set, const MODE mode,
+        shared_ptr<DiscreteGaussianGenerator> dgg, const ui32 window_size){
+    return FVParams {
+        true,
+        set.q, set.p, set.logn, ((ui32)1 << set.logn),
+        (set.q/set.p),
+        mode, dgg,
+        window_size,
+        std::make_shared<const FVContext>(set)
+    };
+}
+
+static void to_eval_batch(std::vector<ui64*>& polys, const FVParams& params){
+    ftt_fwd_batch(*GetNttContext(params), polys.data(), polys.size(), &get_thread_pool());
+}
+
+void ToEvalBatch(std::vector<uv64>& polys, const FVParams& params){
+    std::vector<ui64*> ptrs;
+    for(auto& poly: polys){
+        ptrs.push_back(poly.data());
+    }
+    to_eval_batch(ptrs, params);
+}
+
+void ToCoeffBatch(std::vector<uv64>& polys, const FVParams& params){
+    std::vector<ui64*> ptrs;
+    for(auto& poly: polys){
+        ptrs.push_back(poly.data());
+    }
+    ftt_inv_batch(*GetNttContext(params), ptrs.data(), ptrs.size(), &get_thread_pool());
+}
+
+void ToEvalBatch(std::vector<std::vector<uv64>>& mat, const FVParams& params){
+    std::vector<ui64*> ptrs;
+    for(auto& row: mat){
+        for(auto& poly: row){
+            ptrs.push_back(poly.data());
+        }
+    }
+    to_eval_batch(ptrs, params);
+}
 
 uv64 NullEncrypt(uv64& pt, const FVParams& params){
     return ToEval(pt, params);
 }
 
 Ciphertext Encrypt(const PublicKey& pk, uv64& pt, const FVParams& params){
+    return Encrypt(pk, pt, params, get_prng().stream());
+}
+
+Ciphertext Encrypt(const PublicKey& pk, uv64& pt, const FVParams& params,
+        osuCrypto::PRNG& prng){
     uv64 u(params.phim);
     //Supports both discrete Gaussian (RLWE) and ternary uniform distribution (OPTIMIZED) cases
     if (params.mode == RLWE) {
-        u = params.dgg->GenerateVector(params.phim, params.q);
+        params.dgg->FillVector(u.data(), params.phim, params.q, prng);
     } else {
-        u = get_tug_vector(params.phim, params.q);
+        get_tug_vector(u.data(), params.phim, params.q, prng);
     }
-    u = ToEval(u, params);
+    ToEval(u, u, params);
 
-    uv64 ea = ToEval(params.dgg->GenerateVector(params.phim, params.q), params);
-    uv64 eb = params.dgg->GenerateVector(params.phim, params.q);
+    uv64 ea(params.phim), eb(params.phim);
+    params.dgg->FillVector(ea.data(), params.phim, params.q, prng);
+    params.dgg->FillVector(eb.data(), params.phim, params.q, prng);
+    ToEval(ea, ea, params);
 
     Ciphertext ct(params.phim);
     for(ui32 i=0; i<params.phim; i++){
         ct.b[i] = pt[i]*params.delta + eb[i];
     }
-    ct.b = ToEval(ct.b, params);
+    ToEval(ct.b, ct.b, params);
 
-    for(ui32 i=0; i<params.phim; i++){
-        if(params.fast_modulli){
-            ct.a[i] = opt::modq_full(opt::mul_modq_part(pk.a[i], u[i]) + ea[i]);
-            ct.b[i] = opt::modq_full(opt::mul_modq_part(pk.b[i], u[i]) + ct.b[i]);
-        } else {
+    if(params.fast_modulli){
+        opt::with_modulli(params.q, params.p, [&](auto m){
+            using M = decltype(m);
+            for(ui32 i=0; i<params.phim; i++){
+                ct.a[i] = M::modq_full(M::mul_modq_part(pk.a[i], u[i]) + ea[i]);
+                ct.b[i] = M::modq_full(M::mul_modq_part(pk.b[i], u[i]) + ct.b[i]);
+            }
+        });
+    } else {
+        for(ui32 i=0; i<params.phim; i++){
             ct.a[i] = mod(mod_mul(pk.a[i], u[i], params.q) + ea[i], params.q);
             ct.b[i] = mod(mod_mul(pk.b[i], u[i], params.q) + ct.b[i], params.q);
         }
@@ -63,69 +130,154 @@ Ciphertext Encrypt(const PublicKey& pk, uv64& pt, const FVParams& params){
     return ct;
 }
 
-Ciphertext Encrypt(const SecretKey& sk, uv64& pt, const FVParams& params){
-    Ciphertext ct(params.phim);
-    if(params.fast_modulli){
-        ct.a = get_dug_vector_opt(params.phim);
-    } else {
-        ct.a = get_dug_vector(params.phim, params.q);
-    }
-
-    ct.b = params.dgg->GenerateVector(params.phim, params.q);
+// b = delta*pt + e - a*s in the evaluation domain, for a uniform a
+static void encrypt_sk(const SecretKey& sk, uv64& pt, const uv64& a, uv64& b,
+        const FVParams& params, osuCrypto::PRNG& prng){
+    params.dgg->FillVector(b.data(), params.phim, params.q, prng);
     for(ui32 i=0; i<params.phim; i++){
-        ct.b[i] += pt[i]*params.delta;
+        b[i] += pt[i]*params.delta;
     }
-    ct.b = ToEval(ct.b, params);
+    ToEval(b, b, params);
 
 
-    for(ui32 i=0; i<params.phim; i++){
-        if(params.fast_modulli){
-            auto prod = opt::mul_modq_part(ct.a[i], sk.s[i]);
-            ct.b[i] = opt::sub_modq_part(ct.b[i], prod);
-        } else {
-            auto prod = mod_mul(ct.a[i], sk.s[i], params.q);
-            ct.b[i] = mod(ct.b[i] + params.q - prod, params.q);
+    if(params.fast_modulli){
+        opt::with_modulli(params.q, params.p, [&](auto m){
+            using M = decltype(m);
+            for(ui32 i=0; i<params.phim; i++){
+                auto prod = M::mul_modq_part(a[i], sk.s[i]);
+                b[i] = M::sub_modq_part(b[i], prod);
+            }
+        });
+    } else {
+        for(ui32 i=0; i<params.phim; i++){
+            auto prod = mod_mul(a[i], sk.s[i], params.q);
+            b[i] = mod(b[i] + params.q - prod, params.q);
         }
     }
+}
+
+Ciphertext Encrypt(const SecretKey& sk, uv64& pt, const FVParams& params){
+    return Encrypt(sk, pt, params, get_prng().stream());
+}
+
+Ciphertext Encrypt(const SecretKey& sk, uv64& pt, const FVParams& params,
+        osuCrypto::PRNG& prng){
+    Ciphertext ct(params.phim);
+    get_dug_vector(ct.a.data(), params.phim, params.q, prng);
+    encrypt_sk(sk, pt, ct.a, ct.b, params, prng);
 
     return ct;
 }
 
-uv64 Decrypt(const SecretKey& sk, const Ciphertext& ct, const FVParams& params){
-    uv64 pt(params.phim);
-    for(ui32 i=0; i<params.phim; i++){
-        if(params.fast_modulli){
-            pt[i] = opt::mul_modq_part(ct.a[i], sk.s[i]) + ct.b[i];
-        } else {
+SeededCiphertext EncryptSeeded(const SecretKey& sk, uv64& pt, const FVParams& params){
+    return EncryptSeeded(sk, pt, params, get_prng().stream());
+}
+
+SeededCiphertext EncryptSeeded(const SecretKey& sk, uv64& pt, const FVParams& params,
+        osuCrypto::PRNG& prng){
+    SeededCiphertext ct(params.phim);
+    ct.seed = get_seed(prng);
+
+    uv64 a(params.phim);
+    get_dug_vector(a.data(), params.phim, params.q, ct.seed);
+    encrypt_sk(sk, pt, a, ct.b, params, prng);
+
+    return ct;
+}
+
+void EncryptInto(Ciphertext& ct, const SecretKey& sk, uv64& pt, const FVParams& params){
+    ct = Encrypt(sk, pt, params);
+}
+
+void EncryptInto(SeededCiphertext& ct, const SecretKey& sk, uv64& pt, const FVParams& params){
+    ct = EncryptSeeded(sk, pt, params);
+}
+
+Ciphertext Expand(const SeededCiphertext& ct, const FVParams& params){
+    Ciphertext ct_full(params.phim);
+    get_dug_vector(ct_full.a.data(), params.phim, params.q, ct.seed);
+    ct_full.b = ct.b;
+
+    return ct_full;
+}
+
+// a*s + b, in the evaluation domain
+static void decrypt_eval(const SecretKey& sk, const Ciphertext& ct, uv64& pt,
+        const FVParams& params){
+    if(params.fast_modulli){
+        opt::with_modulli(params.q, params.p, [&](auto m){
+            using M = decltype(m);
+            for(ui32 i=0; i<params.phim; i++){
+                pt[i] = M::mul_modq_part(ct.a[i], sk.s[i]) + ct.b[i];
+            }
+        });
+    } else {
+        for(ui32 i=0; i<params.phim; i++){
             pt[i] = mod_mul(ct.a[i], sk.s[i], params.q) + ct.b[i];
         }
     }
-    pt = ToCoeff(pt, params);
+}
+
+// Rounds the coefficients of a*s + b to the plaintext
+static void decrypt_round(uv64& pt, const FVParams& params){
+    if(params.fast_modulli){
+        opt::with_modulli(params.q, params.p, [&](auto m){
+            using M = decltype(m);
+            for(ui32 i=0; i<params.phim; i++){
+                pt[i] = M::modq_full(pt[i]);
+            }
+        });
+    }
 
     auto delta_by_2 = params.delta/2;
     for(ui32 i=0; i<params.phim; i++){
-        if(params.fast_modulli) {
-            pt[i] = opt::modq_full(pt[i]);
-        }
         pt[i] = (pt[i] + delta_by_2)/params.delta;
+        // Values just below q round up to p
+        pt[i] = (pt[i] >= params.p)? pt[i] - params.p: pt[i];
     }
+}
+
+uv64 Decrypt(const SecretKey& sk, const Ciphertext& ct, const FVParams& params){
+    uv64 pt(params.phim);
+    decrypt_eval(sk, ct, pt, params);
+    ToCoeff(pt, pt, params);
+    decrypt_round(pt, params);
 
     return pt;
 };
 
+std::vector<uv64> Decrypt(const SecretKey& sk, const std::vector<Ciphertext>& ct_vec,
+        const FVParams& params){
+    std::vector<uv64> pt_vec(ct_vec.size(), uv64(params.phim));
+    for(ui32 n=0; n<ct_vec.size(); n++){
+        decrypt_eval(sk, ct_vec[n], pt_vec[n], params);
+    }
+    ToCoeffBatch(pt_vec, params);
+    for(ui32 n=0; n<ct_vec.size(); n++){
+        decrypt_round(pt_vec[n], params);
+    }
+
+    return pt_vec;
+}
+
 sv64 Noise(const SecretKey& sk, const Ciphertext& ct, const FVParams& params){
     uv64 e(params.phim);
     for(ui32 i=0; i<params.phim; i++){
         e[i] = mod_mul(ct.a[i], sk.s[i], params.q) + ct.b[i];
     }
-    e = ToCoeff(e, params);
+    ToCoeff(e, e, params);
+    if(params.fast_modulli) {
+        opt::with_modulli(params.q, params.p, [&](auto m){
+            using M = decltype(m);
+            for(ui32 i=0; i<params.phim; i++){
+                e[i] = M::modq_full(e[i]);
+            }
+        });
+    }
 
     sv64 es(params.phim);
     auto delta_by_2 = params.delta/2;
     for(ui32 i=0; i<params.phim; i++){
-        if(params.fast_modulli) {
-            e[i] = opt::modq_full(e[i]);
-        }
         e[i] = (e[i] % params.delta);
         es[i] = (e[i] > delta_by_2) ? (e[i] - params.delta) : e[i];
     }
@@ -145,29 +297,189 @@ double NoiseMargin(const SecretKey& sk, const Ciphertext& ct, const FVParams& pa
     return (std::log2(params.delta)-std::log2(noise_max));
 }
 
-KeyPair KeyGen(const FVParams& params){
-    SecretKey sk(params.phim);
+ui32 ModSwitchBits(const FVParams& params){
+    // The rounding adds r_b + <r_a, s> to the noise with the r uniform in
+    // [-1/2, 1/2]. Six deviations of that, one bit for rounding to the
+    // nearest multiple of 2^bits/p and one for the noise ct already had.
+    double var_s = (params.mode == RLWE)? std::pow(params.dgg->GetStd(), 2): 2.0/3;
+    double bound = 6*std::sqrt(params.phim*var_s/12) + 1;
+    return opt::bit_length(params.p) + 2 + (ui32)std::ceil(std::log2(bound));
+}
 
-    if (params.mode == RLWE) {
-        sk.s = params.dgg->GenerateVector(params.phim, params.q);
-    } else {
-        sk.s = get_tug_vector(params.phim, params.q);
+// Decrypt computes <a, s> exactly mod q, which needs n*2^bits*|s| far below q
+static void check_switch_bits(const ui32 bits, const FVParams& params){
+    if (bits == 0 || bits + params.logn + 8 >= opt::bit_length(params.q)) {
+        throw std::logic_error("Modulus switching bits out of range");
     }
-    sk.s = ToEval(sk.s, params);
+}
 
-    PublicKey pk(params.phim);
+// round(x*2^bits/q) mod 2^bits of every coefficient. The quotient is
+// estimated from floor(2^(64+bits)/q), which is at most one short.
+static void mod_switch_poly(uv64& poly, const ui32 bits, const FVParams& params){
+    if(params.fast_modulli) {
+        opt::with_modulli(params.q, params.p, [&](auto m){
+            using M = decltype(m);
+            for(ui32 i=0; i<params.phim; i++){
+                poly[i] = M::modq_full(poly[i]);
+            }
+        });
+    }
+
+    const ui64 ratio = (ui64)(((ui128)1 << (64 + bits))/params.q);
+    const ui64 mask = ((ui64)1 << bits) - 1;
+    for(ui32 i=0; i<params.phim; i++){
+        ui64 quot = (ui64)(((ui128)poly[i]*ratio) >> 64);
+        // Below 2q, so the wrapped difference is exact
+        ui64 rem = (poly[i] << bits) - quot*params.q;
+        if (rem >= params.q) {
+            quot++;
+            rem -= params.q;
+        }
+        quot += (rem >= params.q - rem);
+        poly[i] = quot & mask;
+    }
+}
+
+CompressedCiphertext ModSwitch(const Ciphertext& ct, const ui32 bits, const FVParams& params){
+    check_switch_bits(bits, params);
+    CompressedCiphertext ct_sw(params.phim, bits);
+    ToCoeff(ct.a, ct_sw.a, params);
+    ToCoeff(ct.b, ct_sw.b, params);
+    mod_switch_poly(ct_sw.a, bits, params);
+    mod_switch_poly(ct_sw.b, bits, params);
+
+    return ct_sw;
+}
+
+std::vector<CompressedCiphertext> ModSwitch(const std::vector<Ciphertext>& ct_vec,
+        const ui32 bits, const FVParams& params){
+    check_switch_bits(bits, params);
+    std::vector<uv64> polys;
+    polys.reserve(2*ct_vec.size());
+    for(auto& ct: ct_vec){
+        polys.push_back(ct.a);
+        polys.push_back(ct.b);
+    }
+    ToCoeffBatch(polys, params);
+
+    std::vector<CompressedCiphertext> ct_sw(ct_vec.size(), CompressedCiphertext(0, bits));
+    for(ui32 n=0; n<ct_vec.size(); n++){
+        mod_switch_poly(polys[2*n], bits, params);
+        mod_switch_poly(polys[2*n+1], bits, params);
+        ct_sw[n].a = std::move(polys[2*n]);
+        ct_sw[n].b = std::move(polys[2*n+1]);
+    }
+
+    return ct_sw;
+}
+
+// a*s in the evaluation domain, partially reduced
+static void mul_sk(const SecretKey& sk, uv64& a, const FVParams& params){
     if(params.fast_modulli){
-        pk.a = get_dug_vector_opt(params.phim);
+        opt::with_modulli(params.q, params.p, [&](auto m){
+            using M = decltype(m);
+            for(ui32 i=0; i<params.phim; i++){
+                a[i] = M::mul_modq_part(a[i], sk.s[i]);
+            }
+        });
     } else {
-        pk.a = get_dug_vector(params.phim, params.q);
+        for(ui32 i=0; i<params.phim; i++){
+            a[i] = mod_mul(a[i], sk.s[i], params.q);
+        }
+    }
+}
+
+// as holds <a, s> mod q in the coefficient domain, which is the exact
+// product centered around 0. It is added to b mod 2^bits and rounded.
+static void decrypt_switched_round(uv64& as, const CompressedCiphertext& ct,
+        const FVParams& params){
+    if(params.fast_modulli){
+        opt::with_modulli(params.q, params.p, [&](auto m){
+            using M = decltype(m);
+            for(ui32 i=0; i<params.phim; i++){
+                as[i] = M::modq_full(as[i]);
+            }
+        });
     }
-    pk.b = ToEval(params.dgg->GenerateVector(params.phim, params.q), params);
 
+    const ui64 mask = ((ui64)1 << ct.bits) - 1;
+    const ui64 half = ((ui64)1 << (ct.bits - 1));
     for(ui32 i=0; i<params.phim; i++){
-        if(params.fast_modulli){
-            auto prod = opt::mul_modq_part(pk.a[i], sk.s[i]);
-            pk.b[i] = opt::sub_modq_part(pk.b[i], prod);
+        ui64 prod = (as[i] > params.q/2)? as[i] - params.q: as[i];
+        ui64 x = (prod + ct.b[i]) & mask;
+        ui64 pt = (x*params.p + half) >> ct.bits;
+        as[i] = (pt >= params.p)? pt - params.p: pt;
+    }
+}
+
+uv64 Decrypt(const SecretKey& sk, const CompressedCiphertext& ct, const FVParams& params){
+    check_switch_bits(ct.bits, params);
+    uv64 pt = ToEval(ct.a, params);
+    mul_sk(sk, pt, params);
+    ToCoeff(pt, pt, params);
+    decrypt_switched_round(pt, ct, params);
+
+    return pt;
+}
+
+std::vector<uv64> Decrypt(const SecretKey& sk, const std::vector<CompressedCiphertext>& ct_vec,
+        const FVParams& params){
+    std::vector<uv64> pt_vec;
+    pt_vec.reserve(ct_vec.size());
+    for(auto& ct: ct_vec){
+        check_switch_bits(ct.bits, params);
+        pt_vec.push_back(ct.a);
+    }
+    ToEvalBatch(pt_vec, params);
+    for(ui32 n=0; n<ct_vec.size(); n++){
+        mul_sk(sk, pt_vec[n], params);
+    }
+    ToCoeffBatch(pt_vec, params);
+    for(ui32 n=0; n<ct_vec.size(); n++){
+        decrypt_switched_round(pt_vec[n], ct_vec[n], params);
+    }
+
+    return pt_vec;
+}
+
+KeyPair KeyGen(const FVParams& params){
+    return KeyGen(params, get_prng().stream());
+}
+
+KeyPair KeyGen(const FVParams& params, osuCrypto::PRNG& prng){
+    SecretKey sk(params.phim);
+    PublicKey pk(params.phim);
+
+    // The secret key and the error of the public key are transformed at the
+    // same time, each from a stream of its own
+    std::vector<osuCrypto::PRNG> streams;
+    streams.push_back(fork_prng(prng));
+    streams.push_back(fork_prng(prng));
+    get_thread_pool().parallel_for(2, [&](ui32 t){
+        if (t == 0) {
+            if (params.mode == RLWE) {
+                params.dgg->FillVector(sk.s.data(), params.phim, params.q, streams[t]);
+            } else {
+                get_tug_vector(sk.s.data(), params.phim, params.q, streams[t]);
+            }
+            ToEval(sk.s, sk.s, params);
         } else {
+            get_dug_vector(pk.a.data(), params.phim, params.q, streams[t]);
+            params.dgg->FillVector(pk.b.data(), params.phim, params.q, streams[t]);
+            ToEval(pk.b, pk.b, params);
+        }
+    });
+
+    if(params.fast_modulli){
+        opt::with_modulli(params.q, params.p, [&](auto m){
+            using M = decltype(m);
+            for(ui32 i=0; i<params.phim; i++){
+                auto prod = M::mul_modq_part(pk.a[i], sk.s[i]);
+                pk.b[i] = M::sub_modq_part(pk.b[i], prod);
+            }
+        });
+    } else {
+        for(ui32 i=0; i<params.phim; i++){
             auto prod = mod_mul(pk.a[i], sk.s[i], params.q);
             pk.b[i] = mod(pk.b[i] + params.q - prod, params.q);
         }
@@ -179,11 +491,16 @@ KeyPair KeyGen(const FVParams& params){
 Ciphertext EvalAdd(const Ciphertext& ct1, const Ciphertext& ct2, const FVParams& params){
     Ciphertext sum(params.phim);
 
-    for(ui32 i=0; i<params.phim; i++){
-        if(params.fast_modulli){
-            sum.a[i] = opt::modq_part(ct1.a[i] + ct2.a[i]);
-            sum.b[i] = opt::modq_part(ct1.b[i] + ct2.b[i]);
-        } else {
+    if(params.fast_modulli){
+        opt::with_modulli(params.q, params.p, [&](auto m){
+            using M = decltype(m);
+            for(ui32 i=0; i<params.phim; i++){
+                sum.a[i] = M::modq_part(ct1.a[i] + ct2.a[i]);
+                sum.b[i] = M::modq_part(ct1.b[i] + ct2.b[i]);
+            }
+        });
+    } else {
+        for(ui32 i=0; i<params.phim; i++){
             sum.a[i] = mod(ct1.a[i] + ct2.a[i], params.q);
             sum.b[i] = mod(ct1.b[i] + ct2.b[i], params.q);
         }
@@ -196,10 +513,15 @@ Ciphertext EvalAddPlain(const Ciphertext& ct, const uv64& pt, const FVParams& pa
     Ciphertext sum(params.phim);
     sum.a = ct.a;
 
-    for(ui32 i=0; i<params.phim; i++){
-        if(params.fast_modulli){
-            sum.b[i] = opt::modq_part(ct.b[i] + pt[i]);
-        } else {
+    if(params.fast_modulli){
+        opt::with_modulli(params.q, params.p, [&](auto m){
+            using M = decltype(m);
+            for(ui32 i=0; i<params.phim; i++){
+                sum.b[i] = M::modq_part(ct.b[i] + pt[i]);
+            }
+        });
+    } else {
+        for(ui32 i=0; i<params.phim; i++){
             sum.b[i] = mod(ct.b[i] + pt[i], params.q);
         }
     }
@@ -210,11 +532,16 @@ Ciphertext EvalAddPlain(const Ciphertext& ct, const uv64& pt, const FVParams& pa
 Ciphertext EvalSub(const Ciphertext& ct1, const Ciphertext& ct2, const FVParams& params){
     Ciphertext diff(params.phim);
 
-    for(ui32 i=0; i<params.phim; i++){
-        if(params.fast_modulli){
-            diff.a[i] = opt::sub_modq_part(ct1.a[i], ct2.a[i]);
-            diff.b[i] = opt::sub_modq_part(ct1.b[i], ct2.b[i]);
-        } else {
+    if(params.fast_modulli){
+        opt::with_modulli(params.q, params.p, [&](auto m){
+            using M = decltype(m);
+            for(ui32 i=0; i<params.phim; i++){
+                diff.a[i] = M::sub_modq_part(ct1.a[i], ct2.a[i]);
+                diff.b[i] = M::sub_modq_part(ct1.b[i], ct2.b[i]);
+            }
+        });
+    } else {
+        for(ui32 i=0; i<params.phim; i++){
             diff.a[i] = mod(ct1.a[i] + params.q - ct2.a[i], params.q);
             diff.b[i] = mod(ct1.b[i] + params.q - ct2.b[i], params.q);
         }
@@ -227,10 +554,15 @@ Ciphertext EvalSubPlain(const Ciphertext& ct, const uv64& pt, const FVParams& pa
     Ciphertext diff(params.phim);
     diff.a = ct.a;
 
-    for(ui32 i=0; i<params.phim; i++){
-        if(params.fast_modulli){
-            diff.b[i] = opt::sub_modq_part(ct.b[i], pt[i]);
-        } else {
+    if(params.fast_modulli){
+        opt::with_modulli(params.q, params.p, [&](auto m){
+            using M = decltype(m);
+            for(ui32 i=0; i<params.phim; i++){
+                diff.b[i] = M::sub_modq_part(ct.b[i], pt[i]);
+            }
+        });
+    } else {
+        for(ui32 i=0; i<params.phim; i++){
             diff.b[i] = mod(ct.b[i] + params.q - pt[i], params.q);
         }
     }
@@ -241,11 +573,16 @@ Ciphertext EvalSubPlain(const Ciphertext& ct, const uv64& pt, const FVParams& pa
 Ciphertext EvalNegate(const Ciphertext& ct, const FVParams& params){
     Ciphertext neg(params.phim);
 
-    for(ui32 i=0; i<params.phim; i++){
-        if(params.fast_modulli){
-            neg.a[i] = opt::sub_modq_part(0, ct.a[i]);
-            neg.b[i] = opt::sub_modq_part(0, ct.b[i]);
-        } else {
+    if(params.fast_modulli){
+        opt::with_modulli(params.q, params.p, [&](auto m){
+            using M = decltype(m);
+            for(ui32 i=0; i<params.phim; i++){
+                neg.a[i] = M::sub_modq_part(0, ct.a[i]);
+                neg.b[i] = M::sub_modq_part(0, ct.b[i]);
+            }
+        });
+    } else {
+        for(ui32 i=0; i<params.phim; i++){
             neg.a[i] = mod(params.q - ct.a[i], params.q);
             neg.b[i] = mod(params.q - ct.b[i], params.q);
         }
@@ -258,11 +595,16 @@ Ciphertext EvalNegate(const Ciphertext& ct, const FVParams& params){
 Ciphertext EvalMultPlain(const Ciphertext& ct, const uv64& pt, const FVParams& params){
     Ciphertext prod(params.phim);
 
-    for(ui32 i=0; i<params.phim; i++){
-        if(params.fast_modulli){
-            prod.a[i] = opt::mul_modq_part(ct.a[i], pt[i]);
-            prod.b[i] = opt::mul_modq_part(ct.b[i], pt[i]);
-        } else {
+    if(params.fast_modulli){
+        opt::with_modulli(params.q, params.p, [&](auto m){
+            using M = decltype(m);
+            for(ui32 i=0; i<params.phim; i++){
+                prod.a[i] = M::mul_modq_part(ct.a[i], pt[i]);
+                prod.b[i] = M::mul_modq_part(ct.b[i], pt[i]);
+            }
+        });
+    } else {
+        for(ui32 i=0; i<params.phim; i++){
             prod.a[i] = mod_mul(ct.a[i], pt[i], params.q);
             prod.b[i] = mod_mul(ct.b[i], pt[i], params.q);
         }
@@ -271,6 +613,202 @@ Ciphertext EvalMultPlain(const Ciphertext& ct, const uv64& pt, const FVParams& p
     return prod;
 }
 
+void EvalAddInPlace(Ciphertext& ct1, const Ciphertext& ct2, const FVParams& params){
+    if(params.fast_modulli){
+        opt::with_modulli(params.q, params.p, [&](auto m){
+            using M = decltype(m);
+            for(ui32 i=0; i<params.phim; i++){
+                ct1.a[i] = M::modq_part(ct1.a[i] + ct2.a[i]);
+                ct1.b[i] = M::modq_part(ct1.b[i] + ct2.b[i]);
+            }
+        });
+    } else {
+        for(ui32 i=0; i<params.phim; i++){
+            ct1.a[i] = mod(ct1.a[i] + ct2.a[i], params.q);
+            ct1.b[i] = mod(ct1.b[i] + ct2.b[i], params.q);
+        }
+    }
+}
+
+void EvalSubInPlace(Ciphertext& ct1, const Ciphertext& ct2, const FVParams& params){
+    if(params.fast_modulli){
+        opt::with_modulli(params.q, params.p, [&](auto m){
+            using M = decltype(m);
+            for(ui32 i=0; i<params.phim; i++){
+                ct1.a[i] = M::sub_modq_part(ct1.a[i], ct2.a[i]);
+                ct1.b[i] = M::sub_modq_part(ct1.b[i], ct2.b[i]);
+            }
+        });
+    } else {
+        for(ui32 i=0; i<params.phim; i++){
+            ct1.a[i] = mod(ct1.a[i] + params.q - ct2.a[i], params.q);
+            ct1.b[i] = mod(ct1.b[i] + params.q - ct2.b[i], params.q);
+        }
+    }
+}
+
+void EvalMultPlainInPlace(Ciphertext& ct, const uv64& pt, const FVParams& params){
+    if(params.fast_modulli){
+        opt::with_modulli(params.q, params.p, [&](auto m){
+            using M = decltype(m);
+            for(ui32 i=0; i<params.phim; i++){
+                ct.a[i] = M::mul_modq_part(ct.a[i], pt[i]);
+                ct.b[i] = M::mul_modq_part(ct.b[i], pt[i]);
+            }
+        });
+    } else {
+        for(ui32 i=0; i<params.phim; i++){
+            ct.a[i] = mod_mul(ct.a[i], pt[i], params.q);
+            ct.b[i] = mod_mul(ct.b[i], pt[i], params.q);
+        }
+    }
+}
+
+void EvalMultPlainAccumulate(Ciphertext& acc, const Ciphertext& ct, const uv64& pt,
+        const FVParams& params){
+    if(params.fast_modulli){
+        opt::with_modulli(params.q, params.p, [&](auto m){
+            using M = decltype(m);
+            for(ui32 i=0; i<params.phim; i++){
+                acc.a[i] = M::modq_part(acc.a[i] + M::mul_modq_part(ct.a[i], pt[i]));
+                acc.b[i] = M::modq_part(acc.b[i] + M::mul_modq_part(ct.b[i], pt[i]));
+            }
+        });
+    } else {
+        for(ui32 i=0; i<params.phim; i++){
+            acc.a[i] = mod(acc.a[i] + mod_mul(ct.a[i], pt[i], params.q), params.q);
+            acc.b[i] = mod(acc.b[i] + mod_mul(ct.b[i], pt[i], params.q), params.q);
+        }
+    }
+}
+
+// Number of products the accumulator takes before a fold. Ciphertexts may
+// be partially reduced, below 2^62, in the fast modulli case. A folded sum
+// is below q and counts as one product.
+static ui32 accumulator_capacity(const FVParams& params){
+    ui32 ct_bits = params.fast_modulli? 62: opt::bit_length(params.q);
+    ui32 pt_bits = opt::bit_length(params.q);
+    if (ct_bits + pt_bits >= 127) {
+        return 1;
+    }
+    return (ui32)1 << std::min((ui32)20, 127 - ct_bits - pt_bits);
+}
+
+// Any 128-bit x to a partially reduced 64-bit value
+template <class M>
+static inline ui64 fold_modq(const ui128 x){
+    // 2^64 = 16*delta mod q, leaving below 2^99 for modq_part
+    return M::modq_part((ui128)(ui64)x + (x >> 64)*(ui128)M::delta16);
+}
+
+static void fold_accumulator(CiphertextAccumulator& acc, const FVParams& params){
+    if(params.fast_modulli){
+        opt::with_modulli(params.q, params.p, [&](auto m){
+            using M = decltype(m);
+            for(ui32 i=0; i<acc.a.size(); i++){
+                acc.a[i] = fold_modq<M>(acc.a[i]);
+                acc.b[i] = fold_modq<M>(acc.b[i]);
+            }
+        });
+    } else {
+        for(ui32 i=0; i<acc.a.size(); i++){
+            acc.a[i] = mod(acc.a[i], params.q);
+            acc.b[i] = mod(acc.b[i], params.q);
+        }
+    }
+    acc.terms = 1;
+}
+
+void EvalMultPlainAccumulate(CiphertextAccumulator& acc, const Ciphertext& ct,
+        const uv64& pt, const FVParams& params){
+    EvalMultPlainAccumulate(acc, ct, pt.data(), params);
+}
+
+void EvalMultPlainAccumulate(CiphertextAccumulator& acc, const Ciphertext& ct,
+        const ui64* pt, const FVParams& params){
+    if (acc.terms >= accumulator_capacity(params)) {
+        fold_accumulator(acc, params);
+    }
+
+    for(ui32 i=0; i<params.phim; i++){
+        acc.a[i] += (ui128)ct.a[i]*pt[i];
+        acc.b[i] += (ui128)ct.b[i]*pt[i];
+    }
+    acc.terms++;
+}
+
+Ciphertext Reduce(const CiphertextAccumulator& acc, const FVParams& params){
+    Ciphertext ct(params.phim);
+    if(params.fast_modulli){
+        opt::with_modulli(params.q, params.p, [&](auto m){
+            using M = decltype(m);
+            for(ui32 i=0; i<params.phim; i++){
+                ct.a[i] = M::modq_full(fold_modq<M>(acc.a[i]));
+                ct.b[i] = M::modq_full(fold_modq<M>(acc.b[i]));
+            }
+        });
+    } else {
+        for(ui32 i=0; i<params.phim; i++){
+            ct.a[i] = mod(acc.a[i], params.q);
+            ct.b[i] = mod(acc.b[i], params.q);
+        }
+    }
+
+    return ct;
+}
+
+std::vector<Ciphertext> Reduce(const std::vector<CiphertextAccumulator>& acc_vec,
+        const FVParams& params){
+    std::vector<Ciphertext> ct_vec(acc_vec.size(), Ciphertext(0));
+    get_thread_pool().parallel_for(acc_vec.size(), [&](ui32 n){
+        ct_vec[n] = Reduce(acc_vec[n], params);
+    });
+
+    return ct_vec;
+}
+
+// Fills the b rows of rk for its uniform a rows
+// Row i of the b rows of a key switching key, its error drawn from prng
+static void key_switch_gen_row(const SecretKey& orig_sk, const SecretKey& new_sk,
+        RelinKey& rk, const ui32 i, const FVParams& params, osuCrypto::PRNG& prng){
+    params.dgg->FillVector(rk.b[i].data(), params.phim, params.q, prng);
+    ToEval(rk.b[i], rk.b[i], params);
+
+    if(params.fast_modulli){
+        opt::with_modulli(params.q, params.p, [&](auto m){
+            using M = decltype(m);
+            for(ui32 j=0; j<params.phim; j++){
+                rk.b[i][j] += M::lshift_modq_part(orig_sk.s[j], (i*params.window_size));
+                auto prod = M::mul_modq_part(rk.a[i][j], new_sk.s[j]);
+                rk.b[i][j] = M::sub_modq_part(rk.b[i][j], prod);
+            }
+        });
+    } else {
+        for(ui32 j=0; j<params.phim; j++){
+            rk.b[i][j] += mod_mul((ui64)1 << (i*params.window_size), orig_sk.s[j], params.q);
+            auto prod = mod_mul(rk.a[i][j], new_sk.s[j], params.q);
+            rk.b[i][j] = mod(rk.b[i][j] + params.q - prod, params.q);
+        }
+    }
+}
+
+static void key_switch_gen_b(const SecretKey& orig_sk, const SecretKey& new_sk,
+        RelinKey& rk, const FVParams& params){
+    for (ui32 i=0; i<rk.a.size(); i++) {
+        key_switch_gen_row(orig_sk, new_sk, rk, i, params, get_prng().stream());
+    }
+}
+
+// The a rows of a seeded key, all drawn from one stream
+static void expand_key_rows(const osuCrypto::block& seed, std::vector<uv64>& a,
+        const FVParams& params){
+    uv64 rows(a.size()*params.phim);
+    get_dug_vector(rows.data(), rows.size(), params.q, seed);
+    for (ui32 i=0; i<a.size(); i++) {
+        std::copy(rows.begin() + i*params.phim, rows.begin() + (i+1)*params.phim, a[i].begin());
+    }
+}
+
 RelinKey KeySwitchGen(const SecretKey& orig_sk, const SecretKey& new_sk, const FVParams& params){
     // This works because q is never a power of 2, so the floor is 1 less than size of q
     ui32 num_windows = 1 + floor(log2(params.q))/params.window_size;
@@ -280,48 +818,86 @@ RelinKey KeySwitchGen(const SecretKey& orig_sk, const SecretKey& new_sk, const F
 
     for (ui32 i=0; i<num_windows; i++) {
         if(params.fast_modulli){
-            rk.a[i] = get_dug_vector_opt(params.phim);
+            opt::with_modulli(params.q, params.p, [&](auto m){
+                rk.a[i] = get_dug_vector_opt<decltype(m)>(params.phim);
+            });
         } else {
             rk.a[i] = get_dug_vector(params.phim, params.q);
         }
-        rk.b[i] = ToEval(params.dgg->GenerateVector(params.phim, params.q), params);
-
-        for(ui32 j=0; j<params.phim; j++){
-            if(params.fast_modulli){
-                rk.b[i][j] += opt::lshift_modq_part(orig_sk.s[j], (i*params.window_size));
-                auto prod = opt::mul_modq_part(rk.a[i][j], new_sk.s[j]);
-                rk.b[i][j] = opt::sub_modq_part(rk.b[i][j], prod);
-            } else {
-                rk.b[i][j] += mod_mul((ui64)1 << (i*params.window_size), orig_sk.s[j], params.q);
-                auto prod = mod_mul(rk.a[i][j], new_sk.s[j], params.q);
-                rk.b[i][j] = mod(rk.b[i][j] + params.q - prod, params.q);
-            }
-        }
     }
+    key_switch_gen_b(orig_sk, new_sk, rk, params);
 
     return rk;
 }
 
-std::vector<uv64> HoistedDecompose(const Ciphertext& ct, const FVParams& params){
+SeededRelinKey KeySwitchGenSeeded(const SecretKey& orig_sk, const SecretKey& new_sk,
+        const FVParams& params){
+    // This works because q is never a power of 2, so the floor is 1 less than size of q
+    ui32 num_windows = 1 + floor(log2(params.q))/params.window_size;
+
+    RelinKey rk(params.phim, num_windows);
+    SeededRelinKey rk_seeded(params.phim, num_windows);
+    rk_seeded.seed = get_seed();
+    expand_key_rows(rk_seeded.seed, rk.a, params);
+    key_switch_gen_b(orig_sk, new_sk, rk, params);
+    rk_seeded.b = std::move(rk.b);
+
+    return rk_seeded;
+}
+
+RelinKey Expand(const SeededRelinKey& rk, const FVParams& params){
+    RelinKey rk_full(params.phim, rk.b.size());
+    expand_key_rows(rk.seed, rk_full.a, params);
+    rk_full.b = rk.b;
+
+    return rk_full;
+}
+
+template <class Alloc>
+static std::vector<std::vector<ui64, Alloc>> hoisted_decompose(const Ciphertext& ct,
+        const Alloc& alloc, const FVParams& params){
     // This works because q is never a power of 2, so the floor is 1 less than size of q
     ui32 num_windows = 1 + floor(log2(params.q))/params.window_size;
 
     auto ct_a_coeff = ToCoeff(ct.a, params);
     if(params.fast_modulli){
-        for(ui32 n=0; n<params.phim; n++){
-            ct_a_coeff[n] = opt::modq_full(ct_a_coeff[n]);
-        }
+        opt::with_modulli(params.q, params.p, [&](auto m){
+            using M = decltype(m);
+            for(ui32 n=0; n<params.phim; n++){
+                ct_a_coeff[n] = M::modq_full(ct_a_coeff[n]);
+            }
+        });
     }
-    auto digits_ct = base_decompose(ct_a_coeff, params.window_size, num_windows);
+    std::vector<std::vector<ui64, Alloc>> digits_ct;
+    digits_ct.reserve(num_windows);
+    std::vector<ui64*> ptrs;
     for(ui32 i=0; i<num_windows; i++){
-        digits_ct[i] = ToEval(digits_ct[i], params);
+        digits_ct.emplace_back(params.phim, (ui64)0, alloc);
+        ptrs.push_back(digits_ct[i].data());
     }
+    ui64 mask = ((ui64)1 << params.window_size) - 1;
+    for(ui32 j=0; j<params.phim; j++){
+        ui64 curr_coeff = ct_a_coeff[j];
+        for(ui32 i=0; i<num_windows; i++){
+            ptrs[i][j] = (curr_coeff & mask);
+            curr_coeff = (curr_coeff >> params.window_size);
+        }
+    }
+    to_eval_batch(ptrs, params);
 
     return digits_ct;
 }
 
+std::vector<uv64> HoistedDecompose(const Ciphertext& ct, const FVParams& params){
+    return hoisted_decompose(ct, AlignedAllocator<ui64>(), params);
+}
+
+std::vector<av64> HoistedDecompose(const Ciphertext& ct, const FVParams& params, Arena* arena){
+    return hoisted_decompose(ct, ArenaAllocator<ui64>(arena), params);
+}
+
 Ciphertext KeySwitchDigits(const RelinKey& rk, const Ciphertext& ct,
-        const std::vector<uv64> digits_ct, const FVParams& params){
+        const DigitsView& digits_ct, const FVParams& params){
     // This works because q is never a power of 2, so the floor is 1 less than size of q
     ui32 num_windows = 1 + floor(log2(params.q))/params.window_size;
 
@@ -336,11 +912,16 @@ Ciphertext KeySwitchDigits(const RelinKey& rk, const Ciphertext& ct,
     }
 
     Ciphertext ct_new(params.phim);
-    for (ui32 j=0; j<params.phim; j++){
-        if(params.fast_modulli){
-            ct_new.a[j] = opt::modq_part(ct_a[j]);
-            ct_new.b[j] = opt::modq_part(ct_b[j]);
-        } else {
+    if(params.fast_modulli){
+        opt::with_modulli(params.q, params.p, [&](auto m){
+            using M = decltype(m);
+            for (ui32 j=0; j<params.phim; j++){
+                ct_new.a[j] = M::modq_part(ct_a[j]);
+                ct_new.b[j] = M::modq_part(ct_b[j]);
+            }
+        });
+    } else {
+        for (ui32 j=0; j<params.phim; j++){
             ct_new.a[j] = mod(ct_a[j], params.q);
             ct_new.b[j] = mod(ct_b[j], params.q);
         }
@@ -354,67 +935,272 @@ Ciphertext KeySwitch(const RelinKey& rk, const Ciphertext& ct, const FVParams& p
     return KeySwitchDigits(rk, ct, digits_ct, params);
 }
 
-Ciphertext EvalAutomorphismDigits(const ui32 rot, const RelinKey& rk, const Ciphertext& ct,
-        const std::vector<uv64>& digits_ct, const FVParams& params){
+// Slots per block of the rotation kernel, the 128-bit sums of a block stay in
+// L1 instead of a pair of phim sized temporaries
+static const ui32 ROT_BLOCK = 256;
+
+// Slots [j0, j0+ROT_BLOCK) of the rotation of ct by rot
+static void automorph_block(const uv32& perm, const RelinKey& rk, const Ciphertext& ct,
+        const DigitsView& digits_ct, Ciphertext& ct_rot, const ui32 j0,
+        const FVParams& params){
     // This works because q is never a power of 2, so the floor is 1 less than size of q
     ui32 num_windows = 1 + floor(log2(params.q))/params.window_size;
-
-    auto ct_b_rot = automorph(ct.b, rot);
-
-    uv128 ct_a(params.phim);
-    uv128 ct_b(ct_b_rot.begin(), ct_b_rot.end());
+    ui32 len = std::min(ROT_BLOCK, params.phim - j0);
+
+    // The automorphism only permutes the evaluations, so it is applied while
+    // reading the digits instead of rotating them into temporaries
+    ui128 ct_a[ROT_BLOCK];
+    ui128 ct_b[ROT_BLOCK];
+    for (ui32 j=0; j<len; j++){
+        ct_a[j] = 0;
+        ct_b[j] = ct.b[perm[j0+j]];
+    }
 
     for (ui32 i=0; i<num_windows; i++) {
-        auto digit_rot = automorph(digits_ct[i], rot);
-        for (ui32 j=0; j<params.phim; j++){
-            ct_a[j] += ((ui128)(digit_rot[j]) * (ui128)(rk.a[i][j]));
-            ct_b[j] += ((ui128)(digit_rot[j]) * (ui128)(rk.b[i][j]));
+        const ui64* digit = digits_ct[i];
+        const ui64* rk_a = rk.a[i].data() + j0;
+        const ui64* rk_b = rk.b[i].data() + j0;
+        for (ui32 j=0; j<len; j++){
+            ui128 digit_rot = digit[perm[j0+j]];
+            ct_a[j] += (digit_rot * (ui128)(rk_a[j]));
+            ct_b[j] += (digit_rot * (ui128)(rk_b[j]));
         }
     }
 
+    if(params.fast_modulli){
+        opt::with_modulli(params.q, params.p, [&](auto m){
+            using M = decltype(m);
+            for (ui32 j=0; j<len; j++){
+                ct_rot.a[j0+j] = M::modq_part(ct_a[j]);
+                ct_rot.b[j0+j] = M::modq_part(ct_b[j]);
+            }
+        });
+    } else {
+        for (ui32 j=0; j<len; j++){
+            ct_rot.a[j0+j] = mod(ct_a[j], params.q);
+            ct_rot.b[j0+j] = mod(ct_b[j], params.q);
+        }
+    }
+}
+
+Ciphertext EvalAutomorphismDigits(const ui32 rot, const RelinKey& rk, const Ciphertext& ct,
+        const DigitsView& digits_ct, const FVParams& params){
+    auto automorph_ctx = GetAutomorphContext(params);
+    const auto& perm = automorph_ctx->eval_permutation(rot);
+
     Ciphertext ct_rot(params.phim);
-    for (ui32 j=0; j<params.phim; j++){
-        if(params.fast_modulli){
-            ct_rot.a[j] = opt::modq_part(ct_a[j]);
-            ct_rot.b[j] = opt::modq_part(ct_b[j]);
-        } else {
-            ct_rot.a[j] = mod(ct_a[j], params.q);
-            ct_rot.b[j] = mod(ct_b[j], params.q);
+    for (ui32 j0=0; j0<params.phim; j0+=ROT_BLOCK){
+        automorph_block(perm, rk, ct, digits_ct, ct_rot, j0, params);
+    }
+
+    return ct_rot;
+}
+
+Ciphertext EvalAutomorphismDigits(const ui32 rot, const AutomorphismKeys& keys,
+        const Ciphertext& ct, const DigitsView& digits_ct, const FVParams& params){
+    return EvalAutomorphismDigits(rot, GetAutomorphismKey(keys, rot), ct, digits_ct, params);
+}
+
+std::vector<Ciphertext> EvalAutomorphismDigitsBatch(const uv32& rotations,
+        const AutomorphismKeys& keys, const Ciphertext& ct,
+        const DigitsView& digits_ct, const FVParams& params, const bool parallel){
+    // Keys and permutations are looked up once, before any worker runs
+    std::vector<const RelinKey*> rk_list(rotations.size(), nullptr);
+    std::vector<const uv32*> perm_list(rotations.size(), nullptr);
+    auto automorph_ctx = GetAutomorphContext(params);
+    for (ui32 r=0; r<rotations.size(); r++){
+        if (rotations[r] == 0) {
+            continue;
+        }
+        rk_list[r] = &GetAutomorphismKey(keys, rotations[r]);
+        perm_list[r] = &automorph_ctx->eval_permutation(rotations[r]);
+    }
+
+    std::vector<Ciphertext> ct_rot(rotations.size(), Ciphertext(params.phim));
+    if (parallel) {
+        get_thread_pool().parallel_for(rotations.size(), [&](ui32 r){
+            if (rotations[r] == 0) {
+                ct_rot[r] = ct;
+                return;
+            }
+            for (ui32 j0=0; j0<params.phim; j0+=ROT_BLOCK){
+                automorph_block(*perm_list[r], *rk_list[r], ct, digits_ct, ct_rot[r], j0, params);
+            }
+        });
+    } else {
+        for (ui32 r=0; r<rotations.size(); r++){
+            if (rotations[r] == 0) {
+                ct_rot[r] = ct;
+            }
+        }
+        // Block by block, each block for every rotation
+        for (ui32 j0=0; j0<params.phim; j0+=ROT_BLOCK){
+            for (ui32 r=0; r<rotations.size(); r++){
+                if (rotations[r] != 0) {
+                    automorph_block(*perm_list[r], *rk_list[r], ct, digits_ct, ct_rot[r], j0,
+                            params);
+                }
+            }
         }
     }
 
     return ct_rot;
 }
 
-Ciphertext EvalAutomorphism(const ui32 rot, const Ciphertext& ct, const FVParams& params){
+void ForEachAutomorphism(const uv32& rotations, const AutomorphismKeys& keys,
+        const Ciphertext& ct, const DigitsView& digits_ct, const FVParams& params,
+        const std::function<void(ui32, const Ciphertext&)>& f){
+    // One rotation per thread at a time keeps the rotated ciphertexts in
+    // cache until f has used them
+    ui32 batch = get_thread_pool().size();
+    for (ui32 r0=0; r0<rotations.size(); r0+=batch){
+        uv32 rot_list(rotations.begin() + r0,
+                rotations.begin() + std::min(r0 + batch, (ui32)rotations.size()));
+        auto ct_rot = EvalAutomorphismDigitsBatch(rot_list, keys, ct, digits_ct, params, batch > 1);
+        for (ui32 r=0; r<rot_list.size(); r++){
+            f(r0 + r, ct_rot[r]);
+        }
+    }
+}
+
+std::vector<Ciphertext> EvalAutomorphismBatch(const Ciphertext& ct, const uv32& rotations,
+        const AutomorphismKeys& keys, const FVParams& params, const bool parallel){
+    const auto digits_ct = HoistedDecompose(ct, params);
+    return EvalAutomorphismDigitsBatch(rotations, keys, ct, digits_ct, params, parallel);
+}
+
+Ciphertext EvalAutomorphism(const ui32 rot, const AutomorphismKeys& keys, const Ciphertext& ct,
+        const FVParams& params){
     const auto digits_ct = HoistedDecompose(ct, params);
-    const auto rk = g_rk_map[rot];
-    return EvalAutomorphismDigits(rot, (*rk), ct, digits_ct, params);
+    return EvalAutomorphismDigits(rot, GetAutomorphismKey(keys, rot), ct, digits_ct, params);
+}
+
+// Keys for every rotation of index_list with their a rows expanded from
+// seeds. The b rows of all the keys are spread over the shared pool, in the
+// order of the keys, and on_ready(n) is called once key n and every key
+// before it are done. Seeds and streams are all drawn from prng before any
+// worker runs, so the keys only depend on prng.
+static void automorphism_key_gen(const SecretKey& sk, const uv32& index_list,
+        const FVParams& params, osuCrypto::PRNG& prng, std::vector<RelinKey>& rk_list,
+        std::vector<osuCrypto::block>& seeds, const std::function<void(ui32)>& on_ready){
+    // This works because q is never a power of 2, so the floor is 1 less than size of q
+    ui32 num_windows = 1 + floor(log2(params.q))/params.window_size;
+    ui32 num_keys = index_list.size();
+
+    rk_list.assign(num_keys, RelinKey(params.phim, num_windows));
+    seeds.resize(num_keys);
+    std::vector<osuCrypto::PRNG> row_prng;
+    for (ui32 n = 0; n < num_keys; n++) {
+        seeds[n] = get_seed(prng);
+        for (ui32 i = 0; i < num_windows; i++) {
+            row_prng.push_back(fork_prng(prng));
+        }
+    }
+
+    // Also builds the permutation tables ahead of the online rotations
+    std::vector<SecretKey> sk_rot(num_keys, SecretKey(params.phim));
+    get_thread_pool().parallel_for(num_keys, [&](ui32 n){
+        sk_rot[n].s = automorph(sk.s, index_list[n], *GetAutomorphContext(params));
+        expand_key_rows(seeds[n], rk_list[n].a, params);
+    });
+
+    std::unique_ptr<std::atomic<ui32>[]> rows_left(new std::atomic<ui32>[num_keys]);
+    for (ui32 n = 0; n < num_keys; n++) {
+        rows_left[n] = num_windows;
+    }
+    std::vector<bool> done(num_keys, false);
+    ui32 next = 0;
+    std::mutex ready_mutex;
+    get_thread_pool().parallel_for(num_keys*num_windows, [&](ui32 t){
+        ui32 n = t/num_windows, i = t%num_windows;
+        key_switch_gen_row(sk_rot[n], sk, rk_list[n], i, params, row_prng[t]);
+        if (--rows_left[n] == 0) {
+            std::lock_guard<std::mutex> lock(ready_mutex);
+            done[n] = true;
+            for (; (next < num_keys) && done[next]; next++) {
+                on_ready(next);
+            }
+        }
+    });
+}
+
+AutomorphismKeys EvalAutomorphismKeyGen(const SecretKey& sk, const uv32& index_list,
+        const FVParams& params){
+    return EvalAutomorphismKeyGen(sk, index_list, params, get_prng().stream());
 }
 
-void EvalAutomorphismKeyGen(const SecretKey& sk,
-    const uv32& index_list, const FVParams& params){
-    for (ui32 i = 0; i < index_list.size(); i++){
-        SecretKey sk_rot(params.phim);
-        sk_rot.s = automorph(sk.s, index_list[i]);
-        g_rk_map[index_list[i]] = std::make_shared<RelinKey>(KeySwitchGen(sk_rot, sk, params));
+AutomorphismKeys EvalAutomorphismKeyGen(const SecretKey& sk, const uv32& index_list,
+        const FVParams& params, osuCrypto::PRNG& prng){
+    std::vector<RelinKey> rk_list;
+    std::vector<osuCrypto::block> seeds;
+    automorphism_key_gen(sk, index_list, params, prng, rk_list, seeds, [](ui32){});
+
+    AutomorphismKeys keys;
+    for (ui32 n = 0; n < index_list.size(); n++){
+        keys[index_list[n]] = std::make_shared<const RelinKey>(std::move(rk_list[n]));
     }
+    return keys;
+}
 
-    return;
+std::vector<SeededRelinKey> EvalAutomorphismKeyGenSeeded(const SecretKey& sk,
+        const uv32& index_list, const FVParams& params, const KeyGenCallback& on_key){
+    return EvalAutomorphismKeyGenSeeded(sk, index_list, params, get_prng().stream(), on_key);
 }
 
-shared_ptr<RelinKey> GetAutomorphismKey(ui32 rot){
-    return g_rk_map[rot];
+std::vector<SeededRelinKey> EvalAutomorphismKeyGenSeeded(const SecretKey& sk,
+        const uv32& index_list, const FVParams& params, osuCrypto::PRNG& prng,
+        const KeyGenCallback& on_key){
+    std::vector<SeededRelinKey> rk_seeded(index_list.size(), SeededRelinKey(0, 0));
+    std::vector<RelinKey> rk_list;
+    std::vector<osuCrypto::block> seeds;
+    automorphism_key_gen(sk, index_list, params, prng, rk_list, seeds, [&](ui32 n){
+        rk_seeded[n].seed = seeds[n];
+        rk_seeded[n].b = std::move(rk_list[n].b);
+        rk_list[n].a.clear();
+        if (on_key) {
+            on_key(n, rk_seeded[n]);
+        }
+    });
+
+    return rk_seeded;
 }
 
-Ciphertext AddRandomNoise(const Ciphertext& ct, const FVParams& params){
+void AddAutomorphismKey(AutomorphismKeys& keys, const ui32 rot, const SeededRelinKey& rk,
+        const FVParams& params){
+    // Expanded once here, the rotations use the cached rows
+    keys[rot] = std::make_shared<const RelinKey>(Expand(rk, params));
+    GetAutomorphContext(params)->eval_permutation(rot);
+}
+
+const RelinKey& GetAutomorphismKey(const AutomorphismKeys& keys, const ui32 rot){
+    auto rk = keys.find(rot);
+    if (rk == keys.end()) {
+        throw std::logic_error("No automorphism key for rotation " + std::to_string(rot));
+    }
+    return *rk->second;
+}
+
+size_t AutomorphismKeyBytes(const AutomorphismKeys& keys){
+    size_t bytes = 0;
+    for (const auto& rk: keys) {
+        for (ui32 w = 0; w < rk.second->a.size(); w++) {
+            bytes += (rk.second->a[w].size() + rk.second->b[w].size())*sizeof(ui64);
+        }
+    }
+    return bytes;
+}
+
+uv64 RandomNoiseMask(const FVParams& params){
     uv64 random_eval = get_dug_vector(params.phim, params.p);
     random_eval[0] = 0; //first plainext slot does not need to change
 
-    uv64 random_coeff = packed_encode(random_eval, params.p, params.logn);
+    uv64 random_coeff = packed_encode(random_eval, params);
+    return NullEncrypt(random_coeff, params);
+}
 
+Ciphertext AddRandomNoise(const Ciphertext& ct, const FVParams& params){
     Ciphertext random_ct(params.phim);
-    random_ct.b = NullEncrypt(random_coeff, params);
+    random_ct.b = RandomNoiseMask(params);
 
     return EvalAdd(ct, random_ct, params);
 };
@@ -10,15 +10,39 @@
 #ifndef LBCRYPTO_CRYPTO_FV_H
 #define LBCRYPTO_CRYPTO_FV_H
 
+#include <functional>
+#include <map>
 #include <memory>
 using std::shared_ptr;
 
 #include "utils/backend.h"
+#include "math/params.h"
 #include "math/transfrm.h"
+#include "math/automorph.h"
 #include "pke_types.h"
 
 namespace lbcrypto {
 
+    struct EncodingContext;
+
+    /**
+    * @brief All the precomputed tables for one FV parameter set: the transforms
+    * mod q and mod p, the automorphism permutations and the packed encoding.
+    *
+    * The context is immutable once built and is shared between the parameter
+    * structs (and threads) that use it. Contexts for different parameter sets
+    * coexist, unlike the tables registered by ftt_precompute and friends.
+    */
+    struct FVContext {
+        FVContext(const ui64 q, const ui64 z, const ui64 p, const ui64 z_p, const ui32 logn);
+        explicit FVContext(const ParamSet& set);
+
+        shared_ptr<const NttContext> ntt_q;
+        shared_ptr<const NttContext> ntt_p;
+        shared_ptr<const AutomorphContext> automorph;
+        shared_ptr<const EncodingContext> encoding;
+    };
+
     /**
     * @brief This is the parameters class for the FV encryption scheme.
     *
@@ -45,40 +69,125 @@ namespace lbcrypto {
         shared_ptr<DiscreteGaussianGenerator> dgg;
 
         ui32 window_size;
+
+        // Tables used by the evaluation functions. When unset the tables
+        // registered for q and p by the precompute functions are used.
+        shared_ptr<const FVContext> ctx;
     };
 
-    extern std::map<ui32, shared_ptr<RelinKey>> g_rk_map;
+    // Fast modulli parameters for one of the registered sets, with a context
+    // of their own so that they do not depend on the precompute functions
+    FVParams MakeFVParams(const ParamSet& set, const MODE mode,
+            shared_ptr<DiscreteGaussianGenerator> dgg, const ui32 window_size);
+
+    // Rotation keys of one client by rotation index. A set is not modified
+    // once it is handed to the rotations, so any number of threads can read
+    // it without locks; KeyStore holds the sets of many clients.
+    typedef std::map<ui32, shared_ptr<const RelinKey>> AutomorphismKeys;
+
+    inline shared_ptr<const NttContext> GetNttContext(const FVParams& params){
+        return params.ctx ? params.ctx->ntt_q : get_ntt_context(params.q);
+    }
+
+    inline shared_ptr<const AutomorphContext> GetAutomorphContext(const FVParams& params){
+        return params.ctx ? params.ctx->automorph : get_automorph_context(params.phim);
+    }
+
+    // Writes to a caller provided vector of size phim, which may be the input
+    // itself for an in-place transform
+    void inline ToCoeff(const uv64& eval, uv64& coeff, const FVParams& params){
+        ftt_inv(*GetNttContext(params), eval.data(), coeff.data());
+    }
+
+    void inline ToEval(const uv64& coeff, uv64& eval, const FVParams& params){
+        ftt_fwd(*GetNttContext(params), coeff.data(), eval.data());
+    }
 
     uv64 inline ToCoeff(const uv64& eval, const FVParams& params){
-        if(params.fast_modulli){
-            return ftt_inv_opt(eval);
-        } else {
-            return ftt_inv(eval, params.q, params.logn);
-        }
+        uv64 coeff(params.phim);
+        ToCoeff(eval, coeff, params);
+        return coeff;
     }
 
     uv64 inline ToEval(const uv64& coeff, const FVParams& params){
-        if(params.fast_modulli){
-            return ftt_fwd_opt(coeff);
-        } else {
-            return ftt_fwd(coeff, params.q, params.logn);
-        }
+        uv64 eval(params.phim);
+        ToEval(coeff, eval, params);
+        return eval;
     }
 
+    // In-place transforms of many polynomials at once, spread over the shared
+    // thread pool
+    void ToEvalBatch(std::vector<uv64>& polys, const FVParams& params);
+
+    void ToCoeffBatch(std::vector<uv64>& polys, const FVParams& params);
+
+    // All the rows of mat, like the encoded rows of a preprocessed matrix or
+    // filter, in a single batch
+    void ToEvalBatch(std::vector<std::vector<uv64>>& mat, const FVParams& params);
+
     uv64 NullEncrypt(uv64& pt, const FVParams& params);
 
+    // The encryptions draw their randomness from the calling thread's stream,
+    // or from prng when given. Threads that encrypt concurrently can each
+    // use a fork_prng of one seeded stream for reproducible results.
     Ciphertext Encrypt(const PublicKey& pk, uv64& pt, const FVParams& params);
 
+    Ciphertext Encrypt(const PublicKey& pk, uv64& pt, const FVParams& params,
+            osuCrypto::PRNG& prng);
+
     Ciphertext Encrypt(const SecretKey& sk, uv64& pt, const FVParams& params);
 
+    Ciphertext Encrypt(const SecretKey& sk, uv64& pt, const FVParams& params,
+            osuCrypto::PRNG& prng);
+
+    // Symmetric encryption with a expanded from a fresh seed, which halves
+    // the size of the ciphertexts sent to the server
+    SeededCiphertext EncryptSeeded(const SecretKey& sk, uv64& pt, const FVParams& params);
+
+    SeededCiphertext EncryptSeeded(const SecretKey& sk, uv64& pt, const FVParams& params,
+            osuCrypto::PRNG& prng);
+
+    // Encrypt or EncryptSeeded by the type of ct, for the preprocess
+    // functions that produce either
+    void EncryptInto(Ciphertext& ct, const SecretKey& sk, uv64& pt, const FVParams& params);
+
+    void EncryptInto(SeededCiphertext& ct, const SecretKey& sk, uv64& pt, const FVParams& params);
+
+    // Regenerates a from the seed
+    Ciphertext Expand(const SeededCiphertext& ct, const FVParams& params);
+
     uv64 Decrypt(const SecretKey& sk, const Ciphertext& ct, const FVParams& params);
 
+    std::vector<uv64> Decrypt(const SecretKey& sk, const std::vector<Ciphertext>& ct_vec,
+            const FVParams& params);
+
+    // Bits of the modulus 2^bits that ModSwitch rescales to by default: the
+    // rounding error of the switch stays below a quarter of the decryption
+    // threshold except with negligible probability
+    ui32 ModSwitchBits(const FVParams& params);
+
+    // ct rescaled from q to 2^bits, which cuts its size by the ratio of the
+    // bit lengths. The result decrypts to the same plaintext as long as ct
+    // has a bit of noise margin left. Throws unless n*2^bits is far below q.
+    CompressedCiphertext ModSwitch(const Ciphertext& ct, const ui32 bits, const FVParams& params);
+
+    std::vector<CompressedCiphertext> ModSwitch(const std::vector<Ciphertext>& ct_vec,
+            const ui32 bits, const FVParams& params);
+
+    uv64 Decrypt(const SecretKey& sk, const CompressedCiphertext& ct, const FVParams& params);
+
+    std::vector<uv64> Decrypt(const SecretKey& sk, const std::vector<CompressedCiphertext>& ct_vec,
+            const FVParams& params);
+
     sv64 Noise(const SecretKey& sk, const Ciphertext& ct, const FVParams& params);
 
     double NoiseMargin(const SecretKey& sk, const Ciphertext& ct, const FVParams& params);
 
+    // Keys from the calling thread's stream, or from prng when given
     KeyPair KeyGen(const FVParams& params);
 
+    KeyPair KeyGen(const FVParams& params, osuCrypto::PRNG& prng);
+
     Ciphertext EvalAdd(const Ciphertext& ct1, const Ciphertext& ct2, const FVParams& params);
 
     Ciphertext EvalAddPlain(const Ciphertext& ct, const uv64& pt, const FVParams& params);
@@ -89,25 +198,133 @@ namespace lbcrypto {
 
     Ciphertext EvalMultPlain(const Ciphertext& ct, const uv64& pt, const FVParams& params);
 
+    // In-place versions of the operations above, the result is written to the
+    // first argument
+    void EvalAddInPlace(Ciphertext& ct1, const Ciphertext& ct2, const FVParams& params);
+
+    void EvalSubInPlace(Ciphertext& ct1, const Ciphertext& ct2, const FVParams& params);
+
+    void EvalMultPlainInPlace(Ciphertext& ct, const uv64& pt, const FVParams& params);
+
+    // acc += ct*pt without a temporary ciphertext
+    void EvalMultPlainAccumulate(Ciphertext& acc, const Ciphertext& ct, const uv64& pt,
+            const FVParams& params);
+
+    // Same into 128-bit sums, which are only folded back to 64 bits every
+    // few dozen products, when they could overflow. pt must be reduced mod q.
+    void EvalMultPlainAccumulate(CiphertextAccumulator& acc, const Ciphertext& ct,
+            const uv64& pt, const FVParams& params);
+
+    // Same with pt any phim values in memory, such as a mapped EncMat
+    void EvalMultPlainAccumulate(CiphertextAccumulator& acc, const Ciphertext& ct,
+            const ui64* pt, const FVParams& params);
+
+    // The accumulated sum, reduced mod q
+    Ciphertext Reduce(const CiphertextAccumulator& acc, const FVParams& params);
+
+    std::vector<Ciphertext> Reduce(const std::vector<CiphertextAccumulator>& acc_vec,
+            const FVParams& params);
+
     Ciphertext EvalNegate(const Ciphertext& ct, const FVParams& params);
 
     std::vector<uv64> HoistedDecompose(const Ciphertext& ct, const FVParams& params);
 
+    // Same with the digits carved from arena, or the heap for nullptr, for
+    // the scratch of the online layers
+    std::vector<av64> HoistedDecompose(const Ciphertext& ct, const FVParams& params, Arena* arena);
+
+    // The rows of a HoistedDecompose, whichever allocator they came from
+    class DigitsView {
+    public:
+        template <class Alloc>
+        DigitsView(const std::vector<std::vector<ui64, Alloc>>& digits){
+            for (auto& row: digits) {
+                m_rows.push_back(row.data());
+            }
+        }
+
+        const ui64* operator[](const ui32 i) const { return m_rows[i]; }
+
+    private:
+        std::vector<const ui64*> m_rows;
+    };
+
     Ciphertext KeySwitchDigits(const RelinKey& rk, const Ciphertext& ct,
-            const std::vector<uv64> digits_ct, const FVParams& params);
+            const DigitsView& digits_ct, const FVParams& params);
 
     RelinKey KeySwitchGen(const SecretKey& orig_sk, const SecretKey& new_sk, const FVParams& params);
 
-    Ciphertext KeySwitch(const RelinKey& relin_key, const Ciphertext& ct, const FVParams& params);
-
-    Ciphertext EvalAutomorphismDigits(const ui32 rot, const RelinKey& rk, const Ciphertext& ct,
-            const std::vector<uv64>& digits_ct, const FVParams& params);
+    // Same with the a rows expanded from a fresh seed, for upload to the server
+    SeededRelinKey KeySwitchGenSeeded(const SecretKey& orig_sk, const SecretKey& new_sk,
+            const FVParams& params);
 
-    Ciphertext EvalAutomorphism(const ui32 rot, const Ciphertext& ct, const FVParams& params);
+    RelinKey Expand(const SeededRelinKey& rk, const FVParams& params);
 
-    shared_ptr<RelinKey> GetAutomorphismKey(ui32 rot);
+    Ciphertext KeySwitch(const RelinKey& relin_key, const Ciphertext& ct, const FVParams& params);
 
-    void EvalAutomorphismKeyGen(const SecretKey& sk, const uv32& index_list, const FVParams& params);
+    Ciphertext EvalAutomorphismDigits(const ui32 rot, const RelinKey& rk, const Ciphertext& ct,
+            const DigitsView& digits_ct, const FVParams& params);
+
+    Ciphertext EvalAutomorphismDigits(const ui32 rot, const AutomorphismKeys& keys,
+            const Ciphertext& ct, const DigitsView& digits_ct, const FVParams& params);
+
+    Ciphertext EvalAutomorphism(const ui32 rot, const AutomorphismKeys& keys, const Ciphertext& ct,
+            const FVParams& params);
+
+    // The rotations of ct by every entry of rotations, in the same order, all
+    // from the one decomposition. A rotation of 0 is a copy of ct. With
+    // parallel the rotations are spread over the shared pool, otherwise each
+    // block of slots is computed for every rotation before the next block.
+    std::vector<Ciphertext> EvalAutomorphismDigitsBatch(const uv32& rotations,
+            const AutomorphismKeys& keys, const Ciphertext& ct,
+            const DigitsView& digits_ct, const FVParams& params, const bool parallel = true);
+
+    std::vector<Ciphertext> EvalAutomorphismBatch(const Ciphertext& ct, const uv32& rotations,
+            const AutomorphismKeys& keys, const FVParams& params, const bool parallel = true);
+
+    // Calls f(n, rotation of ct by rotations[n]) in order, computing as many
+    // rotations at once as the shared pool has threads
+    void ForEachAutomorphism(const uv32& rotations, const AutomorphismKeys& keys,
+            const Ciphertext& ct, const DigitsView& digits_ct, const FVParams& params,
+            const std::function<void(ui32, const Ciphertext&)>& f);
+
+    // Throws if keys has no key for rot
+    const RelinKey& GetAutomorphismKey(const AutomorphismKeys& keys, const ui32 rot);
+
+    // The keys for all the rotations are generated together over the shared
+    // pool. With prng they only depend on its state, however many threads
+    // the pool has.
+    AutomorphismKeys EvalAutomorphismKeyGen(const SecretKey& sk, const uv32& index_list,
+            const FVParams& params);
+
+    AutomorphismKeys EvalAutomorphismKeyGen(const SecretKey& sk, const uv32& index_list,
+            const FVParams& params, osuCrypto::PRNG& prng);
+
+    // Called with n and the key for index_list[n] as soon as that key and
+    // all the keys before it are done, one call at a time and in order. It
+    // reports the progress and can send each key while the rest are made.
+    typedef std::function<void(const ui32, const SeededRelinKey&)> KeyGenCallback;
+
+    // Seeded keys for the rotations in index_list, in the same order. The
+    // client keeps none of them.
+    std::vector<SeededRelinKey> EvalAutomorphismKeyGenSeeded(const SecretKey& sk,
+            const uv32& index_list, const FVParams& params,
+            const KeyGenCallback& on_key = nullptr);
+
+    std::vector<SeededRelinKey> EvalAutomorphismKeyGenSeeded(const SecretKey& sk,
+            const uv32& index_list, const FVParams& params, osuCrypto::PRNG& prng,
+            const KeyGenCallback& on_key = nullptr);
+
+    // Expands a received key into keys
+    void AddAutomorphismKey(AutomorphismKeys& keys, const ui32 rot, const SeededRelinKey& rk,
+            const FVParams& params);
+
+    // Bytes held by the expanded keys
+    size_t AutomorphismKeyBytes(const AutomorphismKeys& keys);
+
+    // The term AddRandomNoise adds to b: uniform values mod p in every slot
+    // but the first, encoded without the delta scaling
+    uv64 RandomNoiseMask(const FVParams& params);
 
     Ciphertext AddRandomNoise(const Ciphertext& ct, const FVParams& params);
 
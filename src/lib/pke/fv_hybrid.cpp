@@ -0,0 +1,249 @@
+/*
+ * fv_hybrid.cpp
+ *
+ *	Key switching mod q*P, see fv_hybrid.h. Each polynomial mod q*P is kept
+ *	as its two residues, so all the arithmetic stays in 64-bit words.
+ *
+ */
+
+#include <memory>
+
+#include "math/nbtheory.h"
+#include "math/transfrm.h"
+#include "math/automorph.h"
+#include "math/distributiongenerator.h"
+#include "utils/thread_pool.h"
+#include "pke/fv_hybrid.h"
+
+namespace lbcrypto {
+
+// Shoup companion of w < m, floor(w*2^64/m)
+static inline ui64 shoup(const ui64 w, const ui64 m){
+    return (ui64)(((ui128)w << 64)/m);
+}
+
+// x*w mod m in [0, 2m) for any 64-bit x
+static inline ui64 mul_shoup_lazy(const ui64 x, const ui64 w, const ui64 w_shoup, const ui64 m){
+    ui64 Q = (ui64)(((ui128)w_shoup*x) >> 64);
+    return x*w - Q*m;
+}
+
+static SpecialPrimeContext::Reduction make_reduction(const ui64 m){
+    ui64 one_shoup = shoup(1, m);
+    ui64 wide = -(one_shoup*m);
+    return {m, one_shoup, wide, shoup(wide, m)};
+}
+
+// x mod m for any 64-bit x
+static inline ui64 reduce(const ui64 x, const SpecialPrimeContext::Reduction& red){
+    ui64 r = mul_shoup_lazy(x, 1, red.one_shoup, red.m);
+    return (r >= red.m)? r - red.m: r;
+}
+
+// x mod m for a 128-bit x, m is below 2^62
+static inline ui64 reduce(const ui128 x, const SpecialPrimeContext::Reduction& red){
+    ui64 r = mul_shoup_lazy((ui64)(x >> 64), red.wide, red.wide_shoup, red.m) +
+            mul_shoup_lazy((ui64)x, 1, red.one_shoup, red.m);
+    r = (r >= 2*red.m)? r - 2*red.m: r;
+    return (r >= red.m)? r - red.m: r;
+}
+
+SpecialPrimeContext::SpecialPrimeContext(const ui64 sp, const ui64 z_sp, const ui32 digit_bits,
+        const FVParams& params) :
+        sp(sp), digit_bits(digit_bits),
+        // This works because q is never a power of 2, so the floor is 1 less than size of q
+        num_digits((digit_bits == 0)? 0: 1 + floor(log2(params.q))/digit_bits) {
+    if (sp >= ((ui64)1 << 62) || params.q >= ((ui64)1 << 62)) {
+        throw std::logic_error("Hybrid key switching needs q and P below 2^62");
+    }
+    if (sp == params.q) {
+        throw std::logic_error("The special prime must differ from q");
+    }
+    // The key switching sums are accumulated in 128 bits
+    if (digit_bits == 0 || digit_bits > 62 || num_digits > 16) {
+        throw std::logic_error("Unsupported digit size for hybrid key switching");
+    }
+
+    ntt_sp = std::make_shared<const NttContext>(z_sp, sp, params.logn);
+    sp_mod_q = mod(sp, params.q);
+    sp_inv_mod_q = mod_inv(sp_mod_q, params.q);
+    sp_inv_mod_q_shoup = shoup(sp_inv_mod_q, params.q);
+
+    red_q = make_reduction(params.q);
+    red_sp = make_reduction(sp);
+}
+
+// x mod to, for x given mod from with |x| < from/2
+static inline ui64 lift_centered(const ui64 x, const ui64 from,
+        const SpecialPrimeContext::Reduction& to){
+    if (x > (from >> 1)) {
+        ui64 r = reduce(from - x, to);
+        return (r == 0)? 0: to.m - r;
+    }
+    return reduce(x, to);
+}
+
+// Evaluations mod P of a polynomial with small coefficients given in the
+// evaluation domain mod q, like the secret keys
+static uv64 small_to_sp(const uv64& eval_q, const SpecialPrimeContext& sp_ctx,
+        const FVParams& params){
+    auto x = ToCoeff(eval_q, params);
+    for (ui32 n = 0; n < params.phim; n++) {
+        x[n] = lift_centered(x[n], params.q, sp_ctx.red_sp);
+    }
+    ftt_fwd(*sp_ctx.ntt_sp, x.data(), x.data());
+    return x;
+}
+
+// Replaces each x given by its residues x_q and x_sp with (x - [x]_P)/P mod q,
+// the rounding of x/P. Both inputs are in the evaluation domain.
+static void mod_down(std::vector<uv64*> x_q, std::vector<uv64*> x_sp,
+        const SpecialPrimeContext& sp_ctx, const FVParams& params){
+    std::vector<ui64*> ptrs;
+    for (auto x: x_sp) {
+        ptrs.push_back(x->data());
+    }
+    ftt_inv_batch(*sp_ctx.ntt_sp, ptrs.data(), ptrs.size(), &get_thread_pool());
+
+    for (auto x: x_sp) {
+        for (ui32 n = 0; n < params.phim; n++) {
+            (*x)[n] = lift_centered((*x)[n], sp_ctx.sp, sp_ctx.red_q);
+        }
+    }
+    ftt_fwd_batch(*GetNttContext(params), ptrs.data(), ptrs.size(), &get_thread_pool());
+
+    const ui64 q = params.q;
+    for (ui32 i = 0; i < x_q.size(); i++) {
+        auto& xq = *x_q[i];
+        const auto& xp = *x_sp[i];
+        for (ui32 n = 0; n < params.phim; n++) {
+            ui64 r = mul_shoup_lazy(xq[n] + q - xp[n], sp_ctx.sp_inv_mod_q,
+                    sp_ctx.sp_inv_mod_q_shoup, q);
+            xq[n] = (r >= q)? r - q: r;
+        }
+    }
+}
+
+HybridRelinKey HybridKeySwitchGen(const SecretKey& orig_sk, const SecretKey& new_sk,
+        const SpecialPrimeContext& sp_ctx, const FVParams& params){
+    const ui64 q = params.q;
+    const ui64 sp = sp_ctx.sp;
+    auto new_s_sp = small_to_sp(new_sk.s, sp_ctx, params);
+
+    HybridRelinKey rk(params.phim, sp_ctx.num_digits);
+    for (ui32 i = 0; i < sp_ctx.num_digits; i++) {
+        rk.a_q[i] = get_dug_vector(params.phim, q);
+        rk.a_sp[i] = get_dug_vector(params.phim, sp);
+
+        // The same error in both residues
+        auto e = params.dgg->GenerateVector(params.phim, q);
+        for (ui32 n = 0; n < params.phim; n++) {
+            rk.b_sp[i][n] = lift_centered(e[n], q, sp_ctx.red_sp);
+        }
+        ftt_fwd(*sp_ctx.ntt_sp, rk.b_sp[i].data(), rk.b_sp[i].data());
+        rk.b_q[i] = ToEval(e, params);
+
+        // P*2^(i*digit_bits)*orig_s vanishes mod P
+        ui64 gadget = mod_mul(sp_ctx.sp_mod_q, mod_exp(2, i*sp_ctx.digit_bits, q), q);
+        for (ui32 j = 0; j < params.phim; j++) {
+            ui64 b = mod(rk.b_q[i][j] + mod_mul(gadget, orig_sk.s[j], q), q);
+            rk.b_q[i][j] = mod(b + q - mod_mul(rk.a_q[i][j], new_sk.s[j], q), q);
+            rk.b_sp[i][j] = mod(rk.b_sp[i][j] + sp - mod_mul(rk.a_sp[i][j], new_s_sp[j], sp), sp);
+        }
+    }
+
+    return rk;
+}
+
+HybridDigits HybridDecompose(const Ciphertext& ct, const SpecialPrimeContext& sp_ctx,
+        const FVParams& params){
+    auto ct_a_coeff = ToCoeff(ct.a, params);
+
+    HybridDigits digits_ct;
+    digits_ct.q = base_decompose(ct_a_coeff, sp_ctx.digit_bits, sp_ctx.num_digits);
+    digits_ct.sp = digits_ct.q;
+
+    ToEvalBatch(digits_ct.q, params);
+    std::vector<ui64*> ptrs;
+    for (auto& digit: digits_ct.sp) {
+        ptrs.push_back(digit.data());
+    }
+    ftt_fwd_batch(*sp_ctx.ntt_sp, ptrs.data(), ptrs.size(), &get_thread_pool());
+
+    return digits_ct;
+}
+
+// Key switching sum mod q*P followed by the scaling by P. When perm is given
+// the digits and ct.b are read through it, which applies an automorphism.
+static Ciphertext hybrid_key_switch_sum(const HybridRelinKey& rk, const Ciphertext& ct,
+        const HybridDigits& digits_ct, const uv32* perm,
+        const SpecialPrimeContext& sp_ctx, const FVParams& params){
+    uv128 acc_a_q(params.phim), acc_b_q(params.phim);
+    uv128 acc_a_sp(params.phim), acc_b_sp(params.phim);
+    for (ui32 i = 0; i < sp_ctx.num_digits; i++) {
+        const auto& digit_q = digits_ct.q[i];
+        const auto& digit_sp = digits_ct.sp[i];
+        for (ui32 j = 0; j < params.phim; j++) {
+            ui32 k = perm? (*perm)[j]: j;
+            ui128 d_q = digit_q[k];
+            ui128 d_sp = digit_sp[k];
+            acc_a_q[j] += d_q*rk.a_q[i][j];
+            acc_b_q[j] += d_q*rk.b_q[i][j];
+            acc_a_sp[j] += d_sp*rk.a_sp[i][j];
+            acc_b_sp[j] += d_sp*rk.b_sp[i][j];
+        }
+    }
+
+    uv64 a_q(params.phim), b_q(params.phim), a_sp(params.phim), b_sp(params.phim);
+    for (ui32 j = 0; j < params.phim; j++) {
+        a_q[j] = reduce(acc_a_q[j], sp_ctx.red_q);
+        b_q[j] = reduce(acc_b_q[j], sp_ctx.red_q);
+        a_sp[j] = reduce(acc_a_sp[j], sp_ctx.red_sp);
+        b_sp[j] = reduce(acc_b_sp[j], sp_ctx.red_sp);
+    }
+    mod_down({&a_q, &b_q}, {&a_sp, &b_sp}, sp_ctx, params);
+
+    Ciphertext ct_new(params.phim);
+    ct_new.a = std::move(a_q);
+    for (ui32 j = 0; j < params.phim; j++) {
+        ui32 k = perm? (*perm)[j]: j;
+        ct_new.b[j] = reduce(ct.b[k] + b_q[j], sp_ctx.red_q);
+    }
+
+    return ct_new;
+}
+
+Ciphertext HybridKeySwitchDigits(const HybridRelinKey& rk, const Ciphertext& ct,
+        const HybridDigits& digits_ct, const SpecialPrimeContext& sp_ctx,
+        const FVParams& params){
+    return hybrid_key_switch_sum(rk, ct, digits_ct, nullptr, sp_ctx, params);
+}
+
+Ciphertext HybridKeySwitch(const HybridRelinKey& rk, const Ciphertext& ct,
+        const SpecialPrimeContext& sp_ctx, const FVParams& params){
+    auto digits_ct = HybridDecompose(ct, sp_ctx, params);
+    return HybridKeySwitchDigits(rk, ct, digits_ct, sp_ctx, params);
+}
+
+HybridRelinKey HybridAutomorphismKeyGen(const SecretKey& sk, const ui32 rot,
+        const SpecialPrimeContext& sp_ctx, const FVParams& params){
+    SecretKey sk_rot(params.phim);
+    sk_rot.s = automorph(sk.s, rot, *GetAutomorphContext(params));
+    return HybridKeySwitchGen(sk_rot, sk, sp_ctx, params);
+}
+
+Ciphertext HybridEvalAutomorphismDigits(const ui32 rot, const HybridRelinKey& rk,
+        const Ciphertext& ct, const HybridDigits& digits_ct,
+        const SpecialPrimeContext& sp_ctx, const FVParams& params){
+    auto automorph_ctx = GetAutomorphContext(params);
+    const auto& perm = automorph_ctx->eval_permutation(rot);
+    return hybrid_key_switch_sum(rk, ct, digits_ct, &perm, sp_ctx, params);
+}
+
+Ciphertext HybridEvalAutomorphism(const ui32 rot, const HybridRelinKey& rk,
+        const Ciphertext& ct, const SpecialPrimeContext& sp_ctx, const FVParams& params){
+    auto digits_ct = HybridDecompose(ct, sp_ctx, params);
+    return HybridEvalAutomorphismDigits(rot, rk, ct, digits_ct, sp_ctx, params);
+}
+
+}  // namespace lbcrypto ends
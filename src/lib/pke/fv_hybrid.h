@@ -0,0 +1,100 @@
+/*
+ * fv_hybrid.h
+ *
+ *	Hybrid key switching for FV. The key switching keys are generated mod
+ *	q*P for an auxiliary special prime P, and the key switching result is
+ *	scaled back down by P. This divides the key switching noise by P, so
+ *	ct.a can be split into a few large digits (or none at all) instead of
+ *	many window_size digits. Fewer digits means fewer transforms per
+ *	decomposition, fewer multiply-accumulates per rotation and smaller keys.
+ *
+ *	This is an API of its own: the layers, the key store and the demos still
+ *	switch keys with the RelinKeys of fv.h.
+ *
+ */
+
+#ifndef LBCRYPTO_CRYPTO_FV_HYBRID_H
+#define LBCRYPTO_CRYPTO_FV_HYBRID_H
+
+#include <memory>
+using std::shared_ptr;
+
+#include "utils/backend.h"
+#include "math/transfrm.h"
+#include "pke/fv.h"
+#include "pke_types.h"
+
+namespace lbcrypto {
+
+    /**
+    * @brief Tables for the special prime P. Immutable once built.
+    *
+    * The keys live mod q*P, which must still be a secure modulus for the
+    * ring dimension. The added noise is about 2^digit_bits*sqrt(phim)/P per
+    * digit, so P should be at least as large as the digits.
+    */
+    struct SpecialPrimeContext {
+        // q and sp must be below 2^62, sp a prime that is 1 mod 2*phim and z_sp a
+        // primitive 2*phim-th root of unity mod sp. Use digit_bits of at
+        // least log2(q) for a single digit.
+        SpecialPrimeContext(const ui64 sp, const ui64 z_sp, const ui32 digit_bits,
+                const FVParams& params);
+
+        const ui64 sp;
+        const ui32 digit_bits;
+        const ui32 num_digits;
+
+        shared_ptr<const NttContext> ntt_sp;
+
+        // P mod q, P^-1 mod q
+        ui64 sp_mod_q, sp_inv_mod_q, sp_inv_mod_q_shoup;
+
+        // Constants to reduce 64 and 128-bit values mod m without a division:
+        // floor(2^64/m), 2^64 mod m and its Shoup companion
+        struct Reduction {
+            ui64 m, one_shoup, wide, wide_shoup;
+        };
+        Reduction red_q, red_sp;
+    };
+
+    // Indexed by digit, every polynomial is kept mod q and mod P
+    struct HybridRelinKey {
+        std::vector<uv64> a_q, b_q;
+        std::vector<uv64> a_sp, b_sp;
+
+        HybridRelinKey(ui32 size, ui32 digits) :
+            a_q(digits, uv64(size)), b_q(digits, uv64(size)),
+            a_sp(digits, uv64(size)), b_sp(digits, uv64(size)) {};
+    };
+
+    // Digits of ct.a in the evaluation domain mod q and mod P
+    struct HybridDigits {
+        std::vector<uv64> q;
+        std::vector<uv64> sp;
+    };
+
+    HybridRelinKey HybridKeySwitchGen(const SecretKey& orig_sk, const SecretKey& new_sk,
+            const SpecialPrimeContext& sp_ctx, const FVParams& params);
+
+    HybridDigits HybridDecompose(const Ciphertext& ct, const SpecialPrimeContext& sp_ctx,
+            const FVParams& params);
+
+    Ciphertext HybridKeySwitchDigits(const HybridRelinKey& rk, const Ciphertext& ct,
+            const HybridDigits& digits_ct, const SpecialPrimeContext& sp_ctx,
+            const FVParams& params);
+
+    Ciphertext HybridKeySwitch(const HybridRelinKey& rk, const Ciphertext& ct,
+            const SpecialPrimeContext& sp_ctx, const FVParams& params);
+
+    HybridRelinKey HybridAutomorphismKeyGen(const SecretKey& sk, const ui32 rot,
+            const SpecialPrimeContext& sp_ctx, const FVParams& params);
+
+    Ciphertext HybridEvalAutomorphismDigits(const ui32 rot, const HybridRelinKey& rk,
+            const Ciphertext& ct, const HybridDigits& digits_ct,
+            const SpecialPrimeContext& sp_ctx, const FVParams& params);
+
+    Ciphertext HybridEvalAutomorphism(const ui32 rot, const HybridRelinKey& rk,
+            const Ciphertext& ct, const SpecialPrimeContext& sp_ctx, const FVParams& params);
+
+} // namespace lbcrypto ends
+#endif
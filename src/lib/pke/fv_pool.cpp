@@ -0,0 +1,144 @@
+/*
+ * fv_pool.cpp
+ *
+ *	Encryption randomness pool, see fv_pool.h.
+ *
+ */
+
+#include "pke/fv_pool.h"
+
+namespace lbcrypto {
+
+EncryptionPool::EncryptionPool(const SecretKey& sk, const FVParams& params, const ui32 depth) :
+        m_params(params), m_depth(depth), m_zeros(depth, Ciphertext(0)), m_masks(depth, uv64()) {
+    m_make_zero = [sk, params](){
+        uv64 zero(params.phim);
+        return Encrypt(sk, zero, params);
+    };
+    start();
+}
+
+EncryptionPool::EncryptionPool(const PublicKey& pk, const FVParams& params, const ui32 depth) :
+        m_params(params), m_depth(depth), m_zeros(depth, Ciphertext(0)), m_masks(depth, uv64()) {
+    m_make_zero = [pk, params](){
+        uv64 zero(params.phim);
+        return Encrypt(pk, zero, params);
+    };
+    start();
+}
+
+EncryptionPool::EncryptionPool(const FVParams& params, const ui32 depth) :
+        m_params(params), m_depth(depth), m_zeros(0, Ciphertext(0)), m_masks(depth, uv64()) {
+    start();
+}
+
+void EncryptionPool::start() {
+    m_stop = false;
+    m_zero_hits = 0;
+    m_zero_misses = 0;
+    m_mask_hits = 0;
+    m_mask_misses = 0;
+    if (m_depth > 0) {
+        m_producer = std::thread(&EncryptionPool::producer_loop, this);
+    }
+}
+
+EncryptionPool::~EncryptionPool() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_cv.notify_all();
+    if (m_producer.joinable()) {
+        m_producer.join();
+    }
+}
+
+void EncryptionPool::producer_loop() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true) {
+        m_cv.wait(lock, [this](){
+            return m_stop || (m_make_zero && !m_zeros.full()) || !m_masks.full();
+        });
+        if (m_stop) {
+            return;
+        }
+
+        // Refill the emptier buffer first, the work is done unlocked
+        bool zero = m_make_zero && !m_zeros.full() &&
+                (m_masks.full() || m_zeros.size() <= m_masks.size());
+        lock.unlock();
+        if (zero) {
+            auto ct = m_make_zero();
+            lock.lock();
+            m_zeros.push(std::move(ct));
+        } else {
+            auto mask = RandomNoiseMask(m_params);
+            lock.lock();
+            m_masks.push(std::move(mask));
+        }
+    }
+}
+
+Ciphertext EncryptionPool::TakeZero() {
+    if (!m_make_zero) {
+        throw std::logic_error("The pool has no key to encrypt with");
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_zeros.empty()) {
+            auto ct = m_zeros.pop();
+            m_zero_hits++;
+            m_cv.notify_one();
+            return ct;
+        }
+    }
+    m_zero_misses++;
+    return m_make_zero();
+}
+
+uv64 EncryptionPool::TakeMask() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_masks.empty()) {
+            auto mask = m_masks.pop();
+            m_mask_hits++;
+            m_cv.notify_one();
+            return mask;
+        }
+    }
+    m_mask_misses++;
+    return RandomNoiseMask(m_params);
+}
+
+PoolStats EncryptionPool::Stats() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return {m_zero_hits, m_zero_misses, m_mask_hits, m_mask_misses,
+            m_zeros.size(), m_masks.size()};
+}
+
+// Enc(0) + (0, delta*pt) has the distribution of a fresh encryption of pt
+Ciphertext Encrypt(EncryptionPool& pool, uv64& pt, const FVParams& params){
+    auto ct = pool.TakeZero();
+
+    uv64 pt_scaled(params.phim);
+    for(ui32 i=0; i<params.phim; i++){
+        pt_scaled[i] = pt[i]*params.delta;
+    }
+    ToEval(pt_scaled, pt_scaled, params);
+    for(ui32 i=0; i<params.phim; i++){
+        ui64 sum = ct.b[i] + pt_scaled[i];
+        ct.b[i] = (sum >= params.q)? sum - params.q: sum;
+    }
+
+    return ct;
+}
+
+Ciphertext AddRandomNoise(const Ciphertext& ct, EncryptionPool& pool, const FVParams& params){
+    Ciphertext random_ct(params.phim);
+    random_ct.b = pool.TakeMask();
+
+    return EvalAdd(ct, random_ct, params);
+}
+
+}  // namespace lbcrypto ends
@@ -0,0 +1,114 @@
+/*
+ * fv_pool.h
+ *
+ *	Precomputed encryption randomness. A background thread keeps ring
+ *	buffers of encryptions of zero and of AddRandomNoise masks filled, so
+ *	the online Encrypt only adds the encoded plaintext to a zero encryption
+ *	and AddRandomNoise is a single addition. When a buffer runs dry the item
+ *	is computed inline and counted as a miss.
+ *
+ */
+
+#ifndef LBCRYPTO_CRYPTO_FV_POOL_H
+#define LBCRYPTO_CRYPTO_FV_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include "utils/backend.h"
+#include "pke/fv.h"
+#include "pke_types.h"
+
+namespace lbcrypto {
+
+    // Fixed capacity FIFO over slots initialized to empty
+    template <class T>
+    class RingBuffer {
+    public:
+        RingBuffer(const ui32 capacity, const T& empty) :
+            m_slots(capacity, empty), m_head(0), m_size(0) {};
+
+        ui32 size() const { return m_size; }
+        bool empty() const { return m_size == 0; }
+        bool full() const { return m_size == m_slots.size(); }
+
+        void push(T&& x) {
+            m_slots[(m_head + m_size) % m_slots.size()] = std::move(x);
+            m_size++;
+        }
+
+        T pop() {
+            T x = std::move(m_slots[m_head]);
+            m_head = (m_head + 1) % m_slots.size();
+            m_size--;
+            return x;
+        }
+
+    private:
+        std::vector<T> m_slots;
+        ui32 m_head, m_size;
+    };
+
+    struct PoolStats {
+        ui64 zero_hits, zero_misses;
+        ui64 mask_hits, mask_misses;
+
+        // Items ready at the time of the call
+        ui32 zeros_ready, masks_ready;
+    };
+
+    class EncryptionPool {
+    public:
+        // Zero encryptions under sk or pk and noise masks, depth of each
+        EncryptionPool(const SecretKey& sk, const FVParams& params, const ui32 depth);
+        EncryptionPool(const PublicKey& pk, const FVParams& params, const ui32 depth);
+
+        // Noise masks only, for the server
+        EncryptionPool(const FVParams& params, const ui32 depth);
+
+        ~EncryptionPool();
+
+        EncryptionPool(const EncryptionPool&) = delete;
+        EncryptionPool& operator=(const EncryptionPool&) = delete;
+
+        // An encryption of zero, throws if the pool has no key
+        Ciphertext TakeZero();
+
+        // A mask in the form returned by RandomNoiseMask
+        uv64 TakeMask();
+
+        PoolStats Stats() const;
+
+        ui32 Depth() const { return m_depth; }
+
+        const FVParams& Params() const { return m_params; }
+
+    private:
+        void start();
+        void producer_loop();
+
+        const FVParams m_params;
+        const ui32 m_depth;
+        std::function<Ciphertext()> m_make_zero;
+
+        RingBuffer<Ciphertext> m_zeros;
+        RingBuffer<uv64> m_masks;
+        mutable std::mutex m_mutex;
+        std::condition_variable m_cv;
+        bool m_stop;
+        std::thread m_producer;
+
+        std::atomic<ui64> m_zero_hits, m_zero_misses;
+        std::atomic<ui64> m_mask_hits, m_mask_misses;
+    };
+
+    // Encrypt and AddRandomNoise with the randomness taken from the pool
+    Ciphertext Encrypt(EncryptionPool& pool, uv64& pt, const FVParams& params);
+
+    Ciphertext AddRandomNoise(const Ciphertext& ct, EncryptionPool& pool, const FVParams& params);
+
+} // namespace lbcrypto ends
+#endif
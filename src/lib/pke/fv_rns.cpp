@@ -0,0 +1,438 @@
+/*
+ * fv_rns.cpp
+ *
+ *	Decryption uses the scaling of Halevi, Polyakov and Shoup, with the
+ *	fractional parts of p*(q/q_i)^-1/q_i kept in 128-bit fixed point so the
+ *	rounding is exact for all practical chain lengths.
+ *
+ */
+
+#include <memory>
+
+#include "math/nbtheory.h"
+#include "math/transfrm.h"
+#include "math/automorph.h"
+#include "math/distributiongenerator.h"
+#include "pke/fv_rns.h"
+
+namespace lbcrypto {
+
+// One transform per limb, after checking the chain
+static std::vector<shared_ptr<const NttContext>> make_limb_ntt(const uv64& rootsOfUnity,
+        const uv64& moduliiChain, const ui32 logn){
+    ui32 numModulii = moduliiChain.size();
+    if (rootsOfUnity.size() != numModulii) {
+        throw std::logic_error("size of root of unity and size of moduli chain not of same size");
+    }
+    if (numModulii == 0) {
+        throw std::logic_error("RNS moduli chain is empty");
+    }
+
+    std::vector<shared_ptr<const NttContext>> ntt;
+    for (ui32 i = 0; i < numModulii; i++) {
+        if (moduliiChain[i] >= ((ui64)1 << 62)) {
+            throw std::logic_error("RNS moduli must be below 2^62");
+        }
+        ntt.push_back(std::make_shared<const NttContext>(rootsOfUnity[i], moduliiChain[i], logn));
+    }
+    return ntt;
+}
+
+RNSContext::RNSContext(const uv64& rootsOfUnity, const uv64& moduliiChain,
+        const ui64 p, const ui32 logn) :
+        moduli(moduliiChain), p(p), logn(logn), phim(1 << logn),
+        ntt(make_limb_ntt(rootsOfUnity, moduliiChain, logn)),
+        automorph(std::make_shared<const AutomorphContext>(1 << logn)) {
+    ui32 numModulii = moduli.size();
+
+    // q as little endian 64-bit words, to get floor(q/p) by long division
+    uv64 q_words(1, 1);
+    for (ui32 i = 0; i < numModulii; i++) {
+        ui64 carry = 0;
+        for (ui32 w = 0; w < q_words.size(); w++) {
+            ui128 prod = (ui128)q_words[w]*moduli[i] + carry;
+            q_words[w] = (ui64)prod;
+            carry = (ui64)(prod >> 64);
+        }
+        if (carry != 0) {
+            q_words.push_back(carry);
+        }
+    }
+
+    uv64 delta_words(q_words.size());
+    ui64 rem = 0;
+    for (ui32 w = q_words.size(); w-- > 0;) {
+        ui128 cur = ((ui128)rem << 64) | q_words[w];
+        delta_words[w] = (ui64)(cur / p);
+        rem = (ui64)(cur % p);
+    }
+
+    delta.resize(numModulii);
+    q_hat_inv.resize(numModulii);
+    p_q_hat_inv_int.resize(numModulii);
+    p_q_hat_inv_frac_hi.resize(numModulii);
+    p_q_hat_inv_frac_lo.resize(numModulii);
+    for (ui32 i = 0; i < numModulii; i++) {
+        ui64 qi = moduli[i];
+
+        ui64 d = 0;
+        for (ui32 w = delta_words.size(); w-- > 0;) {
+            d = mod(((ui128)d << 64) | delta_words[w], qi);
+        }
+        delta[i] = d;
+
+        ui64 q_hat = 1;
+        for (ui32 j = 0; j < numModulii; j++) {
+            if (j != i) {
+                q_hat = mod_mul(q_hat, mod(moduli[j], qi), qi);
+            }
+        }
+        q_hat_inv[i] = mod_inv(q_hat, qi);
+
+        ui128 num = (ui128)p*q_hat_inv[i];
+        p_q_hat_inv_int[i] = mod(num/qi, p);
+        ui64 r = (ui64)(num % qi);
+        ui128 hi = ((ui128)r << 64);
+        p_q_hat_inv_frac_hi[i] = (ui64)(hi/qi);
+        ui128 lo = ((ui128)(ui64)(hi % qi) << 64);
+        p_q_hat_inv_frac_lo[i] = (ui64)(lo/qi);
+    }
+}
+
+ui32 RNSLimbWindows(const RNSParams& params){
+    ui64 q_max = 0;
+    for (auto qi: params.ctx->moduli) {
+        q_max = std::max(q_max, qi);
+    }
+    // This works because q_i is never a power of 2, so the floor is 1 less than size of q_i
+    return 1 + floor(log2(q_max))/params.window_size;
+}
+
+// Residues of a vector of small signed values given mod modulus
+static std::vector<uv64> lift_small(const uv64& v, const ui64 modulus, const RNSContext& ctx){
+    std::vector<uv64> limbs(ctx.num_limbs(), uv64(ctx.phim));
+    for (ui32 i = 0; i < ctx.num_limbs(); i++) {
+        for (ui32 n = 0; n < ctx.phim; n++) {
+            limbs[i][n] = (v[n] > (modulus >> 1)) ? ctx.moduli[i] - (modulus - v[n]) : v[n];
+        }
+    }
+    return limbs;
+}
+
+static void to_eval(std::vector<uv64>& x, const RNSContext& ctx){
+    for (ui32 i = 0; i < ctx.num_limbs(); i++) {
+        ftt_fwd(*ctx.ntt[i], x[i].data(), x[i].data());
+    }
+}
+
+static std::vector<uv64> sample_error(const RNSParams& params){
+    const auto& ctx = *params.ctx;
+    return lift_small(params.dgg->GenerateVector(ctx.phim, ctx.moduli[0]), ctx.moduli[0], ctx);
+}
+
+static std::vector<uv64> sample_secret(const RNSParams& params){
+    const auto& ctx = *params.ctx;
+    //Supports both discrete Gaussian (RLWE) and ternary uniform distribution (OPTIMIZED) cases
+    if (params.mode == RLWE) {
+        return sample_error(params);
+    }
+    return lift_small(get_tug_vector(ctx.phim, ctx.moduli[0]), ctx.moduli[0], ctx);
+}
+
+std::vector<uv64> NullEncrypt(const uv64& pt, const RNSParams& params){
+    const auto& ctx = *params.ctx;
+    std::vector<uv64> pt_eval(ctx.num_limbs(), uv64(ctx.phim));
+    for (ui32 i = 0; i < ctx.num_limbs(); i++) {
+        for (ui32 n = 0; n < ctx.phim; n++) {
+            pt_eval[i][n] = mod(pt[n], ctx.moduli[i]);
+        }
+    }
+    to_eval(pt_eval, ctx);
+    return pt_eval;
+}
+
+RNSKeyPair KeyGen(const RNSParams& params){
+    const auto& ctx = *params.ctx;
+    RNSSecretKey sk(ctx.phim, ctx.num_limbs());
+    sk.s = sample_secret(params);
+    to_eval(sk.s, ctx);
+
+    RNSPublicKey pk(ctx.phim, ctx.num_limbs());
+    pk.b = sample_error(params);
+    to_eval(pk.b, ctx);
+    for (ui32 i = 0; i < ctx.num_limbs(); i++) {
+        ui64 qi = ctx.moduli[i];
+        pk.a[i] = get_dug_vector(ctx.phim, qi);
+        for (ui32 n = 0; n < ctx.phim; n++) {
+            auto prod = mod_mul(pk.a[i][n], sk.s[i][n], qi);
+            pk.b[i][n] = mod(pk.b[i][n] + qi - prod, qi);
+        }
+    }
+
+    return RNSKeyPair(pk, sk);
+}
+
+// e + floor(q/p)*pt in every limb, in the evaluation domain
+static std::vector<uv64> encode_scaled(const uv64& pt, const RNSParams& params){
+    const auto& ctx = *params.ctx;
+    auto e = sample_error(params);
+    for (ui32 i = 0; i < ctx.num_limbs(); i++) {
+        ui64 qi = ctx.moduli[i];
+        for (ui32 n = 0; n < ctx.phim; n++) {
+            e[i][n] = mod(e[i][n] + mod_mul(pt[n], ctx.delta[i], qi), qi);
+        }
+    }
+    to_eval(e, ctx);
+    return e;
+}
+
+RNSCiphertext Encrypt(const RNSPublicKey& pk, const uv64& pt, const RNSParams& params){
+    const auto& ctx = *params.ctx;
+    auto u = sample_secret(params);
+    to_eval(u, ctx);
+
+    auto ea = sample_error(params);
+    to_eval(ea, ctx);
+
+    RNSCiphertext ct(ctx.phim, ctx.num_limbs());
+    ct.b = encode_scaled(pt, params);
+    for (ui32 i = 0; i < ctx.num_limbs(); i++) {
+        ui64 qi = ctx.moduli[i];
+        for (ui32 n = 0; n < ctx.phim; n++) {
+            ct.a[i][n] = mod(mod_mul(pk.a[i][n], u[i][n], qi) + ea[i][n], qi);
+            ct.b[i][n] = mod(mod_mul(pk.b[i][n], u[i][n], qi) + ct.b[i][n], qi);
+        }
+    }
+
+    return ct;
+}
+
+RNSCiphertext Encrypt(const RNSSecretKey& sk, const uv64& pt, const RNSParams& params){
+    const auto& ctx = *params.ctx;
+    RNSCiphertext ct(ctx.phim, ctx.num_limbs());
+    ct.b = encode_scaled(pt, params);
+    for (ui32 i = 0; i < ctx.num_limbs(); i++) {
+        ui64 qi = ctx.moduli[i];
+        ct.a[i] = get_dug_vector(ctx.phim, qi);
+        for (ui32 n = 0; n < ctx.phim; n++) {
+            auto prod = mod_mul(ct.a[i][n], sk.s[i][n], qi);
+            ct.b[i][n] = mod(ct.b[i][n] + qi - prod, qi);
+        }
+    }
+
+    return ct;
+}
+
+uv64 Decrypt(const RNSSecretKey& sk, const RNSCiphertext& ct, const RNSParams& params){
+    const auto& ctx = *params.ctx;
+    std::vector<uv64> x(ctx.num_limbs(), uv64(ctx.phim));
+    for (ui32 i = 0; i < ctx.num_limbs(); i++) {
+        ui64 qi = ctx.moduli[i];
+        for (ui32 n = 0; n < ctx.phim; n++) {
+            x[i][n] = mod_mul(ct.a[i][n], sk.s[i][n], qi) + ct.b[i][n];
+        }
+        ftt_inv(*ctx.ntt[i], x[i].data(), x[i].data());
+    }
+
+    // round(p/q*x) = sum_i x_i*p*(q/q_i)^-1/q_i mod p
+    uv64 pt(ctx.phim);
+    for (ui32 n = 0; n < ctx.phim; n++) {
+        // Integer parts mod p, and the fractional parts in 64.64 fixed point
+        // with the words summed separately
+        ui128 int_part = 0;
+        ui128 frac_int = 0, frac_lo = 0;
+        for (ui32 i = 0; i < ctx.num_limbs(); i++) {
+            int_part += mod((ui128)x[i][n]*ctx.p_q_hat_inv_int[i], ctx.p);
+            ui128 frac = (ui128)x[i][n]*ctx.p_q_hat_inv_frac_hi[i] +
+                    (((ui128)x[i][n]*ctx.p_q_hat_inv_frac_lo[i]) >> 64);
+            frac_int += (frac >> 64);
+            frac_lo += (ui64)frac;
+        }
+        ui128 rounded = frac_int + ((frac_lo + ((ui128)1 << 63)) >> 64);
+        pt[n] = mod(int_part + rounded, ctx.p);
+    }
+
+    return pt;
+}
+
+RNSCiphertext EvalAdd(const RNSCiphertext& ct1, const RNSCiphertext& ct2, const RNSParams& params){
+    const auto& ctx = *params.ctx;
+    RNSCiphertext sum(ctx.phim, ctx.num_limbs());
+    for (ui32 i = 0; i < ctx.num_limbs(); i++) {
+        ui64 qi = ctx.moduli[i];
+        for (ui32 n = 0; n < ctx.phim; n++) {
+            sum.a[i][n] = mod(ct1.a[i][n] + ct2.a[i][n], qi);
+            sum.b[i][n] = mod(ct1.b[i][n] + ct2.b[i][n], qi);
+        }
+    }
+    return sum;
+}
+
+RNSCiphertext EvalSub(const RNSCiphertext& ct1, const RNSCiphertext& ct2, const RNSParams& params){
+    const auto& ctx = *params.ctx;
+    RNSCiphertext diff(ctx.phim, ctx.num_limbs());
+    for (ui32 i = 0; i < ctx.num_limbs(); i++) {
+        ui64 qi = ctx.moduli[i];
+        for (ui32 n = 0; n < ctx.phim; n++) {
+            diff.a[i][n] = mod(ct1.a[i][n] + qi - ct2.a[i][n], qi);
+            diff.b[i][n] = mod(ct1.b[i][n] + qi - ct2.b[i][n], qi);
+        }
+    }
+    return diff;
+}
+
+RNSCiphertext EvalMultPlain(const RNSCiphertext& ct, const std::vector<uv64>& pt,
+        const RNSParams& params){
+    const auto& ctx = *params.ctx;
+    RNSCiphertext prod(ctx.phim, ctx.num_limbs());
+    for (ui32 i = 0; i < ctx.num_limbs(); i++) {
+        ui64 qi = ctx.moduli[i];
+        for (ui32 n = 0; n < ctx.phim; n++) {
+            prod.a[i][n] = mod_mul(ct.a[i][n], pt[i][n], qi);
+            prod.b[i][n] = mod_mul(ct.b[i][n], pt[i][n], qi);
+        }
+    }
+    return prod;
+}
+
+std::vector<std::vector<uv64>> HoistedDecompose(const RNSCiphertext& ct, const RNSParams& params){
+    const auto& ctx = *params.ctx;
+    ui32 limb_windows = RNSLimbWindows(params);
+
+    // The digits are below 2^window_size, so they are their own residue in
+    // every limb
+    std::vector<std::vector<uv64>> digits_ct;
+    digits_ct.reserve(ctx.num_limbs()*limb_windows);
+    uv64 ct_a_coeff(ctx.phim);
+    for (ui32 i = 0; i < ctx.num_limbs(); i++) {
+        ftt_inv(*ctx.ntt[i], ct.a[i].data(), ct_a_coeff.data());
+        auto digits = base_decompose(ct_a_coeff, params.window_size, limb_windows);
+        for (ui32 w = 0; w < limb_windows; w++) {
+            std::vector<uv64> digit(ctx.num_limbs(), digits[w]);
+            to_eval(digit, ctx);
+            digits_ct.push_back(std::move(digit));
+        }
+    }
+
+    return digits_ct;
+}
+
+RNSRelinKey KeySwitchGen(const RNSSecretKey& orig_sk, const RNSSecretKey& new_sk,
+        const RNSParams& params){
+    const auto& ctx = *params.ctx;
+    ui32 limb_windows = RNSLimbWindows(params);
+
+    // Digit (l, w) carries orig_s*2^(w*window_size)*(q/q_l)*((q/q_l)^-1 mod q_l),
+    // which is orig_s*2^(w*window_size) mod q_l and 0 in the other limbs
+    RNSRelinKey rk(ctx.phim, ctx.num_limbs(), ctx.num_limbs()*limb_windows);
+    for (ui32 l = 0; l < ctx.num_limbs(); l++) {
+        for (ui32 w = 0; w < limb_windows; w++) {
+            ui32 d = l*limb_windows + w;
+            rk.b[d] = sample_error(params);
+            to_eval(rk.b[d], ctx);
+
+            for (ui32 i = 0; i < ctx.num_limbs(); i++) {
+                ui64 qi = ctx.moduli[i];
+                rk.a[d][i] = get_dug_vector(ctx.phim, qi);
+                ui64 gadget = mod((ui64)1 << (w*params.window_size), qi);
+                for (ui32 n = 0; n < ctx.phim; n++) {
+                    if (i == l) {
+                        rk.b[d][i][n] += mod_mul(gadget, orig_sk.s[i][n], qi);
+                    }
+                    auto prod = mod_mul(rk.a[d][i][n], new_sk.s[i][n], qi);
+                    rk.b[d][i][n] = mod(rk.b[d][i][n] + 2*qi - prod, qi);
+                }
+            }
+        }
+    }
+
+    return rk;
+}
+
+// ct_a and ct_b are reduced after each limb so the 128-bit sums cannot overflow
+static RNSCiphertext key_switch_sum(const RNSRelinKey& rk, const std::vector<uv64>& b,
+        const std::vector<const std::vector<uv64>*>& digits, const RNSParams& params){
+    const auto& ctx = *params.ctx;
+    ui32 limb_windows = RNSLimbWindows(params);
+
+    RNSCiphertext ct_new(ctx.phim, ctx.num_limbs());
+    for (ui32 i = 0; i < ctx.num_limbs(); i++) {
+        ui64 qi = ctx.moduli[i];
+        uv128 ct_a(ctx.phim);
+        uv128 ct_b(b[i].begin(), b[i].end());
+        for (ui32 d = 0; d < digits.size(); d++) {
+            const auto& digit = (*digits[d])[i];
+            for (ui32 n = 0; n < ctx.phim; n++) {
+                ct_a[n] += ((ui128)digit[n] * (ui128)rk.a[d][i][n]);
+                ct_b[n] += ((ui128)digit[n] * (ui128)rk.b[d][i][n]);
+            }
+            if ((d+1) % limb_windows == 0) {
+                for (ui32 n = 0; n < ctx.phim; n++) {
+                    ct_a[n] = mod(ct_a[n], qi);
+                    ct_b[n] = mod(ct_b[n], qi);
+                }
+            }
+        }
+        for (ui32 n = 0; n < ctx.phim; n++) {
+            ct_new.a[i][n] = mod(ct_a[n], qi);
+            ct_new.b[i][n] = mod(ct_b[n], qi);
+        }
+    }
+
+    return ct_new;
+}
+
+RNSCiphertext KeySwitchDigits(const RNSRelinKey& rk, const RNSCiphertext& ct,
+        const std::vector<std::vector<uv64>>& digits_ct, const RNSParams& params){
+    std::vector<const std::vector<uv64>*> digits;
+    for (const auto& digit: digits_ct) {
+        digits.push_back(&digit);
+    }
+    return key_switch_sum(rk, ct.b, digits, params);
+}
+
+RNSCiphertext KeySwitch(const RNSRelinKey& rk, const RNSCiphertext& ct, const RNSParams& params){
+    auto digits_ct = HoistedDecompose(ct, params);
+    return KeySwitchDigits(rk, ct, digits_ct, params);
+}
+
+RNSRelinKey EvalAutomorphismKeyGen(const RNSSecretKey& sk, const ui32 rot,
+        const RNSParams& params){
+    const auto& ctx = *params.ctx;
+    RNSSecretKey sk_rot(ctx.phim, ctx.num_limbs());
+    for (ui32 i = 0; i < ctx.num_limbs(); i++) {
+        sk_rot.s[i] = automorph(sk.s[i], rot, *ctx.automorph);
+    }
+    return KeySwitchGen(sk_rot, sk, params);
+}
+
+RNSCiphertext EvalAutomorphismDigits(const ui32 rot, const RNSRelinKey& rk,
+        const RNSCiphertext& ct, const std::vector<std::vector<uv64>>& digits_ct,
+        const RNSParams& params){
+    const auto& ctx = *params.ctx;
+
+    std::vector<uv64> ct_b_rot(ctx.num_limbs());
+    for (ui32 i = 0; i < ctx.num_limbs(); i++) {
+        ct_b_rot[i] = automorph(ct.b[i], rot, *ctx.automorph);
+    }
+
+    std::vector<std::vector<uv64>> digits_rot(digits_ct.size(),
+            std::vector<uv64>(ctx.num_limbs()));
+    std::vector<const std::vector<uv64>*> digits;
+    for (ui32 d = 0; d < digits_ct.size(); d++) {
+        for (ui32 i = 0; i < ctx.num_limbs(); i++) {
+            digits_rot[d][i] = automorph(digits_ct[d][i], rot, *ctx.automorph);
+        }
+        digits.push_back(&digits_rot[d]);
+    }
+
+    return key_switch_sum(rk, ct_b_rot, digits, params);
+}
+
+RNSCiphertext EvalAutomorphism(const ui32 rot, const RNSRelinKey& rk,
+        const RNSCiphertext& ct, const RNSParams& params){
+    auto digits_ct = HoistedDecompose(ct, params);
+    return EvalAutomorphismDigits(rot, rk, ct, digits_ct, params);
+}
+
+}  // namespace lbcrypto ends
@@ -0,0 +1,148 @@
+/*
+ * fv_rns.h
+ *
+ *	FV over a ciphertext modulus q = q_0*q_1*...*q_{L-1} kept in residue
+ *	number system form, one limb per prime. Every limb is transformed with
+ *	its own tables, so no multi-precision arithmetic is needed outside of
+ *	the precomputation.
+ *
+ */
+
+#ifndef LBCRYPTO_CRYPTO_FV_RNS_H
+#define LBCRYPTO_CRYPTO_FV_RNS_H
+
+#include <memory>
+using std::shared_ptr;
+
+#include "utils/backend.h"
+#include "math/transfrm.h"
+#include "math/automorph.h"
+#include "pke_types.h"
+
+namespace lbcrypto {
+
+    /**
+    * @brief Tables for an RNS moduli chain: one transform per limb, the
+    * automorphism permutations and the CRT constants used to scale by p/q.
+    * Immutable once built.
+    */
+    struct RNSContext {
+        // The chain is given like for ftt_pre_compute, the primes must be
+        // below 2^62 and 1 mod 2*phim. p can be any modulus below 2^63.
+        RNSContext(const uv64& rootsOfUnity, const uv64& moduliiChain,
+                const ui64 p, const ui32 logn);
+
+        const uv64 moduli;
+        const ui64 p;
+        const ui32 logn, phim;
+
+        const std::vector<shared_ptr<const NttContext>> ntt;
+        const shared_ptr<const AutomorphContext> automorph;
+
+        // floor(q/p) mod q_i
+        uv64 delta;
+        // (q/q_i)^-1 mod q_i
+        uv64 q_hat_inv;
+        // p*(q/q_i)^-1/q_i mod q_i split into its integer part mod p and
+        // its fractional part with 128 bits of precision
+        uv64 p_q_hat_inv_int;
+        uv64 p_q_hat_inv_frac_hi, p_q_hat_inv_frac_lo;
+
+        ui32 num_limbs() const { return moduli.size(); }
+    };
+
+    /**
+    * @brief Parameters for FV with an RNS ciphertext modulus.
+    */
+    struct RNSParams {
+        shared_ptr<const RNSContext> ctx;
+
+        MODE mode;
+        shared_ptr<DiscreteGaussianGenerator> dgg;
+
+        // Digit size of the key switching within each limb
+        ui32 window_size;
+    };
+
+    // Polynomials below hold one vector per limb, in the evaluation domain
+    struct RNSCiphertext {
+        std::vector<uv64> a;
+        std::vector<uv64> b;
+
+        RNSCiphertext(ui32 size, ui32 limbs) : a(limbs, uv64(size)), b(limbs, uv64(size)) {};
+    };
+
+    struct RNSPublicKey {
+        std::vector<uv64> a;
+        std::vector<uv64> b;
+
+        RNSPublicKey(ui32 size, ui32 limbs) : a(limbs, uv64(size)), b(limbs, uv64(size)) {};
+    };
+
+    struct RNSSecretKey {
+        std::vector<uv64> s;
+
+        RNSSecretKey(ui32 size, ui32 limbs) : s(limbs, uv64(size)) {};
+    };
+
+    struct RNSKeyPair {
+        RNSPublicKey pk;
+        RNSSecretKey sk;
+
+        RNSKeyPair(const RNSPublicKey& pk, const RNSSecretKey& sk) : pk(pk), sk(sk) {};
+    };
+
+    // Indexed as [digit][limb], with limb_windows digits for each limb of q
+    struct RNSRelinKey {
+        std::vector<std::vector<uv64>> a;
+        std::vector<std::vector<uv64>> b;
+
+        RNSRelinKey(ui32 size, ui32 limbs, ui32 digits) :
+            a(digits, std::vector<uv64>(limbs, uv64(size))),
+            b(digits, std::vector<uv64>(limbs, uv64(size))) {};
+    };
+
+    // Number of window_size digits needed for the largest limb
+    ui32 RNSLimbWindows(const RNSParams& params);
+
+    // Evaluation form of a plaintext with coefficients below p, for EvalMultPlain
+    std::vector<uv64> NullEncrypt(const uv64& pt, const RNSParams& params);
+
+    RNSKeyPair KeyGen(const RNSParams& params);
+
+    RNSCiphertext Encrypt(const RNSPublicKey& pk, const uv64& pt, const RNSParams& params);
+
+    RNSCiphertext Encrypt(const RNSSecretKey& sk, const uv64& pt, const RNSParams& params);
+
+    uv64 Decrypt(const RNSSecretKey& sk, const RNSCiphertext& ct, const RNSParams& params);
+
+    RNSCiphertext EvalAdd(const RNSCiphertext& ct1, const RNSCiphertext& ct2, const RNSParams& params);
+
+    RNSCiphertext EvalSub(const RNSCiphertext& ct1, const RNSCiphertext& ct2, const RNSParams& params);
+
+    RNSCiphertext EvalMultPlain(const RNSCiphertext& ct, const std::vector<uv64>& pt,
+            const RNSParams& params);
+
+    // Digits of ct.a in every limb, indexed as [digit][limb]
+    std::vector<std::vector<uv64>> HoistedDecompose(const RNSCiphertext& ct, const RNSParams& params);
+
+    RNSRelinKey KeySwitchGen(const RNSSecretKey& orig_sk, const RNSSecretKey& new_sk,
+            const RNSParams& params);
+
+    RNSCiphertext KeySwitchDigits(const RNSRelinKey& rk, const RNSCiphertext& ct,
+            const std::vector<std::vector<uv64>>& digits_ct, const RNSParams& params);
+
+    RNSCiphertext KeySwitch(const RNSRelinKey& rk, const RNSCiphertext& ct, const RNSParams& params);
+
+    RNSRelinKey EvalAutomorphismKeyGen(const RNSSecretKey& sk, const ui32 rot,
+            const RNSParams& params);
+
+    RNSCiphertext EvalAutomorphismDigits(const ui32 rot, const RNSRelinKey& rk,
+            const RNSCiphertext& ct, const std::vector<std::vector<uv64>>& digits_ct,
+            const RNSParams& params);
+
+    RNSCiphertext EvalAutomorphism(const ui32 rot, const RNSRelinKey& rk,
+            const RNSCiphertext& ct, const RNSParams& params);
+
+} // namespace lbcrypto ends
+#endif
@@ -24,6 +24,13 @@
 
 #include "pke/encoding.h"
 #include "pke/fv.h"
+#include "pke/fv_rns.h"
+#include "pke/fv_hybrid.h"
+#include "pke/fv_pool.h"
+#include "pke/keystore.h"
+#include "pke/serialize.h"
+#include "pke/encmat_cache.h"
+#include "pke/noise.h"
 #include "pke/layers.h"
 #include "pke/mat_mul.h"
 #include "pke/gemm.h"
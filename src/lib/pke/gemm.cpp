@@ -36,7 +36,7 @@ CTMat preprocess_gemm_c(const SecretKey& sk, const std::vector<uv64>& mat,
                 pt[pt_offset+col] = mat[row][col];
             }
         }
-        pt = packed_encode(pt, params.p, params.logn);
+        pt = packed_encode(pt, params);
 
         // Expand the input with multiples of the plaintext base
         for (ui32 w=0; w<num_windows; w++){
@@ -93,7 +93,7 @@ EncMat preprocess_gemm_s(const std::vector<uv64>& mat, const ui32 num_cols_c,
                     }
                 }
                 // std::cout << vec_to_str(pt) << std::endl;
-                pt = packed_encode(pt, params.p, params.logn);
+                pt = packed_encode(pt, params);
 
                 ui64 mask = (1<<window_size)-1;
                 for(ui32 w=0; w<num_windows; w++){
@@ -102,17 +102,19 @@ EncMat preprocess_gemm_s(const std::vector<uv64>& mat, const ui32 num_cols_c,
                     for(ui32 n=0; n<params.phim; n++){
                         pt_scaled[n] = (pt[n] >> shift) & mask;
                     }
-                    enc_mat[w][curr_set] = NullEncrypt(pt_scaled, params);
+                    enc_mat[w][curr_set] = pt_scaled;
                 }
                 curr_set++;
             }
         }
     }
 
+    ToEvalBatch(enc_mat, params);
     return enc_mat;
 }
 
-CTVec gemm_online(const CTMat& ct_mat_c, const EncMat& enc_mat_s, const ui32 num_cols_c, const FVParams& params){
+CTVec gemm_online(const CTMat& ct_mat_c, const EncMatView& enc_mat_s, const ui32 num_cols_c,
+        const AutomorphismKeys& keys, const FVParams& params){
     ui32 num_in_ct = ct_mat_c.size();
     ui32 num_windows = ct_mat_c[0].size();
     ui32 num_sets=enc_mat_s[0].size();
@@ -121,7 +123,8 @@ CTVec gemm_online(const CTMat& ct_mat_c, const EncMat& enc_mat_s, const ui32 num
 
     // std::cout << num_in_ct << " " << num_sets << " " << num_out_ct << std::endl;
 
-    CTVec psum_ct(num_out_ct*rows_per_ct, Ciphertext(params.phim));
+    std::vector<CiphertextAccumulator> psum_acc(num_out_ct*rows_per_ct,
+            CiphertextAccumulator(params.phim));
     for(ui32 in_ct=0; in_ct<num_in_ct; in_ct++){
         for(ui32 w=0; w<num_windows; w++){
             ui32 curr_set = in_ct*num_out_ct*rows_per_ct;
@@ -129,8 +132,7 @@ CTVec gemm_online(const CTMat& ct_mat_c, const EncMat& enc_mat_s, const ui32 num
             for(ui32 out_ct=0; out_ct<num_out_ct; out_ct++){
                 for(ui32 row=0; row<rows_per_ct; row++){
                     ui32 dest = out_ct*rows_per_ct+row;
-                    auto mult = EvalMultPlain(ct_mat_c[in_ct][w], enc_mat_s[w][curr_set], params);
-                    psum_ct[dest] = EvalAdd(psum_ct[dest], mult, params);
+                    EvalMultPlainAccumulate(psum_acc[dest], ct_mat_c[in_ct][w], enc_mat_s[w][curr_set], params);
                     curr_set++;
                     // std::cout << in_ct << " " << w << " " << row << " " << rot << " " << curr_set << std::endl;
                     /*for(ui32 n=0; n<params.phim; n++){
@@ -148,6 +150,7 @@ CTVec gemm_online(const CTMat& ct_mat_c, const EncMat& enc_mat_s, const ui32 num
         }
     }
 
+    auto psum_ct = Reduce(psum_acc, params);
     CTVec ret(num_out_ct, Ciphertext(params.phim));
     for(ui32 out_ct=0; out_ct<num_out_ct; out_ct++){
         for(ui32 row=0; row<rows_per_ct; row++){
@@ -157,8 +160,8 @@ CTVec gemm_online(const CTMat& ct_mat_c, const EncMat& enc_mat_s, const ui32 num
             if(row == 0){
                 ret[out_ct] = psum_ct[psum_row];
             } else {
-                auto psum_rot = EvalAutomorphism(rot, psum_ct[psum_row], params);
-                ret[out_ct] = EvalAdd(ret[out_ct], psum_rot, params);
+                auto psum_rot = EvalAutomorphism(rot, keys, psum_ct[psum_row], params);
+                EvalAddInPlace(ret[out_ct], psum_rot, params);
             }
         }
     }
@@ -187,16 +190,51 @@ CTVec gemm_phim_online(const CTMat& ct_mat_c, const std::vector<uv64>& mat_s_t,
     }
 
     CTVec ret(num_ct, Ciphertext(params.phim));
-    for(ui32 out_ct=0; out_ct<num_ct; out_ct++){
-        for(ui32 n=0; n<params.phim; n++){
-            ret[out_ct].a[n] = opt::modq_part(a[out_ct][n]);
-            ret[out_ct].b[n] = opt::modq_part(b[out_ct][n]);
+    if(params.fast_modulli){
+        opt::with_modulli(params.q, params.p, [&](auto m){
+            using M = decltype(m);
+            for(ui32 out_ct=0; out_ct<num_ct; out_ct++){
+                for(ui32 n=0; n<params.phim; n++){
+                    ret[out_ct].a[n] = M::modq_part(a[out_ct][n]);
+                    ret[out_ct].b[n] = M::modq_part(b[out_ct][n]);
+                }
+            }
+        });
+    } else {
+        for(ui32 out_ct=0; out_ct<num_ct; out_ct++){
+            for(ui32 n=0; n<params.phim; n++){
+                ret[out_ct].a[n] = mod(a[out_ct][n], params.q);
+                ret[out_ct].b[n] = mod(b[out_ct][n], params.q);
+            }
         }
     }
     return ret;
 }
 
-std::vector<uv64> postprocess_gemm(const SecretKey& sk, const CTVec& ct_prod,
+NoiseEstimate gemm_noise(const ui32 num_rows_c, const ui32 num_cols_c,
+        const ui32 window_size, const ui32 num_windows, const FVParams& params){
+    ui32 rows_per_ct = params.phim/num_cols_c;
+    ui32 num_in_ct = num_rows_c/rows_per_ct;
+
+    auto prod = EstimateMultPlain(EstimateEncrypt(params), (ui64)1 << window_size, params);
+    auto psum = EstimateSum(prod, num_in_ct*num_windows);
+    auto ret = psum;
+    for(ui32 row=1; row<rows_per_ct; row++){
+        ret = EstimateAdd(ret, EstimateKeySwitch(psum, params));
+    }
+    return ret;
+}
+
+NoiseEstimate gemm_phim_noise(const ui32 num_rows_c, const ui32 num_cols_c,
+        const ui32 window_size, const ui32 num_windows, const FVParams& params){
+    ui32 num_in_ct = num_rows_c/std::max(params.phim/num_cols_c, (ui32)1);
+
+    auto prod = EstimateMultScalar(EstimateEncrypt(params), (ui64)1 << window_size, params);
+    return EstimateSum(prod, num_in_ct*num_windows);
+}
+
+template <class CT>
+static std::vector<uv64> postprocess_gemm_impl(const SecretKey& sk, const std::vector<CT>& ct_prod,
         const ui32 num_rows, const ui32 num_cols, const FVParams& params){
     ui32 rows_per_ct = (params.phim / num_cols);
     ui32 num_ct = ct_prod.size();
@@ -204,7 +242,7 @@ std::vector<uv64> postprocess_gemm(const SecretKey& sk, const CTVec& ct_prod,
 
     auto prod = std::vector<uv64>(num_rows, uv64(num_cols));
     for(ui32 curr_ct=0; curr_ct<num_ct; curr_ct++){
-        auto pt = packed_decode(Decrypt(sk, ct_prod[curr_ct], params), params.p, params.logn);
+        auto pt = packed_decode(Decrypt(sk, ct_prod[curr_ct], params), params);
         for(ui32 curr_row=0; curr_row<rows_per_ct; curr_row++){
             ui32 row = curr_row+curr_ct*rows_per_ct;
             ui32 pt_offset = curr_row*num_cols;
@@ -218,6 +256,16 @@ std::vector<uv64> postprocess_gemm(const SecretKey& sk, const CTVec& ct_prod,
     return prod;
 }
 
+std::vector<uv64> postprocess_gemm(const SecretKey& sk, const CTVec& ct_prod,
+        const ui32 num_rows, const ui32 num_cols, const FVParams& params){
+    return postprocess_gemm_impl(sk, ct_prod, num_rows, num_cols, params);
+}
+
+std::vector<uv64> postprocess_gemm(const SecretKey& sk, const CompressedCTVec& ct_prod,
+        const ui32 num_rows, const ui32 num_cols, const FVParams& params){
+    return postprocess_gemm_impl(sk, ct_prod, num_rows, num_cols, params);
+}
+
 std::vector<uv64> gemm_pt(const std::vector<uv64>& mat_c, const std::vector<uv64>& mat_s_t, const ui64 p){
     ui32 rows_c = mat_c.size();
     ui32 cols_c = mat_c[0].size();
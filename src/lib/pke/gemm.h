@@ -19,15 +19,26 @@ namespace lbcrypto{
     EncMat preprocess_gemm_s(const std::vector<uv64>& mat, const ui32 num_cols_c,
             const ui32 window_size, const ui32 num_windows, const FVParams& params);
 
-    CTVec gemm_online(const CTMat& ct_mat_c, const EncMat& enc_mat_s,
-            const ui32 num_cols_c, const FVParams& params);
+    CTVec gemm_online(const CTMat& ct_mat_c, const EncMatView& enc_mat_s,
+            const ui32 num_cols_c, const AutomorphismKeys& keys, const FVParams& params);
 
     CTVec gemm_phim_online(const CTMat& ct_mat_c, const std::vector<uv64>& mat_s_t,
             const ui32 window_size, const ui32 num_windows, const FVParams& params);
 
+    // Estimated noise of the outputs of gemm_online and gemm_phim_online, for
+    // PlanWindows
+    NoiseEstimate gemm_noise(const ui32 num_rows_c, const ui32 num_cols_c,
+            const ui32 window_size, const ui32 num_windows, const FVParams& params);
+
+    NoiseEstimate gemm_phim_noise(const ui32 num_rows_c, const ui32 num_cols_c,
+            const ui32 window_size, const ui32 num_windows, const FVParams& params);
+
     std::vector<uv64> postprocess_gemm(const SecretKey& sk, const CTVec& ct_prod,
             const ui32 num_rows, const ui32 num_cols, const FVParams& params);
 
+    std::vector<uv64> postprocess_gemm(const SecretKey& sk, const CompressedCTVec& ct_prod,
+            const ui32 num_rows, const ui32 num_cols, const FVParams& params);
+
     std::vector<uv64> gemm_pt(const std::vector<uv64>& mat_c,
             const std::vector<uv64>& mat_s_t, const ui64 p);
 }
@@ -0,0 +1,241 @@
+/*
+ * keystore.cpp
+ *
+ *	Per-session rotation keys, see keystore.h.
+ *
+ */
+
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include <unistd.h>
+
+#include "pke/keystore.h"
+#include "pke/serialize.h"
+#include "utils/bitpack.h"
+
+namespace lbcrypto {
+
+static std::string spill_prefix(){
+    static std::atomic<ui64> next_store(0);
+    return "keystore_" + std::to_string(getpid()) + "_" + std::to_string(next_store++);
+}
+
+KeyStore::KeyStore(const FVParams& params, const size_t max_bytes, const std::string& spill_dir) :
+        m_params(params), m_max_bytes(max_bytes), m_spill_dir(spill_dir),
+        m_spill_prefix(spill_prefix()),
+        m_table(std::make_shared<const SessionTable>()), m_clock(0),
+        m_bytes(0), m_spilled_bytes(0) {
+}
+
+KeyStore::~KeyStore() {
+    for (const auto& s: *m_table) {
+        if (s.second->spilled) {
+            std::remove(spill_path(s.first).c_str());
+        }
+    }
+}
+
+shared_ptr<KeyStore::Session> KeyStore::find(const SessionId session) const {
+    auto table = std::atomic_load(&m_table);
+    auto s = table->find(session);
+    return (s == table->end()) ? nullptr : s->second;
+}
+
+void KeyStore::Add(const SessionId session, const uv32& index_list,
+        const std::vector<SeededRelinKey>& rk_list){
+    if (index_list.size() != rk_list.size()) {
+        throw std::logic_error("Number of keys does not match the rotations");
+    }
+    // Expanded before taking the lock, requests of other sessions go on
+    AutomorphismKeys keys;
+    for (ui32 n = 0; n < index_list.size(); n++) {
+        AddAutomorphismKey(keys, index_list[n], rk_list[n], m_params);
+    }
+    Add(session, keys);
+}
+
+void KeyStore::Add(const SessionId session, const AutomorphismKeys& keys){
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto s = find(session);
+    if (!s) {
+        s = std::make_shared<Session>();
+        auto table = std::make_shared<SessionTable>(*m_table);
+        (*table)[session] = s;
+        std::atomic_store(&m_table, shared_ptr<const SessionTable>(table));
+    }
+
+    auto old_keys = load(session, *s);
+    auto new_keys = old_keys ? std::make_shared<AutomorphismKeys>(*old_keys):
+        std::make_shared<AutomorphismKeys>();
+    for (const auto& rk: keys) {
+        (*new_keys)[rk.first] = rk.second;
+    }
+
+    m_bytes -= s->bytes;
+    s->bytes = AutomorphismKeyBytes(*new_keys);
+    m_bytes += s->bytes;
+    std::atomic_store(&s->keys, shared_ptr<const AutomorphismKeys>(new_keys));
+    s->last_used = m_clock++;
+    evict(session);
+}
+
+shared_ptr<const AutomorphismKeys> KeyStore::Acquire(const SessionId session){
+    auto s = find(session);
+    if (!s) {
+        return nullptr;
+    }
+    s->last_used = m_clock++;
+    auto keys = std::atomic_load(&s->keys);
+    if (keys) {
+        return keys;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (find(session) != s) {
+        return nullptr;
+    }
+    keys = load(session, *s);
+    evict(session);
+    return keys;
+}
+
+void KeyStore::Remove(const SessionId session){
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto s = find(session);
+    if (!s) {
+        return;
+    }
+    if (s->spilled) {
+        m_spilled_bytes -= s->bytes;
+        std::remove(spill_path(session).c_str());
+    } else {
+        m_bytes -= s->bytes;
+    }
+    auto table = std::make_shared<SessionTable>(*m_table);
+    table->erase(session);
+    std::atomic_store(&m_table, shared_ptr<const SessionTable>(table));
+}
+
+bool KeyStore::Contains(const SessionId session) const {
+    return find(session) != nullptr;
+}
+
+size_t KeyStore::bytes_used() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_bytes;
+}
+
+size_t KeyStore::bytes_spilled() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_spilled_bytes;
+}
+
+std::string KeyStore::spill_path(const SessionId session) const {
+    return m_spill_dir + "/" + m_spill_prefix + "_session_" + std::to_string(session) + ".keys";
+}
+
+// The spill file holds the number of keys, the rotation and window count
+// of each, then all their a and b rows packed mod q
+void KeyStore::spill(const SessionId session, Session& s){
+    auto keys = std::atomic_load(&s.keys);
+    uv64 header(1 + 2*keys->size());
+    header[0] = keys->size();
+    BitPacker packer;
+    uv64 scratch(m_params.phim);
+    ui32 n = 0;
+    for (const auto& rk: *keys) {
+        header[1 + 2*n] = rk.first;
+        header[2 + 2*n] = rk.second->a.size();
+        for (ui32 w = 0; w < rk.second->a.size(); w++) {
+            put_reduced(packer, rk.second->a[w], scratch, m_params.q);
+            put_reduced(packer, rk.second->b[w], scratch, m_params.q);
+        }
+        n++;
+    }
+    uv64 body = packer.take();
+
+    std::ofstream f(spill_path(session), std::ios::binary | std::ios::trunc);
+    f.write((const char*)header.data(), header.size()*sizeof(ui64));
+    f.write((const char*)body.data(), body.size()*sizeof(ui64));
+    if (!f) {
+        throw std::logic_error("Could not write " + spill_path(session));
+    }
+
+    std::atomic_store(&s.keys, shared_ptr<const AutomorphismKeys>());
+    s.spilled = true;
+    m_bytes -= s.bytes;
+    m_spilled_bytes += s.bytes;
+}
+
+shared_ptr<const AutomorphismKeys> KeyStore::load(const SessionId session, Session& s){
+    if (!s.spilled) {
+        return std::atomic_load(&s.keys);
+    }
+
+    std::ifstream f(spill_path(session), std::ios::binary);
+    ui64 num_keys = 0;
+    f.read((char*)&num_keys, sizeof(ui64));
+    uv64 header(2*num_keys);
+    f.read((char*)header.data(), header.size()*sizeof(ui64));
+    ui64 rows = 0;
+    for (ui32 n = 0; n < num_keys; n++) {
+        rows += 2*header[2*n + 1];
+    }
+    uv64 body(packed_words(rows*m_params.phim, wire_bits(m_params.q)));
+    f.read((char*)body.data(), body.size()*sizeof(ui64));
+    if (!f) {
+        throw std::logic_error("Could not read " + spill_path(session));
+    }
+
+    auto keys = std::make_shared<AutomorphismKeys>();
+    BitUnpacker unpacker(body);
+    for (ui32 n = 0; n < num_keys; n++) {
+        auto rk = std::make_shared<RelinKey>(m_params.phim, header[2*n + 1]);
+        for (ui32 w = 0; w < rk->a.size(); w++) {
+            get_reduced(unpacker, rk->a[w], m_params.q);
+            get_reduced(unpacker, rk->b[w], m_params.q);
+        }
+        (*keys)[header[2*n]] = rk;
+    }
+    std::remove(spill_path(session).c_str());
+
+    std::atomic_store(&s.keys, shared_ptr<const AutomorphismKeys>(keys));
+    s.spilled = false;
+    m_spilled_bytes -= s.bytes;
+    m_bytes += s.bytes;
+    return keys;
+}
+
+void KeyStore::evict(const SessionId keep){
+    while (m_max_bytes && (m_bytes > m_max_bytes)) {
+        // The least recently used session that no request holds
+        shared_ptr<Session> lru;
+        SessionId lru_id = 0;
+        for (const auto& s: *m_table) {
+            if ((s.first == keep) || s.second->spilled) {
+                continue;
+            }
+            auto keys = std::atomic_load(&s.second->keys);
+            bool idle = (keys.use_count() <= 2);
+            if (idle && (!lru || (s.second->last_used < lru->last_used))) {
+                lru = s.second;
+                lru_id = s.first;
+            }
+        }
+        if (!lru) {
+            return;
+        }
+
+        if (m_spill_dir.empty()) {
+            m_bytes -= lru->bytes;
+            auto table = std::make_shared<SessionTable>(*m_table);
+            table->erase(lru_id);
+            std::atomic_store(&m_table, shared_ptr<const SessionTable>(table));
+        } else {
+            spill(lru_id, *lru);
+        }
+    }
+}
+
+}  // namespace lbcrypto ends
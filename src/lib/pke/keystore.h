@@ -0,0 +1,112 @@
+/*
+ * keystore.h
+ *
+ *	Rotation keys of many clients, for a server that runs the sessions of
+ *	several clients at once. Each session has its own AutomorphismKeys,
+ *	which a request acquires once and then reads without locks for all its
+ *	rotations. Adding keys publishes a new set rather than modifying the
+ *	one requests may be reading. The resident keys are accounted for and,
+ *	past a limit, the least recently used idle sessions are spilled to
+ *	disk, to be reloaded by their next request, or dropped.
+ *
+ */
+
+#ifndef LBCRYPTO_CRYPTO_KEYSTORE_H
+#define LBCRYPTO_CRYPTO_KEYSTORE_H
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+
+#include "utils/backend.h"
+#include "pke/fv.h"
+#include "pke_types.h"
+
+namespace lbcrypto {
+
+    typedef ui64 SessionId;
+
+    class KeyStore {
+    public:
+        // With max_bytes the keys resident in memory are kept below it as
+        // far as idle sessions allow, 0 for no limit. Evicted sessions are
+        // written to spill_dir, or dropped when it is empty. Their file
+        // names are unique to the store, several may share spill_dir.
+        explicit KeyStore(const FVParams& params, const size_t max_bytes = 0,
+                const std::string& spill_dir = "");
+
+        // Removes the spill files of the remaining sessions
+        ~KeyStore();
+
+        KeyStore(const KeyStore&) = delete;
+        KeyStore& operator=(const KeyStore&) = delete;
+
+        // Expands the keys a client sent, rk_list[n] for the rotation
+        // index_list[n], into its session. Keys for rotations the session
+        // already has replace the old ones for later requests.
+        void Add(const SessionId session, const uv32& index_list,
+                const std::vector<SeededRelinKey>& rk_list);
+
+        void Add(const SessionId session, const AutomorphismKeys& keys);
+
+        // The keys of session, to be passed to the rotations of one request.
+        // The keys stay valid while the pointer is held, whatever is added
+        // or evicted meanwhile. Only takes a lock to reload a spilled
+        // session. nullptr for sessions without keys, including those
+        // dropped by eviction.
+        shared_ptr<const AutomorphismKeys> Acquire(const SessionId session);
+
+        // Forgets session, requests that hold its keys keep them
+        void Remove(const SessionId session);
+
+        bool Contains(const SessionId session) const;
+
+        // Bytes of the keys in memory and on disk
+        size_t bytes_used() const;
+        size_t bytes_spilled() const;
+
+    private:
+        struct Session {
+            // Read and written with atomic_load and atomic_store, nullptr
+            // while spilled
+            shared_ptr<const AutomorphismKeys> keys;
+            std::atomic<ui64> last_used;
+            size_t bytes;
+            bool spilled;
+
+            Session() : last_used(0), bytes(0), spilled(false) {};
+        };
+
+        typedef std::map<SessionId, shared_ptr<Session>> SessionTable;
+
+        shared_ptr<Session> find(const SessionId session) const;
+
+        // The keys of a session, reloaded if spilled, with m_mutex held
+        shared_ptr<const AutomorphismKeys> load(const SessionId session, Session& s);
+
+        // Spills or drops sessions other than keep until the resident keys
+        // fit, with m_mutex held
+        void evict(const SessionId keep);
+
+        void spill(const SessionId session, Session& s);
+
+        std::string spill_path(const SessionId session) const;
+
+        const FVParams m_params;
+        const size_t m_max_bytes;
+        const std::string m_spill_dir;
+        // Process and store number in the spill file names
+        const std::string m_spill_prefix;
+
+        // Replaced as a whole when sessions come and go, so that Acquire
+        // can look up a session while others are added
+        shared_ptr<const SessionTable> m_table;
+        std::atomic<ui64> m_clock;
+
+        size_t m_bytes, m_spilled_bytes;
+        mutable std::mutex m_mutex;
+    };
+
+} // namespace lbcrypto ends
+#endif
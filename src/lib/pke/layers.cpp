@@ -6,10 +6,47 @@
  */
 
 #include "pke/fv.h"
+#include "utils/thread_pool.h"
 
 #include "pke/layers.h"
 
 namespace lbcrypto{
+
+EncMatView::EncMatView(const EncMat& enc_mat) :
+        m_rows(enc_mat.size()), m_cols(enc_mat.empty() ? 0 : enc_mat[0].size()) {
+    m_ptrs.reserve(m_rows*m_cols);
+    for(const auto& row: enc_mat){
+        for(const auto& pt: row){
+            m_ptrs.push_back(pt.data());
+        }
+    }
+}
+
+EncMatView::EncMatView(const ui64* data, const ui32 rows, const ui32 cols, const ui32 phim) :
+        m_rows(rows), m_cols(cols) {
+    m_ptrs.reserve(m_rows*m_cols);
+    for(ui32 n=0; n<rows*cols; n++){
+        m_ptrs.push_back(data + (size_t)n*phim);
+    }
+}
+
+CTVec Expand(const SeededCTVec& ct_vec, const FVParams& params){
+    CTVec ct_full(ct_vec.size(), Ciphertext(params.phim));
+    get_thread_pool().parallel_for(ct_vec.size(), [&](ui32 n){
+        ct_full[n] = Expand(ct_vec[n], params);
+    });
+
+    return ct_full;
+}
+
+CTMat Expand(const SeededCTMat& ct_mat, const FVParams& params){
+    CTMat ct_full;
+    for(const auto& ct_vec: ct_mat){
+        ct_full.push_back(Expand(ct_vec, params));
+    }
+
+    return ct_full;
+}
 /*
 CTVec preprocess_vec(const SecretKey& sk, const uv64& pt,
         const ui32 window_size, const ui32 num_windows, const FVParams& params){
@@ -10,6 +10,7 @@
 
 #include "utils/backend.h"
 #include "pke/fv.h"
+#include "pke/noise.h"
 #include "pke_types.h"
 
 namespace lbcrypto{
@@ -19,6 +20,49 @@ namespace lbcrypto{
 
     typedef std::vector<std::vector<uv64>> EncMat;
 
+    // Read-only view of the plaintexts of an EncMat, in memory or mapped from
+    // a cache file (see MappedEncMat), as taken by the online functions.
+    // view[row][w] points to the phim values of the plaintext.
+    class EncMatView {
+    public:
+        class Row {
+        public:
+            Row(const ui64* const* ptrs, const ui32 cols) : m_ptrs(ptrs), m_cols(cols) {};
+
+            const ui64* operator[](const ui32 w) const { return m_ptrs[w]; }
+            ui32 size() const { return m_cols; }
+
+        private:
+            const ui64* const* m_ptrs;
+            ui32 m_cols;
+        };
+
+        // Implicit, so that an EncMat can be passed where a view is taken
+        EncMatView(const EncMat& enc_mat);
+
+        // Rows of cols plaintexts stored one after the other in data
+        EncMatView(const ui64* data, const ui32 rows, const ui32 cols, const ui32 phim);
+
+        Row operator[](const ui32 row) const { return Row(&m_ptrs[row*m_cols], m_cols); }
+        ui32 size() const { return m_rows; }
+
+    private:
+        std::vector<const ui64*> m_ptrs;
+        ui32 m_rows, m_cols;
+    };
+
+    // What the client uploads when it encrypts with EncryptSeeded
+    typedef std::vector<SeededCiphertext> SeededCTVec;
+    typedef std::vector<std::vector<SeededCiphertext>> SeededCTMat;
+
+    // What the server sends back after ModSwitch
+    typedef std::vector<CompressedCiphertext> CompressedCTVec;
+
+    // Expands the seeded ciphertexts on receipt, spread over the shared pool
+    CTVec Expand(const SeededCTVec& ct_vec, const FVParams& params);
+
+    CTMat Expand(const SeededCTMat& ct_mat, const FVParams& params);
+
     struct Filter2DShape{
         ui32 out_chn, in_chn, f_h, f_w;
 
@@ -18,7 +18,8 @@
 
 namespace lbcrypto{
 
-CTVec preprocess_vec(const SecretKey& sk, const uv64& vec,
+template <class CT>
+static std::vector<CT> preprocess_vec_impl(const SecretKey& sk, const uv64& vec,
         const ui32 window_size, const ui32 num_windows, const FVParams& params){
     uv64 pt(params.phim);
     ui32 sz_pow2 = nxt_pow2(vec.size());
@@ -28,7 +29,7 @@ CTVec preprocess_vec(const SecretKey& sk, const uv64& vec,
             pt[col + sz_pow2*n] = vec[col];
         }
     }
-    pt = packed_encode(pt, params.p, params.logn);
+    pt = packed_encode(pt, params);
 
     // Expand the input with multiples of the plaintext base
     std::vector<uv64> pt_scaled(num_windows, uv64(params.phim));
@@ -38,14 +39,24 @@ CTVec preprocess_vec(const SecretKey& sk, const uv64& vec,
         }
     }
 
-    CTVec ct_vec(num_windows, Ciphertext(params.phim));
+    std::vector<CT> ct_vec(num_windows, CT(params.phim));
     for (ui32 w=0; w<num_windows; w++){
-        ct_vec[w] = Encrypt(sk, pt_scaled[w], params);
+        EncryptInto(ct_vec[w], sk, pt_scaled[w], params);
     }
 
     return ct_vec;
 }
 
+CTVec preprocess_vec(const SecretKey& sk, const uv64& vec,
+        const ui32 window_size, const ui32 num_windows, const FVParams& params){
+    return preprocess_vec_impl<Ciphertext>(sk, vec, window_size, num_windows, params);
+}
+
+SeededCTVec preprocess_vec_seeded(const SecretKey& sk, const uv64& vec,
+        const ui32 window_size, const ui32 num_windows, const FVParams& params){
+    return preprocess_vec_impl<SeededCiphertext>(sk, vec, window_size, num_windows, params);
+}
+
 // Assumes mat is vector of phim-sized rows, num_rows can be any integer up to phim
 EncMat preprocess_matrix(const std::vector<uv64>& mat,
         const ui32 window_size, const ui32 num_windows, const FVParams& params){
@@ -85,48 +96,65 @@ EncMat preprocess_matrix(const std::vector<uv64>& mat,
 
     EncMat enc_mat(num_rows_pack, std::vector<uv64>(num_windows, uv64(params.phim)));
     for(ui32 row=0; row<num_rows_pack; row++){
-        auto pt_row = packed_encode(mat_diag[row], params.p, params.logn);
+        auto pt_row = packed_encode(mat_diag[row], params);
         auto decomposed_row = base_decompose(pt_row, window_size, num_windows);
         for(ui32 w=0; w<num_windows; w++){
             // std::cout << "Decomposed Row " << row << ": " << std::endl;
             // std::cout << vec_to_str(decomposed_row[w]);
-            enc_mat[row][w] = NullEncrypt(decomposed_row[w], params);
+            enc_mat[row][w] = decomposed_row[w];
         }
     }
+    ToEvalBatch(enc_mat, params);
     return enc_mat;
 }
 
-Ciphertext mat_mul_online(const CTVec& ct_vec, const EncMat& enc_mat,
-        const ui32 num_cols, const FVParams& params){
-    Ciphertext ret(params.phim);
+Ciphertext mat_mul_online(const CTVec& ct_vec, const EncMatView& enc_mat,
+        const ui32 num_cols, const AutomorphismKeys& keys, const FVParams& params,
+        Arena* arena){
+    CiphertextAccumulator acc(params.phim);
     ui32 padded_rows = enc_mat.size();
     for(ui32 w=0; w<ct_vec.size(); w++){
-        auto digits_vec_w = HoistedDecompose(ct_vec[w], params);
-        Ciphertext curr_vec(params.phim);
+        auto digits_vec_w = HoistedDecompose(ct_vec[w], params, arena);
+
+        uv32 rot_list(padded_rows);
         for(ui32 row=0; row<padded_rows; row++){
-            if(row == 0){
-                curr_vec = ct_vec[w];
-            } else {
-                auto rk = GetAutomorphismKey(row);
-                curr_vec = EvalAutomorphismDigits(row, *rk, ct_vec[w], digits_vec_w, params);
-            }
-            auto mult = EvalMultPlain(curr_vec, enc_mat[row][w], params);
-            ret = EvalAdd(ret, mult, params);
+            rot_list[row] = row;
         }
+        ForEachAutomorphism(rot_list, keys, ct_vec[w], digits_vec_w, params,
+                [&](ui32 row, const Ciphertext& rot_vec){
+            EvalMultPlainAccumulate(acc, rot_vec, enc_mat[row][w], params);
+        });
     }
+    auto ret = Reduce(acc, params);
 
     // Rotate and add the partial sums
     ui32 pack_factor = (params.phim / nxt_pow2(num_cols));
     for (ui32 rot = padded_rows; rot < (params.phim/pack_factor); rot *= 2){
-        auto rotated_ret = EvalAutomorphism(rot, ret, params);
-        ret = EvalAdd(ret, rotated_ret, params);
+        auto rotated_ret = EvalAutomorphism(rot, keys, ret, params);
+        EvalAddInPlace(ret, rotated_ret, params);
     }
     return ret;
 }
 
-uv64 postprocess_prod(const SecretKey& sk, const Ciphertext& ct_prod,
+NoiseEstimate mat_mul_noise(const ui32 num_rows, const ui32 num_cols,
+        const ui32 window_size, const ui32 num_windows, const FVParams& params){
+    ui32 pack_factor = (params.phim / nxt_pow2(num_cols));
+    ui32 padded_rows = std::max(nxt_pow2(num_rows)/pack_factor, (ui32)1);
+
+    auto rot_vec = EstimateKeySwitch(EstimateEncrypt(params), params);
+    auto prod = EstimateMultPlain(rot_vec, (ui64)1 << window_size, params);
+    // The windows of a row are rotated under the same key
+    auto ret = EstimateSum(EstimateSum(prod, num_windows, true), padded_rows);
+    for (ui32 rot = padded_rows; rot < (params.phim/pack_factor); rot *= 2){
+        ret = EstimateAdd(ret, EstimateKeySwitch(ret, params));
+    }
+    return ret;
+}
+
+template <class CT>
+static uv64 postprocess_prod_impl(const SecretKey& sk, const CT& ct_prod,
         const ui32 vec_size, const ui32 num_rows, const FVParams& params){
-    auto pt = packed_decode(Decrypt(sk, ct_prod, params), params.p, params.logn);
+    auto pt = packed_decode(Decrypt(sk, ct_prod, params), params);
     auto prod = uv64(num_rows);
 
     ui32 sz_pow2 = nxt_pow2(vec_size);
@@ -140,6 +168,16 @@ uv64 postprocess_prod(const SecretKey& sk, const Ciphertext& ct_prod,
     return prod;
 }
 
+uv64 postprocess_prod(const SecretKey& sk, const Ciphertext& ct_prod,
+        const ui32 vec_size, const ui32 num_rows, const FVParams& params){
+    return postprocess_prod_impl(sk, ct_prod, vec_size, num_rows, params);
+}
+
+uv64 postprocess_prod(const SecretKey& sk, const CompressedCiphertext& ct_prod,
+        const ui32 vec_size, const ui32 num_rows, const FVParams& params){
+    return postprocess_prod_impl(sk, ct_prod, vec_size, num_rows, params);
+}
+
 uv64 mat_mul_pt(const uv64& vec, const std::vector<uv64>& mat, const ui64 p){
     ui32 rows = mat.size();
     ui32 cols = vec.size();
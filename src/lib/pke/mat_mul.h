@@ -16,15 +16,29 @@ namespace lbcrypto{
     CTVec preprocess_vec(const SecretKey& sk, const uv64& vec,
             const ui32 window_size, const ui32 num_windows, const FVParams& params);
 
+    // Same with seeded ciphertexts, for upload to the server
+    SeededCTVec preprocess_vec_seeded(const SecretKey& sk, const uv64& vec,
+            const ui32 window_size, const ui32 num_windows, const FVParams& params);
+
     EncMat preprocess_matrix(const std::vector<uv64>& mat,
             const ui32 window_size, const ui32 num_windows, const FVParams& params);
 
-    Ciphertext mat_mul_online(const CTVec& vec, const EncMat& enc_mat,
-            const ui32 pack_factor, const FVParams& params);
+    // The hoisted digits of the rotations are carved from arena when given,
+    // which the caller resets once the result is done with
+    Ciphertext mat_mul_online(const CTVec& vec, const EncMatView& enc_mat,
+            const ui32 pack_factor, const AutomorphismKeys& keys, const FVParams& params,
+            Arena* arena = nullptr);
+
+    // Estimated noise of the output of mat_mul_online, for PlanWindows
+    NoiseEstimate mat_mul_noise(const ui32 num_rows, const ui32 num_cols,
+            const ui32 window_size, const ui32 num_windows, const FVParams& params);
 
     uv64 postprocess_prod(const SecretKey& sk, const Ciphertext& ct_prod,
             const ui32 vec_size, const ui32 num_rows, const FVParams& params);
 
+    uv64 postprocess_prod(const SecretKey& sk, const CompressedCiphertext& ct_prod,
+            const ui32 vec_size, const ui32 num_rows, const FVParams& params);
+
     uv64 mat_mul_pt(const uv64& vec, const std::vector<uv64>& mat, const ui64 p);
 }
 
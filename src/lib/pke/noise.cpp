@@ -0,0 +1,128 @@
+/*
+ * noise.cpp
+ *
+ *	Static noise estimates, see noise.h.
+ *
+ */
+
+#include <cmath>
+#include <map>
+#include <stdexcept>
+
+#include "pke/noise.h"
+
+namespace lbcrypto {
+
+// Deviations out that a coefficient of the random part is counted at, a
+// polynomial exceeds it with probability about n*2^-50
+static const double NOISE_TAIL = 8;
+
+// Variance of the coefficients of the secret key and the encryption masks
+static double key_var(const FVParams& params){
+    return (params.mode == RLWE)? std::pow(params.dgg->GetStd(), 2): 2.0/3;
+}
+
+static double error_var(const FVParams& params){
+    return std::pow(params.dgg->GetStd(), 2);
+}
+
+static ui32 key_switch_digits(const FVParams& params){
+    // This works because q is never a power of 2, so the floor is 1 less than size of q
+    return 1 + floor(log2(params.q))/params.window_size;
+}
+
+NoiseEstimate EstimateEncrypt(const FVParams& params, const bool public_key){
+    // e1 + e_pk*u + e2*s for public key encryptions, e otherwise
+    double var = error_var(params);
+    if (public_key) {
+        var += 2*params.phim*key_var(params)*error_var(params);
+    }
+    return {var, 0, 0};
+}
+
+NoiseEstimate EstimateAdd(const NoiseEstimate& x, const NoiseEstimate& y){
+    return {x.var + y.var, x.key_var + y.key_var, x.bound + y.bound};
+}
+
+// Coherent terms are at worst equal, which multiplies the deviation by terms
+NoiseEstimate EstimateSum(const NoiseEstimate& x, const ui64 terms, const bool same_key){
+    double var_terms = same_key? (double)terms*terms: terms;
+    return {x.var*var_terms, x.key_var*var_terms, x.bound*terms};
+}
+
+// (delta*m + e)*u = delta*(m*u mod p) + e*u - (q mod p)*k, with the k the
+// carries of m*u mod p. Plaintexts are the server's, so no bound on the
+// coefficients of u is assumed beyond pt_bound, while m is uniform mod p and
+// the carries are at most half of n*u_max on average.
+NoiseEstimate EstimateMultPlain(const NoiseEstimate& x, const ui64 pt_bound,
+        const FVParams& params){
+    double u_max = pt_bound - 1;
+    double carries = params.phim*u_max/2;
+    double var_terms = params.phim*u_max*u_max;
+    return {x.var*var_terms, x.key_var*var_terms,
+            x.bound*params.phim*u_max + (params.q % params.p)*carries};
+}
+
+NoiseEstimate EstimateMultScalar(const NoiseEstimate& x, const ui64 scalar_bound,
+        const FVParams& params){
+    double c_max = scalar_bound - 1;
+    return {x.var*c_max*c_max, x.key_var*c_max*c_max,
+            x.bound*c_max + (params.q % params.p)*c_max/2};
+}
+
+// Each digit of a multiplies the error of its row of the key. The digits of
+// a uniform a are uniform below 2^window_size: their mean multiplies the
+// errors of the key into a part that is the same for every ciphertext, and
+// only the deviations from it are random.
+NoiseEstimate EstimateKeySwitch(const NoiseEstimate& x, const FVParams& params){
+    double digit_range = std::pow(2.0, params.window_size);
+    double digit_mean = (digit_range - 1)/2;
+    double digit_var = (digit_range*digit_range - 1)/12;
+    double rows_var = key_switch_digits(params)*params.phim*error_var(params);
+    return {x.var + rows_var*digit_var, x.key_var + rows_var*digit_mean*digit_mean, x.bound};
+}
+
+// The rounding adds r_b + <r_a, s> with the r uniform in [-1/2, 1/2], in
+// units of q/2^bits. It is independent of the noise ct had, so the two
+// share one tail instead of ModSwitchBits' bit for each.
+NoiseEstimate EstimateModSwitch(const NoiseEstimate& x, const ui32 bits,
+        const FVParams& params){
+    double unit = (double)params.q/std::pow(2.0, bits);
+    double round_var = (1 + params.phim*key_var(params))/12*unit*unit;
+    return {x.var + round_var, x.key_var, x.bound};
+}
+
+// The part fixed by the keys is one draw for all the coefficients of every
+// ciphertext switched with them, so it is counted at its own tail instead of
+// being averaged into the random part
+double EstimateMargin(const NoiseEstimate& x, const FVParams& params){
+    double dev = std::sqrt(x.var) + std::sqrt(x.key_var);
+    return std::log2(params.delta) - std::log2(x.bound + NOISE_TAIL*dev);
+}
+
+WindowPlan PlanWindows(const LayerNoise& layer_noise, const FVParams& params,
+        const double min_margin){
+    // The narrowest key switching window for each digit count
+    std::map<ui32, ui32> ks_windows;
+    FVParams plan_params = params;
+    for (ui32 w = opt::bit_length(params.q); w >= 1; w--) {
+        plan_params.window_size = w;
+        ks_windows[key_switch_digits(plan_params)] = w;
+    }
+
+    ui32 p_bits = opt::bit_length(params.p - 1);
+    for (ui32 pt_num_windows = 1; pt_num_windows <= p_bits; pt_num_windows++) {
+        ui32 pt_window_size = (p_bits + pt_num_windows - 1)/pt_num_windows;
+        for (auto& ks: ks_windows) {
+            plan_params.window_size = ks.second;
+            auto noise = layer_noise(pt_window_size, pt_num_windows, plan_params);
+            double margin = EstimateMargin(noise, plan_params);
+            if (margin >= min_margin) {
+                return {pt_window_size, pt_num_windows, ks.second, margin};
+            }
+        }
+    }
+    throw std::logic_error("No window sizes leave the noise margin");
+}
+
+}  // namespace lbcrypto ends
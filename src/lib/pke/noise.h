@@ -0,0 +1,84 @@
+/*
+ * noise.h
+ *
+ *	Static noise estimates, for the server which has no key to measure the
+ *	noise with. The noise of a ciphertext is modelled as a random part, the
+ *	variance of independent zero mean coefficients, a part fixed by the
+ *	errors of the key switching keys, and a bounded part from the reduction
+ *	of the plaintext products mod p. The estimates follow the operations of
+ *	a layer from fresh encryptions and only need the parameters and the
+ *	size of the plaintext windows.
+ *
+ */
+
+#ifndef LBCRYPTO_CRYPTO_NOISE_H
+#define LBCRYPTO_CRYPTO_NOISE_H
+
+#include <functional>
+
+#include "utils/backend.h"
+#include "pke/fv.h"
+
+namespace lbcrypto {
+
+    struct NoiseEstimate {
+        double var;
+        // Variance over the keys of the part that the errors of the keys fix,
+        // the same for every ciphertext switched with them
+        double key_var;
+        double bound;
+    };
+
+    // Noise of a fresh encryption of any plaintext
+    NoiseEstimate EstimateEncrypt(const FVParams& params, const bool public_key = false);
+
+    NoiseEstimate EstimateAdd(const NoiseEstimate& x, const NoiseEstimate& y);
+
+    // Sum of terms ciphertexts with the noise of x. Terms switched with the
+    // same key, or products of the same ciphertext, add up coherently; those
+    // are summed with same_key.
+    NoiseEstimate EstimateSum(const NoiseEstimate& x, const ui64 terms, const bool same_key = false);
+
+    // Product with a plaintext polynomial, or a constant, below pt_bound
+    NoiseEstimate EstimateMultPlain(const NoiseEstimate& x, const ui64 pt_bound,
+            const FVParams& params);
+
+    NoiseEstimate EstimateMultScalar(const NoiseEstimate& x, const ui64 scalar_bound,
+            const FVParams& params);
+
+    // Key switching with params.window_size, rotations included
+    NoiseEstimate EstimateKeySwitch(const NoiseEstimate& x, const FVParams& params);
+
+    // Noise after ModSwitch to 2^bits, on the scale of q
+    NoiseEstimate EstimateModSwitch(const NoiseEstimate& x, const ui32 bits,
+            const FVParams& params);
+
+    // Same scale as NoiseMargin, for a coefficient several deviations out.
+    // Decryption needs more than 1, also after ModSwitch when estimated
+    // with EstimateModSwitch.
+    double EstimateMargin(const NoiseEstimate& x, const FVParams& params);
+
+    struct WindowPlan {
+        // Plaintext windows, for the preprocess functions of the layer
+        ui32 pt_window_size, pt_num_windows;
+
+        // Key switching window, for FVParams::window_size
+        ui32 window_size;
+
+        double margin;
+    };
+
+    // Noise of the output of a layer for a choice of plaintext windows, with
+    // the key switching window in params
+    typedef std::function<NoiseEstimate(const ui32 pt_window_size, const ui32 pt_num_windows,
+            const FVParams& params)> LayerNoise;
+
+    // The plan with the fewest plaintext windows, then the fewest key
+    // switching digits, whose estimated margin is at least min_margin.
+    // Layers whose output is switched down pass the noise through
+    // EstimateModSwitch. Throws if no plan is.
+    WindowPlan PlanWindows(const LayerNoise& layer_noise, const FVParams& params,
+            const double min_margin = 1);
+
+} // namespace lbcrypto ends
+#endif
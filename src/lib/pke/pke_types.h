@@ -22,6 +22,36 @@ namespace lbcrypto {
         Ciphertext(ui32 size) : a(size), b(size) {};
     };
 
+    // Unreduced sum of ciphertext-plaintext products, see EvalMultPlainAccumulate
+    struct CiphertextAccumulator {
+        uv128 a;
+        uv128 b;
+
+        // Products added since the last reduction
+        ui32 terms;
+
+        CiphertextAccumulator(ui32 size) : a(size), b(size), terms(0) {};
+    };
+
+    // Symmetric ciphertext whose a is expanded from a 128-bit seed, so that
+    // only the seed and b have to be sent
+    struct SeededCiphertext {
+        osuCrypto::block seed;
+        uv64 b;
+
+        SeededCiphertext(ui32 size) : seed(_mm_setzero_si128()), b(size) {};
+    };
+
+    // Ciphertext rescaled from q to 2^bits by ModSwitch, in the coefficient
+    // domain, for the results the server sends back to the client
+    struct CompressedCiphertext {
+        uv64 a;
+        uv64 b;
+        ui32 bits;
+
+        CompressedCiphertext(ui32 size, ui32 bits) : a(size), b(size), bits(bits) {};
+    };
+
     struct PublicKey {
         uv64 a;
         uv64 b;
@@ -36,6 +66,14 @@ namespace lbcrypto {
         RelinKey(ui32 size, ui32 windows) : a(windows, uv64(size)), b(windows, uv64(size)) {};
     };
 
+    // Key switching key whose a rows are expanded from a seed
+    struct SeededRelinKey {
+        osuCrypto::block seed;
+        std::vector<uv64> b;
+
+        SeededRelinKey(ui32 size, ui32 windows) : seed(_mm_setzero_si128()), b(windows, uv64(size)) {};
+    };
+
 
     struct SecretKey {
         uv64 s;
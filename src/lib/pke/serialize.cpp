@@ -0,0 +1,267 @@
+/*
+ * serialize.cpp
+ *
+ */
+
+#include <stdexcept>
+
+#include "pke/serialize.h"
+
+namespace lbcrypto {
+
+void put_reduced(BitPacker& packer, const uv64& poly, uv64& scratch, const ui64 modulus){
+    for (ui32 i=0; i<poly.size(); i++) {
+        ui64 x = poly[i];
+        while (x >= modulus) {
+            x -= modulus;
+        }
+        scratch[i] = x;
+    }
+    packer.put(scratch.data(), poly.size(), wire_bits(modulus));
+}
+
+void get_reduced(BitUnpacker& unpacker, uv64& poly, const ui64 modulus){
+    unpacker.get(poly, wire_bits(modulus));
+    for (auto x: poly) {
+        if (x >= modulus) {
+            throw std::logic_error("Value not reduced mod the modulus");
+        }
+    }
+}
+
+static void put_packed_seed(BitPacker& packer, const osuCrypto::block& seed){
+    ui64 words[2];
+    _mm_storeu_si128((__m128i*)words, seed);
+    packer.put(words, 2, 64);
+}
+
+static void get_packed_seed(BitUnpacker& unpacker, osuCrypto::block& seed){
+    ui64 words[2];
+    unpacker.get(words, 2, 64);
+    seed = _mm_loadu_si128((const __m128i*)words);
+}
+
+static void check_done(const BitUnpacker& unpacker){
+    if (!unpacker.done()) {
+        throw std::logic_error("Packed buffer too long");
+    }
+}
+
+static void put_ct(BitPacker& packer, const Ciphertext& ct, uv64& scratch,
+        const FVParams& params){
+    put_reduced(packer, ct.a, scratch, params.q);
+    put_reduced(packer, ct.b, scratch, params.q);
+}
+
+static void get_ct(BitUnpacker& unpacker, Ciphertext& ct, const FVParams& params){
+    get_reduced(unpacker, ct.a, params.q);
+    get_reduced(unpacker, ct.b, params.q);
+}
+
+static void put_seeded(BitPacker& packer, const SeededCiphertext& ct, uv64& scratch,
+        const FVParams& params){
+    put_packed_seed(packer, ct.seed);
+    put_reduced(packer, ct.b, scratch, params.q);
+}
+
+static void get_seeded(BitUnpacker& unpacker, SeededCiphertext& ct, const FVParams& params){
+    get_packed_seed(unpacker, ct.seed);
+    get_reduced(unpacker, ct.b, params.q);
+}
+
+// Size of count packed ciphertexts, to reserve the buffer up front
+static ui64 ct_words(const ui64 count, const bool seeded, const FVParams& params){
+    ui64 bits = seeded? (128 + params.phim*wire_bits(params.q)): 2*params.phim*wire_bits(params.q);
+    return packed_words(count*bits, 1);
+}
+
+uv64 Pack(const Ciphertext& ct, const FVParams& params){
+    BitPacker packer(ct_words(1, false, params));
+    uv64 scratch(params.phim);
+    put_ct(packer, ct, scratch, params);
+    return packer.take();
+}
+
+uv64 Pack(const std::vector<Ciphertext>& ct_vec, const FVParams& params){
+    BitPacker packer(ct_words(ct_vec.size(), false, params));
+    uv64 scratch(params.phim);
+    for (auto& ct: ct_vec) {
+        put_ct(packer, ct, scratch, params);
+    }
+    return packer.take();
+}
+
+uv64 Pack(const std::vector<std::vector<Ciphertext>>& ct_mat, const FVParams& params){
+    BitPacker packer(ct_words(ct_mat.size()*(ct_mat.empty()? 0: ct_mat[0].size()), false, params));
+    uv64 scratch(params.phim);
+    for (auto& ct_vec: ct_mat) {
+        for (auto& ct: ct_vec) {
+            put_ct(packer, ct, scratch, params);
+        }
+    }
+    return packer.take();
+}
+
+uv64 Pack(const std::vector<SeededCiphertext>& ct_vec, const FVParams& params){
+    BitPacker packer(ct_words(ct_vec.size(), true, params));
+    uv64 scratch(params.phim);
+    for (auto& ct: ct_vec) {
+        put_seeded(packer, ct, scratch, params);
+    }
+    return packer.take();
+}
+
+uv64 Pack(const std::vector<std::vector<SeededCiphertext>>& ct_mat, const FVParams& params){
+    BitPacker packer(ct_words(ct_mat.size()*(ct_mat.empty()? 0: ct_mat[0].size()), true, params));
+    uv64 scratch(params.phim);
+    for (auto& ct_vec: ct_mat) {
+        for (auto& ct: ct_vec) {
+            put_seeded(packer, ct, scratch, params);
+        }
+    }
+    return packer.take();
+}
+
+static void put_key(BitPacker& packer, const SeededRelinKey& rk, uv64& scratch,
+        const FVParams& params){
+    put_packed_seed(packer, rk.seed);
+    for (auto& b: rk.b) {
+        put_reduced(packer, b, scratch, params.q);
+    }
+}
+
+uv64 Pack(const SeededRelinKey& rk, const FVParams& params){
+    BitPacker packer;
+    uv64 scratch(params.phim);
+    put_key(packer, rk, scratch, params);
+    return packer.take();
+}
+
+uv64 Pack(const std::vector<SeededRelinKey>& rk_list, const FVParams& params){
+    BitPacker packer;
+    uv64 scratch(params.phim);
+    for (auto& rk: rk_list) {
+        put_key(packer, rk, scratch, params);
+    }
+    return packer.take();
+}
+
+uv64 Pack(const uv64& v, const ui64 modulus){
+    for (auto x: v) {
+        if (x >= modulus) {
+            throw std::logic_error("Value not reduced mod the modulus");
+        }
+    }
+    BitPacker packer(packed_words(v.size(), wire_bits(modulus)));
+    packer.put(v, wire_bits(modulus));
+    return packer.take();
+}
+
+uv64 Pack(const CompressedCiphertext& ct){
+    BitPacker packer(packed_words(2*ct.a.size(), ct.bits));
+    packer.put(ct.a, ct.bits);
+    packer.put(ct.b, ct.bits);
+    return packer.take();
+}
+
+uv64 Pack(const std::vector<CompressedCiphertext>& ct_vec){
+    ui64 bits = 0;
+    for (auto& ct: ct_vec) {
+        bits += 2*ct.a.size()*ct.bits;
+    }
+    BitPacker packer(packed_words(bits, 1));
+    for (auto& ct: ct_vec) {
+        packer.put(ct.a, ct.bits);
+        packer.put(ct.b, ct.bits);
+    }
+    return packer.take();
+}
+
+void Unpack(const uv64& buf, Ciphertext& ct, const FVParams& params){
+    BitUnpacker unpacker(buf);
+    get_ct(unpacker, ct, params);
+    check_done(unpacker);
+}
+
+void Unpack(const uv64& buf, std::vector<Ciphertext>& ct_vec, const FVParams& params){
+    BitUnpacker unpacker(buf);
+    for (auto& ct: ct_vec) {
+        get_ct(unpacker, ct, params);
+    }
+    check_done(unpacker);
+}
+
+void Unpack(const uv64& buf, std::vector<std::vector<Ciphertext>>& ct_mat,
+        const FVParams& params){
+    BitUnpacker unpacker(buf);
+    for (auto& ct_vec: ct_mat) {
+        for (auto& ct: ct_vec) {
+            get_ct(unpacker, ct, params);
+        }
+    }
+    check_done(unpacker);
+}
+
+void Unpack(const uv64& buf, std::vector<SeededCiphertext>& ct_vec, const FVParams& params){
+    BitUnpacker unpacker(buf);
+    for (auto& ct: ct_vec) {
+        get_seeded(unpacker, ct, params);
+    }
+    check_done(unpacker);
+}
+
+void Unpack(const uv64& buf, std::vector<std::vector<SeededCiphertext>>& ct_mat,
+        const FVParams& params){
+    BitUnpacker unpacker(buf);
+    for (auto& ct_vec: ct_mat) {
+        for (auto& ct: ct_vec) {
+            get_seeded(unpacker, ct, params);
+        }
+    }
+    check_done(unpacker);
+}
+
+static void get_key(BitUnpacker& unpacker, SeededRelinKey& rk, const FVParams& params){
+    get_packed_seed(unpacker, rk.seed);
+    for (auto& b: rk.b) {
+        get_reduced(unpacker, b, params.q);
+    }
+}
+
+void Unpack(const uv64& buf, SeededRelinKey& rk, const FVParams& params){
+    BitUnpacker unpacker(buf);
+    get_key(unpacker, rk, params);
+    check_done(unpacker);
+}
+
+void Unpack(const uv64& buf, std::vector<SeededRelinKey>& rk_list, const FVParams& params){
+    BitUnpacker unpacker(buf);
+    for (auto& rk: rk_list) {
+        get_key(unpacker, rk, params);
+    }
+    check_done(unpacker);
+}
+
+void Unpack(const uv64& buf, uv64& v, const ui64 modulus){
+    BitUnpacker unpacker(buf);
+    get_reduced(unpacker, v, modulus);
+    check_done(unpacker);
+}
+
+void Unpack(const uv64& buf, CompressedCiphertext& ct){
+    BitUnpacker unpacker(buf);
+    unpacker.get(ct.a, ct.bits);
+    unpacker.get(ct.b, ct.bits);
+    check_done(unpacker);
+}
+
+void Unpack(const uv64& buf, std::vector<CompressedCiphertext>& ct_vec){
+    BitUnpacker unpacker(buf);
+    for (auto& ct: ct_vec) {
+        unpacker.get(ct.a, ct.bits);
+        unpacker.get(ct.b, ct.bits);
+    }
+    check_done(unpacker);
+}
+
+}  // namespace lbcrypto ends
@@ -0,0 +1,85 @@
+/*
+ * serialize.h
+ *
+ *	Wire format of the ciphertexts, keys and shares. Coefficients mod q or
+ *	p are packed to the bit length of the modulus and a whole batch goes
+ *	into one buffer, to be sent as a single message.
+ *
+ */
+
+#ifndef LBCRYPTO_CRYPTO_SERIALIZE_H
+#define LBCRYPTO_CRYPTO_SERIALIZE_H
+
+#include "utils/backend.h"
+#include "utils/bitpack.h"
+#include "math/params.h"
+#include "pke/fv.h"
+#include "pke_types.h"
+
+namespace lbcrypto {
+
+    // Bits per value below modulus
+    inline ui32 wire_bits(const ui64 modulus){
+        return opt::bit_length(modulus - 1);
+    }
+
+    // Packs poly reduced mod modulus. Its values may be partially reduced,
+    // below 4*modulus like with the fast modulli. scratch holds poly.size().
+    void put_reduced(BitPacker& packer, const uv64& poly, uv64& scratch, const ui64 modulus);
+
+    // The inverse, throws on values that are not reduced
+    void get_reduced(BitUnpacker& unpacker, uv64& poly, const ui64 modulus);
+
+    // a and b of every ciphertext in order, reduced mod q. Seeded
+    // ciphertexts and keys are their seed followed by their b rows.
+    uv64 Pack(const Ciphertext& ct, const FVParams& params);
+
+    uv64 Pack(const std::vector<Ciphertext>& ct_vec, const FVParams& params);
+
+    uv64 Pack(const std::vector<std::vector<Ciphertext>>& ct_mat, const FVParams& params);
+
+    uv64 Pack(const std::vector<SeededCiphertext>& ct_vec, const FVParams& params);
+
+    uv64 Pack(const std::vector<std::vector<SeededCiphertext>>& ct_mat, const FVParams& params);
+
+    // One key per message, for keys sent as they are generated
+    uv64 Pack(const SeededRelinKey& rk, const FVParams& params);
+
+    uv64 Pack(const std::vector<SeededRelinKey>& rk_list, const FVParams& params);
+
+    // Values already reduced mod modulus, throws otherwise
+    uv64 Pack(const uv64& v, const ui64 modulus);
+
+    // Switched ciphertexts take their own bits per coefficient
+    uv64 Pack(const CompressedCiphertext& ct);
+
+    uv64 Pack(const std::vector<CompressedCiphertext>& ct_vec);
+
+    // The inverses fill containers shaped like the ones that were packed and
+    // throw if the buffer does not have the matching size, or holds values
+    // that are not reduced mod the modulus
+    void Unpack(const uv64& buf, Ciphertext& ct, const FVParams& params);
+
+    void Unpack(const uv64& buf, std::vector<Ciphertext>& ct_vec, const FVParams& params);
+
+    void Unpack(const uv64& buf, std::vector<std::vector<Ciphertext>>& ct_mat,
+            const FVParams& params);
+
+    void Unpack(const uv64& buf, std::vector<SeededCiphertext>& ct_vec, const FVParams& params);
+
+    void Unpack(const uv64& buf, std::vector<std::vector<SeededCiphertext>>& ct_mat,
+            const FVParams& params);
+
+    void Unpack(const uv64& buf, SeededRelinKey& rk, const FVParams& params);
+
+    void Unpack(const uv64& buf, std::vector<SeededRelinKey>& rk_list, const FVParams& params);
+
+    void Unpack(const uv64& buf, uv64& v, const ui64 modulus);
+
+    // The containers give the bits the ciphertexts were switched to
+    void Unpack(const uv64& buf, CompressedCiphertext& ct);
+
+    void Unpack(const uv64& buf, std::vector<CompressedCiphertext>& ct_vec);
+
+} // namespace lbcrypto ends
+#endif
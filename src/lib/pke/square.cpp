@@ -22,17 +22,22 @@ namespace lbcrypto{
 CTVec preprocess_client_share(const SecretKey& sk, const uv64& vec, const FVParams& params){
     std::vector<uv64> pt(2, uv64(params.phim));
     pt[0] = vec;
-    for(ui32 n=0; n<vec.size(); n++){
-        if(params.fast_modulli){
-            pt[1][n] = opt::modp_full(vec[n]*vec[n]);
-        } else {
+    if(params.fast_modulli){
+        opt::with_modulli(params.q, params.p, [&](auto m){
+            using M = decltype(m);
+            for(ui32 n=0; n<vec.size(); n++){
+                pt[1][n] = M::modp_full(vec[n]*vec[n]);
+            }
+        });
+    } else {
+        for(ui32 n=0; n<vec.size(); n++){
             pt[1][n] = mod(vec[n]*vec[n], params.p);
         }
     }
 
     CTVec ct_vec(2, Ciphertext(params.phim));
     for(ui32 i=0; i<2; i++){
-        auto pt_enc = packed_encode(pt[i], params.p, params.logn);
+        auto pt_enc = packed_encode(pt[i], params);
         ct_vec[i] = Encrypt(sk, pt_enc, params);
     }
 
@@ -41,11 +46,16 @@ CTVec preprocess_client_share(const SecretKey& sk, const uv64& vec, const FVPara
 
 std::tuple<std::vector<uv64>, uv64> preprocess_server_share(const uv64& vec, const FVParams& params){
     std::vector<uv64> pt(3, uv64(params.phim));
-    for(ui32 n=0; n<vec.size(); n++){
-        if(params.fast_modulli){
-            pt[0][n] = opt::modp_full(2*vec[n]);
-            pt[1][n] = opt::modp_full(vec[n]*vec[n]);
-        } else {
+    if(params.fast_modulli){
+        opt::with_modulli(params.q, params.p, [&](auto m){
+            using M = decltype(m);
+            for(ui32 n=0; n<vec.size(); n++){
+                pt[0][n] = M::modp_full(2*vec[n]);
+                pt[1][n] = M::modp_full(vec[n]*vec[n]);
+            }
+        });
+    } else {
+        for(ui32 n=0; n<vec.size(); n++){
             pt[0][n] = mod(2*vec[n], params.p);
             pt[1][n] = mod(vec[n]*vec[n], params.p);
         }
@@ -54,7 +64,7 @@ std::tuple<std::vector<uv64>, uv64> preprocess_server_share(const uv64& vec, con
 
     std::vector<uv64> ct_vec(3, uv64(params.phim));
     for(ui32 i=0; i<3; i++){
-        auto pt_enc = packed_encode(pt[i], params.p, params.logn);
+        auto pt_enc = packed_encode(pt[i], params);
         if(i != 0){
             for(ui32 n=0; n<params.phim; n++){
                 pt_enc[n] = pt_enc[n]*params.delta;
@@ -74,9 +84,10 @@ Ciphertext square_online(const CTVec& ct_vec_c, const std::vector<uv64>& pt_vec_
     return ct_share;
 }
 
-uv64 postprocess_client_share(const SecretKey& sk, const Ciphertext& ct,
+template <class CT>
+static uv64 postprocess_client_share_impl(const SecretKey& sk, const CT& ct,
         const ui32 vec_size, const FVParams& params){
-    auto pt = packed_decode(Decrypt(sk, ct, params), params.p, params.logn);
+    auto pt = packed_decode(Decrypt(sk, ct, params), params);
     uv64 vec(vec_size);
     for(ui32 n=0; n<vec_size; n++){
         vec[n] = pt[n];
@@ -85,6 +96,16 @@ uv64 postprocess_client_share(const SecretKey& sk, const Ciphertext& ct,
     return vec;
 }
 
+uv64 postprocess_client_share(const SecretKey& sk, const Ciphertext& ct,
+        const ui32 vec_size, const FVParams& params){
+    return postprocess_client_share_impl(sk, ct, vec_size, params);
+}
+
+uv64 postprocess_client_share(const SecretKey& sk, const CompressedCiphertext& ct,
+        const ui32 vec_size, const FVParams& params){
+    return postprocess_client_share_impl(sk, ct, vec_size, params);
+}
+
 uv64 square_pt(const uv64& vec_c, const uv64& vec_s, const uv64& vec_s_f, const ui64 p){
     uv64 vec_c_f(vec_c.size());
     for(ui32 n=0; n<vec_c.size(); n++){
@@ -22,6 +22,9 @@ namespace lbcrypto{
     uv64 postprocess_client_share(const SecretKey& sk, const Ciphertext& ct,
             const ui32 vec_size, const FVParams& params);
 
+    uv64 postprocess_client_share(const SecretKey& sk, const CompressedCiphertext& ct,
+            const ui32 vec_size, const FVParams& params);
+
     uv64 square_pt(const uv64& vec_c, const uv64& vec_s, const uv64& vec_s_f, const ui64 p);
 }
 
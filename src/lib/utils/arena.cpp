@@ -0,0 +1,113 @@
+/*
+ * arena.cpp
+ *
+ */
+
+#include <algorithm>
+#include <cstdlib>
+#include <stdexcept>
+#include <sys/mman.h>
+
+#include "utils/arena.h"
+
+namespace lbcrypto {
+
+    static size_t round_up(const size_t x, const size_t m){
+        return (x + m - 1)/m*m;
+    }
+
+    Arena::Arena(const size_t slab_bytes, const bool huge_pages) :
+            m_slab_bytes(round_up(slab_bytes, ARENA_ALIGNMENT)), m_huge_pages(huge_pages),
+            m_curr_slab(0), m_offset(0), m_used(0) {
+    }
+
+    Arena::~Arena() {
+        for (auto& slab: m_slabs) {
+            free_slab(slab);
+        }
+    }
+
+    Arena::Slab Arena::new_slab(const size_t bytes) {
+        Slab slab;
+        slab.size = std::max(bytes, m_slab_bytes);
+        if (m_huge_pages) {
+            slab.size = round_up(slab.size, (1 << 21));
+            void* p = mmap(nullptr, slab.size, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (p == MAP_FAILED) {
+                throw std::bad_alloc();
+            }
+#ifdef MADV_HUGEPAGE
+            madvise(p, slab.size, MADV_HUGEPAGE);
+#endif
+            slab.base = static_cast<char*>(p);
+        } else {
+            slab.base = static_cast<char*>(aligned_heap_allocate(slab.size));
+        }
+        return slab;
+    }
+
+    void Arena::free_slab(const Slab& slab) {
+        if (m_huge_pages) {
+            munmap(slab.base, slab.size);
+        } else {
+            aligned_heap_free(slab.base);
+        }
+    }
+
+    void* Arena::allocate(const size_t bytes) {
+        size_t size = round_up(std::max(bytes, (size_t)1), ARENA_ALIGNMENT);
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        // First slab after the current one that fits, a fresh one otherwise
+        while (m_curr_slab < m_slabs.size() &&
+                m_offset + size > m_slabs[m_curr_slab].size) {
+            m_curr_slab++;
+            m_offset = 0;
+        }
+        if (m_curr_slab == m_slabs.size()) {
+            m_slabs.push_back(new_slab(size));
+            m_offset = 0;
+        }
+
+        void* p = m_slabs[m_curr_slab].base + m_offset;
+        m_offset += size;
+        m_used += size;
+        return p;
+    }
+
+    void Arena::reset() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_curr_slab = 0;
+        m_offset = 0;
+        m_used = 0;
+    }
+
+    size_t Arena::bytes_used() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_used;
+    }
+
+    size_t Arena::bytes_reserved() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        size_t total = 0;
+        for (auto& slab: m_slabs) {
+            total += slab.size;
+        }
+        return total;
+    }
+
+    void* aligned_heap_allocate(const size_t bytes) {
+        void* p = nullptr;
+        if (posix_memalign(&p, ARENA_ALIGNMENT, round_up(std::max(bytes, (size_t)1),
+                ARENA_ALIGNMENT)) != 0) {
+            throw std::bad_alloc();
+        }
+        return p;
+    }
+
+    void aligned_heap_free(void* p) {
+        free(p);
+    }
+
+}
@@ -0,0 +1,140 @@
+/*
+ * arena.h
+ *
+ *	Storage for the polynomial vectors. Every buffer is 64-byte aligned.
+ *	uv64 always comes from the heap. av64 is carved in order from the slabs
+ *	of the Arena it is made with, for the scratch of the online layers, so
+ *	the buffers of one request sit in a contiguous run of memory. Freeing
+ *	arena buffers is a no-op: everything made from an arena stays allocated
+ *	until the whole arena is recycled with reset, typically once per server
+ *	request.
+ *
+ */
+
+#ifndef LBCRYPTO_UTILS_ARENA_H
+#define LBCRYPTO_UTILS_ARENA_H
+
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+namespace lbcrypto {
+
+    const size_t ARENA_ALIGNMENT = 64;
+
+    class Arena {
+    public:
+        // Slabs are at least slab_bytes. With huge_pages they are mapped
+        // directly and advised as transparent huge pages where supported.
+        explicit Arena(const size_t slab_bytes = (1 << 21), const bool huge_pages = false);
+        ~Arena();
+
+        Arena(const Arena&) = delete;
+        Arena& operator=(const Arena&) = delete;
+
+        // Thread safe, the buffer is aligned to ARENA_ALIGNMENT
+        void* allocate(const size_t bytes);
+
+        // Makes all the slabs available again. Every buffer handed out since
+        // the last reset must be dead by now.
+        void reset();
+
+        size_t bytes_used() const;
+        size_t bytes_reserved() const;
+
+    private:
+        struct Slab {
+            char* base;
+            size_t size;
+        };
+
+        Slab new_slab(const size_t bytes);
+        void free_slab(const Slab& slab);
+
+        const size_t m_slab_bytes;
+        const bool m_huge_pages;
+
+        std::vector<Slab> m_slabs;
+        size_t m_curr_slab, m_offset;
+        size_t m_used;
+        mutable std::mutex m_mutex;
+    };
+
+    void* aligned_heap_allocate(const size_t bytes);
+    void aligned_heap_free(void* p);
+
+    // Allocator of uv64, 64-byte aligned buffers from the heap
+    template <class T>
+    class AlignedAllocator {
+    public:
+        typedef T value_type;
+
+        AlignedAllocator() {};
+
+        template <class U>
+        AlignedAllocator(const AlignedAllocator<U>&) {};
+
+        T* allocate(const size_t n){
+            return static_cast<T*>(aligned_heap_allocate(n*sizeof(T)));
+        }
+
+        void deallocate(T* p, const size_t){
+            aligned_heap_free(p);
+        }
+    };
+
+    template <class T, class U>
+    inline bool operator==(const AlignedAllocator<T>&, const AlignedAllocator<U>&){
+        return true;
+    }
+
+    template <class T, class U>
+    inline bool operator!=(const AlignedAllocator<T>&, const AlignedAllocator<U>&){
+        return false;
+    }
+
+    // Allocator of av64, from the arena it is made with or the heap for
+    // nullptr. Copies of a container stay in its arena.
+    template <class T>
+    class ArenaAllocator {
+    public:
+        typedef T value_type;
+
+        explicit ArenaAllocator(Arena* arena) : m_arena(arena) {};
+
+        template <class U>
+        ArenaAllocator(const ArenaAllocator<U>& other) : m_arena(other.arena()) {};
+
+        T* allocate(const size_t n){
+            size_t bytes = n*sizeof(T);
+            return static_cast<T*>(m_arena? m_arena->allocate(bytes):
+                aligned_heap_allocate(bytes));
+        }
+
+        void deallocate(T* p, const size_t){
+            if (!m_arena) {
+                aligned_heap_free(p);
+            }
+        }
+
+        Arena* arena() const { return m_arena; }
+
+    private:
+        Arena* m_arena;
+    };
+
+    template <class T, class U>
+    inline bool operator==(const ArenaAllocator<T>& x, const ArenaAllocator<U>& y){
+        return x.arena() == y.arena();
+    }
+
+    template <class T, class U>
+    inline bool operator!=(const ArenaAllocator<T>& x, const ArenaAllocator<U>& y){
+        return x.arena() != y.arena();
+    }
+
+}
+
+#endif
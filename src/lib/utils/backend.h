@@ -12,6 +12,8 @@
 #include <inttypes.h>
 #include <vector>
 
+#include "utils/arena.h"
+
 /**
  * @namespace lbcrypto
  * The namespace of lbcrypto
@@ -26,7 +28,10 @@ namespace lbcrypto {
     typedef std::vector<si32> sv32;
     typedef std::vector<ui32> uv32;
     typedef std::vector<si64> sv64;
-    typedef std::vector<ui64> uv64;
+    // 64-byte aligned
+    typedef std::vector<ui64, AlignedAllocator<ui64>> uv64;
+    // Same, allocated from an explicit Arena, see arena.h
+    typedef std::vector<ui64, ArenaAllocator<ui64>> av64;
     typedef std::vector<ui128> uv128;
 
 
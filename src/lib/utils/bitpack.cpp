@@ -0,0 +1,74 @@
+/*
+ * bitpack.cpp
+ *
+ */
+
+#include <stdexcept>
+
+#include "utils/bitpack.h"
+
+namespace lbcrypto {
+
+    static void check_bits(const ui32 bits){
+        if (bits == 0 || bits > 64) {
+            throw std::logic_error("Packed values must have 1 to 64 bits");
+        }
+    }
+
+    static inline ui64 low_mask(const ui32 bits){
+        return (bits == 64)? ~(ui64)0: (((ui64)1 << bits) - 1);
+    }
+
+    BitPacker::BitPacker(const ui64 reserve_words) : m_bits(0) {
+        m_buf.reserve(reserve_words);
+    }
+
+    void BitPacker::put(const ui64* in, const ui64 n, const ui32 bits){
+        check_bits(bits);
+        m_buf.resize(packed_words(m_bits + n*bits, 1), 0);
+
+        ui64 mask = low_mask(bits);
+        ui64* out = m_buf.data();
+        for (ui64 i = 0; i < n; i++) {
+            ui64 x = in[i] & mask;
+            ui64 word = m_bits >> 6;
+            ui32 off = m_bits & 63;
+            out[word] |= x << off;
+            if (off + bits > 64) {
+                out[word + 1] |= x >> (64 - off);
+            }
+            m_bits += bits;
+        }
+    }
+
+    uv64 BitPacker::take(){
+        uv64 buf = std::move(m_buf);
+        m_buf.clear();
+        m_bits = 0;
+        return buf;
+    }
+
+    BitUnpacker::BitUnpacker(const uv64& buf) : m_buf(buf), m_bits(0) {
+    }
+
+    void BitUnpacker::get(ui64* out, const ui64 n, const ui32 bits){
+        check_bits(bits);
+        if (packed_words(m_bits + n*bits, 1) > m_buf.size()) {
+            throw std::logic_error("Packed buffer too short");
+        }
+
+        ui64 mask = low_mask(bits);
+        const ui64* in = m_buf.data();
+        for (ui64 i = 0; i < n; i++) {
+            ui64 word = m_bits >> 6;
+            ui32 off = m_bits & 63;
+            ui64 x = in[word] >> off;
+            if (off + bits > 64) {
+                x |= in[word + 1] << (64 - off);
+            }
+            out[i] = x & mask;
+            m_bits += bits;
+        }
+    }
+
+}
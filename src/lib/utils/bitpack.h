@@ -0,0 +1,65 @@
+/*
+ * bitpack.h
+ *
+ *	Packing of values below 2^bits into a contiguous stream of 64-bit
+ *	words, without padding between values or between the vectors put into
+ *	one packer.
+ *
+ */
+
+#ifndef LBCRYPTO_UTILS_BITPACK_H
+#define LBCRYPTO_UTILS_BITPACK_H
+
+#include "utils/backend.h"
+
+namespace lbcrypto {
+
+    // Words taken by n values of bits bits each
+    inline ui64 packed_words(const ui64 n, const ui32 bits){
+        return (n*bits + 63)/64;
+    }
+
+    class BitPacker {
+    public:
+        explicit BitPacker(const ui64 reserve_words = 0);
+
+        // Only the low bits bits of each value are kept
+        void put(const ui64* in, const ui64 n, const ui32 bits);
+
+        void put(const uv64& v, const ui32 bits){
+            put(v.data(), v.size(), bits);
+        }
+
+        ui64 size_bits() const { return m_bits; }
+
+        // The packed words, the packer is left empty. Moving the result into
+        // Channel::asyncSend sends it without a copy.
+        uv64 take();
+
+    private:
+        uv64 m_buf;
+        ui64 m_bits;
+    };
+
+    class BitUnpacker {
+    public:
+        explicit BitUnpacker(const uv64& buf);
+
+        // Throws if the buffer runs out
+        void get(ui64* out, const ui64 n, const ui32 bits);
+
+        void get(uv64& v, const ui32 bits){
+            get(v.data(), v.size(), bits);
+        }
+
+        // Whether everything up to the padding of the last word was read
+        bool done() const { return (m_bits + 63)/64 == m_buf.size(); }
+
+    private:
+        const uv64& m_buf;
+        ui64 m_bits;
+    };
+
+}
+
+#endif
@@ -12,8 +12,8 @@ namespace lbcrypto {
 
 sv64 to_signed(uv64 v, ui64 p);
 
-template<typename IntType>
-std::string vec_to_str(std::vector<IntType> v){
+template<typename IntType, typename Alloc>
+std::string vec_to_str(std::vector<IntType, Alloc> v){
     std::string str;
     for(ui32 i=0; i<v.size(); i++){
         str += std::to_string(v[i]) + " ";
@@ -22,8 +22,8 @@ std::string vec_to_str(std::vector<IntType> v){
     return str;
 }
 
-template<typename IntType>
-std::string mat_to_str(std::vector<std::vector<IntType>> m){
+template<typename IntType, typename Alloc>
+std::string mat_to_str(std::vector<std::vector<IntType, Alloc>> m){
     std::string str;
     for(ui32 j=0; j<m.size(); j++){
         for(ui32 i=0; i<m[0].size(); i++){
@@ -35,8 +35,8 @@ std::string mat_to_str(std::vector<std::vector<IntType>> m){
     return str;
 }
 
-template<typename IntType>
-void check_vec_eq(std::vector<IntType> v1, std::vector<IntType> v2,
+template<typename IntType, typename Alloc>
+void check_vec_eq(std::vector<IntType, Alloc> v1, std::vector<IntType, Alloc> v2,
         const std::string& what){
     if(v1 != v2){
         std::cout << vec_to_str(v1) << std::endl;
@@ -47,10 +47,10 @@ void check_vec_eq(std::vector<IntType> v1, std::vector<IntType> v2,
     return;
 }
 
-template<typename IntType>
+template<typename IntType, typename Alloc>
 void check_mat_eq(
-        std::vector<std::vector<IntType>> m1,
-        std::vector<std::vector<IntType>> m2,
+        std::vector<std::vector<IntType, Alloc>> m1,
+        std::vector<std::vector<IntType, Alloc>> m2,
         const std::string& what){
     if(m1.size() != m2.size()){
         std::cout << "Sizes: " << m1.size() << " " << m1.size() << std::endl;
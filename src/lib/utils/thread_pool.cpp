@@ -0,0 +1,117 @@
+/*
+ * thread_pool.cpp
+ *
+ */
+
+#include <atomic>
+#include <exception>
+#include <memory>
+
+#include "utils/thread_pool.h"
+
+namespace lbcrypto {
+
+    ThreadPool::ThreadPool(const ui32 num_threads) : m_stop(false) {
+        for (ui32 i = 1; i < num_threads; i++) {
+            m_workers.emplace_back([this]() { worker_loop(); });
+        }
+    }
+
+    ThreadPool::~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_cv.notify_all();
+        for (auto& worker: m_workers) {
+            worker.join();
+        }
+    }
+
+    void ThreadPool::worker_loop() {
+        while (true) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_cv.wait(lock, [this]() { return m_stop || !m_tasks.empty(); });
+                if (m_tasks.empty()) {
+                    return;
+                }
+                task = std::move(m_tasks.front());
+                m_tasks.pop_front();
+            }
+            task();
+        }
+    }
+
+    // Shared between the caller and the helpers, which may only get to run
+    // after the loop is over
+    struct ParallelLoop {
+        std::function<void(ui32)> f;
+        ui32 count;
+        std::atomic<ui32> next;
+        std::atomic<ui32> done;
+        std::exception_ptr error;
+        std::mutex mutex;
+        std::condition_variable cv;
+
+        void run() {
+            ui32 i;
+            while ((i = next++) < count) {
+                try {
+                    f(i);
+                } catch (...) {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    if (!error) {
+                        error = std::current_exception();
+                    }
+                }
+                if (++done == count) {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    cv.notify_all();
+                }
+            }
+        }
+    };
+
+    void ThreadPool::parallel_for(const ui32 count, const std::function<void(ui32)>& f) {
+        if (count == 0) {
+            return;
+        }
+        if (count == 1 || m_workers.empty()) {
+            for (ui32 i = 0; i < count; i++) {
+                f(i);
+            }
+            return;
+        }
+
+        auto loop = std::make_shared<ParallelLoop>();
+        loop->f = f;
+        loop->count = count;
+        loop->next = 0;
+        loop->done = 0;
+
+        ui32 helpers = std::min<ui32>(m_workers.size(), count-1);
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            for (ui32 i = 0; i < helpers; i++) {
+                m_tasks.emplace_back([loop]() { loop->run(); });
+            }
+        }
+        m_cv.notify_all();
+
+        loop->run();
+
+        std::unique_lock<std::mutex> lock(loop->mutex);
+        loop->cv.wait(lock, [&loop]() { return loop->done == loop->count; });
+        if (loop->error) {
+            std::rethrow_exception(loop->error);
+        }
+    }
+
+    ThreadPool& get_thread_pool() {
+        static ThreadPool pool(std::max(1u, std::thread::hardware_concurrency()));
+        return pool;
+    }
+
+}
@@ -0,0 +1,55 @@
+/*
+ * thread_pool.h
+ *
+ *	Fixed set of worker threads for the bulk loops of the library. The
+ *	calling thread always takes part in its own loops, so nested loops and
+ *	loops issued while the workers are busy cannot deadlock.
+ *
+ */
+
+#ifndef LBCRYPTO_UTILS_THREAD_POOL_H
+#define LBCRYPTO_UTILS_THREAD_POOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "utils/backend.h"
+
+namespace lbcrypto {
+
+    class ThreadPool {
+    public:
+        // num_threads counts the calling thread, so num_threads-1 workers are
+        // started and a pool of size 1 runs everything inline
+        explicit ThreadPool(const ui32 num_threads);
+        ~ThreadPool();
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        ui32 size() const { return m_workers.size() + 1; }
+
+        // Calls f(i) for every i in [0, count) and returns once all the calls
+        // are done. The first exception thrown by f is rethrown here.
+        void parallel_for(const ui32 count, const std::function<void(ui32)>& f);
+
+    private:
+        void worker_loop();
+
+        std::vector<std::thread> m_workers;
+        std::deque<std::function<void()>> m_tasks;
+        std::mutex m_mutex;
+        std::condition_variable m_cv;
+        bool m_stop;
+    };
+
+    // Process wide pool with one thread per hardware thread
+    ThreadPool& get_thread_pool();
+
+}
+
+#endif
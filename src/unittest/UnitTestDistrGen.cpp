@@ -32,6 +32,7 @@
 
 #include "include/gtest/gtest.h"
 #include <iostream>
+#include <thread>
 
 #include "utils/debug.h"
 #include "math/backend.h"
@@ -68,7 +69,23 @@ TEST(UTPRNG, PRNG ) {
         }
     }
 
-    EXPECT_LT(max_output, 2) << "Failure in testing PRNG";
+    EXPECT_LT(max_output, 2u) << "Failure in testing PRNG";
+}
+
+TEST(UTPRNG, Seed) {
+    // The calling thread and threads started after the seed get the same
+    // streams for the same seed
+    auto draw = [](){
+        uv64 v = get_dug_vector(1000, 1 << 30);
+        std::thread([&](){ v.push_back(get_dug_vector(1, 1 << 30)[0]); }).join();
+        return v;
+    };
+    set_prng_seed(osuCrypto::toBlock(7));
+    auto v1 = draw();
+    set_prng_seed(osuCrypto::toBlock(7));
+    EXPECT_EQ(v1, draw());
+    set_prng_seed(osuCrypto::toBlock(8));
+    EXPECT_NE(v1, draw());
 }
 
 
@@ -90,10 +107,15 @@ TEST(UTDistrGen, DiscreteUniformGenerator_LONG ) {
     ui64 large_modulus(100019);
     testDiscreteUniformGenerator(large_modulus, "large_modulus");
   }
-  if( MATH_DEFBITS > 64 ) {
-    // TEST CASE ON FIRST AND SECOND CENTRAL MOMENTS HUGE MODULUS
-    ui64 huge_modulus(10/*"10402635286389262637365363"*/);
-    testDiscreteUniformGenerator(huge_modulus, "huge_modulus");
+  {
+    // About half of the 32-bit words are rejected for this one
+    ui64 rejecting_modulus(((ui64)1 << 31) + 1);
+    testDiscreteUniformGenerator(rejecting_modulus, "rejecting_modulus");
+  }
+  {
+    // Sampled from 64-bit words
+    ui64 q_modulus(opt::q);
+    testDiscreteUniformGenerator(q_modulus, "q_modulus");
   }
 
 } //end TEST(UTDistrGen, DiscreteUniformGenerator)
@@ -108,7 +130,7 @@ void testDiscreteUniformGenerator(ui64 &modulus, std::string test_name){
     uv64 rand_vec = get_dug_vector(size, modulus);
 
     ui64 min_output = *std::min_element(rand_vec.begin(), rand_vec.end());
-    EXPECT_GE(min_output, 0) << "Failure testing min_value";
+    EXPECT_GE(min_output, 0u) << "Failure testing min_value";
 
     ui64 max_output = *std::max_element(rand_vec.begin(), rand_vec.end());
     EXPECT_LT(max_output, modulus) << "Failure testing max_value";
@@ -160,11 +182,6 @@ TEST(UTDistrGen, ParallelDiscreteUniformGenerator_LONG ) {
   ui64 large_modulus(100019);// test large modulus
   testParallelDiscreteUniformGenerator(large_modulus, "large_modulus");
 
-  if( MATH_DEFBITS > 64 ) {
-      ui64 huge_modulus(10/*10402635286389262637365363*/);
-      testParallelDiscreteUniformGenerator(huge_modulus, "huge_modulus");
-  }
-
 }
 
 //
@@ -381,7 +398,7 @@ TEST(UTDistrGen, ParallelDiscreteGaussianGenerator_LONG) {
 #pragma omp parallel // this is executed in parallel
         {
             //private copies of our vector
-            vector <ui64> dggBigVectorPvt;
+            uv64 dggBigVectorPvt;
             DiscreteGaussianGenerator dgg = lbcrypto::DiscreteGaussianGenerator(stdev);
 
             // build the vectors in parallel
@@ -428,7 +445,7 @@ TEST(UTDistrGen, ParallelDiscreteGaussianGenerator_LONG) {
 #pragma omp parallel // this is executed in parallel
         {
             //private copies of our vector
-            vector <ui64> dggBigVectorPvt;
+            uv64 dggBigVectorPvt;
             DiscreteGaussianGenerator dgg = lbcrypto::DiscreteGaussianGenerator(stdev);
 
             // build the vectors in parallel
@@ -465,3 +482,37 @@ TEST(UTDistrGen, ParallelDiscreteGaussianGenerator_LONG) {
 
     }
 }
+
+TEST(UTDistrGen, DiscreteGaussianGeneratorCDT) {
+    double stdev = 4;
+    ui32 size = 100000;
+    ui64 modulus(10403);
+    DiscreteGaussianGenerator dgg = lbcrypto::DiscreteGaussianGenerator(stdev);
+
+    // A given stream always gives the same samples
+    osuCrypto::block seed = get_seed();
+    uv64 v1(size), v2(size);
+    osuCrypto::PRNG prng1(seed), prng2(seed);
+    dgg.FillVector(v1.data(), size, modulus, prng1);
+    dgg.FillVector(v2.data(), size, modulus, prng2);
+    EXPECT_EQ(v1, v2);
+
+    double mean = 0, variance = 0;
+    for (ui32 i = 0; i < size; i++) {
+        double x = (v1[i] <= (modulus-1)/2)? (double)v1[i]: -(double)(modulus-v1[i]);
+        EXPECT_LE(std::abs(x), 10*stdev) << "Failure testing tail bound";
+        mean += x;
+        variance += x*x;
+    }
+    mean /= size;
+    variance = variance/size - mean*mean;
+
+    EXPECT_LT(std::abs(mean), 0.1) << "Failure testing mean";
+    EXPECT_LT(std::abs(sqrt(variance) - stdev), 0.05*stdev) << "Failure testing standard deviation";
+
+    // Independent streams per thread
+    uv64 v3(size);
+    osuCrypto::PRNG prng3(get_seed());
+    dgg.FillVector(v3.data(), size, modulus, prng3);
+    EXPECT_NE(v1, v3);
+}
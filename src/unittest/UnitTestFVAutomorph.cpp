@@ -29,6 +29,8 @@
 
 #include "include/gtest/gtest.h"
 #include <iostream>
+#include <thread>
+#include <unistd.h>
 
 #include "../lib/pke/gazelle.h"
 
@@ -80,10 +82,10 @@ TEST(UTFV_Automorph, Ref){
     }
 
     //-------------------- Relin KeyGen --------------------
-    EvalAutomorphismKeyGen(kp.sk, index_list, test_params);
+    auto keys = EvalAutomorphismKeyGen(kp.sk, index_list, test_params);
 
     //------------------- EvalAutomorph --------------------
-    auto ct_rot = EvalAutomorphism(rot, ct1, test_params);
+    auto ct_rot = EvalAutomorphism(rot, keys, ct1, test_params);
 
     //----------------------- Check ------------------------
     auto v1_rot = packed_decode(Decrypt(kp.sk, ct_rot, test_params), opt::p, opt::logn);
@@ -126,10 +128,10 @@ TEST(UTFV_Automorph, Fast){
     }
 
     //-------------------- Relin KeyGen --------------------
-    EvalAutomorphismKeyGen(kp.sk, index_list, test_params);
+    auto keys = EvalAutomorphismKeyGen(kp.sk, index_list, test_params);
 
     //------------------- EvalAutomorph --------------------
-    auto ct_rot = EvalAutomorphism(rot, ct1, test_params);
+    auto ct_rot = EvalAutomorphism(rot, keys, ct1, test_params);
 
     //----------------------- Check ------------------------
     auto v1_rot = packed_decode(Decrypt(kp.sk, ct_rot, test_params), opt::p, opt::logn);
@@ -138,3 +140,315 @@ TEST(UTFV_Automorph, Fast){
     EXPECT_EQ(v1_rot_ref, v1_rot);
 
 }
+
+TEST(UTFV_Automorph, Context){
+    //------------------ Setup Parameters ------------------
+    // A smaller ring than the registered tables, all of its tables come
+    // from the context
+    ui32 logn = opt::logn-1;
+    ui32 phim = (1 << logn);
+    ui64 z = RootOfUnity(phim << 1, opt::q);
+    ui64 z_p = RootOfUnity(phim << 1, opt::p);
+
+    DiscreteGaussianGenerator dgg = DiscreteGaussianGenerator(4.0);
+
+    FVParams test_params {
+        true,
+        opt::q, opt::p, logn, phim,
+        (opt::q/opt::p),
+        OPTIMIZED, std::make_shared<DiscreteGaussianGenerator>(dgg),
+        20,
+        std::make_shared<const FVContext>(opt::q, z, opt::p, z_p, logn)
+    };
+
+    auto kp = KeyGen(test_params);
+    uv64 v1 = get_dgg_testvector(phim, opt::p);
+    uv64 pt1 = packed_encode(v1, test_params);
+    auto ct1 = Encrypt(kp.sk, pt1, test_params);
+    ui32 rot = 4;
+
+    uv32 index_list(logn);
+    ui32 index = 1;
+    for(ui32 i=0; i<logn; i++){
+        index_list[i] = index;
+        index = index*2;
+    }
+
+    //-------------------- Relin KeyGen --------------------
+    auto keys = EvalAutomorphismKeyGen(kp.sk, index_list, test_params);
+
+    //------------------- EvalAutomorph --------------------
+    auto ct_rot = EvalAutomorphism(rot, keys, ct1, test_params);
+
+    //----------------------- Check ------------------------
+    auto v1_rot = packed_decode(Decrypt(kp.sk, ct_rot, test_params), test_params);
+    uv64 v1_rot_ref = automorph_pt(v1, rot);
+
+    EXPECT_EQ(v1_rot_ref, v1_rot);
+}
+
+TEST(UTFV_Automorph, EvalPermutation){
+    ui32 logn = 6;
+    ui32 phim = (1 << logn);
+    ui64 modulus = FirstPrime(30, phim << 1);
+    NttContext ntt(RootOfUnity(phim << 1, modulus), modulus, logn);
+    AutomorphContext ctx(phim);
+
+    uv64 x = get_dug_vector(phim, modulus);
+    uv64 X(phim);
+    ftt_fwd(ntt, x.data(), X.data());
+
+    for (ui32 rot = 0; rot < phim; rot++) {
+        // x(X^g) in the coefficient domain, with X^phim = -1
+        ui32 g = ctx.index[rot];
+        uv64 x_rot(phim);
+        for (ui32 i = 0; i < phim; i++) {
+            ui32 e = (i*g) & ((phim << 1) - 1);
+            if (e < phim) {
+                x_rot[e] = x[i];
+            } else {
+                x_rot[e - phim] = (x[i] == 0)? 0: modulus - x[i];
+            }
+        }
+        uv64 X_rot_ref(phim);
+        ftt_fwd(ntt, x_rot.data(), X_rot_ref.data());
+
+        EXPECT_EQ(X_rot_ref, automorph(X, rot, ctx)) << "rotation " << rot;
+    }
+}
+
+TEST(UTFV_Automorph, Hybrid){
+    //------------------ Setup Parameters ------------------
+    DiscreteGaussianGenerator dgg = DiscreteGaussianGenerator(4.0);
+    auto test_params = MakeFVParams(get_param_set("n2048_p20"), OPTIMIZED,
+            std::make_shared<DiscreteGaussianGenerator>(dgg), 20);
+
+    // The ciphertext modulus of another set of the same dimension serves as
+    // the special prime
+    const auto& sp_set = get_param_set("n2048_p19");
+    ui64 sp = sp_set.q;
+    ui64 z_sp = sp_set.z;
+
+    auto kp = KeyGen(test_params);
+    uv64 v1 = get_dgg_testvector(test_params.phim, test_params.p);
+    uv64 pt1 = packed_encode(v1, test_params);
+    auto ct1 = Encrypt(kp.sk, pt1, test_params);
+    ui32 rot = 5;
+
+    // A single digit, and a split into two digits
+    for (ui32 digit_bits: {60, 30}) {
+        SpecialPrimeContext sp_ctx(sp, z_sp, digit_bits, test_params);
+        EXPECT_EQ(sp_ctx.num_digits, 60/digit_bits);
+
+        auto rk = HybridAutomorphismKeyGen(kp.sk, rot, sp_ctx, test_params);
+        auto ct_rot = HybridEvalAutomorphism(rot, rk, ct1, sp_ctx, test_params);
+
+        auto v1_rot = packed_decode(Decrypt(kp.sk, ct_rot, test_params), test_params);
+        EXPECT_EQ(automorph_pt(v1, rot), v1_rot) << "digit bits " << digit_bits;
+
+        // Key switching to the same key
+        auto rk_id = HybridKeySwitchGen(kp.sk, kp.sk, sp_ctx, test_params);
+        auto ct_id = HybridKeySwitch(rk_id, ct1, sp_ctx, test_params);
+        EXPECT_EQ(v1, packed_decode(Decrypt(kp.sk, ct_id, test_params), test_params));
+
+        // Less noise than the window_size gadget
+        auto ct_ref = KeySwitch(KeySwitchGen(kp.sk, kp.sk, test_params), ct1, test_params);
+        EXPECT_GT(NoiseMargin(kp.sk, ct_id, test_params), NoiseMargin(kp.sk, ct_ref, test_params));
+    }
+}
+
+TEST(UTFV_Automorph, Seeded){
+    //------------------ Setup Parameters ------------------
+    DiscreteGaussianGenerator dgg = DiscreteGaussianGenerator(4.0);
+    auto test_params = MakeFVParams(get_param_set("n2048_p20"), OPTIMIZED,
+            std::make_shared<DiscreteGaussianGenerator>(dgg), 20);
+
+    auto kp = KeyGen(test_params);
+    uv64 v1 = get_dgg_testvector(test_params.phim, test_params.p);
+    uv64 pt1 = packed_encode(v1, test_params);
+    auto ct1 = Encrypt(kp.sk, pt1, test_params);
+    uv32 index_list = {3, 64};
+
+    //-------------------- Relin KeyGen --------------------
+    // Every key is handed out once, in order, as it is done
+    uv32 order;
+    std::vector<uv64> rk_bufs;
+    auto rk_list = EvalAutomorphismKeyGenSeeded(kp.sk, index_list, test_params,
+            [&](const ui32 n, const SeededRelinKey& rk){
+        order.push_back(n);
+        rk_bufs.push_back(Pack(rk, test_params));
+    });
+    ASSERT_EQ(rk_list.size(), index_list.size());
+    EXPECT_EQ(order, uv32({0, 1}));
+    SeededRelinKey rk_recv(test_params.phim, rk_list[1].b.size());
+    Unpack(rk_bufs[1], rk_recv, test_params);
+    EXPECT_EQ(rk_list[1].b, rk_recv.b);
+
+    // Keys from one seed are reproducible
+    osuCrypto::block seed = get_seed();
+    osuCrypto::PRNG prng1(seed), prng2(seed);
+    auto kp_seeded = KeyGen(test_params, prng1);
+    EXPECT_EQ(kp_seeded.sk.s, KeyGen(test_params, prng2).sk.s);
+    auto rk_seeded = EvalAutomorphismKeyGenSeeded(kp_seeded.sk, index_list, test_params, prng1);
+    auto rk_again = EvalAutomorphismKeyGenSeeded(kp_seeded.sk, index_list, test_params, prng2);
+    for (ui32 n = 0; n < index_list.size(); n++) {
+        EXPECT_EQ(rk_seeded[n].b, rk_again[n].b);
+    }
+    AutomorphismKeys keys;
+    for (ui32 n = 0; n < index_list.size(); n++) {
+        AddAutomorphismKey(keys, index_list[n], rk_list[n], test_params);
+    }
+
+    // The expansion only depends on the seed
+    auto rk = Expand(rk_list[0], test_params);
+    EXPECT_EQ(rk.a, GetAutomorphismKey(keys, index_list[0]).a);
+    EXPECT_NE(rk.a, GetAutomorphismKey(keys, index_list[1]).a);
+
+    //------------------- EvalAutomorph --------------------
+    for (auto rot: index_list) {
+        auto ct_rot = EvalAutomorphism(rot, keys, ct1, test_params);
+        auto v1_rot = packed_decode(Decrypt(kp.sk, ct_rot, test_params), test_params);
+        EXPECT_EQ(automorph_pt(v1, rot), v1_rot) << "rotation " << rot;
+    }
+}
+
+TEST(UTFV_Automorph, Batch){
+    //------------------ Setup Parameters ------------------
+    DiscreteGaussianGenerator dgg = DiscreteGaussianGenerator(4.0);
+    auto test_params = MakeFVParams(get_param_set("n2048_p20"), OPTIMIZED,
+            std::make_shared<DiscreteGaussianGenerator>(dgg), 20);
+
+    auto kp = KeyGen(test_params);
+    uv64 v1 = get_dgg_testvector(test_params.phim, test_params.p);
+    uv64 pt1 = packed_encode(v1, test_params);
+    auto ct1 = Encrypt(kp.sk, pt1, test_params);
+    uv32 index_list = {1, 5, 0, 1024, 1029, 5};
+
+    //-------------------- Relin KeyGen --------------------
+    auto keys = EvalAutomorphismKeyGen(kp.sk, {1, 5, 1024, 1029}, test_params);
+
+    //------------------- EvalAutomorph --------------------
+    auto ct_par = EvalAutomorphismBatch(ct1, index_list, keys, test_params);
+    auto ct_ser = EvalAutomorphismBatch(ct1, index_list, keys, test_params, false);
+
+    //----------------------- Check ------------------------
+    ASSERT_EQ(ct_par.size(), index_list.size());
+    ASSERT_EQ(ct_ser.size(), index_list.size());
+    for (ui32 n = 0; n < index_list.size(); n++) {
+        auto rot = index_list[n];
+        auto v1_rot = packed_decode(Decrypt(kp.sk, ct_par[n], test_params), test_params);
+        EXPECT_EQ(automorph_pt(v1, rot), v1_rot) << "rotation " << rot;
+        EXPECT_EQ(ct_par[n].a, ct_ser[n].a);
+        EXPECT_EQ(ct_par[n].b, ct_ser[n].b);
+        if (rot != 0) {
+            auto ct_rot = EvalAutomorphism(rot, keys, ct1, test_params);
+            EXPECT_EQ(ct_rot.a, ct_par[n].a);
+            EXPECT_EQ(ct_rot.b, ct_par[n].b);
+        }
+    }
+
+    EXPECT_THROW(EvalAutomorphismBatch(ct1, {7}, keys, test_params), std::logic_error);
+}
+
+TEST(UTFV_Automorph, KeyStore){
+    //------------------ Setup Parameters ------------------
+    DiscreteGaussianGenerator dgg = DiscreteGaussianGenerator(4.0);
+    auto test_params = MakeFVParams(get_param_set("n2048_p20"), OPTIMIZED,
+            std::make_shared<DiscreteGaussianGenerator>(dgg), 20);
+    uv32 index_list = {1, 5};
+
+    // Two clients with keys of their own
+    std::vector<KeyPair> kp_list = {KeyGen(test_params), KeyGen(test_params)};
+    std::vector<std::vector<SeededRelinKey>> rk_lists;
+    for (const auto& kp: kp_list) {
+        rk_lists.push_back(EvalAutomorphismKeyGenSeeded(kp.sk, index_list, test_params));
+    }
+    uv64 v1 = get_dgg_testvector(test_params.phim, test_params.p);
+    uv64 pt1 = packed_encode(v1, test_params);
+
+    auto check_session = [&](KeyStore& store, const SessionId session){
+        auto keys = store.Acquire(session);
+        ASSERT_TRUE(keys != nullptr) << "session " << session;
+        const auto& sk = kp_list[session].sk;
+        for (auto rot: index_list) {
+            auto ct_rot = EvalAutomorphism(rot, *keys, Encrypt(sk, pt1, test_params), test_params);
+            auto v1_rot = packed_decode(Decrypt(sk, ct_rot, test_params), test_params);
+            EXPECT_EQ(automorph_pt(v1, rot), v1_rot) << "session " << session << " rotation " << rot;
+        }
+    };
+
+    //-------------------- Sessions ------------------------
+    KeyStore store(test_params);
+    EXPECT_EQ(store.Acquire(0), nullptr);
+    store.Add(0, {index_list[0]}, {rk_lists[0][0]});
+    auto keys_0 = store.Acquire(0);
+    store.Add(0, {index_list[1]}, {rk_lists[0][1]});
+    store.Add(1, index_list, rk_lists[1]);
+
+    // Earlier acquisitions keep the keys they had
+    EXPECT_EQ(keys_0->size(), 1u);
+    EXPECT_EQ(store.Acquire(0)->size(), 2u);
+    size_t session_bytes = AutomorphismKeyBytes(*store.Acquire(1));
+    EXPECT_EQ(store.bytes_used(), 2*session_bytes);
+
+    // Requests of both sessions at once
+    std::vector<std::thread> threads;
+    for (SessionId session = 0; session < 2; session++) {
+        threads.emplace_back([&, session](){ check_session(store, session); });
+    }
+    for (auto& t: threads) {
+        t.join();
+    }
+
+    store.Remove(0);
+    EXPECT_FALSE(store.Contains(0));
+    EXPECT_EQ(store.bytes_used(), session_bytes);
+
+    //-------------------- Eviction ------------------------
+    // Room for one session, the least recently used one is dropped
+    KeyStore small_store(test_params, session_bytes);
+    small_store.Add(0, index_list, rk_lists[0]);
+    small_store.Add(1, index_list, rk_lists[1]);
+    EXPECT_EQ(small_store.Acquire(0), nullptr);
+    EXPECT_EQ(small_store.bytes_used(), session_bytes);
+
+    // Sessions held by a request stay resident
+    auto keys_1 = small_store.Acquire(1);
+    small_store.Add(0, index_list, rk_lists[0]);
+    EXPECT_TRUE(small_store.Contains(1));
+    keys_1.reset();
+
+    // With a spill directory the evicted session is reloaded on demand
+    char spill_dir[] = "/tmp/keystore_XXXXXX";
+    ASSERT_TRUE(mkdtemp(spill_dir) != nullptr);
+    {
+        KeyStore spill_store(test_params, session_bytes, spill_dir);
+        spill_store.Add(0, index_list, rk_lists[0]);
+        auto rk = spill_store.Acquire(0)->at(index_list[0]);
+        spill_store.Add(1, index_list, rk_lists[1]);
+        EXPECT_EQ(spill_store.bytes_spilled(), session_bytes);
+
+        // Another store spilling the same session id to the same directory
+        KeyStore other_store(test_params, session_bytes, spill_dir);
+        other_store.Add(0, index_list, rk_lists[1]);
+        auto other_rk = other_store.Acquire(0)->at(index_list[0]);
+        other_store.Add(1, index_list, rk_lists[0]);
+        EXPECT_EQ(other_store.bytes_spilled(), session_bytes);
+
+        auto keys = spill_store.Acquire(0);
+        EXPECT_EQ(rk->a, GetAutomorphismKey(*keys, index_list[0]).a);
+        EXPECT_EQ(rk->b, GetAutomorphismKey(*keys, index_list[0]).b);
+        keys.reset();
+
+        auto other_keys = other_store.Acquire(0);
+        EXPECT_EQ(other_rk->b, GetAutomorphismKey(*other_keys, index_list[0]).b);
+        EXPECT_NE(rk->b, other_rk->b);
+        other_keys.reset();
+        EXPECT_EQ(spill_store.bytes_used(), session_bytes);
+        EXPECT_EQ(spill_store.bytes_spilled(), session_bytes);
+
+        check_session(spill_store, 0);
+        check_session(spill_store, 1);
+    }
+    EXPECT_EQ(rmdir(spill_dir), 0);
+}
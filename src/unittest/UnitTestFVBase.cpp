@@ -28,7 +28,9 @@
 */
 
 #include "include/gtest/gtest.h"
+#include <algorithm>
 #include <iostream>
+#include <unistd.h>
 
 #include "../lib/pke/gazelle.h"
 
@@ -128,3 +130,464 @@ TEST(UTFV, Fast){
     EXPECT_EQ(pt, pt_sk);
 
 }
+
+TEST(UTFV, ParamSets){
+    //------------------ Setup Parameters ------------------
+    DiscreteGaussianGenerator dgg = DiscreteGaussianGenerator(4.0);
+
+    // All the sets are used side by side, without the precompute functions
+    for(auto& name: get_param_set_names()){
+        const auto& set = get_param_set(name);
+        auto test_params = MakeFVParams(set, OPTIMIZED,
+                std::make_shared<DiscreteGaussianGenerator>(dgg), 10);
+
+        uv64 pt = get_dug_vector(test_params.phim, test_params.p);
+
+        //----------------------- KeyGen -----------------------
+        auto kp = KeyGen(test_params);
+        auto kp_new = KeyGen(test_params);
+        auto rk = KeySwitchGen(kp.sk, kp_new.sk, test_params);
+
+        //---------------------- Encrypt -----------------------
+        auto ct_pk = Encrypt(kp.pk, pt, test_params);
+        auto ct_sk = Encrypt(kp.sk, pt, test_params);
+        auto ct_ks = KeySwitch(rk, ct_sk, test_params);
+
+        //---------------------- Decrypt -----------------------
+        EXPECT_EQ(pt, Decrypt(kp.sk, ct_pk, test_params)) << name;
+        EXPECT_EQ(pt, Decrypt(kp.sk, ct_sk, test_params)) << name;
+        EXPECT_EQ(pt, Decrypt(kp_new.sk, ct_ks, test_params)) << name;
+    }
+
+    EXPECT_THROW(get_param_set("n1024"), std::logic_error);
+}
+
+TEST(UTFV, Serialize){
+    //------------------ Setup Parameters ------------------
+    DiscreteGaussianGenerator dgg = DiscreteGaussianGenerator(4.0);
+    auto test_params = MakeFVParams(get_param_set("n2048_p20"), OPTIMIZED,
+            std::make_shared<DiscreteGaussianGenerator>(dgg), 20);
+    ui32 phim = test_params.phim;
+    ui32 q_bits = wire_bits(test_params.q);
+
+    auto kp = KeyGen(test_params);
+    uv64 pt = get_dug_vector(phim, test_params.p);
+
+    //---------------------- Pack ---------------------------
+    std::vector<Ciphertext> ct_vec;
+    std::vector<SeededCiphertext> ct_seeded;
+    for (ui32 n = 0; n < 3; n++) {
+        ct_vec.push_back(Encrypt(kp.sk, pt, test_params));
+        ct_seeded.push_back(EncryptSeeded(kp.sk, pt, test_params));
+    }
+    // Partially reduced values are reduced on the way out
+    ct_vec[0].a[0] += test_params.q;
+    std::vector<std::vector<Ciphertext>> ct_mat(2, ct_vec);
+    auto rk_list = EvalAutomorphismKeyGenSeeded(kp.sk, {1, 2}, test_params);
+
+    auto buf_vec = Pack(ct_vec, test_params);
+    auto buf_mat = Pack(ct_mat, test_params);
+    auto buf_seeded = Pack(ct_seeded, test_params);
+    auto buf_rk = Pack(rk_list, test_params);
+    auto buf_pt = Pack(pt, test_params.p);
+
+    EXPECT_EQ(buf_vec.size(), packed_words(3*2*phim, q_bits));
+    EXPECT_EQ(buf_pt.size(), packed_words(phim, wire_bits(test_params.p)));
+    EXPECT_LT(buf_pt.size()*2, pt.size());
+
+    //--------------------- Unpack --------------------------
+    std::vector<Ciphertext> ct_vec_r(3, Ciphertext(phim));
+    std::vector<std::vector<Ciphertext>> ct_mat_r(2, ct_vec_r);
+    std::vector<SeededCiphertext> ct_seeded_r(3, SeededCiphertext(phim));
+    std::vector<SeededRelinKey> rk_list_r(2, rk_list[0]);
+    uv64 pt_r(phim);
+
+    Unpack(buf_vec, ct_vec_r, test_params);
+    Unpack(buf_mat, ct_mat_r, test_params);
+    Unpack(buf_seeded, ct_seeded_r, test_params);
+    Unpack(buf_rk, rk_list_r, test_params);
+    Unpack(buf_pt, pt_r, test_params.p);
+
+    //----------------------- Check ------------------------
+    ct_vec[0].a[0] -= test_params.q;
+    for (ui32 n = 0; n < 3; n++) {
+        EXPECT_EQ(ct_vec[n].a, ct_vec_r[n].a);
+        EXPECT_EQ(ct_vec[n].b, ct_vec_r[n].b);
+        EXPECT_EQ(ct_vec[n].b, ct_mat_r[1][n].b);
+        EXPECT_EQ(pt, Decrypt(kp.sk, Expand(ct_seeded_r[n], test_params), test_params));
+    }
+    for (ui32 n = 0; n < 2; n++) {
+        EXPECT_EQ(rk_list[n].b, rk_list_r[n].b);
+        EXPECT_EQ(Expand(rk_list[n], test_params).a, Expand(rk_list_r[n], test_params).a);
+    }
+    EXPECT_EQ(pt, pt_r);
+
+    // Shape mismatches and unreduced shares are rejected
+    std::vector<Ciphertext> ct_short(2, Ciphertext(phim));
+    std::vector<Ciphertext> ct_long(4, Ciphertext(phim));
+    EXPECT_THROW(Unpack(buf_vec, ct_short, test_params), std::logic_error);
+    EXPECT_THROW(Unpack(buf_vec, ct_long, test_params), std::logic_error);
+    pt[0] = test_params.p;
+    EXPECT_THROW(Pack(pt, test_params.p), std::logic_error);
+
+    // So are packed values that are not reduced
+    BitPacker packer;
+    packer.put(uv64(2*phim, test_params.q), q_bits);
+    Ciphertext ct_r(phim);
+    EXPECT_THROW(Unpack(packer.take(), ct_r, test_params), std::logic_error);
+    BitPacker pt_packer;
+    pt_packer.put(pt, wire_bits(test_params.p));
+    EXPECT_THROW(Unpack(pt_packer.take(), pt_r, test_params.p), std::logic_error);
+}
+
+TEST(UTFV, ModSwitch){
+    //------------------ Setup Parameters ------------------
+    DiscreteGaussianGenerator dgg = DiscreteGaussianGenerator(4.0);
+    auto test_params = MakeFVParams(get_param_set("n2048_p20"), OPTIMIZED,
+            std::make_shared<DiscreteGaussianGenerator>(dgg), 20);
+    auto ref_params = test_params;
+    ref_params.fast_modulli = false;
+    ui32 phim = test_params.phim;
+    ui32 bits = ModSwitchBits(test_params);
+    EXPECT_LE(bits, 30u);
+
+    auto kp = KeyGen(test_params);
+
+    // Sums of products, with the noise of a layer output
+    std::vector<Ciphertext> ct_vec;
+    for (ui32 n = 0; n < 3; n++) {
+        Ciphertext ct(phim);
+        for (ui32 k = 0; k < 8; k++) {
+            uv64 pt = get_dug_vector(phim, test_params.p);
+            uv64 pt_mult = get_dug_vector(phim, test_params.p);
+            auto prod = EvalMultPlain(Encrypt(kp.sk, pt, test_params),
+                    NullEncrypt(pt_mult, test_params), test_params);
+            EvalAddInPlace(ct, prod, test_params);
+        }
+        ct_vec.push_back(AddRandomNoise(ct, test_params));
+    }
+
+    //------------------ Switch and Decrypt -----------------
+    auto ct_sw = ModSwitch(ct_vec, bits, test_params);
+    auto buf = Pack(ct_sw);
+    EXPECT_EQ(buf.size(), packed_words(3*2*phim, bits));
+    EXPECT_LT(buf.size()*2, Pack(ct_vec, test_params).size());
+
+    CompressedCTVec ct_sw_r(3, CompressedCiphertext(phim, bits));
+    Unpack(buf, ct_sw_r);
+    auto pt_vec = Decrypt(kp.sk, ct_sw_r, test_params);
+    for (ui32 n = 0; n < 3; n++) {
+        auto pt_ref = Decrypt(kp.sk, ct_vec[n], test_params);
+        EXPECT_EQ(pt_ref, pt_vec[n]);
+        EXPECT_EQ(pt_ref, Decrypt(kp.sk, ModSwitch(ct_vec[n], bits, test_params), test_params));
+        EXPECT_EQ(pt_ref, Decrypt(kp.sk, ModSwitch(ct_vec[n], bits, ref_params), ref_params));
+    }
+
+    // Moduli too large for the exact product in Decrypt are rejected
+    EXPECT_THROW(ModSwitch(ct_vec[0], 50, test_params), std::logic_error);
+    EXPECT_THROW(ModSwitch(ct_vec[0], 0, test_params), std::logic_error);
+}
+
+TEST(UTFV, NoiseEstimate){
+    //------------------ Setup Parameters ------------------
+    DiscreteGaussianGenerator dgg = DiscreteGaussianGenerator(4.0);
+    auto test_params = MakeFVParams(get_param_set("n2048_p20"), OPTIMIZED,
+            std::make_shared<DiscreteGaussianGenerator>(dgg), 9);
+    ui32 phim = test_params.phim;
+
+    // Seeded, so that the margins below are the same on every run
+    osuCrypto::PRNG prng(osuCrypto::toBlock(22));
+    auto kp = KeyGen(test_params, prng);
+    auto keys = EvalAutomorphismKeyGen(kp.sk, {1, 2, 3, 4}, test_params, prng);
+    uv64 pt(phim);
+    get_dug_vector(pt.data(), phim, test_params.p, prng);
+
+    //--------- Estimates against the measured margins -------
+    // Conservative for any keys, but by no more than a few bits. Over many
+    // keys the estimates are between half a bit and four and a half under.
+    auto check_margin = [&](const NoiseEstimate& est, const Ciphertext& ct){
+        double margin = NoiseMargin(kp.sk, ct, test_params);
+        double est_margin = EstimateMargin(est, test_params);
+        EXPECT_LE(est_margin, margin);
+        EXPECT_GT(est_margin, margin - 5);
+    };
+
+    auto ct = Encrypt(kp.sk, pt, test_params, prng);
+    auto fresh = EstimateEncrypt(test_params);
+    check_margin(fresh, ct);
+    check_margin(EstimateEncrypt(test_params, true), Encrypt(kp.pk, pt, test_params, prng));
+
+    auto rot = EstimateKeySwitch(fresh, test_params);
+    check_margin(rot, EvalAutomorphism(1, keys, ct, test_params));
+
+    // Products of fresh ciphertexts under a single key, where the part of the
+    // noise fixed by the key adds up coherently, then four products under
+    // each of four keys, as in the layers
+    auto prod = EstimateMultPlain(rot, 1 << 10, test_params);
+    auto sum_products = [&](const ui32 num_keys, const ui32 terms){
+        Ciphertext acc(phim);
+        for (ui32 k = 0; k < terms; k++) {
+            uv64 digits(phim);
+            get_dug_vector(digits.data(), phim, 1 << 10, prng);
+            auto rot_ct = EvalAutomorphism(1 + k%num_keys, keys,
+                    Encrypt(kp.sk, pt, test_params, prng), test_params);
+            EvalAddInPlace(acc, EvalMultPlain(rot_ct, NullEncrypt(digits, test_params),
+                    test_params), test_params);
+        }
+        return acc;
+    };
+    check_margin(prod, sum_products(1, 1));
+    check_margin(EstimateSum(prod, 32, true), sum_products(1, 32));
+    check_margin(EstimateSum(EstimateSum(prod, 4, true), 4), sum_products(4, 16));
+
+    //------------- Planned windows for a layer -------------
+    ui32 num_rows = 16, num_cols = 128;
+    auto layer_noise = [&](const ui32 pt_window_size, const ui32 pt_num_windows,
+            const FVParams& params){
+        return mat_mul_noise(num_rows, num_cols, pt_window_size, pt_num_windows, params);
+    };
+    auto plan = PlanWindows(layer_noise, test_params);
+    EXPECT_GE(plan.margin, 1);
+    EXPECT_GE(plan.pt_window_size*plan.pt_num_windows, opt::bit_length(test_params.p - 1));
+    EXPECT_THROW(PlanWindows(layer_noise, test_params, 40), std::logic_error);
+
+    auto plan_params = test_params;
+    plan_params.window_size = plan.window_size;
+    auto tight = PlanWindows(layer_noise, plan_params, plan.margin + 4);
+    EXPECT_GE(tight.pt_num_windows, plan.pt_num_windows);
+
+    // The layer still decrypts with the planned windows
+    kp = KeyGen(plan_params, prng);
+    uv32 index_list;
+    for (ui32 i = 1; i < num_cols; i *= 2) {
+        index_list.push_back(i);
+    }
+    keys = EvalAutomorphismKeyGen(kp.sk, index_list, plan_params, prng);
+
+    uv64 vec = get_dgg_testvector(num_cols, test_params.p);
+    std::vector<uv64> mat(num_rows);
+    for (ui32 row = 0; row < num_rows; row++) {
+        mat[row] = get_dgg_testvector(num_cols, test_params.p);
+    }
+    auto ct_vec = preprocess_vec(kp.sk, vec, plan.pt_window_size, plan.pt_num_windows, plan_params);
+    auto enc_mat = preprocess_matrix(mat, plan.pt_window_size, plan.pt_num_windows, plan_params);
+    auto ct_prod = mat_mul_online(ct_vec, enc_mat, num_cols, keys, plan_params);
+    EXPECT_GE(NoiseMargin(kp.sk, ct_prod, plan_params), plan.margin);
+    EXPECT_EQ(mat_mul_pt(vec, mat, test_params.p),
+            postprocess_prod(kp.sk, ct_prod, num_cols, num_rows, plan_params));
+}
+
+// The planned windows of the mat-mul and conv2d demo layers, against the
+// margins they measure. The estimates are as close as in NoiseEstimate, and
+// the outputs still decrypt after ModSwitch.
+TEST(UTFV, NoiseEstimateLayers){
+    //------------------ Setup Parameters ------------------
+    DiscreteGaussianGenerator dgg = DiscreteGaussianGenerator(4.0);
+    auto test_params = MakeFVParams(get_param_set("n2048_p20"), OPTIMIZED,
+            std::make_shared<DiscreteGaussianGenerator>(dgg), 20);
+    ui32 phim = test_params.phim;
+    ui32 bits = ModSwitchBits(test_params);
+    osuCrypto::PRNG prng(osuCrypto::toBlock(22));
+
+    auto check_plan = [&](const LayerNoise& layer_noise){
+        auto plan = PlanWindows([&](const ui32 pt_window_size, const ui32 pt_num_windows,
+                const FVParams& params){
+            return EstimateModSwitch(layer_noise(pt_window_size, pt_num_windows, params),
+                    ModSwitchBits(params), params);
+        }, test_params);
+        auto plan_params = test_params;
+        plan_params.window_size = plan.window_size;
+        auto est = layer_noise(plan.pt_window_size, plan.pt_num_windows, plan_params);
+        EXPECT_GE(EstimateMargin(est, plan_params), plan.margin);
+        return std::make_pair(plan, plan_params);
+    };
+    auto check_margin = [&](const NoiseEstimate& est, const SecretKey& sk, const Ciphertext& ct,
+            const FVParams& params){
+        double margin = NoiseMargin(sk, ct, params);
+        double est_margin = EstimateMargin(est, params);
+        EXPECT_LE(est_margin, margin);
+        EXPECT_GT(est_margin, margin - 5);
+    };
+
+    //------------------ Matrix multiplication ----------------
+    {
+        ui32 num_rows = 100, num_cols = 980;
+        auto layer_noise = [&](const ui32 pt_window_size, const ui32 pt_num_windows,
+                const FVParams& params){
+            return mat_mul_noise(num_rows, num_cols, pt_window_size, pt_num_windows, params);
+        };
+        auto planned = check_plan(layer_noise);
+        auto& plan = planned.first;
+        auto& plan_params = planned.second;
+        // 9 bits, by hand before the planner, fails to decrypt
+        EXPECT_LT(plan.window_size, 9u);
+
+        auto kp = KeyGen(plan_params, prng);
+        ui32 num_rot = nxt_pow2(num_rows)*nxt_pow2(num_cols)/phim;
+        uv32 index_list;
+        for (ui32 i = 1; i < num_rot; i++) {
+            index_list.push_back(i);
+        }
+        for (ui32 i = num_rot; i < num_cols; i *= 2) {
+            index_list.push_back(i);
+        }
+        auto keys = EvalAutomorphismKeyGen(kp.sk, index_list, plan_params, prng);
+
+        uv64 vec = get_dgg_testvector(num_cols, test_params.p);
+        std::vector<uv64> mat(num_rows);
+        for (ui32 row = 0; row < num_rows; row++) {
+            mat[row] = get_dgg_testvector(num_cols, test_params.p);
+        }
+        auto ct_vec = preprocess_vec(kp.sk, vec, plan.pt_window_size, plan.pt_num_windows, plan_params);
+        auto enc_mat = preprocess_matrix(mat, plan.pt_window_size, plan.pt_num_windows, plan_params);
+        auto ct_prod = mat_mul_online(ct_vec, enc_mat, num_cols, keys, plan_params);
+        check_margin(layer_noise(plan.pt_window_size, plan.pt_num_windows, plan_params),
+                kp.sk, ct_prod, plan_params);
+        EXPECT_EQ(mat_mul_pt(vec, mat, test_params.p),
+                postprocess_prod(kp.sk, ModSwitch(ct_prod, bits, plan_params), num_cols, num_rows,
+                plan_params));
+    }
+
+    //------------------ 2D convolution ----------------------
+    {
+        Filter2DShape filter_shape(5, 4, 3, 3);
+        ConvShape in_shape(4, 14, 14);
+        auto layer_noise = [&](const ui32 pt_window_size, const ui32 pt_num_windows,
+                const FVParams& params){
+            return conv_2d_noise(filter_shape, in_shape, pt_window_size, pt_num_windows, params);
+        };
+        auto planned = check_plan(layer_noise);
+        auto& plan = planned.first;
+        auto& plan_params = planned.second;
+        // Within a bit of the 9 picked by hand before the planner, which
+        // the part of the noise fixed by the keys costs
+        EXPECT_GE(plan.window_size, 8u);
+
+        auto kp = KeyGen(plan_params, prng);
+        ui32 chn_pow2 = nxt_pow2(in_shape.h*in_shape.w);
+        ui32 offset_h = (filter_shape.f_h-1)/2, offset_w = (filter_shape.f_w-1)/2;
+        uv32 index_list;
+        for (ui32 curr_loop = 0; curr_loop < phim/chn_pow2; curr_loop++) {
+            ui32 rot_base = curr_loop*chn_pow2;
+            for (ui32 f_h = 0; f_h < filter_shape.f_h; f_h++) {
+                for (ui32 f_w = 0; f_w < filter_shape.f_w; f_w++) {
+                    ui32 rot_f = ((rot_base + (f_h-offset_h)*in_shape.w + (f_w-offset_w))
+                            & ((phim >> 1) - 1));
+                    index_list.push_back((rot_base & (phim >> 1)) + rot_f);
+                }
+            }
+        }
+        auto keys = EvalAutomorphismKeyGen(kp.sk, index_list, plan_params, prng);
+
+        ConvLayer ifmap(in_shape.chn, in_shape.h, in_shape.w);
+        for (auto& chn: ifmap.act) {
+            for (auto& row: chn) {
+                row = get_dgg_testvector(in_shape.w, test_params.p);
+            }
+        }
+        Filter2D filter(filter_shape.out_chn, filter_shape.in_chn, filter_shape.f_h, filter_shape.f_w);
+        for (auto& out_chn: filter.w) {
+            for (auto& in_chn: out_chn) {
+                for (auto& row: in_chn) {
+                    row = get_dgg_testvector(filter_shape.f_w, test_params.p);
+                }
+            }
+        }
+        auto ct_mat = preprocess_ifmap(kp.sk, ifmap, plan.pt_window_size, plan.pt_num_windows,
+                plan_params);
+        auto enc_filter = preprocess_filter(filter, in_shape, plan.pt_window_size,
+                plan.pt_num_windows, plan_params);
+        auto ct_conv = conv_2d_online(ct_mat, enc_filter, filter_shape, in_shape, keys, plan_params);
+        // The layer decrypts or not on its worst output
+        auto worst = std::min_element(ct_conv.begin(), ct_conv.end(),
+                [&](const Ciphertext& x, const Ciphertext& y){
+            return NoiseMargin(kp.sk, x, plan_params) < NoiseMargin(kp.sk, y, plan_params);
+        });
+        check_margin(layer_noise(plan.pt_window_size, plan.pt_num_windows, plan_params),
+                kp.sk, *worst, plan_params);
+        ConvShape out_shape(filter_shape.out_chn, in_shape.h, in_shape.w);
+        EXPECT_TRUE(check_conv(postprocess_conv(kp.sk, ModSwitch(ct_conv, bits, plan_params),
+                out_shape, plan_params), conv_2d_pt(ifmap, filter, true, test_params.p)));
+    }
+}
+
+TEST(UTFV, EncMatCache){
+    //------------------ Setup Parameters ------------------
+    DiscreteGaussianGenerator dgg = DiscreteGaussianGenerator(4.0);
+    auto test_params = MakeFVParams(get_param_set("n2048_p20"), OPTIMIZED,
+            std::make_shared<DiscreteGaussianGenerator>(dgg), 10);
+    auto other_params = MakeFVParams(get_param_set("n4096_p20"), OPTIMIZED,
+            std::make_shared<DiscreteGaussianGenerator>(dgg), 10);
+    ui32 num_rows = 16, num_cols = 128;
+    ui32 pt_window_size = 10, pt_num_windows = 2;
+    // A row of windows for each packed diagonal
+    const EncMatCacheId id {7, pt_window_size,
+            nxt_pow2(num_rows)*nxt_pow2(num_cols)/test_params.phim, pt_num_windows};
+
+    std::vector<uv64> mat(num_rows);
+    for (ui32 row = 0; row < num_rows; row++) {
+        mat[row] = get_dgg_testvector(num_cols, test_params.p);
+    }
+    ui32 preprocess_calls = 0;
+    auto preprocess = [&](){
+        preprocess_calls++;
+        return preprocess_matrix(mat, pt_window_size, pt_num_windows, test_params);
+    };
+
+    char cache_dir[] = "/tmp/encmat_XXXXXX";
+    ASSERT_TRUE(mkdtemp(cache_dir) != nullptr);
+    std::string path = std::string(cache_dir) + "/matrix.encmat";
+
+    //------------------ Save and map ----------------------
+    EXPECT_FALSE(IsEncMatCache(path, id, test_params));
+    auto mapped = CachedEncMat(path, id, test_params, preprocess);
+    EXPECT_EQ(preprocess_calls, 1u);
+    EXPECT_EQ(mapped->rows(), id.rows);
+    EXPECT_EQ(mapped->cols(), id.cols);
+    EXPECT_TRUE(IsEncMatCache(path, id, test_params));
+    EXPECT_FALSE(IsEncMatCache(path, {id.key + 1, id.pt_window_size, id.rows, id.cols},
+            test_params));
+    EXPECT_FALSE(IsEncMatCache(path, {id.key, id.pt_window_size + 1, id.rows, id.cols},
+            test_params));
+    EXPECT_FALSE(IsEncMatCache(path, {id.key, id.pt_window_size, id.rows + 1, id.cols},
+            test_params));
+    EXPECT_FALSE(IsEncMatCache(path, {id.key, id.pt_window_size, id.rows, id.cols + 1},
+            test_params));
+    EXPECT_FALSE(IsEncMatCache(path, id, other_params));
+    auto slow_params = test_params;
+    slow_params.fast_modulli = !test_params.fast_modulli;
+    EXPECT_FALSE(IsEncMatCache(path, id, slow_params));
+    EXPECT_THROW(MappedEncMat(path, {id.key + 1, id.pt_window_size, id.rows, id.cols},
+            test_params), std::logic_error);
+
+    // Weights of another shape are not saved under id
+    EXPECT_THROW(SaveEncMat(path, EncMat(id.rows + 1, std::vector<uv64>(id.cols)), id,
+            test_params), std::logic_error);
+
+    // A later start maps the saved file without preprocessing
+    mapped = CachedEncMat(path, id, test_params, preprocess);
+    EXPECT_EQ(preprocess_calls, 1u);
+    auto enc_mat = preprocess();
+    EXPECT_EQ(mapped->load(), enc_mat);
+
+    //-------------- Online from the mapping ---------------
+    auto kp = KeyGen(test_params);
+    uv32 index_list;
+    for (ui32 i = 1; i < num_cols; i *= 2) {
+        index_list.push_back(i);
+    }
+    auto keys = EvalAutomorphismKeyGen(kp.sk, index_list, test_params);
+    uv64 vec = get_dgg_testvector(num_cols, test_params.p);
+    auto ct_vec = preprocess_vec(kp.sk, vec, pt_window_size, pt_num_windows, test_params);
+
+    auto ct_mem = mat_mul_online(ct_vec, enc_mat, num_cols, keys, test_params);
+    auto ct_map = mat_mul_online(ct_vec, mapped->view(), num_cols, keys, test_params);
+    EXPECT_EQ(ct_mem.a, ct_map.a);
+    EXPECT_EQ(ct_mem.b, ct_map.b);
+    EXPECT_EQ(mat_mul_pt(vec, mat, test_params.p),
+            postprocess_prod(kp.sk, ct_map, num_cols, num_rows, test_params));
+
+    mapped.reset();
+    EXPECT_EQ(std::remove(path.c_str()), 0);
+    EXPECT_EQ(rmdir(cache_dir), 0);
+}
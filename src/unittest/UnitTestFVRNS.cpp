@@ -0,0 +1,167 @@
+/*
+ * @file 
+ * @author  TPOC: palisade@njit.edu
+ *
+ * @copyright Copyright (c) 2017, New Jersey Institute of Technology (NJIT)
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+ /*
+    This code tests the RNS variant of the FV scheme.
+*/
+
+#include "include/gtest/gtest.h"
+#include <iostream>
+
+#include "../lib/pke/gazelle.h"
+
+using namespace std;
+using namespace lbcrypto;
+
+
+class UnitTestFVRNS : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+  }
+
+  virtual void TearDown() {
+    // Code here will be called immediately after each test
+    // (right before the destructor).
+  }
+};
+
+// Three 60-bit limbs from the n=2048 parameter sets and a 41-bit p, which
+// a single 60-bit q could not support
+static RNSParams rns_test_params(const ui32 window_size){
+    uv64 roots, moduli;
+    for(ui32 i=0; i<3; i++){
+        roots.push_back(g_param_sets[i].z);
+        moduli.push_back(g_param_sets[i].q);
+    }
+
+    DiscreteGaussianGenerator dgg = DiscreteGaussianGenerator(4.0);
+    return RNSParams {
+        std::make_shared<const RNSContext>(roots, moduli, 1099511627791ULL, 11),
+        OPTIMIZED, std::make_shared<DiscreteGaussianGenerator>(dgg),
+        window_size
+    };
+}
+
+TEST(UTFV_RNS, EncryptDecrypt){
+    auto params = rns_test_params(20);
+    const auto& ctx = *params.ctx;
+
+    uv64 pt = get_dug_vector(ctx.phim, ctx.p);
+    auto kp = KeyGen(params);
+
+    auto ct_pk = Encrypt(kp.pk, pt, params);
+    auto ct_sk = Encrypt(kp.sk, pt, params);
+    EXPECT_EQ(pt, Decrypt(kp.sk, ct_pk, params));
+    EXPECT_EQ(pt, Decrypt(kp.sk, ct_sk, params));
+
+    // (pt + pt)*3
+    uv64 three(ctx.phim);
+    three[0] = 3;
+    auto ct = EvalMultPlain(EvalAdd(ct_pk, ct_sk, params), NullEncrypt(three, params), params);
+
+    uv64 expected(ctx.phim);
+    for(ui32 n=0; n<ctx.phim; n++){
+        expected[n] = mod_mul(2*pt[n], 3, ctx.p);
+    }
+    EXPECT_EQ(expected, Decrypt(kp.sk, ct, params));
+
+    EXPECT_EQ(uv64(ctx.phim), Decrypt(kp.sk, EvalSub(ct_sk, ct_pk, params), params));
+}
+
+// Plaintexts for EvalMultPlain are reduced into every limb, even with a p
+// above the limbs
+TEST(UTFV_RNS, MultPlainLargeP){
+    uv64 roots, moduli;
+    for(ui32 i=0; i<3; i++){
+        roots.push_back(g_param_sets[i].z);
+        moduli.push_back(g_param_sets[i].q);
+    }
+    const ui64 p = ((ui64)1 << 63) - 25;
+    DiscreteGaussianGenerator dgg = DiscreteGaussianGenerator(4.0);
+    RNSParams params {
+        std::make_shared<const RNSContext>(roots, moduli, p, 11),
+        OPTIMIZED, std::make_shared<DiscreteGaussianGenerator>(dgg), 20
+    };
+    const auto& ctx = *params.ctx;
+
+    uv64 pt = get_dug_vector(ctx.phim, 1 << 20);
+    uv64 pt_mult = get_dug_vector(ctx.phim, p);
+    auto kp = KeyGen(params);
+    auto ct = EvalMultPlain(Encrypt(kp.sk, pt, params), NullEncrypt(pt_mult, params), params);
+
+    // The negacyclic product mod p
+    uv64 expected(ctx.phim);
+    for(ui32 i=0; i<ctx.phim; i++){
+        for(ui32 j=0; j<ctx.phim; j++){
+            ui64 prod = mod_mul(pt[i], pt_mult[j], p);
+            ui32 k = i + j;
+            if(k < ctx.phim){
+                expected[k] = mod(expected[k] + prod, p);
+            } else {
+                expected[k - ctx.phim] = mod(expected[k - ctx.phim] + p - prod, p);
+            }
+        }
+    }
+    EXPECT_EQ(expected, Decrypt(kp.sk, ct, params));
+}
+
+TEST(UTFV_RNS, KeySwitch){
+    auto params = rns_test_params(20);
+    const auto& ctx = *params.ctx;
+
+    uv64 pt = get_dug_vector(ctx.phim, ctx.p);
+    auto kp = KeyGen(params);
+    auto kp_new = KeyGen(params);
+
+    auto rk = KeySwitchGen(kp.sk, kp_new.sk, params);
+    auto ct = KeySwitch(rk, Encrypt(kp.sk, pt, params), params);
+    EXPECT_EQ(pt, Decrypt(kp_new.sk, ct, params));
+}
+
+TEST(UTFV_RNS, Automorphism){
+    auto params = rns_test_params(20);
+    const auto& ctx = *params.ctx;
+
+    uv64 pt = get_dug_vector(ctx.phim, ctx.p);
+    auto kp = KeyGen(params);
+
+    const ui32 rot = 3;
+    auto rk = EvalAutomorphismKeyGen(kp.sk, rot, params);
+    auto ct_rot = EvalAutomorphism(rot, rk, Encrypt(kp.sk, pt, params), params);
+
+    // pt(X^g) for the Galois element g of the rotation
+    ui32 g = ctx.automorph->index[rot];
+    ui32 mask = (ctx.phim << 1) - 1;
+    uv64 expected(ctx.phim);
+    for(ui32 n=0; n<ctx.phim; n++){
+        ui32 dest = (n*g) & mask;
+        if(dest < ctx.phim){
+            expected[dest] = pt[n];
+        } else {
+            expected[dest - ctx.phim] = (ctx.p - pt[n]) % ctx.p;
+        }
+    }
+    EXPECT_EQ(expected, Decrypt(kp.sk, ct_rot, params));
+}
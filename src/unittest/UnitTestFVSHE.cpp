@@ -28,9 +28,11 @@
 */
 
 #include "include/gtest/gtest.h"
+#include <algorithm>
 #include <iostream>
 
 #include "../lib/pke/gazelle.h"
+#include "../lib/utils/thread_pool.h"
 
 using namespace std;
 using namespace lbcrypto;
@@ -178,3 +180,279 @@ TEST(UTFV_SHE, Fast){
     EXPECT_EQ(v_mul_ref, v_mul);
 
 }
+
+TEST(UTFV_SHE, InPlace){
+    //------------------ Setup Parameters ------------------
+    ui64 z = RootOfUnity(opt::phim << 1, opt::q);
+    ui64 z_p = RootOfUnity(opt::phim << 1, opt::p);
+    ftt_precompute(z, opt::q, opt::logn);
+    ftt_precompute(z_p, opt::p, opt::logn);
+    encoding_precompute(opt::p, opt::logn);
+
+    DiscreteGaussianGenerator dgg = DiscreteGaussianGenerator(4.0);
+
+    FVParams test_params {
+        true,
+        opt::q, opt::p, opt::logn, opt::phim,
+        (opt::q/opt::p),
+        OPTIMIZED, std::make_shared<DiscreteGaussianGenerator>(dgg)
+    };
+
+    auto kp = KeyGen(test_params);
+    uv64 v1 = get_dgg_testvector(opt::phim, opt::p);
+    uv64 v2 = get_dgg_testvector(opt::phim, opt::p);
+
+    uv64 pt1 = packed_encode(v1, opt::p, opt::logn);
+    uv64 pt2 = packed_encode(v2, opt::p, opt::logn);
+
+    auto ct1 = Encrypt(kp.pk, pt1, test_params);
+    auto ct2 = Encrypt(kp.pk, pt2, test_params);
+    auto ct2_null = NullEncrypt(pt2, test_params);
+
+    // In-place transforms must match the allocating ones
+    uv64 x = ct1.b;
+    ToCoeff(x, x, test_params);
+    EXPECT_EQ(ToCoeff(ct1.b, test_params), x);
+    ToEval(x, x, test_params);
+    EXPECT_EQ(ToEval(ToCoeff(ct1.b, test_params), test_params), x);
+
+    auto ct_add = ct1;
+    EvalAddInPlace(ct_add, ct2, test_params);
+    auto ct_sub = ct1;
+    EvalSubInPlace(ct_sub, ct2, test_params);
+    auto ct_mul = ct1;
+    EvalMultPlainInPlace(ct_mul, ct2_null, test_params);
+    auto ct_mac = ct2;
+    EvalMultPlainAccumulate(ct_mac, ct1, ct2_null, test_params);
+
+    //----------------------- Check ------------------------
+    auto v_add = packed_decode(Decrypt(kp.sk, ct_add, test_params), opt::p, opt::logn);
+    auto v_sub = packed_decode(Decrypt(kp.sk, ct_sub, test_params), opt::p, opt::logn);
+    auto v_mul = packed_decode(Decrypt(kp.sk, ct_mul, test_params), opt::p, opt::logn);
+    auto v_mac = packed_decode(Decrypt(kp.sk, ct_mac, test_params), opt::p, opt::logn);
+
+    uv64 v_add_ref(opt::phim);
+    uv64 v_sub_ref(opt::phim);
+    uv64 v_mul_ref(opt::phim);
+    uv64 v_mac_ref(opt::phim);
+
+    for(ui32 i=0; i<opt::phim; i++){
+        v_add_ref[i] = (v1[i] + v2[i]) % opt::p;
+        v_sub_ref[i] = (v1[i] + opt::p - v2[i]) % opt::p;
+        v_mul_ref[i] = (v1[i] * v2[i]) % opt::p;
+        v_mac_ref[i] = (v2[i] + v1[i] * v2[i]) % opt::p;
+    }
+
+    EXPECT_EQ(v_add_ref, v_add);
+    EXPECT_EQ(v_sub_ref, v_sub);
+    EXPECT_EQ(v_mul_ref, v_mul);
+    EXPECT_EQ(v_mac_ref, v_mac);
+
+    // The lazily reduced accumulator over more products than it holds
+    // between folds must agree with the reduced one
+    ui32 terms = 100;
+    auto ct_ref = ct2;
+    CiphertextAccumulator acc(opt::phim);
+    EvalMultPlainAccumulate(acc, ct2, uv64(opt::phim, 1), test_params);
+    for(ui32 n=0; n<terms; n++){
+        EvalMultPlainAccumulate(ct_ref, ct1, ct2_null, test_params);
+        EvalMultPlainAccumulate(acc, ct1, ct2_null, test_params);
+    }
+    auto ct_acc = Reduce(acc, test_params);
+    for(ui32 i=0; i<opt::phim; i++){
+        EXPECT_LT(ct_acc.a[i], opt::q);
+        EXPECT_LT(ct_acc.b[i], opt::q);
+    }
+    EXPECT_EQ(Decrypt(kp.sk, ct_ref, test_params), Decrypt(kp.sk, ct_acc, test_params));
+}
+
+TEST(UTFV_SHE, Seeded){
+    //------------------ Setup Parameters ------------------
+    DiscreteGaussianGenerator dgg = DiscreteGaussianGenerator(4.0);
+    auto test_params = MakeFVParams(get_param_set("n2048_p20"), OPTIMIZED,
+            std::make_shared<DiscreteGaussianGenerator>(dgg), 20);
+
+    auto kp = KeyGen(test_params);
+    uv64 v1 = get_dgg_testvector(test_params.phim, test_params.p);
+    uv64 pt1 = packed_encode(v1, test_params);
+
+    auto ct_seeded = EncryptSeeded(kp.sk, pt1, test_params);
+    auto ct1 = Expand(ct_seeded, test_params);
+
+    // The expansion only depends on the seed
+    EXPECT_EQ(ct1.a, Expand(ct_seeded, test_params).a);
+    EXPECT_EQ(ct_seeded.b, ct1.b);
+    EXPECT_NE(ct1.a, Expand(EncryptSeeded(kp.sk, pt1, test_params), test_params).a);
+
+    //----------------------- Check ------------------------
+    auto v_dec = packed_decode(Decrypt(kp.sk, ct1, test_params), test_params);
+    EXPECT_EQ(v1, v_dec);
+
+    auto ct_add = EvalAdd(ct1, ct1, test_params);
+    auto v_add = packed_decode(Decrypt(kp.sk, ct_add, test_params), test_params);
+    for(ui32 i=0; i<test_params.phim; i++){
+        EXPECT_EQ((2*v1[i]) % test_params.p, v_add[i]);
+    }
+}
+
+TEST(UTFV_SHE, Streams){
+    //------------------ Setup Parameters ------------------
+    DiscreteGaussianGenerator dgg = DiscreteGaussianGenerator(4.0);
+    auto test_params = MakeFVParams(get_param_set("n2048_p20"), OPTIMIZED,
+            std::make_shared<DiscreteGaussianGenerator>(dgg), 20);
+
+    auto kp = KeyGen(test_params);
+    uv64 v1 = get_dgg_testvector(test_params.phim, test_params.p);
+    uv64 pt1 = packed_encode(v1, test_params);
+
+    // Encryptions from one seed are reproducible, for both key types
+    osuCrypto::block seed = get_seed();
+    osuCrypto::PRNG prng1(seed), prng2(seed);
+    auto ct_sk = Encrypt(kp.sk, pt1, test_params, prng1);
+    auto ct_pk = Encrypt(kp.pk, pt1, test_params, prng1);
+    EXPECT_EQ(ct_sk.a, Encrypt(kp.sk, pt1, test_params, prng2).a);
+    EXPECT_EQ(ct_pk.b, Encrypt(kp.pk, pt1, test_params, prng2).b);
+    EXPECT_EQ(v1, packed_decode(Decrypt(kp.sk, ct_pk, test_params), test_params));
+
+    // Concurrent encryptions, each with a fork of the same stream
+    const ui32 count = 8;
+    std::vector<Ciphertext> ct_vec(count, Ciphertext(test_params.phim));
+    ThreadPool pool(4);
+    for (ui32 rep = 0; rep < 2; rep++) {
+        osuCrypto::PRNG prng(seed);
+        std::vector<osuCrypto::PRNG> streams;
+        for (ui32 n = 0; n < count; n++) {
+            streams.push_back(fork_prng(prng));
+        }
+
+        std::vector<Ciphertext> ct_rep(count, Ciphertext(test_params.phim));
+        pool.parallel_for(count, [&](ui32 n){
+            ct_rep[n] = Encrypt(kp.sk, pt1, test_params, streams[n]);
+        });
+        if (rep == 0) {
+            ct_vec = ct_rep;
+        } else {
+            for (ui32 n = 0; n < count; n++) {
+                EXPECT_EQ(ct_vec[n].a, ct_rep[n].a);
+                EXPECT_EQ(ct_vec[n].b, ct_rep[n].b);
+            }
+        }
+    }
+    EXPECT_NE(ct_vec[0].a, ct_vec[1].a);
+    for (auto& v: Decrypt(kp.sk, ct_vec, test_params)) {
+        EXPECT_EQ(v1, packed_decode(v, test_params));
+    }
+}
+
+TEST(UTFV_SHE, Pool){
+    //------------------ Setup Parameters ------------------
+    DiscreteGaussianGenerator dgg = DiscreteGaussianGenerator(4.0);
+    auto test_params = MakeFVParams(get_param_set("n2048_p20"), OPTIMIZED,
+            std::make_shared<DiscreteGaussianGenerator>(dgg), 20);
+
+    auto kp = KeyGen(test_params);
+    uv64 v1 = get_dgg_testvector(test_params.phim, test_params.p);
+    uv64 pt1 = packed_encode(v1, test_params);
+
+    const ui32 depth = 4;
+    EncryptionPool pool_sk(kp.sk, test_params, depth);
+    EncryptionPool pool_pk(kp.pk, test_params, depth);
+    EncryptionPool pool_none(test_params, 0);
+
+    // Wait for the producer to fill the buffers
+    for (ui32 t = 0; t < 1000; t++) {
+        auto stats = pool_sk.Stats();
+        if (stats.zeros_ready == depth && stats.masks_ready == depth) {
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    EXPECT_EQ(pool_sk.Stats().zeros_ready, depth);
+
+    //----------------------- Check ------------------------
+    const ui32 count = 2*depth;
+    for (ui32 n = 0; n < count; n++) {
+        for (auto pool: {&pool_sk, &pool_pk, &pool_none}) {
+            if (pool == &pool_none) {
+                EXPECT_THROW(Encrypt(*pool, pt1, test_params), std::logic_error);
+            } else {
+                auto ct = Encrypt(*pool, pt1, test_params);
+                EXPECT_EQ(v1, packed_decode(Decrypt(kp.sk, ct, test_params), test_params));
+            }
+
+            auto ct1 = Encrypt(kp.sk, pt1, test_params);
+            auto ct_noise = AddRandomNoise(ct1, *pool, test_params);
+            EXPECT_NE(ct1.b, ct_noise.b);
+            EXPECT_EQ(v1, packed_decode(Decrypt(kp.sk, ct_noise, test_params), test_params));
+        }
+    }
+
+    auto stats = pool_sk.Stats();
+    EXPECT_GE(stats.zero_hits, depth);
+    EXPECT_EQ(stats.zero_hits + stats.zero_misses, count);
+    EXPECT_EQ(stats.mask_hits + stats.mask_misses, count);
+
+    stats = pool_none.Stats();
+    EXPECT_EQ(stats.mask_hits, (ui64)0);
+    EXPECT_EQ(stats.mask_misses, count);
+}
+
+TEST(UTFV_SHE, Arena){
+    //------------------ Setup Parameters ------------------
+    DiscreteGaussianGenerator dgg = DiscreteGaussianGenerator(4.0);
+    auto test_params = MakeFVParams(get_param_set("n2048_p20"), OPTIMIZED,
+            std::make_shared<DiscreteGaussianGenerator>(dgg), 20);
+    ui32 phim = test_params.phim;
+
+    auto kp = KeyGen(test_params);
+    auto keys = EvalAutomorphismKeyGen(kp.sk, {1}, test_params);
+    uv64 v1 = get_dgg_testvector(phim, test_params.p);
+    uv64 pt1 = packed_encode(v1, test_params);
+    auto ct1 = Encrypt(kp.sk, pt1, test_params);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(ct1.a.data()) % ARENA_ALIGNMENT, (uintptr_t)0);
+
+    auto digits_heap = HoistedDecompose(ct1, test_params);
+    auto ct_rot = EvalAutomorphismDigits(1, keys, ct1, digits_heap, test_params);
+
+    //----------------------- Check ------------------------
+    Arena arena(1 << 16, true);
+    const ui64* first = nullptr;
+    for (ui32 rep = 0; rep < 2; rep++) {
+        arena.reset();
+
+        // The digits are one run carved from the arena, the same one every
+        // request
+        auto digits = HoistedDecompose(ct1, test_params, &arena);
+        ASSERT_EQ(digits.size(), digits_heap.size());
+        for (ui32 i = 0; i < digits.size(); i++) {
+            EXPECT_EQ(digits[i].get_allocator().arena(), &arena);
+            EXPECT_TRUE(std::equal(digits[i].begin(), digits[i].end(), digits_heap[i].begin()));
+            if (i > 0) {
+                EXPECT_EQ(digits[i].data(), digits[i-1].data() + phim);
+            }
+        }
+        if (rep == 0) {
+            first = digits[0].data();
+        } else {
+            EXPECT_EQ(first, digits[0].data());
+        }
+        EXPECT_EQ(arena.bytes_used(), digits.size()*phim*sizeof(ui64));
+        EXPECT_GE(arena.bytes_reserved(), arena.bytes_used());
+
+        auto ct = EvalAutomorphismDigits(1, keys, ct1, digits, test_params);
+        EXPECT_EQ(ct.a, ct_rot.a);
+        EXPECT_EQ(ct.b, ct_rot.b);
+    }
+
+    // Without an arena the digits come from the heap
+    auto digits = HoistedDecompose(ct1, test_params, nullptr);
+    EXPECT_EQ(digits[0].get_allocator().arena(), nullptr);
+
+    // Everything else stays on the heap, however the arena is recycled
+    arena.reset();
+    std::vector<av64> fill;
+    while (arena.bytes_used() < digits_heap.size()*phim*sizeof(ui64)) {
+        fill.emplace_back(phim, 0xdead, ArenaAllocator<ui64>(&arena));
+    }
+    EXPECT_EQ(EvalAutomorphismDigits(1, keys, ct1, digits_heap, test_params).a, ct_rot.a);
+}
@@ -38,9 +38,13 @@ Test cases in this file make the following assumptions:
 //#include "../lib/lattice/dcrtpoly.h"
 #include "math/backend.h"
 #include "math/transfrm.h"
+#include "math/transfrm_simd.h"
+#include "math/params.h"
 
 #include "math/nbtheory.h"
-//#include "math/distrgen.h"
+#include "math/bit_twiddle.h"
+#include "math/distrgen.h"
+#include "utils/thread_pool.h"
 
 using namespace std;
 using namespace lbcrypto;
@@ -84,6 +88,169 @@ TEST(UTNTT, switch_format_simple_single_crt) {
     EXPECT_EQ(x1, x1Clone);
 }
 
+TEST(UTNTT, switch_format_opt_simd_levels) {
+    ui64 z = RootOfUnity(opt::phim << 1, opt::q);
+    ui64 z_p = RootOfUnity(opt::phim << 1, opt::p);
+    ftt_precompute(z, opt::q, opt::logn);
+    ftt_precompute(z_p, opt::p, opt::logn);
+
+    uv64 x = get_dug_vector(opt::phim, opt::q);
+    uv64 x_p = get_dug_vector(opt::phim, opt::p);
+    uv64 X_ref = ftt_fwd(x, opt::q, opt::logn);
+    uv64 X_p_ref = ftt_fwd(x_p, opt::p, opt::logn);
+
+    auto max_level = simd::max_simd_level();
+    for (ui32 level = simd::SCALAR; level <= max_level; level++) {
+        simd::set_simd_level((simd::SIMD_LEVEL)level);
+
+        uv64 X = ftt_fwd_opt(x);
+        uv64 xx = ftt_inv_opt(X);
+        for (ui32 i = 0; i < opt::phim; i++) {
+            X[i] = opt::modq_full(X[i]);
+            xx[i] = opt::modq_full(xx[i]);
+        }
+        EXPECT_EQ(X_ref, X) << "simd level " << level;
+        EXPECT_EQ(x, xx) << "simd level " << level;
+
+        uv64 X_p = ftt_fwd_opt_p(x_p);
+        EXPECT_EQ(X_p_ref, X_p) << "simd level " << level;
+        EXPECT_EQ(x_p, ftt_inv_opt_p(X_p)) << "simd level " << level;
+    }
+    simd::set_simd_level(max_level);
+}
+
+// Lazy values reach 2^63 above q = 2^61, past the signed compares. The
+// moduli are just above 2^61 and just below 2^62, psi a primitive 4096-th
+// root of unity for each.
+TEST(UTNTT, switch_format_simd_levels_large_modulus) {
+    ui32 logn = 11;
+    ui32 phim = (1 << logn);
+
+    const ui64 moduli[][2] = {
+        {2305843009213800449ULL, 87143482071848776ULL},
+        {4611686018427322369ULL, 3710688476054411196ULL},
+    };
+    for (auto& mp: moduli) {
+        ui64 modulus = mp[0];
+        ftt_precompute(mp[1], modulus, logn);
+        uv64 x = get_dug_vector(phim, modulus);
+
+        auto max_level = simd::max_simd_level();
+        simd::set_simd_level(simd::SCALAR);
+        uv64 X_ref = ftt_fwd(x, modulus, logn);
+        for (ui32 level = simd::SCALAR; level <= max_level; level++) {
+            simd::set_simd_level((simd::SIMD_LEVEL)level);
+
+            uv64 X = ftt_fwd(x, modulus, logn);
+            EXPECT_EQ(X_ref, X) << "simd level " << level << " modulus " << modulus;
+            EXPECT_EQ(x, ftt_inv(X, modulus, logn)) << "simd level " << level << " modulus " << modulus;
+        }
+        simd::set_simd_level(max_level);
+    }
+}
+
+TEST(UTNTT, eval_bit_reversed_order) {
+    ui32 logn = 4;
+    ui32 phim = (1 << logn);
+    ui32 m = phim*2;
+
+    ui64 modulus = FirstPrime(30, m);
+    ui64 psi = RootOfUnity(m, modulus);
+    ftt_precompute(psi, modulus, logn);
+
+    uv64 x = get_dug_vector(phim, modulus);
+    uv64 X = ftt_fwd(x, modulus, logn);
+
+    // Entry k holds x(psi^(2*rev(k)+1))
+    for (ui32 k = 0; k < phim; k++) {
+        ui64 point = mod_exp(psi, 2*ReverseBits(k, logn)+1, modulus);
+        ui64 eval = 0;
+        for (ui32 i = phim; i > 0; i--) {
+            eval = (mod_mul(eval, point, modulus) + x[i-1]) % modulus;
+        }
+        EXPECT_EQ(eval, X[k]) << "slot " << k;
+    }
+}
+
+// Primes of 30, 50, 61 and 62 bits that are not of the 2^k - delta form
+// the opt moduli take, with a primitive 4096-th root of unity for each
+TEST(UTNTT, negacyclic_product_generic_modulus) {
+    ui32 logn = 6;
+    ui32 phim = (1 << logn);
+    ui32 m = phim*2;
+
+    const ui64 moduli[][2] = {
+        {1073692673ULL, 77672603ULL},
+        {1125899906826241ULL, 765727830662934ULL},
+        {2305843009213616129ULL, 336264465743942051ULL},
+        {4611686018427322369ULL, 3710688476054411196ULL},
+    };
+    for (auto& mp: moduli) {
+        ui64 modulus = mp[0];
+        ftt_precompute(mod_exp(mp[1], 4096/m, modulus), modulus, logn);
+
+        uv64 x = get_dug_vector(phim, modulus);
+        uv64 y = get_dug_vector(phim, modulus);
+
+        // Schoolbook product in Z_q[X]/(X^n+1)
+        uv64 z_ref(phim, 0);
+        for (ui32 i = 0; i < phim; i++) {
+            for (ui32 j = 0; j < phim; j++) {
+                ui64 prod = mod_mul(x[i], y[j], modulus);
+                ui32 k = (i+j) & (phim-1);
+                z_ref[k] = ((i+j) < phim)? (z_ref[k] + prod) % modulus:
+                        (z_ref[k] + modulus - prod) % modulus;
+            }
+        }
+
+        auto max_level = simd::max_simd_level();
+        for (ui32 level = simd::SCALAR; level <= max_level; level++) {
+            simd::set_simd_level((simd::SIMD_LEVEL)level);
+
+            uv64 X = ftt_fwd(x, modulus, logn);
+            uv64 Y = ftt_fwd(y, modulus, logn);
+            for (ui32 i = 0; i < phim; i++) {
+                X[i] = mod_mul(X[i], Y[i], modulus);
+            }
+            EXPECT_EQ(z_ref, ftt_inv(X, modulus, logn))
+                    << "simd level " << level << " modulus " << modulus;
+        }
+        simd::set_simd_level(max_level);
+    }
+}
+
+TEST(UTNTT, batch_matches_single) {
+    ui32 logn = 11;
+    ui32 phim = (1 << logn);
+    ui32 count = 37;
+
+    NttContext ctx(opt::z, opt::q, logn);
+    ThreadPool pool(4);
+
+    uv64 x(count*phim);
+    for (ui32 k = 0; k < count; k++) {
+        auto poly = get_dug_vector(phim, opt::q);
+        std::copy(poly.begin(), poly.end(), x.begin() + k*phim);
+    }
+
+    // Each polynomial on its own
+    uv64 X_ref(count*phim);
+    for (ui32 k = 0; k < count; k++) {
+        ftt_fwd(ctx, x.data() + k*phim, X_ref.data() + k*phim);
+    }
+
+    uv64 X(x);
+    ftt_fwd_batch(ctx, X.data(), count);
+    EXPECT_EQ(X_ref, X);
+
+    X = x;
+    ftt_fwd_batch(ctx, X.data(), count, &pool);
+    EXPECT_EQ(X_ref, X);
+
+    ftt_inv_batch(ctx, X.data(), count, &pool);
+    EXPECT_EQ(x, X);
+}
+
 
 /*
 TEST(UTNTT, switch_format_simple_single_crt) {